@@ -0,0 +1,80 @@
+/**
+ * Aggregator implementation
+ */
+
+#include "Aggregator.h"
+#include <math.h>
+
+Aggregator::Aggregator() {
+  periodMs = 5000;
+  periodStartMs = 0;
+  count = 0;
+  firstTimestamp = 0;
+  sumCurrentSq = 0.0;
+  sumVoltage = 0.0;
+  sumPower = 0.0;
+  peakPower = 0.0;
+  lastEnergy = 0.0;
+  lastCount = 0;
+  lastPeak = 0.0;
+}
+
+void Aggregator::setPeriod(uint32_t periodMs) {
+  this->periodMs = periodMs;
+}
+
+bool Aggregator::add(const PowerData &measurement, uint32_t nowMs, PowerData &out) {
+  if (count == 0) {
+    start(measurement, nowMs);
+    accumulate(measurement);
+    return false;
+  }
+  
+  if (nowMs - periodStartMs < periodMs) {
+    accumulate(measurement);
+    return false;
+  }
+  
+  // Close the running period; this measurement opens the next one
+  out.timestamp = firstTimestamp;
+  out.synced = firstSynced;
+  out.current = sqrt(sumCurrentSq / count);
+  out.voltage = sumVoltage / count;
+  out.power = sumPower / count;
+  out.energy = lastEnergy;
+  out.peak = peakPower;
+  out.anomaly = false;
+  lastCount = count;
+  lastPeak = peakPower;
+  
+  start(measurement, nowMs);
+  accumulate(measurement);
+  return true;
+}
+
+void Aggregator::start(const PowerData &measurement, uint32_t nowMs) {
+  // Keep periods on a fixed grid unless a whole period was skipped
+  if (count > 0 && nowMs - periodStartMs < 2 * periodMs) {
+    periodStartMs += periodMs;
+  } else {
+    periodStartMs = nowMs;
+  }
+  count = 0;
+  firstTimestamp = measurement.timestamp;
+  firstSynced = measurement.synced;
+  sumCurrentSq = 0.0;
+  sumVoltage = 0.0;
+  sumPower = 0.0;
+  peakPower = measurement.power;
+}
+
+void Aggregator::accumulate(const PowerData &measurement) {
+  count++;
+  sumCurrentSq += (double)measurement.current * measurement.current;
+  sumVoltage += measurement.voltage;
+  sumPower += measurement.power;
+  if (measurement.power > peakPower) {
+    peakPower = measurement.power;
+  }
+  lastEnergy = measurement.energy;
+}
@@ -0,0 +1,47 @@
+/**
+ * Aggregator Class
+ * Folds measurements taken at the measurement rate into one reading per
+ * aggregation period, so the measurement rate can be raised without
+ * raising the load on analytics and the network (and the other way round)
+ */
+
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <stdint.h>
+#include "PowerData.h"
+
+class Aggregator {
+public:
+  Aggregator();
+  
+  void setPeriod(uint32_t periodMs);
+  uint32_t getPeriod() const { return periodMs; }
+  
+  // Adds a measurement taken at nowMs. When it starts a new period the
+  // finished one is written to out and true is returned.
+  bool add(const PowerData &measurement, uint32_t nowMs, PowerData &out);
+  
+  uint32_t getLastCount() const { return lastCount; }   // Measurements in the last period
+  float getLastPeakPower() const { return lastPeak; }   // Highest measured power in the last period (W)
+  
+private:
+  uint32_t periodMs;
+  uint32_t periodStartMs;
+  uint32_t count;
+  unsigned long firstTimestamp;
+  bool firstSynced;
+  double sumCurrentSq;             // Current is combined as RMS over the period
+  double sumVoltage;
+  double sumPower;
+  float peakPower;
+  float lastEnergy;
+  
+  uint32_t lastCount;
+  float lastPeak;
+  
+  void start(const PowerData &measurement, uint32_t nowMs);
+  void accumulate(const PowerData &measurement);
+};
+
+#endif // AGGREGATOR_H
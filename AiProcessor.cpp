@@ -3,170 +3,1084 @@
  */
 
 #include "AiProcessor.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "Arena.h"
 #include <math.h>
+#include <string.h>
 
-AiProcessor::AiProcessor() {
+AiProcessor::AiProcessor() : shortWindow(QUANTILE_SHORT_HORIZON), longWindow(QUANTILE_LONG_HORIZON) {
   powerPrediction = 0.0;
+  robustZ = ROBUST_Z_THRESHOLD;
+  robustMinSamples = ROBUST_MIN_SAMPLES;
+  criticalRatio = ANOMALY_CRITICAL_RATIO;
+  baselineZ = BASELINE_Z_THRESHOLD;
+  trendWindow = TREND_WINDOW_SIZE;
+  lastScore = 0.0f;
+  outliers = 0;
+  anomalyPending = false;
+  memset(&anomalyStatus, 0, sizeof(anomalyStatus));
+  memset(&modelStatus, 0, sizeof(modelStatus));
+  memset(&waveformStatus, 0, sizeof(waveformStatus));
+  waveformStatus.label = -1;
+  memset(&changes, 0, sizeof(changes));
+  samplesSinceRebuild = 0;
+  rollupHour = 0;
+  rollupSum = 0.0;
+  rollupCount = 0;
+  savedForecastVersion = 0;
+  memset(&baselineStatus, 0, sizeof(baselineStatus));
+  baselineChanged = false;
+  savedBaselineVersion = 0;
+  lastEnergy = -1.0f;
+  trendPercent = 0.0f;
+  trendValid = false;
+  projectionChanged = false;
+  savedProjectionVersion = 0;
+  tariff.pricePerKwh = TARIFF_PRICE_PER_KWH;
+  tariff.standingPerDay = TARIFF_STANDING_PER_DAY;
+  tariff.billingDay = TARIFF_BILLING_DAY;
+  strlcpy(tariff.currency, TARIFF_CURRENCY, sizeof(tariff.currency));
+  projector.setTariff(tariff.pricePerKwh, tariff.standingPerDay, tariff.billingDay);
+  readingSeconds = 5.0f;
+  savedLibraryVersion = 0;
+  savedStatesVersion = 0;
 }
 
-void AiProcessor::begin() {
+// Fixed-size state blobs on SPIFFS; a missing or short file is not loaded
+static bool loadBlob(const char *path, void *data, size_t size) {
+  if (!SPIFFS.exists(path)) {
+    return false;
+  }
+  
+  File file = SPIFFS.open(path, "r");
+  if (!file) {
+    return false;
+  }
+  bool complete = file.size() == size && file.read((uint8_t *)data, size) == size;
+  file.close();
+  
+  if (!complete) {
+    Serial.printf("%s has the wrong size, ignoring it\n", path);
+  }
+  return complete;
+}
+
+static bool saveBlob(const char *path, const void *data, size_t size) {
+  File file = SPIFFS.open(path, "w");
+  if (!file) {
+    LOG_WARN("Failed to open %s for writing", path);
+    return false;
+  }
+  
+  size_t written = file.write((const uint8_t *)data, size);
+  file.close();
+  if (written != size) {
+    LOG_WARN("Write to %s failed (%u of %u bytes)", path, (unsigned)written, (unsigned)size);
+    return false;
+  }
+  return true;
+}
+
+void AiProcessor::begin(const ParamBundle &bundle) {
   // Initialize the data history with empty space
   dataHistory.clear();
+  stats.reset();
+  applyParams(bundle);
+  
+  // Seasonal state, the weekly profile, the energy registers, the appliance
+  // library and the operating states survive reboots; a missing or stale
+  // file starts fresh
+  loadForecast();
+  loadBaseline();
+  loadProjection();
+  loadAppliances();
+  loadStates();
+  
+  // The model and waveform reference set are used in place from the bundle
+  loadModel(bundle);
+  loadWaveforms(bundle);
   
   Serial.println("AiProcessor initialized");
 }
 
-void AiProcessor::update(const PowerData &data) {
-  // Add new data to history
-  dataHistory.push_back(data);
+void AiProcessor::applyParams(const ParamBundle &bundle) {
+  // Ranges are listed in tools/make_bundle.py; values outside them are clamped
+  robustZ = bundle.getParam("robust_z", ROBUST_Z_THRESHOLD, 1.0f, 20.0f);
+  robustMinSamples = (uint32_t)bundle.getParam("robust_min_samples", ROBUST_MIN_SAMPLES, 8, QUANTILE_SHORT_HORIZON);
+  criticalRatio = bundle.getParam("critical_ratio", ANOMALY_CRITICAL_RATIO, 1.0f, 10.0f);
+  baselineZ = bundle.getParam("baseline_z", BASELINE_Z_THRESHOLD, 1.0f, 20.0f);
+  states.setRejectSigma(bundle.getParam("state_reject_sigma", OPSTATE_REJECT_SIGMA, 1.0f, 10.0f));
+  
+  // The trend compares two halves of at most the stored window
+  uint32_t window = (uint32_t)bundle.getParam("trend_window", TREND_WINDOW_SIZE, 16, TREND_WINDOW_SIZE);
+  trendWindow = window & ~1UL;
   
-  // Keep history size limited to TREND_WINDOW_SIZE
-  if (dataHistory.size() > TREND_WINDOW_SIZE) {
-    dataHistory.pop_front();
+  // Level thresholds and creep sensitivity per rollup scale
+  static const char *const names[ANOMALY_SCALE_COUNT][3] = {
+    { NULL, NULL, NULL },
+    { "minute_z_warning", "minute_z_critical", "minute_creep_h" },
+    { "quarter_z_warning", "quarter_z_critical", "quarter_creep_h" },
+    { "hour_z_warning", "hour_z_critical", "hour_creep_h" }
+  };
+  for (int scale = ANOMALY_SCALE_MINUTE; scale < ANOMALY_SCALE_COUNT; scale++) {
+    MultiScaleDetector::ScaleParams params = MultiScaleDetector::defaultParams((AnomalyScale)scale);
+    params.zWarning = bundle.getParam(names[scale][0], params.zWarning, 1.0f, 50.0f);
+    params.zCritical = bundle.getParam(names[scale][1], params.zCritical, 1.0f, 50.0f);
+    params.creepH = bundle.getParam(names[scale][2], params.creepH, 0.0f, 100.0f);
+    scales.setScaleParams((AnomalyScale)scale, params);
   }
   
-  // Update prediction for next interval
+  if (bundle.isBound()) {
+    Serial.printf("Parameter bundle %u: %u parameters, robust z %.1f, baseline z %.1f\n",
+                  (unsigned)bundle.getSequence(), (unsigned)bundle.getParamCount(), robustZ, baselineZ);
+  }
+}
+
+void AiProcessor::setReadingInterval(uint32_t intervalMs) {
+  readingSeconds = intervalMs / 1000.0f;
+  scales.setReadingInterval(intervalMs);
+}
+
+void AiProcessor::setTariff(const Tariff &tariff) {
+  this->tariff = tariff;
+  projector.setTariff(tariff.pricePerKwh, tariff.standingPerDay, tariff.billingDay);
+}
+
+void AiProcessor::processBatch(PowerData *batch, size_t count) {
+  PROFILE_ZONE(PROF_AI);
+  if (count == 0) {
+    return;
+  }
+  
+  // Each reading is scored against the windows as they were before it
+  for (size_t i = 0; i < count; i++) {
+    batch[i].anomaly = detectAnomaly(batch[i]);
+    update(batch[i]);
+  }
+  
+  // Only the newest regression prediction is ever read, so the trend
+  // window takes the whole batch at once
+  appendHistory(batch, count);
   updatePrediction();
+  publishBatch();
+}
+
+void AiProcessor::appendHistory(const PowerData *batch, size_t count) {
+  // The ring keeps only the last TREND_WINDOW_SIZE
+  for (size_t i = 0; i < count; i++) {
+    if (dataHistory.full()) {
+      stats.popOldest(dataHistory.oldest());
+    }
+    dataHistory.push(batch[i].power);
+    stats.push(batch[i].power);
+  }
+  
+  // Recompute the running sums from the window now and then to bound drift
+  samplesSinceRebuild += count;
+  if (samplesSinceRebuild >= STATS_REBUILD_INTERVAL) {
+    rebuildStats();
+  }
+}
+
+void AiProcessor::publishBatch() {
+  // Readers only ever want the latest summaries, so they are copied out
+  // once per batch rather than once per reading
+  publishQuantiles();
+  if (baselineChanged) {
+    baselineSummary.publish(baselineStatus);
+    baselineChanged = false;
+  }
+  publishBaseload();
+  if (projectionChanged) {
+    publishProjection();
+    projectionChanged = false;
+  }
+  publishAppliances();
+  statePublishBuffer.learned = states.getState();
+  statePublishBuffer.current = states.getCurrent();
+  stateSummary.publish(statePublishBuffer);
+}
+
+void AiProcessor::update(const PowerData &data) {
+  // Robust baselines; the outlier score was taken against the windows before this reading
+  shortWindow.add(data.power);
+  longWindow.add(data.power);
+  
+  // Longer scales are only tested when their rollup period closes
+  AnomalyEvent events[ANOMALY_SCALE_COUNT];
+  int found = scales.update(data.power, millis(), events);
+  for (int i = 0; i < found; i++) {
+    raiseAnomaly(events[i]);
+  }
+  
+  // Seasonal forecasting and the weekly profile work on wall-clock time
+  rollupHourly(data);
+  updateBaseline(data);
+  updateProjection(data);
+  
+  // Split this reading's energy into always-on and active use, and
+  // attribute it to the appliances running now
+  updateBaseload(data);
+  disaggregator.accumulate(data.power, readingSeconds);
+  updateStates(data);
+}
+
+void AiProcessor::onChange(const ChangeEvent &event) {
+  LOG_INFO("Load change: %s %+.1f W to %.1f W, detected after %u ms", ChangeDetector::typeName(event.type),
+           event.magnitude, event.after, (unsigned)event.delayMs);
+  
+  if (event.type == CHANGE_STEP_UP || event.type == CHANGE_STEP_DOWN) {
+    changes.steps++;
+  } else {
+    changes.drifts++;
+  }
+  changes.last = event;
+  changeSummary.publish(changes);
+  
+  // Load changes are expected behaviour; they go into the stream for context only
+  raiseAnomaly(ANOMALY_SCALE_READING, ANOMALY_CHANGE, ANOMALY_INFO, event.after, event.before, event.magnitude);
+  
+  ApplianceMatch match = disaggregator.onChange(event);
+  if (match.index >= 0) {
+    const ApplianceSignature &appliance = disaggregator.getAppliance(match.index);
+    // Printed directly: the deferred logger keeps string arguments by
+    // pointer, and learn() can evict and rename this slot before it formats
+    Serial.printf("Appliance %s %s (%.0f W)%s\n", appliance.name, match.on ? "on" : "off", appliance.power,
+                  match.learned ? ", new signature" : "");
+  }
 }
 
 bool AiProcessor::detectAnomaly(const PowerData &data) {
-  // Simple anomaly detection based on standard deviation
-  if (dataHistory.size() < 3) {
-    return false; // Not enough data for detection
+  // Median and MAD are not pulled towards the outliers they are meant to
+  // catch, and stay meaningful when the load switches between two levels
+  if (shortWindow.coverage() >= robustMinSamples) {
+    lastScore = shortWindow.score(data.power);
+    if (fabsf(lastScore) > robustZ) {
+      outliers++;
+      raiseAnomaly(ANOMALY_SCALE_READING, ANOMALY_OUTLIER, severityOf(lastScore, robustZ), data.power,
+                   shortWindow.median(), lastScore);
+    }
   }
   
-  float avg = calculateMovingAverage(data.power);
-  float stdDev = calculateStandardDeviation();
+  // Longer scales, the weekly profile and the model raise events as their
+  // periods close; the next aggregated reading carries the flag
+  bool anomaly = anomalyPending;
+  anomalyPending = false;
+  return anomaly;
+}
+
+AnomalySeverity AiProcessor::severityOf(float score, float threshold) const {
+  return fabsf(score) > threshold * criticalRatio ? ANOMALY_CRITICAL : ANOMALY_WARNING;
+}
+
+void AiProcessor::raiseAnomaly(AnomalyScale scale, AnomalyKind kind, AnomalySeverity severity, float value,
+                               float expected, float score) {
+  AnomalyEvent event;
+  event.scale = scale;
+  event.severity = severity;
+  event.kind = kind;
+  event.reserved = 0;
+  event.value = value;
+  event.expected = expected;
+  event.score = score;
+  event.timestampMs = millis();
+  raiseAnomaly(event);
+}
+
+void AiProcessor::raiseAnomaly(const AnomalyEvent &event) {
+  anomalyStatus.counts[event.scale][event.severity]++;
+  anomalyStatus.recent[anomalyStatus.total % ANOMALY_RECENT_EVENTS] = event;
+  anomalyStatus.total++;
+  anomalySummary.publish(anomalyStatus);
   
-  // Check if current value deviates significantly from moving average
-  float deviation = fabs(data.power - avg);
+  if (event.severity == ANOMALY_INFO) {
+    return;
+  }
+  anomalyPending = true;
+  const char *scale = MultiScaleDetector::scaleName((AnomalyScale)event.scale);
+  const char *kind = MultiScaleDetector::kindName((AnomalyKind)event.kind);
+  if (event.severity == ANOMALY_CRITICAL) {
+    LOG_WARN("Critical %s %s anomaly: %.1f W, score %+.1f", scale, kind, event.value, event.score);
+  } else {
+    LOG_INFO("Warning %s %s anomaly: %.1f W, score %+.1f", scale, kind, event.value, event.score);
+  }
+}
+
+bool AiProcessor::getAnomalies(AnomalySummary &out) {
+  return anomalySummary.read(out);
+}
+
+void AiProcessor::addAnomalyTelemetry(JsonObject &out) {
+  AnomalySummary summary;
+  if (!anomalySummary.read(summary)) {
+    out["total"] = 0;
+    return;
+  }
   
-  if (deviation > (stdDev * ANOMALY_THRESHOLD)) {
-    Serial.print("Anomaly detected! Current: ");
-    Serial.print(data.power);
-    Serial.print(" W, Avg: ");
-    Serial.print(avg);
-    Serial.print(" W, Deviation: ");
-    Serial.print(deviation);
-    Serial.print(" (threshold: ");
-    Serial.print(stdDev * ANOMALY_THRESHOLD);
-    Serial.println(")");
-    return true;
+  out["total"] = summary.total;
+  JsonObject counts = out.createNestedObject("scales");
+  for (int scale = 0; scale < ANOMALY_SCALE_COUNT; scale++) {
+    JsonObject entry = counts.createNestedObject(MultiScaleDetector::scaleName((AnomalyScale)scale));
+    entry["warning"] = summary.counts[scale][ANOMALY_WARNING];
+    entry["critical"] = summary.counts[scale][ANOMALY_CRITICAL];
   }
   
-  return false;
+  // Newest first
+  JsonArray recent = out.createNestedArray("recent");
+  uint32_t shown = summary.total < ANOMALY_RECENT_EVENTS ? summary.total : ANOMALY_RECENT_EVENTS;
+  uint32_t now = millis();
+  for (uint32_t i = 0; i < shown; i++) {
+    const AnomalyEvent &event = summary.recent[(summary.total - 1 - i) % ANOMALY_RECENT_EVENTS];
+    JsonObject entry = recent.createNestedObject();
+    entry["scale"] = MultiScaleDetector::scaleName((AnomalyScale)event.scale);
+    entry["severity"] = MultiScaleDetector::severityName((AnomalySeverity)event.severity);
+    entry["kind"] = MultiScaleDetector::kindName((AnomalyKind)event.kind);
+    entry["value_w"] = event.value;
+    entry["expected_w"] = event.expected;
+    entry["score"] = event.score;
+    entry["age_s"] = (now - event.timestampMs) / 1000;
+  }
 }
 
 void AiProcessor::analyzeTrend() {
-  if (dataHistory.size() < TREND_WINDOW_SIZE) {
-    Serial.println("Not enough data for trend analysis");
+  if (dataHistory.size() < trendWindow) {
+    LOG_INFO("Not enough data for trend analysis");
     return;
   }
   
   // Calculate simple trend (increasing, decreasing, stable)
   float firstAvg = 0.0;
   float lastAvg = 0.0;
+  size_t first = dataHistory.size() - trendWindow;
+  size_t half = trendWindow / 2;
   
   // First half average
-  for (size_t i = 0; i < TREND_WINDOW_SIZE / 2; i++) {
-    firstAvg += dataHistory[i].power;
+  for (size_t i = 0; i < half; i++) {
+    firstAvg += dataHistory.get(0, first + i);
   }
-  firstAvg /= (TREND_WINDOW_SIZE / 2);
+  firstAvg /= half;
   
   // Second half average
-  for (size_t i = TREND_WINDOW_SIZE / 2; i < TREND_WINDOW_SIZE; i++) {
-    lastAvg += dataHistory[i].power;
+  for (size_t i = half; i < trendWindow; i++) {
+    lastAvg += dataHistory.get(0, first + i);
   }
-  lastAvg /= (TREND_WINDOW_SIZE / 2);
+  lastAvg /= half;
   
   float change = lastAvg - firstAvg;
   float percentChange = (change / firstAvg) * 100.0;
+  trendPercent = percentChange;
+  trendValid = isfinite(percentChange);
   
-  Serial.print("Power trend analysis: ");
   if (fabs(percentChange) < 5.0) {
-    Serial.println("Stable usage");
+    LOG_INFO("Power trend analysis: Stable usage");
   } else if (percentChange > 0) {
-    Serial.print("Increasing (");
-    Serial.print(percentChange);
-    Serial.println("%)");
+    LOG_INFO("Power trend analysis: Increasing (%.2f%%)", percentChange);
   } else {
-    Serial.print("Decreasing (");
-    Serial.print(-percentChange);
-    Serial.println("%)");
+    LOG_INFO("Power trend analysis: Decreasing (%.2f%%)", -percentChange);
   }
 }
 
 float AiProcessor::getPredictedPower() {
+  if (forecaster.isReady()) {
+    return forecaster.forecast(1);
+  }
   return powerPrediction;
 }
 
-float AiProcessor::calculateMovingAverage(float value) {
-  if (dataHistory.empty()) {
-    return value;
+bool AiProcessor::getForecast(ForecastSummary &out) {
+  return forecastSummary.read(out);
+}
+
+void AiProcessor::addForecastTelemetry(JsonObject &out) {
+  ForecastSummary summary;
+  if (!forecastSummary.read(summary)) {
+    out["ready"] = false;
+    out["hours"] = 0;
+    return;
   }
   
-  float sum = 0;
-  for (const auto &data : dataHistory) {
-    sum += data.power;
+  out["ready"] = summary.ready;
+  out["hours"] = summary.hours;
+  out["next_hour_w"] = summary.nextHour;
+  out["low_w"] = summary.low;
+  out["high_w"] = summary.high;
+  out["mape"] = summary.mape;
+}
+
+static void fillBaseline(const RobustWindow &window, QuantileBaseline &out) {
+  for (int i = 0; i < ROBUST_QUANTILE_COUNT; i++) {
+    out.percentile[i] = window.quantile((RobustQuantile)i);
+  }
+  out.mad = window.mad();
+  out.coverage = window.coverage();
+}
+
+void AiProcessor::publishQuantiles() {
+  QuantileSummary summary;
+  fillBaseline(shortWindow, summary.shortTerm);
+  fillBaseline(longWindow, summary.longTerm);
+  summary.lastScore = lastScore;
+  summary.outliers = outliers;
+  quantileSummary.publish(summary);
+}
+
+bool AiProcessor::getQuantiles(QuantileSummary &out) {
+  return quantileSummary.read(out);
+}
+
+static void addBaseline(const QuantileBaseline &baseline, JsonObject out) {
+  out["p05_w"] = baseline.percentile[ROBUST_P05];
+  out["p25_w"] = baseline.percentile[ROBUST_P25];
+  out["p50_w"] = baseline.percentile[ROBUST_P50];
+  out["p75_w"] = baseline.percentile[ROBUST_P75];
+  out["p95_w"] = baseline.percentile[ROBUST_P95];
+  out["mad_w"] = baseline.mad;
+  out["readings"] = baseline.coverage;
+}
+
+void AiProcessor::addQuantileTelemetry(JsonObject &out) {
+  QuantileSummary summary;
+  if (!quantileSummary.read(summary)) {
+    out["outliers"] = 0;
+    return;
   }
   
-  return sum / dataHistory.size();
+  out["outliers"] = summary.outliers;
+  out["last_score"] = summary.lastScore;
+  addBaseline(summary.shortTerm, out.createNestedObject("short"));
+  addBaseline(summary.longTerm, out.createNestedObject("long"));
 }
 
-float AiProcessor::calculateStandardDeviation() {
-  if (dataHistory.size() < 2) {
-    return 0.0;
+void AiProcessor::addChangeTelemetry(JsonObject &out) {
+  ChangeSummary summary;
+  if (!changeSummary.read(summary)) {
+    out["steps"] = 0;
+    out["drifts"] = 0;
+    return;
   }
   
-  // Calculate mean
-  float mean = 0.0;
-  for (const auto &data : dataHistory) {
-    mean += data.power;
+  out["steps"] = summary.steps;
+  out["drifts"] = summary.drifts;
+  out["last_type"] = ChangeDetector::typeName(summary.last.type);
+  out["last_magnitude_w"] = summary.last.magnitude;
+  out["last_delay_ms"] = summary.last.delayMs;
+}
+
+void AiProcessor::registerJobs(Scheduler &analytics, Scheduler &storage, unsigned long trendIntervalMs) {
+  analytics.addPeriodic("ai-trend", trendIntervalMs, trendJob, this, trendIntervalMs);
+  storage.addPeriodic("ai-save", AI_STATE_SAVE_INTERVAL, saveJob, this, AI_STATE_SAVE_INTERVAL);
+}
+
+void AiProcessor::rollupHourly(const PowerData &data) {
+  // Readings taken before NTP sync carry uptime and have no hour of day
+  if (!data.synced) {
+    return;
   }
-  mean /= dataHistory.size();
   
-  // Calculate sum of squared differences
-  float sumSqDiff = 0.0;
-  for (const auto &data : dataHistory) {
-    float diff = data.power - mean;
-    sumSqDiff += diff * diff;
+  uint32_t hour = (data.timestamp + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC) / 3600;
+  if (rollupCount > 0 && hour != rollupHour) {
+    forecaster.update(rollupHour, (float)(rollupSum / rollupCount));
+    publishForecast();
+    rollupSum = 0.0;
+    rollupCount = 0;
   }
   
-  // Standard deviation
-  return sqrt(sumSqDiff / (dataHistory.size() - 1));
+  rollupHour = hour;
+  rollupSum += data.power;
+  rollupCount++;
 }
 
-void AiProcessor::updatePrediction() {
-  if (dataHistory.size() < 2) {
-    if (!dataHistory.empty()) {
-      powerPrediction = dataHistory.back().power;
+void AiProcessor::publishForecast() {
+  ForecastSummary summary;
+  summary.ready = forecaster.isReady();
+  summary.hours = forecaster.getObservations();
+  summary.nextHour = forecaster.forecast(1);
+  forecaster.interval(1, summary.low, summary.high);
+  summary.mape = forecaster.getMape();
+  forecastSummary.publish(summary);
+  forecastState.publish(forecaster.getState());
+}
+
+void AiProcessor::loadForecast() {
+  if (!loadBlob(FORECAST_STATE_FILE, &forecastBuffer, sizeof(forecastBuffer))) {
+    return;
+  }
+  
+  if (forecaster.setState(forecastBuffer)) {
+    publishForecast();
+    savedForecastVersion = forecastState.getVersion();
+    Serial.printf("Seasonal forecast restored (%u hours)\n", (unsigned)forecaster.getObservations());
+  } else {
+    Serial.println("Seasonal forecast state invalid, starting fresh");
+  }
+}
+
+void AiProcessor::updateBaseline(const PowerData &data) {
+  if (!data.synced) {
+    return;
+  }
+  
+  uint32_t localSeconds = data.timestamp + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC;
+  if (baseline.update(localSeconds, data.power, baselineStatus.reading, baselineStatus.period)) {
+    const BaselineDeviation &period = baselineStatus.period;
+    if (period.valid && fabsf(period.score) > baselineZ) {
+      raiseAnomaly(MultiScaleDetector::scaleOf(BASELINE_PERIOD_SECONDS), ANOMALY_PROFILE,
+                   severityOf(period.score, baselineZ), period.value, period.expected, period.score);
+    }
+    baselineStatus.learnedBins = baseline.getLearnedBins();
+    baselineStatus.periods = baseline.getPeriods();
+    baselineState.publish(baseline.getState());
+  }
+  baselineChanged = true;
+}
+
+void AiProcessor::loadBaseline() {
+  if (!loadBlob(BASELINE_STATE_FILE, &baselineBuffer, sizeof(baselineBuffer))) {
+    return;
+  }
+  
+  if (baseline.setState(baselineBuffer)) {
+    baselineStatus.learnedBins = baseline.getLearnedBins();
+    baselineStatus.periods = baseline.getPeriods();
+    baselineState.publish(baseline.getState());
+    savedBaselineVersion = baselineState.getVersion();
+    Serial.printf("Weekly profile restored (%u of %u slots learned)\n", (unsigned)baselineStatus.learnedBins,
+                  (unsigned)BASELINE_BINS);
+  } else {
+    Serial.println("Weekly profile state invalid, starting fresh");
+  }
+}
+
+bool AiProcessor::getBaseline(BaselineSummary &out) {
+  return baselineSummary.read(out);
+}
+
+static void addDeviation(const BaselineDeviation &deviation, JsonObject out) {
+  out["valid"] = deviation.valid;
+  out["bin"] = deviation.bin;
+  out["value_w"] = deviation.value;
+  out["expected_w"] = deviation.expected;
+  out["sigma_w"] = deviation.sigma;
+  out["score"] = deviation.score;
+}
+
+void AiProcessor::addBaselineTelemetry(JsonObject &out) {
+  BaselineSummary summary;
+  if (!baselineSummary.read(summary)) {
+    out["learned_bins"] = 0;
+    return;
+  }
+  
+  out["learned_bins"] = summary.learnedBins;
+  out["bins"] = BASELINE_BINS;
+  out["periods"] = summary.periods;
+  addDeviation(summary.reading, out.createNestedObject("reading"));
+  addDeviation(summary.period, out.createNestedObject("period"));
+}
+
+void AiProcessor::updateBaseload(const PowerData &data) {
+  // Days roll over at local midnight once the date is known
+  uint32_t day = 0;
+  if (data.synced) {
+    day = (data.timestamp + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC) / 86400;
+  }
+  baseload.update(day, data.power, readingSeconds);
+}
+
+void AiProcessor::publishBaseload() {
+  BaseloadSummary summary;
+  summary.ready = baseload.isReady();
+  summary.baseload = baseload.getBaseload();
+  summary.sustained = baseload.getSustained();
+  summary.coverageHours = baseload.getCoverageHours();
+  summary.today = baseload.getToday();
+  summary.yesterday = baseload.getYesterday();
+  summary.hasYesterday = baseload.hasYesterday();
+  baseloadSummary.publish(summary);
+}
+
+bool AiProcessor::getBaseload(BaseloadSummary &out) {
+  return baseloadSummary.read(out);
+}
+
+void AiProcessor::addBaseloadTelemetry(JsonObject &out) {
+  BaseloadSummary summary;
+  if (!baseloadSummary.read(summary)) {
+    out["ready"] = false;
+    return;
+  }
+  
+  out["ready"] = summary.ready;
+  out["baseload_w"] = summary.baseload;
+  out["coverage_h"] = summary.coverageHours;
+  out["today_base_kwh"] = summary.today.baseKwh;
+  out["today_active_kwh"] = summary.today.activeKwh;
+  if (summary.hasYesterday) {
+    out["yesterday_base_kwh"] = summary.yesterday.baseKwh;
+    out["yesterday_active_kwh"] = summary.yesterday.activeKwh;
+  }
+}
+
+void AiProcessor::updateProjection(const PowerData &data) {
+  // Energy since the previous reading; a register that went backwards was reset
+  float energy = 0.0f;
+  if (lastEnergy >= 0.0f && data.energy >= lastEnergy) {
+    energy = data.energy - lastEnergy;
+  }
+  lastEnergy = data.energy;
+  if (!data.synced) {
+    return;
+  }
+  
+  projector.update(data.timestamp + GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC, energy, baseline);
+  projectionChanged = true;
+}
+
+void AiProcessor::publishProjection() {
+  projectionState.publish(projector.getState());
+  
+  ProjectionSummary summary;
+  summary.valid = projector.isValid();
+  summary.day = projector.getDay();
+  summary.period = projector.getPeriod();
+  summary.periodStartDay = projector.getPeriodStartDay();
+  summary.trendPercent = trendPercent;
+  summary.trendValid = trendValid;
+  projectionSummary.publish(summary);
+}
+
+void AiProcessor::loadProjection() {
+  if (!loadBlob(PROJECTION_STATE_FILE, &projectionBuffer, sizeof(projectionBuffer))) {
+    return;
+  }
+  
+  if (projector.setState(projectionBuffer)) {
+    projectionState.publish(projector.getState());
+    savedProjectionVersion = projectionState.getVersion();
+    Serial.printf("Energy registers restored (%.3f kWh this billing period)\n", projectionBuffer.periodUsedKwh);
+  } else {
+    Serial.println("Energy register state invalid, starting fresh");
+  }
+}
+
+bool AiProcessor::getProjection(ProjectionSummary &out) {
+  return projectionSummary.read(out);
+}
+
+static void addProjection(const Projection &projection, float pricePerKwh, JsonObject out) {
+  out["used_kwh"] = projection.usedKwh;
+  out["expected_kwh"] = projection.expectedKwh;
+  out["low_kwh"] = projection.lowKwh;
+  out["high_kwh"] = projection.highKwh;
+  out["cost"] = projection.cost;
+  out["cost_low"] = projection.costLow;
+  out["cost_high"] = projection.costHigh;
+  out["used_cost"] = projection.usedKwh * pricePerKwh;
+  out["learned"] = projection.learnedFraction;
+  out["hours_left"] = projection.secondsLeft / 3600.0f;
+}
+
+void AiProcessor::addProjectionTelemetry(JsonObject &out) {
+  ProjectionSummary summary;
+  if (!projectionSummary.read(summary) || !summary.valid) {
+    out["valid"] = false;
+    return;
+  }
+  
+  out["valid"] = true;
+  if (summary.trendValid) {
+    out["trend_pct"] = summary.trendPercent;
+  }
+  out["currency"] = (const char *)tariff.currency;
+  out["price_per_kwh"] = tariff.pricePerKwh;
+  addProjection(summary.day, tariff.pricePerKwh, out.createNestedObject("day"));
+  JsonObject period = out.createNestedObject("period");
+  addProjection(summary.period, tariff.pricePerKwh, period);
+  int year;
+  unsigned month, day;
+  CostProjector::civilFromDays(summary.periodStartDay, year, month, day);
+  char start[11];
+  snprintf(start, sizeof(start), "%04d-%02u-%02u", year, month, day);
+  period["start"] = start;
+  period["days"] = summary.period.days;
+}
+
+void AiProcessor::publishAppliances() {
+  ApplianceSummary &summary = appliancePublishBuffer;
+  summary.library = disaggregator.getLibrary();
+  summary.running = disaggregator.getRunning();
+  applianceSummary.publish(summary);
+}
+
+void AiProcessor::loadAppliances() {
+  if (!loadBlob(NILM_LIBRARY_FILE, &applianceBuffer.library, sizeof(applianceBuffer.library))) {
+    return;
+  }
+  
+  if (disaggregator.setLibrary(applianceBuffer.library)) {
+    publishAppliances();
+    savedLibraryVersion = applianceSummary.getVersion();
+    Serial.printf("Appliance library restored (%u appliances)\n", (unsigned)disaggregator.getCount());
+  } else {
+    Serial.println("Appliance library invalid, starting fresh");
+  }
+}
+
+bool AiProcessor::getAppliances(ApplianceSummary &out) {
+  return applianceSummary.read(out);
+}
+
+void AiProcessor::addApplianceTelemetry(JsonObject &out) {
+  if (!applianceSummary.read(applianceBuffer)) {
+    out["count"] = 0;
+    return;
+  }
+  
+  const ApplianceLibrary &library = applianceBuffer.library;
+  out["count"] = library.count;
+  out["other_kwh"] = library.otherEnergyKwh;
+  JsonArray loads = out.createNestedArray("loads");
+  for (uint16_t i = 0; i < library.count; i++) {
+    JsonObject load = loads.createNestedObject();
+    load["name"] = library.appliances[i].name;
+    load["on"] = ((applianceBuffer.running >> i) & 1) != 0;
+    load["power_w"] = library.appliances[i].power;
+    load["energy_kwh"] = library.appliances[i].energyKwh;
+  }
+}
+
+void AiProcessor::updateStates(const PowerData &data) {
+  OperatingStateSummary &summary = statePublishBuffer;
+  states.update(data.power, data.peak, readingSeconds, summary.last);
+  const StateClusterer::State &learned = states.getState();
+  if (summary.last.created) {
+    LOG_INFO("New operating state %d at %.1f W", summary.last.state,
+             StateClusterer::powerOf(learned.clusters[summary.last.state]));
+  }
+  
+  // Once the states have had a memory's worth of readings, a reading that
+  // fits none of them is an unfamiliar operating condition
+  if (summary.last.novel && learned.readings >= OPSTATE_MEMORY) {
+    raiseAnomaly(ANOMALY_SCALE_READING, ANOMALY_STATE, ANOMALY_WARNING, data.power,
+                 StateClusterer::powerOf(learned.clusters[summary.last.nearest]), summary.last.score);
+  }
+}
+
+void AiProcessor::loadStates() {
+  if (!loadBlob(OPSTATE_STATE_FILE, &stateBuffer.learned, sizeof(stateBuffer.learned))) {
+    return;
+  }
+  
+  if (states.setState(stateBuffer.learned)) {
+    statePublishBuffer.learned = states.getState();
+    statePublishBuffer.current = -1;
+    statePublishBuffer.last.state = -1;
+    statePublishBuffer.last.nearest = -1;
+    statePublishBuffer.last.novel = false;
+    statePublishBuffer.last.created = false;
+    statePublishBuffer.last.score = 0.0f;
+    stateSummary.publish(statePublishBuffer);
+    savedStatesVersion = stateSummary.getVersion();
+    Serial.printf("Operating states restored (%u learned)\n", (unsigned)states.getActiveCount());
+  } else {
+    Serial.println("Operating state model invalid, starting fresh");
+  }
+}
+
+bool AiProcessor::getStates(OperatingStateSummary &out) {
+  return stateSummary.read(out);
+}
+
+void AiProcessor::addStateTelemetry(JsonObject &out) {
+  if (!stateSummary.read(stateBuffer)) {
+    out["count"] = 0;
+    return;
+  }
+  
+  const StateClusterer::State &learned = stateBuffer.learned;
+  out["current"] = stateBuffer.current;
+  out["unknown_readings"] = learned.unknownReadings;
+  out["unknown_kwh"] = learned.unknownKwh;
+  JsonArray list = out.createNestedArray("states");
+  int count = 0;
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    const StateClusterer::Cluster &cluster = learned.clusters[i];
+    if (cluster.weight <= 0.0f) {
+      continue;
+    }
+    count++;
+    JsonObject state = list.createNestedObject();
+    state["id"] = i;
+    state["power_w"] = StateClusterer::powerOf(cluster);
+    state["peak_ratio"] = StateClusterer::peakRatioOf(cluster);
+    state["hours"] = cluster.seconds / 3600.0;
+    state["energy_kwh"] = cluster.energyKwh;
+    JsonArray to = state.createNestedArray("to");
+    for (int j = 0; j < OPSTATE_CLUSTERS; j++) {
+      to.add(learned.transitions[i][j]);
+    }
+  }
+  out["count"] = count;
+}
+
+void AiProcessor::loadModel(const ParamBundle &bundle) {
+  size_t size;
+  const uint8_t *blob = bundle.section(BUNDLE_SECTION_MODEL, size);
+  if (blob == NULL) {
+    Serial.println("No model in the parameter bundle, model inference disabled");
+    return;
+  }
+  
+  uint8_t *arena = bootArena.allocateArray<uint8_t>(MODEL_ARENA_SIZE);
+  if (!model.load(blob, size, arena, arena ? MODEL_ARENA_SIZE : 0)) {
+    Serial.printf("No usable model in the parameter bundle (%s)\n", model.getError());
+    return;
+  }
+  
+  modelStatus.loaded = true;
+  modelStatus.kind = model.getKind();
+  modelStatus.selfTest = model.selfTest();
+  modelStatus.arenaUsed = model.getArenaUsed();
+  modelStatus.arenaCapacity = model.getArenaCapacity();
+  modelStatus.label = -1;
+  modelSummary.publish(modelStatus);
+  Serial.printf("Model loaded: kind %u, %u -> %u values, arena %u/%u bytes, self-test %08x\n",
+                modelStatus.kind, (unsigned)model.inputSize(), (unsigned)model.outputSize(),
+                (unsigned)modelStatus.arenaUsed, (unsigned)modelStatus.arenaCapacity, (unsigned)modelStatus.selfTest);
+}
+
+void AiProcessor::runModel() {
+  PROFILE_ZONE(PROF_AI);
+  
+  // The input window is the most recent readings, oldest first
+  size_t count = model.inputSize();
+  if (!model.isLoaded() || dataHistory.size() < count) {
+    return;
+  }
+  size_t first = dataHistory.size() - count;
+  for (size_t i = 0; i < count; i++) {
+    model.setInput(i, dataHistory.get(0, first + i));
+  }
+  model.invoke();
+  
+  if (model.getKind() == MODEL_AUTOENCODER && model.outputSize() == count) {
+    // Mean squared reconstruction error, in watts squared
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      double error = model.dequantizeOutput(i) - model.dequantizeInput(i);
+      sum += error * error;
+    }
+    modelStatus.score = (float)(sum / count);
+    if (modelStatus.score > model.getThreshold()) {
+      AnomalyScale scale = MultiScaleDetector::scaleOf((uint32_t)(count * readingSeconds));
+      raiseAnomaly(scale, ANOMALY_MODEL, severityOf(modelStatus.score, model.getThreshold()),
+                   modelStatus.score, model.getThreshold(), modelStatus.score / model.getThreshold());
+    }
+  } else if (model.getKind() == MODEL_CLASSIFIER) {
+    int best = 0;
+    for (size_t i = 1; i < model.outputSize(); i++) {
+      if (model.output()[i] > model.output()[best]) {
+        best = i;
+      }
     }
+    modelStatus.label = best;
+    modelStatus.confidence = model.dequantizeOutput(best);
+    LOG_INFO("Model class %d (%.2f)", best, modelStatus.confidence);
+  }
+  
+  modelStatus.invocations = model.getInvocations();
+  modelStatus.lastMicros = model.getLastMicros();
+  modelStatus.maxMicros = model.getMaxMicros();
+  modelSummary.publish(modelStatus);
+}
+
+void AiProcessor::loadWaveforms(const ParamBundle &bundle) {
+  size_t size;
+  const uint8_t *blob = bundle.section(BUNDLE_SECTION_WAVEFORMS, size);
+  if (blob == NULL) {
+    Serial.println("No waveform references in the parameter bundle, waveform classification disabled");
+  } else if (!classifier.load(blob, size)) {
+    Serial.printf("No usable waveform references in the parameter bundle (%s)\n", classifier.getError());
+  } else {
+    waveformStatus.loaded = true;
+    waveformStatus.refCount = classifier.getRefCount();
+    Serial.printf("Waveform references loaded: %u vectors, %u labels, k=%u\n", (unsigned)classifier.getRefCount(),
+                  (unsigned)classifier.getLabelCount(), (unsigned)classifier.getK());
+  }
+  
+  // Features are still extracted and reported without a reference set
+  waveformSummary.publish(waveformStatus);
+}
+
+void AiProcessor::onWaveform(const WaveformVector &vector) {
+  PROFILE_ZONE(PROF_AI);
+  
+  WaveformKind kind = (WaveformKind)vector.kind;
+  waveformStatus.vectors[kind]++;
+  waveformStatus.last = vector;
+  
+  KnnResult result;
+  if (classifier.classify(vector, result)) {
+    waveformStatus.label = result.label;
+    waveformStatus.votes = result.votes;
+    waveformStatus.neighbours = result.neighbours;
+    waveformStatus.distance = result.distance;
+    waveformStatus.lastMicros = classifier.getLastMicros();
+    waveformStatus.maxMicros = classifier.getMaxMicros();
+    if (result.label < 0) {
+      waveformStatus.unknown++;
+    }
+    LOG_INFO("Waveform %s: %s (%u/%u votes)", WaveformAnalyzer::kindName(kind), classifier.labelName(result.label),
+             (unsigned)result.votes, (unsigned)result.neighbours);
+  } else {
+    waveformStatus.label = -1;
+    waveformStatus.votes = 0;
+    waveformStatus.neighbours = 0;
+  }
+  strlcpy(waveformStatus.labelName, classifier.labelName(waveformStatus.label), sizeof(waveformStatus.labelName));
+  waveformSummary.publish(waveformStatus);
+}
+
+bool AiProcessor::getWaveform(WaveformSummary &out) {
+  return waveformSummary.read(out);
+}
+
+void AiProcessor::addWaveformTelemetry(JsonObject &out) {
+  WaveformSummary summary;
+  if (!waveformSummary.read(summary)) {
+    out["loaded"] = false;
+    return;
+  }
+  
+  out["loaded"] = summary.loaded;
+  out["references"] = summary.refCount;
+  out["steady"] = summary.vectors[WAVEFORM_STEADY];
+  out["transitions"] = summary.vectors[WAVEFORM_TRANSITION];
+  out["unknown"] = summary.unknown;
+  out["classify_last_us"] = summary.lastMicros;
+  out["classify_max_us"] = summary.maxMicros;
+  if (summary.vectors[WAVEFORM_STEADY] + summary.vectors[WAVEFORM_TRANSITION] == 0) {
+    return;
+  }
+  
+  WaveformKind kind = (WaveformKind)summary.last.kind;
+  JsonObject last = out.createNestedObject("last");
+  last["kind"] = WaveformAnalyzer::kindName(kind);
+  last["label"] = summary.labelName;
+  last["votes"] = summary.votes;
+  last["distance"] = summary.distance;
+  JsonObject features = last.createNestedObject("features");
+  for (int i = 0; i < WAVEFORM_FEATURES; i++) {
+    features[WaveformAnalyzer::featureName(kind, i)] = WaveformAnalyzer::toFloat(kind, i, summary.last.values[i]);
+  }
+}
+
+bool AiProcessor::getModel(ModelSummary &out) {
+  return modelSummary.read(out);
+}
+
+void AiProcessor::addModelTelemetry(JsonObject &out) {
+  ModelSummary summary;
+  if (!modelSummary.read(summary)) {
+    out["loaded"] = false;
     return;
   }
   
-  // Simple linear regression for prediction
-  float sumX = 0;
-  float sumY = 0;
-  float sumXY = 0;
-  float sumX2 = 0;
-  int n = dataHistory.size();
+  out["loaded"] = summary.loaded;
+  out["kind"] = summary.kind;
+  out["invocations"] = summary.invocations;
+  out["last_us"] = summary.lastMicros;
+  out["max_us"] = summary.maxMicros;
+  out["arena_used"] = summary.arenaUsed;
+  out["arena_capacity"] = summary.arenaCapacity;
+  if (summary.kind == MODEL_AUTOENCODER) {
+    out["score"] = summary.score;
+  } else if (summary.kind == MODEL_CLASSIFIER) {
+    out["label"] = summary.label;
+    out["confidence"] = summary.confidence;
+  }
+}
+
+void AiProcessor::saveState() {
+  uint32_t version = forecastState.getVersion();
+  if (version != savedForecastVersion && forecastState.read(forecastBuffer) &&
+      saveBlob(FORECAST_STATE_FILE, &forecastBuffer, sizeof(forecastBuffer))) {
+    savedForecastVersion = version;
+  }
+  
+  version = baselineState.getVersion();
+  if (version != savedBaselineVersion && baselineState.read(baselineBuffer) &&
+      saveBlob(BASELINE_STATE_FILE, &baselineBuffer, sizeof(baselineBuffer))) {
+    savedBaselineVersion = version;
+  }
+  
+  version = projectionState.getVersion();
+  if (version != savedProjectionVersion && projectionState.read(projectionBuffer) &&
+      saveBlob(PROJECTION_STATE_FILE, &projectionBuffer, sizeof(projectionBuffer))) {
+    savedProjectionVersion = version;
+  }
   
-  for (int i = 0; i < n; i++) {
-    float x = i;
-    float y = dataHistory[i].power;
-    
-    sumX += x;
-    sumY += y;
-    sumXY += x * y;
-    sumX2 += x * x;
+  version = applianceSummary.getVersion();
+  if (version != savedLibraryVersion && applianceSummary.read(applianceBuffer) &&
+      saveBlob(NILM_LIBRARY_FILE, &applianceBuffer.library, sizeof(applianceBuffer.library))) {
+    savedLibraryVersion = version;
   }
   
-  // Calculate regression line slope and intercept
-  float slope = (n * sumXY - sumX * sumY) / (n * sumX2 - sumX * sumX);
-  float intercept = (sumY - slope * sumX) / n;
+  version = stateSummary.getVersion();
+  if (version != savedStatesVersion && stateSummary.read(stateBuffer) &&
+      saveBlob(OPSTATE_STATE_FILE, &stateBuffer.learned, sizeof(stateBuffer.learned))) {
+    savedStatesVersion = version;
+  }
+}
+
+void AiProcessor::saveJob(void *context) {
+  static_cast<AiProcessor *>(context)->saveState();
+}
+
+void AiProcessor::trendJob(void *context) {
+  AiProcessor *self = static_cast<AiProcessor *>(context);
+  
+  // Run AI trend analysis and the deployed model
+  self->analyzeTrend();
+  self->runModel();
+  
+  // Display prediction
+  if (self->forecaster.isReady()) {
+    float low, high;
+    self->forecaster.interval(1, low, high);
+    LOG_INFO("Forecast next hour: %.1f W (%.1f-%.1f W), MAPE %.1f%%",
+             self->getPredictedPower(), low, high, self->forecaster.getMape());
+  } else {
+    LOG_INFO("Predicted next power usage: %.1f W", self->getPredictedPower());
+  }
+}
+
+void AiProcessor::rebuildStats() {
+  stats.reset();
+  const float *first;
+  const float *second;
+  size_t secondCount;
+  size_t firstCount = dataHistory.spans(0, first, second, secondCount);
+  for (size_t i = 0; i < firstCount; i++) {
+    stats.push(first[i]);
+  }
+  for (size_t i = 0; i < secondCount; i++) {
+    stats.push(second[i]);
+  }
+  samplesSinceRebuild = 0;
+}
+
+void AiProcessor::updatePrediction() {
+  if (dataHistory.size() < 2) {
+    if (!dataHistory.empty()) {
+      powerPrediction = dataHistory.newest();
+    }
+    return;
+  }
   
-  // Predict next value
-  powerPrediction = intercept + slope * n;
+  // Predict next value from the regression line through the window
+  powerPrediction = stats.predict(dataHistory.size());
   
   // Ensure prediction is not negative
   if (powerPrediction < 0) {
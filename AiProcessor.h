@@ -7,30 +7,302 @@
 #define AI_PROCESSOR_H
 
 #include "Config.h"
-#include <deque>
+#include "Scheduler.h"
+#include "ColumnRing.h"
+#include "RunningStats.h"
+#include "SeasonalForecaster.h"
+#include "Snapshot.h"
+#include "ChangeDetector.h"
+#include "LoadDisaggregator.h"
+#include "InferenceEngine.h"
+#include "ParamBundle.h"
+#include "RobustWindow.h"
+#include "WeeklyBaseline.h"
+#include "MultiScaleDetector.h"
+#include "BaseloadEstimator.h"
+#include "CostProjector.h"
+#include "WaveformAnalyzer.h"
+#include "KnnClassifier.h"
+#include "StateClusterer.h"
+
+// Load change counts and the latest event, published for readers on other tasks
+struct ChangeSummary {
+  uint32_t steps;
+  uint32_t drifts;
+  ChangeEvent last;
+};
+
+// Latest hourly forecast, published for readers on other tasks
+struct ForecastSummary {
+  bool ready;
+  uint32_t hours;                 // Hourly observations folded in
+  float nextHour;                 // Mean power expected over the next hour (W)
+  float low;                      // Prediction interval (W)
+  float high;
+  float mape;                     // Mean absolute percentage error of past forecasts (%)
+};
+
+// Appliance library with the running set, published for readers on other tasks
+struct ApplianceSummary {
+  ApplianceLibrary library;
+  uint32_t running;               // Bit per library index
+};
+
+// Deployed model status and its latest result, published for readers on other tasks
+struct ModelSummary {
+  bool loaded;
+  uint8_t kind;                   // ModelKind
+  uint32_t selfTest;              // Output checksum for the fixed self-test input
+  uint32_t invocations;
+  uint32_t lastMicros;
+  uint32_t maxMicros;
+  uint32_t arenaUsed;
+  uint32_t arenaCapacity;
+  float score;                    // Autoencoder reconstruction error
+  int label;                      // Classifier argmax
+  float confidence;               // Classifier score of label
+};
+
+// Waveform feature vectors and their classification, published for readers on other tasks
+struct WaveformSummary {
+  bool loaded;                    // A reference set is mapped
+  uint16_t refCount;
+  uint32_t vectors[WAVEFORM_KIND_COUNT]; // Vectors received, per kind
+  uint32_t unknown;               // Vectors no reference was close enough to
+  WaveformVector last;            // Latest vector
+  int label;                      // Its class; -1 when unknown or not classified
+  char labelName[WAVEFORM_LABEL_LEN];
+  uint8_t votes;
+  uint8_t neighbours;
+  uint32_t distance;              // To the nearest reference
+  uint32_t lastMicros;
+  uint32_t maxMicros;
+};
+
+// Learned operating states with time, energy and transitions, published for readers on other tasks
+struct OperatingStateSummary {
+  StateClusterer::State learned;
+  int8_t current;                 // Confirmed state, -1 when the load fits none
+  StateReading last;              // Latest reading's assignment
+};
+
+// Percentiles and MAD of one horizon
+struct QuantileBaseline {
+  float percentile[ROBUST_QUANTILE_COUNT]; // p05, p25, p50, p75, p95 (W)
+  float mad;                      // Median absolute deviation (W)
+  uint32_t coverage;              // Readings the estimates are based on
+};
+
+// Robust baselines over the short and long horizons, published for readers on other tasks
+struct QuantileSummary {
+  QuantileBaseline shortTerm;
+  QuantileBaseline longTerm;
+  float lastScore;                // Modified z-score of the latest reading against the short horizon
+  uint32_t outliers;              // Readings scored beyond the robust z threshold
+};
+
+// Deviation from the learned weekly profile, published for readers on other tasks
+struct BaselineSummary {
+  uint16_t learnedBins;           // Slots of the week seen at least once
+  uint32_t periods;               // Periods folded in
+  BaselineDeviation reading;      // Latest reading
+  BaselineDeviation period;       // Latest completed period
+};
+
+// Unified anomaly stream from every detector and scale, published for readers on other tasks
+struct AnomalySummary {
+  uint32_t counts[ANOMALY_SCALE_COUNT][ANOMALY_SEVERITY_COUNT];
+  uint32_t total;                 // Events raised; recent[(total - 1) % ANOMALY_RECENT_EVENTS] is the latest
+  AnomalyEvent recent[ANOMALY_RECENT_EVENTS];
+};
+
+// Always-on consumption and the daily energy split, published for readers on other tasks
+struct BaseloadSummary {
+  bool ready;
+  float baseload;                 // Minimum sustained power over the window (W)
+  float sustained;                // Latest sustained level (W)
+  float coverageHours;            // Hours of the window filled so far
+  BaseloadEstimator::DayTotals today;
+  BaseloadEstimator::DayTotals yesterday;
+  bool hasYesterday;
+};
+
+// Energy and cost projections for the day and billing period, published for readers on other tasks
+struct ProjectionSummary {
+  bool valid;                     // Needs NTP time
+  Projection day;
+  Projection period;
+  uint32_t periodStartDay;        // Local days since the epoch
+  float trendPercent;             // Second half of the trend window against the first
+  bool trendValid;
+};
 
 class AiProcessor {
 public:
   AiProcessor();
   
-  void begin();                                 // Initialize the AI processor
-  void update(const PowerData &data);           // Process new power data
-  bool detectAnomaly(const PowerData &data);    // Detect anomalies in current readings
-  void analyzeTrend();                          // Analyze power usage trends
-  float getPredictedPower();                    // Get predicted power for next interval
+  void begin(const ParamBundle &bundle);        // Initialize with the bundle's parameters, model and references
+  void setReadingInterval(uint32_t intervalMs); // Time covered by one reading, for energy attribution
+  void setTariff(const Tariff &tariff);         // Price, standing charge and billing day for projections
+  void processBatch(PowerData *batch, size_t count); // Detect and learn over queued readings in order, setting their anomaly flags
+  void onChange(const ChangeEvent &event);      // Record a load change found on the measurement path
+  void onWaveform(const WaveformVector &vector); // Classify a waveform feature vector from the measurement path
+  void analyzeTrend();                          // Analyze power usage trends (reported with the projections)
+  float getPredictedPower();                    // Next-hour seasonal forecast, or the window regression until it is ready
+  bool getForecast(ForecastSummary &out);       // Latest forecast summary, safe from any task
+  void addChangeTelemetry(JsonObject &out);     // Load change section for the telemetry payload
+  void addForecastTelemetry(JsonObject &out);   // Forecast section for the telemetry payload
+  bool getAppliances(ApplianceSummary &out);    // Appliance library and running set, safe from any task
+  void addApplianceTelemetry(JsonObject &out);  // Per-appliance section for the telemetry payload
+  bool getQuantiles(QuantileSummary &out);      // Robust baselines, safe from any task
+  void addQuantileTelemetry(JsonObject &out);   // Percentile baseline section for the telemetry payload
+  bool getBaseline(BaselineSummary &out);       // Weekly profile deviation, safe from any task
+  void addBaselineTelemetry(JsonObject &out);   // Weekly profile section for the telemetry payload
+  bool getAnomalies(AnomalySummary &out);       // Anomaly counts and latest events, safe from any task
+  void addAnomalyTelemetry(JsonObject &out);    // Anomaly stream section for the telemetry payload
+  bool getBaseload(BaseloadSummary &out);       // Always-on estimate and daily split, safe from any task
+  void addBaseloadTelemetry(JsonObject &out);   // Baseload section for the telemetry payload
+  bool getProjection(ProjectionSummary &out);   // Day and billing period projections, safe from any task
+  void addProjectionTelemetry(JsonObject &out); // Projection section for the telemetry payload
+  bool getWaveform(WaveformSummary &out);       // Latest waveform classification, safe from any task
+  void addWaveformTelemetry(JsonObject &out);   // Waveform section for the telemetry payload
+  bool getStates(OperatingStateSummary &out);   // Learned operating states, safe from any task
+  void addStateTelemetry(JsonObject &out);      // Operating state section for the telemetry payload
+  bool getModel(ModelSummary &out);             // Deployed model status, safe from any task
+  void addModelTelemetry(JsonObject &out);      // Model section for the telemetry payload
+  void saveState();                             // Persist models, profiles and energy registers if changed (network task)
+  void registerJobs(Scheduler &analytics, Scheduler &storage, unsigned long trendIntervalMs); // Trend and persistence jobs
   
 private:
-  std::deque<PowerData> dataHistory;            // Store recent data for analysis
-  float powerPrediction;                        // Predicted power for next interval
+  ColumnRing<TREND_WINDOW_SIZE> dataHistory;    // Power column of recent readings (4 bytes per slot)
+  RunningStats stats;                           // O(1) mean, variance and regression over dataHistory
+  uint32_t samplesSinceRebuild;                 // Updates since stats were recomputed from scratch
+  float powerPrediction;                        // Regression prediction for the next reading
+  bool anomalyPending;                          // A warning or critical event was raised since the last reading
+  ChangeSummary changes;
+  Snapshot<ChangeSummary> changeSummary;        // analytics -> readers
+  
+  // Thresholds: Config.h defaults unless the parameter bundle sets them
+  float robustZ;
+  uint32_t robustMinSamples;
+  float criticalRatio;
+  float baselineZ;
+  uint32_t trendWindow;                         // Readings compared by analyzeTrend, at most TREND_WINDOW_SIZE
+  
+  // Streaming quantiles for median/MAD outlier scoring and percentile baselines
+  RobustWindow shortWindow;
+  RobustWindow longWindow;
+  float lastScore;
+  uint32_t outliers;
+  Snapshot<QuantileSummary> quantileSummary;    // analytics -> readers
+  
+  // Anomaly detection over the minute, quarter-hour and hour rollups, and
+  // the stream every detector reports into
+  MultiScaleDetector scales;
+  AnomalySummary anomalyStatus;
+  Snapshot<AnomalySummary> anomalySummary;      // analytics -> readers
+  
+  // Hour-of-week profile of typical power
+  WeeklyBaseline baseline;
+  BaselineSummary baselineStatus;
+  bool baselineChanged;                         // baselineStatus awaits publishing
+  Snapshot<BaselineSummary> baselineSummary;    // analytics -> readers
+  Snapshot<WeeklyBaseline::State> baselineState; // analytics -> network (persistence)
+  WeeklyBaseline::State baselineBuffer;         // Scratch for saveState, network task only
+  uint32_t savedBaselineVersion;
   
-  // Simple moving average calculation
-  float calculateMovingAverage(float value);
+  // Always-on consumption and the per-day base/active energy split
+  BaseloadEstimator baseload;
+  Snapshot<BaseloadSummary> baseloadSummary;    // analytics -> readers
   
-  // Standard deviation calculation for anomaly detection
-  float calculateStandardDeviation();
+  // Day and billing period projections from the energy register and the weekly profile
+  CostProjector projector;
+  Tariff tariff;
+  float lastEnergy;                             // Energy register at the previous reading; negative before the first
+  float trendPercent;
+  bool trendValid;
+  bool projectionChanged;                       // Projections await publishing
+  Snapshot<ProjectionSummary> projectionSummary; // analytics -> readers
+  Snapshot<CostProjector::State> projectionState; // analytics -> network (persistence)
+  CostProjector::State projectionBuffer;        // Scratch for saveState, network task only
+  uint32_t savedProjectionVersion;
+  
+  // Hourly rollup feeding the seasonal forecaster
+  SeasonalForecaster forecaster;
+  uint32_t rollupHour;                          // Local hours since the epoch being accumulated
+  double rollupSum;
+  uint32_t rollupCount;
+  Snapshot<SeasonalForecaster::State> forecastState; // analytics -> network (persistence)
+  Snapshot<ForecastSummary> forecastSummary;    // analytics -> readers
+  SeasonalForecaster::State forecastBuffer;     // Scratch for saveState, network task only
+  uint32_t savedForecastVersion;                // forecastState version last written to flash
+  
+  // Appliance disaggregation from load change steps
+  LoadDisaggregator disaggregator;
+  float readingSeconds;
+  Snapshot<ApplianceSummary> applianceSummary;  // analytics -> readers and persistence
+  ApplianceSummary appliancePublishBuffer;      // Scratch for publishAppliances, analytics task only
+  ApplianceSummary applianceBuffer;             // Scratch for saveState and telemetry, network task only
+  uint32_t savedLibraryVersion;
+  
+  // Operating states clustered from power and its peak over each reading
+  StateClusterer states;
+  Snapshot<OperatingStateSummary> stateSummary; // analytics -> readers and persistence
+  OperatingStateSummary statePublishBuffer;     // Scratch for updateStates and publishBatch, analytics task only
+  OperatingStateSummary stateBuffer;            // Scratch for saveState and telemetry, network task only
+  uint32_t savedStatesVersion;
+  
+  // Offline-trained int8 model executed in place from the parameter bundle
+  InferenceEngine model;
+  ModelSummary modelStatus;
+  Snapshot<ModelSummary> modelSummary;          // analytics -> readers
+  
+  // Appliance classification of waveform features against the reference
+  // set in the parameter bundle
+  KnnClassifier classifier;
+  WaveformSummary waveformStatus;
+  Snapshot<WaveformSummary> waveformSummary;    // analytics -> readers
+  
+  // Per-reading detectors and learners, in arrival order; their summaries
+  // are published once per batch
+  bool detectAnomaly(const PowerData &data);    // True if a warning or critical anomaly was raised since the last reading
+  void update(const PowerData &data);
+  void appendHistory(const PowerData *batch, size_t count);
+  void publishBatch();
   
   // Linear regression for basic trend prediction
   void updatePrediction();
+  
+  // Close the running hour and publish the updated forecast
+  void rollupHourly(const PowerData &data);
+  void publishForecast();
+  void publishQuantiles();
+  void raiseAnomaly(const AnomalyEvent &event);
+  void raiseAnomaly(AnomalyScale scale, AnomalyKind kind, AnomalySeverity severity, float value, float expected,
+                    float score);
+  AnomalySeverity severityOf(float score, float threshold) const;
+  void updateBaseline(const PowerData &data);
+  void loadBaseline();
+  void updateBaseload(const PowerData &data);
+  void publishBaseload();
+  void updateProjection(const PowerData &data);
+  void publishProjection();
+  void loadProjection();
+  void loadForecast();
+  void publishAppliances();
+  void loadAppliances();
+  void updateStates(const PowerData &data);
+  void loadStates();
+  void applyParams(const ParamBundle &bundle);
+  void loadModel(const ParamBundle &bundle);
+  void runModel();
+  void loadWaveforms(const ParamBundle &bundle);
+  
+  // Recompute stats from dataHistory to discard accumulated rounding error
+  void rebuildStats();
+  
+  static void trendJob(void *context);
+  static void saveJob(void *context);
 };
 
 #endif // AI_PROCESSOR_H
\ No newline at end of file
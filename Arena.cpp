@@ -0,0 +1,34 @@
+/**
+ * Arena implementation
+ */
+
+#include "Arena.h"
+#include "Config.h"
+#include <string.h>
+
+static uint8_t bootArenaStorage[BOOT_ARENA_SIZE] __attribute__((aligned(8)));
+Arena bootArena(bootArenaStorage, sizeof(bootArenaStorage));
+
+Arena::Arena(uint8_t *storage, size_t size) {
+  this->storage = storage;
+  capacity = size;
+  used = 0;
+  failed = 0;
+  sealed = false;
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+  size_t offset = (used + align - 1) & ~(align - 1);
+  if (sealed || offset + size > capacity) {
+    failed++;
+    return NULL;
+  }
+  
+  used = offset + size;
+  memset(storage + offset, 0, size);
+  return storage + offset;
+}
+
+void Arena::seal() {
+  sealed = true;
+}
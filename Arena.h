@@ -0,0 +1,42 @@
+/**
+ * Arena Class
+ * Boot-time bump allocator. Modules carve their long-lived buffers out of
+ * one static block during setup(); once the arena is sealed further
+ * requests fail instead of falling back to the heap, and nothing is ever
+ * freed, so the block cannot fragment.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Arena {
+public:
+  Arena(uint8_t *storage, size_t size);
+  
+  void *allocate(size_t size, size_t align = sizeof(void *)); // Zeroed block, NULL when full or sealed
+  
+  template <typename T>
+  T *allocateArray(size_t count) {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+  
+  void seal();                     // Reject further allocations
+  bool isSealed() const { return sealed; }
+  size_t getUsed() const { return used; }
+  size_t getCapacity() const { return capacity; }
+  uint32_t getFailed() const { return failed; } // Requests refused
+  
+private:
+  uint8_t *storage;
+  size_t capacity;
+  size_t used;
+  uint32_t failed;
+  bool sealed;
+};
+
+extern Arena bootArena;
+
+#endif // ARENA_H
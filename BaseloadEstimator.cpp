@@ -0,0 +1,71 @@
+/**
+ * BaseloadEstimator implementation
+ */
+
+#include "BaseloadEstimator.h"
+
+BaseloadEstimator::BaseloadEstimator() {
+  reset();
+}
+
+void BaseloadEstimator::reset() {
+  sustained.clear();
+  window.clear();
+  minuteSeconds = 0.0f;
+  minuteEnergy = 0.0;
+  minutes = 0;
+  currentDay = 0;
+  today.baseKwh = 0.0f;
+  today.activeKwh = 0.0f;
+  yesterday = today;
+  yesterdayValid = false;
+}
+
+void BaseloadEstimator::update(uint32_t day, float power, float seconds) {
+  if (day != 0 && day != currentDay) {
+    // The first known date only labels the running day
+    if (currentDay != 0) {
+      yesterday = today;
+      yesterdayValid = true;
+      today.baseKwh = 0.0f;
+      today.activeKwh = 0.0f;
+    }
+    currentDay = day;
+  }
+  
+  // Attribute this reading's energy with the current estimate
+  float base = 0.0f;
+  if (!window.empty()) {
+    base = power < window.value() ? power : window.value();
+  }
+  if (base < 0.0f) {
+    base = 0.0f;
+  }
+  float hours = seconds / 3600.0f;
+  today.baseKwh += base * hours / 1000.0f;
+  today.activeKwh += (power - base) * hours / 1000.0f;
+  
+  // Minute means feed the sustained level, which feeds the window once per sustain period
+  minuteSeconds += seconds;
+  minuteEnergy += (double)power * seconds;
+  if (minuteSeconds < 60.0f) {
+    return;
+  }
+  sustained.push((float)(minuteEnergy / minuteSeconds));
+  minuteSeconds = 0.0f;
+  minuteEnergy = 0.0;
+  
+  if (++minutes >= BASELOAD_SUSTAIN_MINUTES && sustained.full()) {
+    window.push(sustained.value());
+    minutes = 0;
+  }
+}
+
+float BaseloadEstimator::getCoverageHours() const {
+  uint32_t slots = window.getPushed() < BASELOAD_WINDOW_SLOTS ? window.getPushed() : BASELOAD_WINDOW_SLOTS;
+  return slots * BASELOAD_SUSTAIN_MINUTES / 60.0f;
+}
+
+bool BaseloadEstimator::isReady() const {
+  return getCoverageHours() >= BASELOAD_MIN_HOURS;
+}
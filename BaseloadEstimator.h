@@ -0,0 +1,72 @@
+/**
+ * BaseloadEstimator Class
+ * Always-on (standby) consumption from the power readings: the minimum
+ * sustained power over a sliding window long enough to always include a
+ * night. A level counts as sustained when it held for a whole
+ * BASELOAD_SUSTAIN_MINUTES (sliding maximum of minute means), and the
+ * baseload is the sliding minimum of those levels over
+ * BASELOAD_WINDOW_HOURS. Both use monotonic deques, so each reading costs
+ * O(1) amortized. Energy is split per day into the baseload share and
+ * active use above it.
+ */
+
+#ifndef BASELOAD_ESTIMATOR_H
+#define BASELOAD_ESTIMATOR_H
+
+#include <stdint.h>
+#include "SlidingExtremum.h"
+
+#ifndef BASELOAD_SUSTAIN_MINUTES
+#define BASELOAD_SUSTAIN_MINUTES 15 // A level must hold this long to count as always-on
+#endif
+#ifndef BASELOAD_WINDOW_HOURS
+#define BASELOAD_WINDOW_HOURS 24   // Sliding window the minimum is taken over
+#endif
+#ifndef BASELOAD_MIN_HOURS
+#define BASELOAD_MIN_HOURS 6       // Window coverage before the estimate is reported as ready
+#endif
+
+// Sustained levels enter the minimum window once per sustain period
+#define BASELOAD_WINDOW_SLOTS (BASELOAD_WINDOW_HOURS * 60 / BASELOAD_SUSTAIN_MINUTES)
+
+class BaseloadEstimator {
+public:
+  struct DayTotals {
+    float baseKwh;                 // Energy at or below the baseload
+    float activeKwh;               // Energy above it
+  };
+  
+  BaseloadEstimator();
+  
+  void reset();
+  
+  // Adds a reading covering seconds of a local day (days since the epoch,
+  // 0 while the date is unknown). A new day moves today into yesterday.
+  void update(uint32_t day, float power, float seconds);
+  
+  bool isReady() const;
+  bool hasEstimate() const { return !window.empty(); }
+  float getBaseload() const { return window.empty() ? 0.0f : window.value(); } // W
+  float getSustained() const { return sustained.empty() ? 0.0f : sustained.value(); } // Latest sustained level (W)
+  float getCoverageHours() const;
+  
+  const DayTotals &getToday() const { return today; }
+  const DayTotals &getYesterday() const { return yesterday; }
+  bool hasYesterday() const { return yesterdayValid; }
+  
+private:
+  SlidingExtremum<BASELOAD_SUSTAIN_MINUTES, true> sustained; // Max of minute means
+  SlidingExtremum<BASELOAD_WINDOW_SLOTS> window;             // Min of sustained levels
+  
+  // Minute being accumulated
+  float minuteSeconds;
+  double minuteEnergy;             // Watt-seconds
+  uint32_t minutes;                // Minutes closed since the last sustained sample
+  
+  uint32_t currentDay;
+  DayTotals today;
+  DayTotals yesterday;
+  bool yesterdayValid;
+};
+
+#endif // BASELOAD_ESTIMATOR_H
@@ -0,0 +1,79 @@
+/**
+ * BootTimeline implementation
+ */
+
+#include "BootTimeline.h"
+#include <esp_timer.h>
+#include <esp_system.h>
+
+BootTimeline bootTimeline;
+
+static const char *MILESTONE_NAMES[BOOT_MILESTONE_COUNT] = {
+  "setup_start",
+  "tasks_started",
+  "first_sample",
+  "wifi_connected",
+  "time_synced",
+  "first_upload",
+};
+
+static const char *resetReasonName(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_POWERON: return "power-on";
+    case ESP_RST_EXT: return "external";
+    case ESP_RST_SW: return "software";
+    case ESP_RST_PANIC: return "panic";
+    case ESP_RST_INT_WDT: return "interrupt watchdog";
+    case ESP_RST_TASK_WDT: return "task watchdog";
+    case ESP_RST_WDT: return "watchdog";
+    case ESP_RST_DEEPSLEEP: return "deep sleep";
+    case ESP_RST_BROWNOUT: return "brownout";
+    default: return "unknown";
+  }
+}
+
+BootTimeline::BootTimeline() {
+  for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+    marks[i].store(0);
+  }
+}
+
+void BootTimeline::mark(BootMilestone milestone) {
+  // Stored off by one so that 0 can mean "not reached"; only the first mark wins
+  uint32_t expected = 0;
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000) + 1;
+  marks[milestone].compare_exchange_strong(expected, now);
+}
+
+bool BootTimeline::reached(BootMilestone milestone) {
+  return marks[milestone].load() != 0;
+}
+
+uint32_t BootTimeline::getMs(BootMilestone milestone) {
+  uint32_t value = marks[milestone].load();
+  return value == 0 ? 0 : value - 1;
+}
+
+void BootTimeline::printReport() {
+  Serial.printf("Boot timeline (reset reason: %s):\n", resetReasonName(esp_reset_reason()));
+  for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+    if (reached((BootMilestone)i)) {
+      Serial.printf("  %-16s %8u ms\n", MILESTONE_NAMES[i], (unsigned)getMs((BootMilestone)i));
+    } else {
+      Serial.printf("  %-16s  pending\n", MILESTONE_NAMES[i]);
+    }
+  }
+}
+
+void BootTimeline::addTelemetry(JsonObject &out) {
+  out["reset_reason"] = resetReasonName(esp_reset_reason());
+  for (int i = 0; i < BOOT_MILESTONE_COUNT; i++) {
+    if (reached((BootMilestone)i)) {
+      out[MILESTONE_NAMES[i]] = getMs((BootMilestone)i);
+    }
+  }
+}
+
+const char *BootTimeline::milestoneName(int milestone) {
+  return milestone >= 0 && milestone < BOOT_MILESTONE_COUNT ? MILESTONE_NAMES[milestone] : "unknown";
+}
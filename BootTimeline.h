@@ -0,0 +1,44 @@
+/**
+ * BootTimeline Class
+ * Records when each boot milestone was first reached, in milliseconds
+ * since the esp_timer started (right after the second-stage bootloader),
+ * so the time from a reset or power blip to the first sample and the
+ * first upload can be tracked across firmware changes
+ */
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+
+enum BootMilestone {
+  BOOT_SETUP_START,                // setup() entered
+  BOOT_TASKS_STARTED,              // Sampling and analytics tasks running
+  BOOT_FIRST_SAMPLE,               // First reading integrated into energy
+  BOOT_WIFI_CONNECTED,             // Station got an IP address
+  BOOT_TIME_SYNCED,                // NTP time valid
+  BOOT_FIRST_UPLOAD,               // First reading accepted by the backend
+  BOOT_MILESTONE_COUNT
+};
+
+class BootTimeline {
+public:
+  BootTimeline();
+  
+  void mark(BootMilestone milestone); // Record the first time a milestone is reached
+  bool reached(BootMilestone milestone);
+  uint32_t getMs(BootMilestone milestone); // 0 if not reached yet
+  
+  void printReport();
+  void addTelemetry(JsonObject &out);
+  static const char *milestoneName(int milestone);
+  
+private:
+  std::atomic<uint32_t> marks[BOOT_MILESTONE_COUNT]; // ms + 1, 0 = not reached
+};
+
+extern BootTimeline bootTimeline;
+
+#endif // BOOT_TIMELINE_H
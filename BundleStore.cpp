@@ -0,0 +1,219 @@
+/**
+ * BundleStore implementation
+ */
+
+#include "BundleStore.h"
+#include "Logger.h"
+#include <HTTPClient.h>
+
+#define BUNDLE_SECTOR_SIZE 4096    // Flash erase granularity
+#define BUNDLE_CHUNK_SIZE 512      // Download buffer, on the network task's stack
+
+static const char *const slotLabels[BUNDLE_SLOTS] = { BUNDLE_SLOT_A_LABEL, BUNDLE_SLOT_B_LABEL };
+
+BundleStore::BundleStore() {
+  for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+    partitions[slot] = NULL;
+  }
+  activeSlot = -1;
+  updateSlot = -1;
+  updateSize = 0;
+  updateWritten = 0;
+  pending = false;
+  pendingSequence = 0;
+  updateError = "";
+}
+
+void BundleStore::mapSlot(int slot) {
+  bundles[slot].unbind();
+  if (partitions[slot] == NULL ||
+      !slots[slot].map(slotLabels[slot], (esp_partition_subtype_t)BUNDLE_PARTITION_SUBTYPE)) {
+    return;
+  }
+  bundles[slot].bind(slots[slot].data(), slots[slot].size());
+}
+
+void BundleStore::begin() {
+  for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+    partitions[slot] = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                (esp_partition_subtype_t)BUNDLE_PARTITION_SUBTYPE, slotLabels[slot]);
+    mapSlot(slot);
+  }
+  
+  // The newest valid bundle wins; an interrupted update never validates
+  activeSlot = -1;
+  for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+    if (bundles[slot].isBound() &&
+        (activeSlot < 0 || ParamBundle::isNewer(bundles[slot].getSequence(), bundles[activeSlot].getSequence()))) {
+      activeSlot = slot;
+    }
+  }
+  
+  for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+    if (partitions[slot] == NULL) {
+      Serial.printf("Bundle slot %s: no partition\n", slotName(slot));
+    } else if (bundles[slot].isBound()) {
+      Serial.printf("Bundle slot %s: sequence %u, %u bytes%s\n", slotName(slot), (unsigned)bundles[slot].getSequence(),
+                    (unsigned)bundles[slot].getSize(), slot == activeSlot ? " (active)" : "");
+    } else {
+      Serial.printf("Bundle slot %s: %s\n", slotName(slot), bundles[slot].getError());
+    }
+  }
+  
+  // Only the active slot stays mapped; the other may be rewritten
+  for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+    if (slot != activeSlot) {
+      bundles[slot].unbind();
+      slots[slot].unmap();
+    }
+  }
+}
+
+const ParamBundle &BundleStore::active() const {
+  return activeSlot >= 0 ? bundles[activeSlot] : none;
+}
+
+uint32_t BundleStore::getSlotAddress(int slot) const {
+  return partitions[slot] ? partitions[slot]->address : 0;
+}
+
+uint32_t BundleStore::getSlotSize(int slot) const {
+  return partitions[slot] ? partitions[slot]->size : 0;
+}
+
+const char *BundleStore::slotName(int slot) {
+  return slot == 0 ? "A" : slot == 1 ? "B" : "-";
+}
+
+bool BundleStore::failUpdate(const char *message) {
+  updateError = message;
+  updateSlot = -1;
+  return false;
+}
+
+bool BundleStore::beginUpdate(size_t size) {
+  // The active slot is never written; with none active, A is used
+  int slot = activeSlot == 0 ? 1 : 0;
+  if (partitions[slot] == NULL) {
+    return failUpdate("no partition for the inactive slot");
+  }
+  if (size < sizeof(BundleHeader) || size > partitions[slot]->size) {
+    return failUpdate("bundle does not fit the slot");
+  }
+  
+  bundles[slot].unbind();
+  slots[slot].unmap();
+  size_t eraseSize = (size + BUNDLE_SECTOR_SIZE - 1) / BUNDLE_SECTOR_SIZE * BUNDLE_SECTOR_SIZE;
+  if (esp_partition_erase_range(partitions[slot], 0, eraseSize) != ESP_OK) {
+    return failUpdate("erase failed");
+  }
+  
+  updateSlot = slot;
+  updateSize = size;
+  updateWritten = 0;
+  updateError = "";
+  return true;
+}
+
+bool BundleStore::writeUpdate(const uint8_t *data, size_t length) {
+  if (updateSlot < 0) {
+    return false;
+  }
+  if (length > updateSize - updateWritten) {
+    return failUpdate("more data than announced");
+  }
+  if (esp_partition_write(partitions[updateSlot], updateWritten, data, length) != ESP_OK) {
+    return failUpdate("write failed");
+  }
+  updateWritten += length;
+  return true;
+}
+
+bool BundleStore::commitUpdate() {
+  if (updateSlot < 0) {
+    return false;
+  }
+  int slot = updateSlot;
+  if (updateWritten != updateSize) {
+    return failUpdate("short bundle");
+  }
+  
+  // Validate what is actually in flash, through a fresh mapping
+  mapSlot(slot);
+  if (!bundles[slot].isBound()) {
+    const char *error = bundles[slot].getError();
+    slots[slot].unmap();
+    return failUpdate(error);
+  }
+  bool newer = activeSlot < 0 || ParamBundle::isNewer(bundles[slot].getSequence(), active().getSequence());
+  uint32_t sequence = bundles[slot].getSequence();
+  bundles[slot].unbind();
+  slots[slot].unmap();
+  if (!newer) {
+    return failUpdate("sequence not newer than the active bundle");
+  }
+  
+  updateSlot = -1;
+  pending = true;
+  pendingSequence = sequence;
+  LOG_INFO("Bundle %u stored in slot %s, active from the next boot", (unsigned)sequence, slotName(slot));
+  return true;
+}
+
+bool BundleStore::fetch(const char *url) {
+  HTTPClient http;
+  char sequence[12];
+  snprintf(sequence, sizeof(sequence), "%u", (unsigned)(pending ? pendingSequence : active().getSequence()));
+  http.begin(url);
+  http.addHeader("X-Bundle-Sequence", sequence);
+  
+  int code = http.GET();
+  if (code == HTTP_CODE_NOT_MODIFIED) {
+    http.end();
+    return false;
+  }
+  if (code != HTTP_CODE_OK) {
+    LOG_WARN("Bundle download failed: HTTP %d", code);
+    http.end();
+    return false;
+  }
+  
+  // The header comes first so an old bundle is turned away before erasing
+  int size = http.getSize();
+  WiFiClient *stream = http.getStreamPtr();
+  stream->setTimeout(CONNECTION_TIMEOUT);
+  uint32_t buffer[BUNDLE_CHUNK_SIZE / 4];  // Word-aligned for the header
+  uint8_t *chunk = (uint8_t *)buffer;
+  const BundleHeader *header = (const BundleHeader *)buffer;
+  bool stored = false;
+  if (size < (int)sizeof(BundleHeader)) {
+    failUpdate("no content length");
+  } else if (stream->readBytes(chunk, sizeof(BundleHeader)) != sizeof(BundleHeader)) {
+    failUpdate("connection lost");
+  } else if (header->magic != BUNDLE_MAGIC || header->totalSize != (uint32_t)size) {
+    failUpdate("not a bundle");
+  } else if ((activeSlot >= 0 && !ParamBundle::isNewer(header->sequence, active().getSequence())) ||
+             (pending && !ParamBundle::isNewer(header->sequence, pendingSequence))) {
+    failUpdate("sequence not newer than the active bundle");
+  } else if (beginUpdate(size) && writeUpdate(chunk, sizeof(BundleHeader))) {
+    size_t remaining = size - sizeof(BundleHeader);
+    while (remaining > 0) {
+      size_t length = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+      if (stream->readBytes(chunk, length) != length) {
+        failUpdate("connection lost");
+        break;
+      }
+      if (!writeUpdate(chunk, length)) {
+        break;
+      }
+      remaining -= length;
+    }
+    stored = remaining == 0 && commitUpdate();
+  }
+  http.end();
+  
+  if (!stored) {
+    LOG_WARN("Bundle update rejected: %s", updateError);
+  }
+  return stored;
+}
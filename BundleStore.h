@@ -0,0 +1,63 @@
+/**
+ * BundleStore Class
+ * Two flash slots (A/B) holding parameter bundles (ParamBundle.h). Both are
+ * memory-mapped at boot and the valid bundle with the highest sequence
+ * number is used in place. Updates are written to the other slot only and
+ * checked (CRC, newer sequence) after writing, so a failed or interrupted
+ * update leaves the running bundle untouched; the new one is picked up at
+ * the next boot. The running bundle's pointers stay valid until reboot.
+ */
+
+#ifndef BUNDLE_STORE_H
+#define BUNDLE_STORE_H
+
+#include "Config.h"
+#include "ModelPartition.h"
+#include "ParamBundle.h"
+
+#define BUNDLE_SLOTS 2
+
+class BundleStore {
+public:
+  BundleStore();
+  
+  void begin();                        // Map both slots and choose the active bundle
+  
+  const ParamBundle &active() const;   // Unbound when neither slot holds a valid bundle
+  int getActiveSlot() const { return activeSlot; } // -1 when none
+  const ParamBundle &getSlot(int slot) const { return bundles[slot]; }
+  uint32_t getSlotAddress(int slot) const; // Flash offset, for esptool
+  uint32_t getSlotSize(int slot) const;
+  static const char *slotName(int slot);
+  bool isPending() const { return pending; } // A newer bundle was stored and applies at the next boot
+  uint32_t getPendingSequence() const { return pendingSequence; }
+  
+  // Streaming update of the inactive slot
+  bool beginUpdate(size_t size);
+  bool writeUpdate(const uint8_t *data, size_t length);
+  bool commitUpdate();                 // True when the slot now holds a valid, newer bundle
+  const char *getUpdateError() const { return updateError; }
+  
+  // Downloads a bundle over HTTP into the inactive slot; true when a newer
+  // one was stored. The active sequence is sent so the server can answer 304.
+  bool fetch(const char *url);
+  
+private:
+  const esp_partition_t *partitions[BUNDLE_SLOTS];
+  ModelPartition slots[BUNDLE_SLOTS];
+  ParamBundle bundles[BUNDLE_SLOTS];
+  ParamBundle none;
+  int activeSlot;
+  
+  int updateSlot;                      // -1 when no update is in progress
+  size_t updateSize;
+  size_t updateWritten;
+  bool pending;
+  uint32_t pendingSequence;
+  const char *updateError;
+  
+  void mapSlot(int slot);
+  bool failUpdate(const char *message);
+};
+
+#endif // BUNDLE_STORE_H
@@ -0,0 +1,236 @@
+/**
+ * ChangeDetector implementation
+ */
+
+#include "ChangeDetector.h"
+#include <math.h>
+
+// In-control samples refine the variance with this weight
+#define CHANGE_VARIANCE_WEIGHT (1.0 / 256.0)
+
+// Weight of the newest sample in recentLevel
+#define CHANGE_LEVEL_WEIGHT (1.0f / 16.0f)
+
+ChangeDetector::ChangeDetector() {
+  params = defaultParams();
+  reset();
+}
+
+ChangeDetector::Params ChangeDetector::defaultParams() {
+  Params defaults;
+  defaults.cusumK = CHANGE_CUSUM_K;
+  defaults.cusumH = CHANGE_CUSUM_H;
+  defaults.phDelta = CHANGE_PH_DELTA;
+  defaults.phLambda = CHANGE_PH_LAMBDA;
+  defaults.minStep = CHANGE_MIN_STEP_W;
+  defaults.driftHoldoff = CHANGE_DRIFT_HOLDOFF;
+  defaults.warmupSamples = CHANGE_WARMUP_SAMPLES;
+  defaults.sigmaFloor = CHANGE_SIGMA_FLOOR_W;
+  return defaults;
+}
+
+void ChangeDetector::setParams(const Params &params) {
+  this->params = params;
+  if (this->params.warmupSamples < 2) {
+    this->params.warmupSamples = 2;
+  }
+  reset();
+}
+
+void ChangeDetector::reset() {
+  restartAt(0.0f);
+  variance = 0.0;
+  driftReported = false;
+  lastDrift = CHANGE_DRIFT_UP;
+  samplesSinceDrift = 0;
+}
+
+void ChangeDetector::restartAt(float level) {
+  // The variance estimate carries over; the level is learned afresh
+  warmupCount = 0;
+  mean = level;
+  m2 = 0.0;
+  recentLevel = level;
+  resetCusum();
+  
+  phCount = 0;
+  phMean = 0.0;
+  phUp = 0.0f;
+  phUpMin = 0.0f;
+  phDown = 0.0f;
+  phDownMin = 0.0f;
+  phUpMinCount = 0;
+  phDownMinCount = 0;
+  phUpMinMs = 0;
+  phDownMinMs = 0;
+  phUpMinLevel = level;
+  phDownMinLevel = level;
+}
+
+void ChangeDetector::resetCusum() {
+  cusumUp = 0.0f;
+  cusumDown = 0.0f;
+  upRunLength = 0;
+  downRunLength = 0;
+  upRunStartMs = 0;
+  downRunStartMs = 0;
+  upRunSum = 0.0;
+  downRunSum = 0.0;
+}
+
+float ChangeDetector::getSigma() const {
+  float sigma = (float)sqrt(variance);
+  return sigma > params.sigmaFloor ? sigma : params.sigmaFloor;
+}
+
+bool ChangeDetector::update(float value, uint32_t timestampMs, ChangeEvent &event) {
+  if (samplesSinceDrift < UINT32_MAX) {
+    samplesSinceDrift++;
+  }
+  
+  // Learn the new baseline before testing against it
+  if (warmupCount < params.warmupSamples) {
+    warmupCount++;
+    double delta = value - mean;
+    mean += delta / warmupCount;
+    m2 += delta * (value - mean);
+    recentLevel = (float)mean;
+    if (warmupCount == params.warmupSamples) {
+      double warmupVariance = m2 / (warmupCount - 1);
+      // Take a larger estimate at once but only relax halfway towards a
+      // smaller one, so a quiet warm-up after a noisy load is not twitchy
+      variance = warmupVariance > variance ? warmupVariance : 0.5 * (variance + warmupVariance);
+      phUpMinLevel = recentLevel;
+      phDownMinLevel = recentLevel;
+    }
+    return false;
+  }
+  
+  float sigma = getSigma();
+  float z = (float)((value - mean) / sigma);
+  recentLevel += CHANGE_LEVEL_WEIGHT * (value - recentLevel);
+  
+  // Two-sided CUSUM: each side accumulates evidence beyond the allowance k
+  cusumUp += z - params.cusumK;
+  if (cusumUp <= 0.0f) {
+    cusumUp = 0.0f;
+    upRunLength = 0;
+    upRunSum = 0.0;
+  } else {
+    if (upRunLength == 0) {
+      upRunStartMs = timestampMs;
+    }
+    upRunLength++;
+    upRunSum += value;
+  }
+  
+  cusumDown += -z - params.cusumK;
+  if (cusumDown <= 0.0f) {
+    cusumDown = 0.0f;
+    downRunLength = 0;
+    downRunSum = 0.0;
+  } else {
+    if (downRunLength == 0) {
+      downRunStartMs = timestampMs;
+    }
+    downRunLength++;
+    downRunSum += value;
+  }
+  
+  // Page-Hinkley: cumulative deviation from the running mean, less the
+  // tolerated drift, compared with its historical extreme
+  phCount++;
+  phMean += (value - phMean) / phCount;
+  float deviation = (float)((value - phMean) / sigma);
+  phUp += deviation - params.phDelta;
+  if (phUp < phUpMin) {
+    phUpMin = phUp;
+    phUpMinCount = phCount;
+    phUpMinMs = timestampMs;
+    phUpMinLevel = recentLevel;
+  }
+  phDown += -deviation - params.phDelta;
+  if (phDown < phDownMin) {
+    phDownMin = phDown;
+    phDownMinCount = phCount;
+    phDownMinMs = timestampMs;
+    phDownMinLevel = recentLevel;
+  }
+  
+  // Steps first: CUSUM reacts faster and its run gives a cleaner level.
+  // A shift below the minimum step moves the CUSUM reference only; the
+  // Page-Hinkley sums keep integrating so a ramp still shows up as a drift.
+  if (cusumUp > params.cusumH || cusumDown > params.cusumH) {
+    bool up = cusumUp > params.cusumH;
+    float after = (float)(up ? upRunSum / upRunLength : downRunSum / downRunLength);
+    if (fabs(after - mean) < params.minStep) {
+      mean = after;
+      resetCusum();
+      return false;
+    }
+    if (up) {
+      fill(event, CHANGE_STEP_UP, (float)mean, after, upRunLength - 1, upRunStartMs, timestampMs);
+    } else {
+      fill(event, CHANGE_STEP_DOWN, (float)mean, after, downRunLength - 1, downRunStartMs, timestampMs);
+    }
+    restartAt(after);
+    driftReported = false;
+    return true;
+  }
+  
+  if (phUp - phUpMin > params.phLambda) {
+    return checkDrift(CHANGE_DRIFT_UP, phUpMinLevel, phCount - phUpMinCount, phUpMinMs, timestampMs, event);
+  }
+  if (phDown - phDownMin > params.phLambda) {
+    return checkDrift(CHANGE_DRIFT_DOWN, phDownMinLevel, phCount - phDownMinCount, phDownMinMs, timestampMs, event);
+  }
+  
+  // Quiet sample: let it refine the noise estimate
+  if (cusumUp == 0.0f && cusumDown == 0.0f) {
+    double error = value - mean;
+    variance += CHANGE_VARIANCE_WEIGHT * (error * error - variance);
+  }
+  
+  return false;
+}
+
+bool ChangeDetector::checkDrift(ChangeType type, float before, uint32_t delaySamples, uint32_t startMs,
+                                uint32_t timestampMs, ChangeEvent &event) {
+  // Wait until the level has actually moved by a step's worth
+  if (fabsf(recentLevel - before) < params.minStep) {
+    return false;
+  }
+  
+  // Further alarms along the same ramp extend the event already reported
+  bool merged = driftReported && lastDrift == type && samplesSinceDrift < params.driftHoldoff;
+  if (!merged) {
+    fill(event, type, before, recentLevel, delaySamples, startMs, timestampMs);
+  }
+  
+  driftReported = true;
+  lastDrift = type;
+  samplesSinceDrift = 0;
+  restartAt(recentLevel);
+  return !merged;
+}
+
+void ChangeDetector::fill(ChangeEvent &event, ChangeType type, float before, float after, uint32_t delaySamples,
+                          uint32_t startMs, uint32_t timestampMs) const {
+  event.type = type;
+  event.before = before;
+  event.after = after;
+  event.magnitude = after - before;
+  event.delaySamples = delaySamples;
+  event.delayMs = delaySamples > 0 ? timestampMs - startMs : 0;
+  event.timestampMs = timestampMs;
+}
+
+const char *ChangeDetector::typeName(ChangeType type) {
+  switch (type) {
+    case CHANGE_STEP_UP: return "step up";
+    case CHANGE_STEP_DOWN: return "step down";
+    case CHANGE_DRIFT_UP: return "drift up";
+    case CHANGE_DRIFT_DOWN: return "drift down";
+  }
+  return "?";
+}
@@ -0,0 +1,140 @@
+/**
+ * ChangeDetector Class
+ * Streaming change-point detection on power measurements with O(1) state.
+ * A two-sided CUSUM catches abrupt steps and a two-sided Page-Hinkley test
+ * catches slow drifts; both work in units of the in-control standard
+ * deviation, so one set of thresholds fits small and large loads. After an
+ * event the baseline restarts at the new level. Shifts below a minimum step
+ * only re-centre the CUSUM, and drift alarms in the same direction close
+ * together are merged, so a ramp is reported once rather than as a
+ * staircase of small events.
+ *
+ * Larger thresholds mean fewer false alarms and longer detection delays;
+ * measure the trade-off with tools/host_replay.cpp on labelled traces.
+ */
+
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+#include <stdint.h>
+
+#ifndef CHANGE_CUSUM_K
+#define CHANGE_CUSUM_K 0.5f        // CUSUM allowance (sigmas); about half the smallest step of interest
+#endif
+#ifndef CHANGE_CUSUM_H
+#define CHANGE_CUSUM_H 8.0f        // CUSUM decision threshold (sigmas)
+#endif
+#ifndef CHANGE_PH_DELTA
+#define CHANGE_PH_DELTA 0.05f      // Page-Hinkley tolerated drift per sample (sigmas)
+#endif
+#ifndef CHANGE_PH_LAMBDA
+#define CHANGE_PH_LAMBDA 50.0f     // Page-Hinkley decision threshold (sigmas)
+#endif
+#ifndef CHANGE_MIN_STEP_W
+#define CHANGE_MIN_STEP_W 15.0f    // Smaller CUSUM shifts only re-centre the baseline
+#endif
+#ifndef CHANGE_DRIFT_HOLDOFF
+#define CHANGE_DRIFT_HOLDOFF 900   // Same-direction drift alarms closer than this (samples) extend one event
+#endif
+#ifndef CHANGE_WARMUP_SAMPLES
+#define CHANGE_WARMUP_SAMPLES 50   // Samples used to learn the baseline after a reset
+#endif
+#ifndef CHANGE_SIGMA_FLOOR_W
+#define CHANGE_SIGMA_FLOOR_W 2.0f  // Lower bound on sigma so steady loads do not alarm on noise
+#endif
+
+enum ChangeType {
+  CHANGE_STEP_UP,
+  CHANGE_STEP_DOWN,
+  CHANGE_DRIFT_UP,
+  CHANGE_DRIFT_DOWN
+};
+
+struct ChangeEvent {
+  ChangeType type;
+  float before;                    // Baseline level before the change (W)
+  float after;                     // Level since the estimated change point (W)
+  float magnitude;                 // after - before (W)
+  uint32_t delaySamples;           // Samples from the estimated change point to detection
+  uint32_t delayMs;
+  uint32_t timestampMs;            // Time of detection
+};
+
+class ChangeDetector {
+public:
+  struct Params {
+    float cusumK;
+    float cusumH;
+    float phDelta;
+    float phLambda;
+    float minStep;
+    uint32_t driftHoldoff;
+    uint32_t warmupSamples;
+    float sigmaFloor;
+  };
+  
+  ChangeDetector();
+  
+  void setParams(const Params &params);
+  const Params &getParams() const { return params; }
+  static Params defaultParams();
+  
+  void reset();
+  
+  // Feeds one measurement; returns true and fills event when a change is detected
+  bool update(float value, uint32_t timestampMs, ChangeEvent &event);
+  
+  float getBaseline() const { return (float)mean; }
+  float getSigma() const;
+  bool isWarm() const { return warmupCount >= params.warmupSamples; }
+  
+  static const char *typeName(ChangeType type);
+  
+private:
+  Params params;
+  
+  // Baseline, learned during warm-up and refined while in control
+  uint32_t warmupCount;
+  double mean;
+  double m2;
+  double variance;
+  float recentLevel;               // Short exponential average, the level a drift has reached
+  
+  // CUSUM, with the start of the current run for the change point estimate
+  float cusumUp;
+  float cusumDown;
+  uint32_t upRunLength;
+  uint32_t downRunLength;
+  uint32_t upRunStartMs;
+  uint32_t downRunStartMs;
+  double upRunSum;
+  double downRunSum;
+  
+  // Page-Hinkley cumulative sums and their extremes
+  uint32_t phCount;
+  double phMean;
+  float phUp;
+  float phUpMin;
+  float phDown;
+  float phDownMin;
+  uint32_t phUpMinCount;
+  uint32_t phDownMinCount;
+  uint32_t phUpMinMs;
+  uint32_t phDownMinMs;
+  float phUpMinLevel;              // recentLevel when each extreme was set
+  float phDownMinLevel;
+  
+  // Last drift reported, to merge alarms along one ramp
+  bool driftReported;
+  ChangeType lastDrift;
+  uint32_t samplesSinceDrift;
+  
+  void restartAt(float level);
+  void resetCusum();
+  bool checkDrift(ChangeType type, float before, uint32_t delaySamples, uint32_t startMs,
+                  uint32_t timestampMs, ChangeEvent &event);
+  void fill(ChangeEvent &event, ChangeType type, float before, float after, uint32_t delaySamples,
+            uint32_t startMs, uint32_t timestampMs) const;
+};
+
+#endif // CHANGE_DETECTOR_H
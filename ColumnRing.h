@@ -0,0 +1,73 @@
+/**
+ * ColumnRing Class
+ * Fixed-capacity history stored column-wise (structure of arrays): each
+ * field the models read gets its own contiguous array, so a scan over one
+ * field touches only that field's memory and vectorises well. Storage is
+ * embedded in the object; the oldest row is overwritten when full.
+ */
+
+#ifndef COLUMN_RING_H
+#define COLUMN_RING_H
+
+#include <stddef.h>
+
+template <size_t Capacity, size_t Columns = 1, typename T = float>
+class ColumnRing {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "ColumnRing capacity must be a power of two");
+  static_assert(Columns >= 1, "ColumnRing needs at least one column");
+  
+public:
+  ColumnRing() : head(0), count(0) {}
+  
+  // Appends one row (one value per column)
+  void push(const T (&row)[Columns]) {
+    for (size_t c = 0; c < Columns; c++) {
+      data[c][head] = row[c];
+    }
+    advance();
+  }
+  
+  // Appends a row to a single-column ring
+  void push(T value) {
+    static_assert(Columns == 1, "push(value) needs a single-column ring");
+    data[0][head] = value;
+    advance();
+  }
+  
+  // Row 0 is the oldest
+  T get(size_t column, size_t row) const { return data[column][(head - count + row) & (Capacity - 1)]; }
+  T oldest(size_t column = 0) const { return get(column, 0); }
+  T newest(size_t column = 0) const { return data[column][(head - 1) & (Capacity - 1)]; }
+  
+  // The column in age order as up to two contiguous spans; returns the
+  // length of the first span, the second starts at the array base
+  size_t spans(size_t column, const T *&first, const T *&second, size_t &secondCount) const {
+    size_t start = (head - count) & (Capacity - 1);
+    size_t firstCount = count < Capacity - start ? count : Capacity - start;
+    first = &data[column][start];
+    second = &data[column][0];
+    secondCount = count - firstCount;
+    return firstCount;
+  }
+  
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == Capacity; }
+  void clear() { head = 0; count = 0; }
+  static size_t capacity() { return Capacity; }
+  
+private:
+  T data[Columns][Capacity];
+  size_t head;                     // Next slot to write
+  size_t count;
+  
+  void advance() {
+    head = (head + 1) & (Capacity - 1);
+    if (count < Capacity) {
+      count++;
+    }
+  }
+};
+
+#endif // COLUMN_RING_H
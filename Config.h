@@ -11,12 +11,17 @@
 #include <SPIFFS.h>
 #include <HTTPClient.h>
 #include <Update.h>
-#include <vector>
+#include "PowerData.h"
 
 // Device identification
 #define DEVICE_NAME "ESP32_Power_Monitor"
 #define FIRMWARE_VERSION "1.0.0"
 
+// Low-power mode (battery-backed deployments); the cadences below depend on it
+#ifndef LOW_POWER_MODE
+#define LOW_POWER_MODE 1           // Light-sleep between capture blocks and jobs
+#endif
+
 // Hardware pins
 #define CURRENT_SENSOR_PIN 34      // ADC pin connected to SCT-013-000
 #define LED_PIN 2                  // Built-in LED pin
@@ -36,29 +41,137 @@
 #define CONNECTION_TIMEOUT 10000   // Milliseconds to wait for connection before retry
 #define MAX_RETRY_ATTEMPTS 3       // Number of times to retry connection
 #define DATA_BUFFER_SIZE 100       // Maximum number of readings to buffer
+#define UPLOAD_BATCH_MAX 12        // Readings per upload request
+#define BATCH_DOC_SIZE 2048        // JSON document capacity for one upload batch (bytes)
+#define TELEMETRY_INTERVAL 60000   // Milliseconds between telemetry uploads
+#define TELEMETRY_DOC_SIZE 7680    // JSON document capacity for telemetry (bytes)
+#define MAX_TELEMETRY_SOURCES 16   // Modules that can add a telemetry section
+
+// Cadences (defaults; override in config.json)
+//   measurement: one capture block (SAMPLES_PER_CYCLE ADC samples, ~20 ms)
+//   aggregation: measurements folded into one reading for analytics and display
+//   report:      buffered readings uploaded in batches
+#if LOW_POWER_MODE
+#define MEASUREMENT_INTERVAL_MS 1000 // 1 measurement per second
+#else
+#define MEASUREMENT_INTERVAL_MS 200  // 5 measurements per second
+#endif
+#define AGGREGATION_PERIOD_MS 5000 // One reading every 5 seconds
+#define REPORT_PERIOD_MS 30000     // One upload every 30 seconds
+#define MIN_MEASUREMENT_INTERVAL_MS 20 // 50 per second; capture blocks then run back to back
+
+struct Cadence {
+  uint32_t measurementMs;
+  uint32_t aggregationMs;
+  uint32_t reportMs;
+};
+
+// Tariff (defaults; override in config.json)
+#define TARIFF_PRICE_PER_KWH 0.30f // Energy price per kWh
+#define TARIFF_STANDING_PER_DAY 0.0f // Fixed charge per day
+#define TARIFF_BILLING_DAY 1       // Day of the month a billing period starts (1-28)
+#define TARIFF_CURRENCY "EUR"
+
+struct Tariff {
+  float pricePerKwh;
+  float standingPerDay;
+  uint8_t billingDay;
+  char currency[4];
+};
 
 // NTP settings
 #define NTP_SERVER1 "pool.ntp.org"
 #define NTP_SERVER2 "time.nist.gov"
 #define GMT_OFFSET_SEC 3600        // GMT+1 (modify for your timezone)
 #define DAYLIGHT_OFFSET_SEC 3600   // 1 hour DST (modify if needed)
+#define MIN_VALID_EPOCH 1609459200UL // System time below this has not been set by NTP yet
 
 // OTA settings
 #define OTA_PASSWORD "PowerMonitor" // Password for OTA updates
 #define OTA_PORT 3232              // Port for OTA updates
 
-// AI local processing settings
-#define ANOMALY_THRESHOLD 0.2      // Threshold for local anomaly detection
-#define TREND_WINDOW_SIZE 10       // Window size for trend analysis
-
-// Data structure for power readings
-struct PowerData {
-  unsigned long timestamp;
-  float current;     // Amperes
-  float voltage;     // Volts
-  float power;       // Watts
-  float energy;      // Kilowatt-hours
-  bool anomaly;      // Flag for detected anomalies
-};
+// AI local processing settings; thresholds are defaults that a parameter
+// bundle can override at boot (see ParamBundle.h and README)
+#define TREND_WINDOW_SIZE 1024     // Window size for trend analysis (~85 minutes of 5 s readings, power of two)
+#define STATS_REBUILD_INTERVAL 4096 // Updates between exact recomputes of the running statistics
+#define QUANTILE_SHORT_HORIZON 720 // Readings in the short robust baseline (~1 hour of 5 s readings)
+#define QUANTILE_LONG_HORIZON 17280 // Readings in the long robust baseline (~1 day)
+#define ROBUST_Z_THRESHOLD 3.5f    // Modified z-score beyond which a reading is an outlier
+#define ROBUST_MIN_SAMPLES 60      // Readings in the short baseline before outliers are scored
+#define ANOMALY_CRITICAL_RATIO 2.0f // Scores this many times a source's threshold are critical
+#define ANOMALY_RECENT_EVENTS 8    // Latest anomaly events kept for telemetry (power of two)
+#define FORECAST_STATE_FILE "/forecast.bin" // Seasonal forecaster state on SPIFFS
+#define BASELINE_STATE_FILE "/baseline.bin" // Weekly profile of typical power on SPIFFS
+#define BASELINE_Z_THRESHOLD 3.0f  // Period deviation from the weekly profile that raises an anomaly
+#define PROJECTION_STATE_FILE "/projection.bin" // Day and billing period energy registers on SPIFFS
+#define NILM_LIBRARY_FILE "/appliances.bin" // Appliance signature library on SPIFFS
+#define OPSTATE_STATE_FILE "/states.bin" // Learned operating states on SPIFFS
+#define MODEL_ARENA_SIZE 4096      // Activation arena for the model (bytes, from the boot arena)
+#define BUNDLE_SLOT_A_LABEL "params_a" // Data partitions holding parameter bundles (partitions.csv, ParamBundle.h)
+#define BUNDLE_SLOT_B_LABEL "params_b"
+#define BUNDLE_PARTITION_SUBTYPE 0x40
+#define BUNDLE_CHECK_INTERVAL 3600000 // Milliseconds between checks of bundle_url for a newer bundle
+#define AI_STATE_SAVE_INTERVAL 900000 // Milliseconds between saves of changed forecaster/appliance state
+
+// Power management
+#define CPU_MAX_FREQ_MHZ 240       // DFS ceiling while tasks are busy
+#define CPU_MIN_FREQ_MHZ 80        // DFS floor while idle (APB needs 80 MHz for Wi-Fi)
+#define ACTIVE_CURRENT_MA 68.0     // Estimated draw with a busy CPU and modem sleep (mA)
+#define IDLE_CURRENT_MA 30.0       // Estimated draw idling at the DFS floor (mA)
+#define LIGHT_SLEEP_CURRENT_MA 2.5 // Estimated draw in automatic light sleep (mA)
+#define POWER_REPORT_INTERVAL 300000 // Milliseconds between power/latency reports
+
+// FreeRTOS task layout (priority map)
+//
+//   Task       Core  Priority  Role
+//   sampling     1       5     Sensor capture, RMS and energy integration
+//   analytics    1       2     AiProcessor detection and learning, one batch per wake-up
+//   network      0       3     Wi-Fi/NTP/OTA upkeep, upload and buffering
+//   input        0       4     Button edge debounce and gesture timing (InputManager.h)
+//   ui           0       1     Serial console, button gestures, stack reports
+//   log          0       1     Drains the deferred log ring to the UART
+//
+// Wi-Fi and lwIP run on core 0 at priorities 18-23, so the network task
+// always yields to them. Sampling owns core 1 and preempts analytics.
+#define SAMPLING_TASK_CORE 1
+#define SAMPLING_TASK_PRIORITY 5
+#define SAMPLING_TASK_STACK 4608   // Bytes (the waveform analyzer lives on it)
+#define ANALYTICS_TASK_CORE 1
+#define ANALYTICS_TASK_PRIORITY 2
+#define ANALYTICS_TASK_STACK 4096  // Bytes
+#define NETWORK_TASK_CORE 0
+#define NETWORK_TASK_PRIORITY 3
+#define NETWORK_TASK_STACK 8192    // Bytes (HTTPClient and WiFiManager are stack hungry)
+#define UI_TASK_CORE 0
+#define UI_TASK_PRIORITY 1
+#define UI_TASK_STACK 3072         // Bytes
+#define LOG_TASK_CORE 0
+#define LOG_TASK_PRIORITY 1
+#define LOG_TASK_STACK 3072        // Bytes
+
+// Inter-task channels
+#define MEASUREMENT_QUEUE_SIZE 16  // Readings in flight between tasks (power of two)
+#define CHANGE_QUEUE_SIZE 8        // Load change events in flight to analytics (power of two)
+#define FEATURE_QUEUE_SIZE 8       // Waveform feature vectors in flight to analytics (power of two)
+#define ANOMALY_FLAG_QUEUE_SIZE 8  // Anomaly flags in flight from analytics to the uploader (power of two)
+#if LOW_POWER_MODE
+#define NETWORK_POLL_INTERVAL 500  // Milliseconds between Wi-Fi/OTA service calls
+#else
+#define NETWORK_POLL_INTERVAL 100  // Milliseconds between Wi-Fi/OTA service calls
+#endif
+#define NETWORK_CONNECTION_CHECK_INTERVAL 1000 // Milliseconds between connection state checks
+#define STACK_REPORT_INTERVAL 60000 // Milliseconds between stack high-watermark reports
+
+// Memory (steady state runs from fixed buffers, not the heap)
+#define BOOT_ARENA_SIZE 15872      // Bytes handed out to modules during setup()
+#define BACKEND_URL_MAX_LEN 128    // Backend URL buffer, including terminator
+#define JSON_PAYLOAD_SIZE 7680     // Serialized upload/telemetry payload buffer (bytes)
+#define HEAP_LOW_WATER_BYTES 16384 // Warn when the largest free heap block drops below this
+#ifndef NO_MALLOC_AFTER_INIT
+#define NO_MALLOC_AFTER_INIT 0     // Trap heap allocations from app tasks after setup()
+#endif
+#ifndef NO_MALLOC_ABORT
+#define NO_MALLOC_ABORT 0          // Abort on a trapped allocation instead of counting it
+#endif
 
 #endif // CONFIG_H
@@ -0,0 +1,196 @@
+/**
+ * CostProjector implementation
+ */
+
+#include "CostProjector.h"
+#include <math.h>
+#include <string.h>
+
+CostProjector::CostProjector() {
+  pricePerKwh = 0.0f;
+  standingPerDay = 0.0f;
+  billingDay = 1;
+  memset(&state, 0, sizeof(state));
+  state.magic = PROJECTION_STATE_MAGIC;
+  state.version = PROJECTION_STATE_VERSION;
+  day = 0;
+  periodEndDay = 0;
+  slotIndex = 0;
+  fallbackPower = 0.0f;
+  dayFutureKwh = dayFutureVariance = dayFutureLearned = 0.0;
+  periodFutureKwh = periodFutureVariance = periodFutureLearned = 0.0;
+  memset(&dayProjection, 0, sizeof(dayProjection));
+  memset(&periodProjection, 0, sizeof(periodProjection));
+}
+
+void CostProjector::setTariff(float pricePerKwh, float standingPerDay, uint8_t billingDay) {
+  this->pricePerKwh = pricePerKwh;
+  this->standingPerDay = standingPerDay;
+  this->billingDay = billingDay < 1 ? 1 : (billingDay > 28 ? 28 : billingDay);
+  day = 0;                         // Re-derive the billing period on the next update
+}
+
+// Howard Hinnant's algorithms, restricted to dates after 1970
+uint32_t CostProjector::daysFromCivil(int year, unsigned month, unsigned day) {
+  year -= month <= 2;
+  int era = year / 400;
+  unsigned yearOfEra = (unsigned)(year - era * 400);
+  unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return (uint32_t)(era * 146097 + (int)dayOfEra - 719468);
+}
+
+void CostProjector::civilFromDays(uint32_t days, int &year, unsigned &month, unsigned &day) {
+  uint32_t z = days + 719468;
+  uint32_t era = z / 146097;
+  unsigned dayOfEra = z - era * 146097;
+  unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+  unsigned mp = (5 * dayOfYear + 2) / 153;
+  day = dayOfYear - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = (int)(yearOfEra + era * 400) + (month <= 2);
+}
+
+void CostProjector::startPeriod(uint32_t today) {
+  int year;
+  unsigned month, date;
+  civilFromDays(today, year, month, date);
+  
+  // The period starts on billingDay of this month, or of the last one
+  if (date < billingDay) {
+    if (--month == 0) {
+      month = 12;
+      year--;
+    }
+  }
+  uint32_t start = daysFromCivil(year, month, billingDay);
+  if (++month == 13) {
+    month = 1;
+    year++;
+  }
+  periodEndDay = daysFromCivil(year, month, billingDay);
+  
+  if (state.periodStartDay != start) {
+    state.periodStartDay = start;
+    state.periodUsedKwh = 0.0f;
+  }
+}
+
+void CostProjector::slotExpectation(const WeeklyBaseline &profile, uint16_t bin, float fallback, float &kwh,
+                                    float &variance, bool &learned) const {
+  const WeeklyBaseline::Bin &b = profile.getBin(bin);
+  float hours = BASELINE_PERIOD_SECONDS / 3600.0f;
+  learned = b.periods > 0;
+  float mean = learned ? b.mean : fallback;
+  // One period says nothing about the spread; assume it is as large as the mean
+  float sigma = b.periods >= BASELINE_MIN_PERIODS ? sqrtf(b.periodVariance) : mean;
+  kwh = mean * hours / 1000.0f;
+  variance = (sigma * hours / 1000.0f) * (sigma * hours / 1000.0f);
+}
+
+void CostProjector::rebuildFuture(uint32_t slot, const WeeklyBaseline &profile) {
+  // Unlearned slots get the average of the learned ones
+  double sum = 0.0;
+  uint16_t learnedBins = 0;
+  for (uint16_t i = 0; i < BASELINE_BINS; i++) {
+    if (profile.getBin(i).periods > 0) {
+      sum += profile.getBin(i).mean;
+      learnedBins++;
+    }
+  }
+  fallbackPower = learnedBins > 0 ? (float)(sum / learnedBins) : 0.0f;
+  
+  uint32_t slotsPerDay = 86400UL / BASELINE_PERIOD_SECONDS;
+  uint32_t dayEnd = (slot / slotsPerDay + 1) * slotsPerDay;
+  uint32_t periodEnd = periodEndDay * slotsPerDay;
+  
+  dayFutureKwh = dayFutureVariance = dayFutureLearned = 0.0;
+  periodFutureKwh = periodFutureVariance = periodFutureLearned = 0.0;
+  for (uint32_t s = slot + 1; s < periodEnd; s++) {
+    float kwh, variance;
+    bool learned;
+    slotExpectation(profile, WeeklyBaseline::binOf(s * BASELINE_PERIOD_SECONDS), fallbackPower, kwh, variance, learned);
+    periodFutureKwh += kwh;
+    periodFutureVariance += variance;
+    periodFutureLearned += learned ? kwh : 0.0f;
+    if (s < dayEnd) {
+      dayFutureKwh += kwh;
+      dayFutureVariance += variance;
+      dayFutureLearned += learned ? kwh : 0.0f;
+    }
+  }
+  slotIndex = slot;
+}
+
+void CostProjector::update(uint32_t localSeconds, float energyKwh, const WeeklyBaseline &profile) {
+  uint32_t today = localSeconds / 86400;
+  if (today != day) {
+    if (today != state.day) {
+      state.day = today;
+      state.dayUsedKwh = 0.0f;
+    }
+    if (day == 0 || today >= periodEndDay) {
+      startPeriod(today);
+    }
+    day = today;
+    slotIndex = 0;
+  }
+  
+  if (energyKwh > 0.0f) {
+    state.dayUsedKwh += energyKwh;
+    state.periodUsedKwh += energyKwh;
+  }
+  
+  uint32_t slot = localSeconds / BASELINE_PERIOD_SECONDS;
+  if (slot != slotIndex) {
+    rebuildFuture(slot, profile);
+  }
+  
+  // Prorate the running slot
+  float slotKwh, slotVariance;
+  bool slotLearned;
+  slotExpectation(profile, WeeklyBaseline::binOf(localSeconds), fallbackPower, slotKwh, slotVariance, slotLearned);
+  float slotFraction = 1.0f - (float)(localSeconds % BASELINE_PERIOD_SECONDS) / BASELINE_PERIOD_SECONDS;
+  
+  uint32_t dayLeft = (today + 1) * 86400UL - localSeconds;
+  uint32_t periodLeft = periodEndDay * 86400UL - localSeconds;
+  project(dayProjection, state.dayUsedKwh, dayFutureKwh, dayFutureVariance, dayFutureLearned, slotKwh, slotVariance,
+          slotLearned, slotFraction, dayLeft, 1);
+  project(periodProjection, state.periodUsedKwh, periodFutureKwh, periodFutureVariance, periodFutureLearned, slotKwh,
+          slotVariance, slotLearned, slotFraction, periodLeft, (uint16_t)(periodEndDay - state.periodStartDay));
+}
+
+void CostProjector::project(Projection &out, float used, double futureKwh, double futureVariance,
+                            double futureLearned, float slotKwh, float slotVariance, bool slotLearned,
+                            float slotFraction, uint32_t secondsLeft, uint16_t days) const {
+  double remaining = futureKwh + slotFraction * slotKwh;
+  double variance = futureVariance + slotFraction * slotFraction * slotVariance;
+  double learned = futureLearned + (slotLearned ? slotFraction * slotKwh : 0.0f);
+  float margin = PROJECTION_INTERVAL_Z * sqrtf((float)(variance * PROJECTION_VARIANCE_INFLATION));
+  
+  out.usedKwh = used;
+  out.expectedKwh = used + (float)remaining;
+  out.lowKwh = out.expectedKwh - margin > used ? out.expectedKwh - margin : used;
+  out.highKwh = out.expectedKwh + margin;
+  float standing = standingPerDay * days;
+  out.cost = out.expectedKwh * pricePerKwh + standing;
+  out.costLow = out.lowKwh * pricePerKwh + standing;
+  out.costHigh = out.highKwh * pricePerKwh + standing;
+  out.learnedFraction = remaining > 0.0 ? (float)(learned / remaining) : 1.0f;
+  out.secondsLeft = secondsLeft;
+  out.days = days;
+}
+
+bool CostProjector::setState(const State &saved) {
+  if (saved.magic != PROJECTION_STATE_MAGIC || saved.version != PROJECTION_STATE_VERSION ||
+      !isfinite(saved.dayUsedKwh) || !isfinite(saved.periodUsedKwh) ||
+      saved.dayUsedKwh < 0.0f || saved.periodUsedKwh < 0.0f) {
+    return false;
+  }
+  
+  // Registers from an earlier day or period are dropped on the next update
+  state = saved;
+  day = 0;
+  return true;
+}
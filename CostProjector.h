@@ -0,0 +1,105 @@
+/**
+ * CostProjector Class
+ * End-of-day and end-of-billing-period energy and cost projections with
+ * confidence bounds. Energy used so far comes from the energy register.
+ * The rest of each period is the weekly profile's expected energy for the
+ * slots still to come, with the profile's spread giving the bounds. The
+ * future sums are rebuilt once per profile slot and only the running slot
+ * is prorated per reading, so updates are O(1) between slot boundaries.
+ * Slots the profile has not learned yet are filled with the learned
+ * average at full uncertainty.
+ */
+
+#ifndef COST_PROJECTOR_H
+#define COST_PROJECTOR_H
+
+#include <stdint.h>
+#include "WeeklyBaseline.h"
+
+#ifndef PROJECTION_INTERVAL_Z
+#define PROJECTION_INTERVAL_Z 1.64f // Two-sided 90 % bounds
+#endif
+#ifndef PROJECTION_VARIANCE_INFLATION
+#define PROJECTION_VARIANCE_INFLATION 4.0f // Slot deviations persist for hours; widens the sum of slot variances
+#endif
+
+#define PROJECTION_STATE_MAGIC 0x4A4F5250UL // "PROJ"
+#define PROJECTION_STATE_VERSION 1
+
+struct Projection {
+  float usedKwh;                   // Since the start of the period
+  float expectedKwh;               // Projected total at the end of the period
+  float lowKwh;                    // Confidence bounds of expectedKwh
+  float highKwh;
+  float cost;                      // Energy at the tariff price plus the standing charge
+  float costLow;
+  float costHigh;
+  float learnedFraction;           // Share of the remaining expectation from learned slots
+  uint32_t secondsLeft;
+  uint16_t days;                   // Days in the period
+};
+
+class CostProjector {
+public:
+  // Registers that must survive a reboot mid-period
+  struct State {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t day;                  // Local days since the epoch of dayUsedKwh
+    uint32_t periodStartDay;       // First day of the billing period of periodUsedKwh
+    float dayUsedKwh;
+    float periodUsedKwh;
+  };
+  
+  CostProjector();
+  
+  void setTariff(float pricePerKwh, float standingPerDay, uint8_t billingDay);
+  
+  // Adds the energy used since the previous call at a local time (seconds
+  // since the epoch) and refreshes both projections
+  void update(uint32_t localSeconds, float energyKwh, const WeeklyBaseline &profile);
+  
+  bool isValid() const { return day != 0; }
+  const Projection &getDay() const { return dayProjection; }
+  const Projection &getPeriod() const { return periodProjection; }
+  uint32_t getPeriodStartDay() const { return state.periodStartDay; }
+  
+  const State &getState() const { return state; }
+  bool setState(const State &saved);
+  
+  // Calendar helpers on days since the epoch
+  static uint32_t daysFromCivil(int year, unsigned month, unsigned day);
+  static void civilFromDays(uint32_t days, int &year, unsigned &month, unsigned &day);
+  
+private:
+  float pricePerKwh;
+  float standingPerDay;
+  uint8_t billingDay;
+  
+  State state;
+  uint32_t day;                    // Day of the last update; 0 before the first
+  uint32_t periodEndDay;           // First day of the next billing period
+  
+  // Expected energy from the start of the next slot to the end of each period
+  uint32_t slotIndex;              // Local slots since the epoch the sums were built for
+  float fallbackPower;             // Average learned slot power, for slots not learned yet (W)
+  double dayFutureKwh;
+  double dayFutureVariance;
+  double dayFutureLearned;
+  double periodFutureKwh;
+  double periodFutureVariance;
+  double periodFutureLearned;
+  
+  Projection dayProjection;
+  Projection periodProjection;
+  
+  void startPeriod(uint32_t today);
+  void rebuildFuture(uint32_t slot, const WeeklyBaseline &profile);
+  void slotExpectation(const WeeklyBaseline &profile, uint16_t bin, float fallback, float &kwh, float &variance,
+                       bool &learned) const;
+  void project(Projection &out, float used, double futureKwh, double futureVariance, double futureLearned,
+               float slotKwh, float slotVariance, bool slotLearned, float slotFraction, uint32_t secondsLeft,
+               uint16_t days) const;
+};
+
+#endif // COST_PROJECTOR_H
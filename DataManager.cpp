@@ -3,38 +3,70 @@
  */
 
 #include "DataManager.h"
+#include "Arena.h"
+#include "BootTimeline.h"
+#include "Logger.h"
+#include "Profiler.h"
 
 DataManager::DataManager() {
-  backendUrl = DEFAULT_BACKEND_URL;
+  strlcpy(backendUrl, DEFAULT_BACKEND_URL, sizeof(backendUrl));
+  bundleUrl[0] = '\0';
+  payloadBuffer = NULL;
+  telemetrySourceCount = 0;
+  lateFlags = 0;
+  cadence.measurementMs = MEASUREMENT_INTERVAL_MS;
+  cadence.aggregationMs = AGGREGATION_PERIOD_MS;
+  cadence.reportMs = REPORT_PERIOD_MS;
+  tariff.pricePerKwh = TARIFF_PRICE_PER_KWH;
+  tariff.standingPerDay = TARIFF_STANDING_PER_DAY;
+  tariff.billingDay = TARIFF_BILLING_DAY;
+  strlcpy(tariff.currency, TARIFF_CURRENCY, sizeof(tariff.currency));
 }
 
 void DataManager::begin() {
   // Load configuration from file system
   loadConfig();
+  validateCadence();
   
-  // Initialize data buffer
-  dataBuffer.reserve(DATA_BUFFER_SIZE);
+  // Payload buffer lives for the lifetime of the firmware
+  payloadBuffer = bootArena.allocateArray<char>(JSON_PAYLOAD_SIZE);
+  if (payloadBuffer == NULL) {
+    Serial.println("ERROR: Boot arena exhausted, uploads disabled (increase BOOT_ARENA_SIZE)");
+  }
   
   Serial.println("DataManager initialized");
   Serial.print("Backend URL: "); Serial.println(backendUrl);
+  Serial.printf("Cadence: measure every %u ms, aggregate %u ms, report %u ms\n",
+                (unsigned)cadence.measurementMs, (unsigned)cadence.aggregationMs, (unsigned)cadence.reportMs);
 }
 
 bool DataManager::sendData(const PowerData &data) {
-  String jsonPayload = convertDataToJson(data);
-  return sendJsonToBackend(jsonPayload);
+  if (payloadBuffer == NULL) {
+    return false;
+  }
+  size_t length = convertDataToJson(data, payloadBuffer, JSON_PAYLOAD_SIZE);
+  if (!sendJsonToBackend(payloadBuffer, length)) {
+    return false;
+  }
+  
+  recordUpload();
+  return true;
+}
+
+void DataManager::recordUpload() {
+  if (!bootTimeline.reached(BOOT_FIRST_UPLOAD)) {
+    bootTimeline.mark(BOOT_FIRST_UPLOAD);
+    LOG_INFO("First upload %u ms after reset (first sample at %u ms)",
+             (unsigned)bootTimeline.getMs(BOOT_FIRST_UPLOAD), (unsigned)bootTimeline.getMs(BOOT_FIRST_SAMPLE));
+  }
 }
 
 void DataManager::bufferData(const PowerData &data) {
-  // Only buffer if we have space
-  if (dataBuffer.size() < DATA_BUFFER_SIZE) {
-    dataBuffer.push_back(data);
-    Serial.print("Data buffered. Buffer size: "); Serial.println(dataBuffer.size());
+  // When full the oldest reading is overwritten
+  if (dataBuffer.push(data)) {
+    LOG_DEBUG("Data buffered. Buffer size: %u", (unsigned)dataBuffer.size());
   } else {
-    Serial.println("WARNING: Data buffer full, discarding oldest reading");
-    // Remove oldest reading
-    dataBuffer.erase(dataBuffer.begin());
-    // Add new reading
-    dataBuffer.push_back(data);
+    LOG_WARN_EVERY(60000, "Data buffer full, discarding oldest reading");
   }
 }
 
@@ -47,52 +79,205 @@ bool DataManager::sendBufferedData() {
     return true; // No data to send
   }
   
-  Serial.print("Attempting to send "); Serial.print(dataBuffer.size()); Serial.println(" buffered readings");
+  LOG_INFO("Attempting to send %u buffered readings", (unsigned)dataBuffer.size());
   
   size_t initialSize = dataBuffer.size();
-  std::vector<PowerData> failedTransmissions;
   
-  // Try to send each buffered item
-  for (const auto &data : dataBuffer) {
-    if (!sendData(data)) {
-      failedTransmissions.push_back(data);
+  // Send oldest first; stop at the first failure so readings stay in order
+  // and an unreachable server does not cost a full retry cycle per batch
+  while (!dataBuffer.empty() && payloadBuffer != NULL) {
+    size_t count = dataBuffer.size() < UPLOAD_BATCH_MAX ? dataBuffer.size() : UPLOAD_BATCH_MAX;
+    
+    // A lone reading keeps the original single-reading payload
+    bool sent;
+    if (count == 1) {
+      sent = sendData(dataBuffer.front());
+    } else {
+      size_t length = convertBatchToJson(count, payloadBuffer, JSON_PAYLOAD_SIZE);
+      sent = length > 0 && sendJsonToBackend(payloadBuffer, length);
+      if (sent) {
+        recordUpload();
+      }
+    }
+    if (!sent) {
+      break;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+      dataBuffer.popFront();
+    }
+    if (!dataBuffer.empty()) {
+      // Short delay to avoid overwhelming the server
+      delay(100);
     }
-    // Short delay to avoid overwhelming the server
-    delay(100);
   }
   
-  // Replace buffer with only the failed transmissions
-  dataBuffer = failedTransmissions;
-  
-  Serial.print("Buffered data sent. Remaining buffer size: "); Serial.println(dataBuffer.size());
+  LOG_INFO("Buffered data sent. Remaining buffer size: %u", (unsigned)dataBuffer.size());
   
   return dataBuffer.size() < initialSize;
 }
 
-void DataManager::setBackendUrl(const String &url) {
-  backendUrl = url;
+void DataManager::rebaseTimestamps(unsigned long bootEpoch) {
+  for (size_t i = 0; i < dataBuffer.size(); i++) {
+    if (!dataBuffer[i].synced) {
+      dataBuffer[i].timestamp = bootEpoch + dataBuffer[i].timestamp / 1000;
+      dataBuffer[i].synced = true;
+    }
+  }
+}
+
+bool DataManager::markAnomaly(unsigned long timestamp, bool synced) {
+  // Flags trail their reading by one analytics pass, so search from the newest
+  for (size_t i = dataBuffer.size(); i-- > 0;) {
+    if (dataBuffer[i].timestamp == timestamp && dataBuffer[i].synced == synced) {
+      dataBuffer[i].anomaly = true;
+      return true;
+    }
+  }
+  lateFlags++;
+  LOG_DEBUG("Anomaly flag for %lu arrived after its reading was uploaded", timestamp);
+  return false;
+}
+
+void DataManager::setBackendUrl(const char *url) {
+  strlcpy(backendUrl, url, sizeof(backendUrl));
   saveConfig();
 }
 
-String DataManager::convertDataToJson(const PowerData &data) {
+void DataManager::addTelemetrySource(const char *key, TelemetrySource source) {
+  if (telemetrySourceCount >= MAX_TELEMETRY_SOURCES) {
+    Serial.print("Too many telemetry sources, ignoring: ");
+    Serial.println(key);
+    return;
+  }
+  telemetrySources[telemetrySourceCount].key = key;
+  telemetrySources[telemetrySourceCount].source = source;
+  telemetrySourceCount++;
+}
+
+bool DataManager::sendTelemetry(unsigned long timestamp) {
+  // Only the network task sends, so the document can live in static storage
+  static StaticJsonDocument<TELEMETRY_DOC_SIZE> doc;
+  doc.clear();
+  
+  doc["type"] = "telemetry";
+  doc["timestamp"] = timestamp;
+  doc["device_id"] = DEVICE_NAME;
+  doc["firmware"] = FIRMWARE_VERSION;
+  
+  JsonObject telemetry = doc.createNestedObject("telemetry");
+  for (int i = 0; i < telemetrySourceCount; i++) {
+    JsonObject section = telemetry.createNestedObject(telemetrySources[i].key);
+    telemetrySources[i].source(section);
+  }
+  
+  if (doc.overflowed()) {
+    Serial.println("WARNING: Telemetry payload truncated, increase TELEMETRY_DOC_SIZE");
+  }
+  
+  if (payloadBuffer == NULL) {
+    return false;
+  }
+  
+  size_t length;
+  {
+    PROFILE_ZONE(PROF_SERIALIZE);
+    length = serializeJson(doc, payloadBuffer, JSON_PAYLOAD_SIZE);
+  }
+  if (length >= JSON_PAYLOAD_SIZE - 1) {
+    Serial.println("WARNING: Telemetry payload does not fit, increase JSON_PAYLOAD_SIZE");
+    return false;
+  }
+  return sendJsonToBackend(payloadBuffer, length);
+}
+
+size_t DataManager::convertDataToJson(const PowerData &data, char *out, size_t size) {
+  PROFILE_ZONE(PROF_SERIALIZE);
+  
   // Create JSON document
   StaticJsonDocument<256> doc;
   
   doc["timestamp"] = data.timestamp;
+  if (!data.synced) {
+    doc["synced"] = false;
+  }
   doc["current_amps"] = data.current;
   doc["voltage_volts"] = data.voltage;
   doc["power_watts"] = data.power;
   doc["energy_kwh"] = data.energy;
+  if (data.anomaly) {
+    doc["anomaly"] = true;
+  }
   doc["device_id"] = DEVICE_NAME;
   
-  // Serialize to string
-  String jsonString;
-  serializeJson(doc, jsonString);
+  // Serialize into the caller's buffer
+  return serializeJson(doc, out, size);
+}
+
+size_t DataManager::convertBatchToJson(size_t count, char *out, size_t size) {
+  PROFILE_ZONE(PROF_SERIALIZE);
+  
+  // Only the network task uploads, so the document can live in static storage
+  static StaticJsonDocument<BATCH_DOC_SIZE> doc;
+  doc.clear();
   
-  return jsonString;
+  doc["type"] = "batch";
+  doc["device_id"] = DEVICE_NAME;
+  JsonArray readings = doc.createNestedArray("readings");
+  for (size_t i = 0; i < count; i++) {
+    const PowerData &data = dataBuffer[i];
+    JsonObject reading = readings.createNestedObject();
+    reading["timestamp"] = data.timestamp;
+    if (!data.synced) {
+      reading["synced"] = false;
+    }
+    reading["current_amps"] = data.current;
+    reading["voltage_volts"] = data.voltage;
+    reading["power_watts"] = data.power;
+    reading["energy_kwh"] = data.energy;
+    if (data.anomaly) {
+      reading["anomaly"] = true;
+    }
+  }
+  
+  size_t length = serializeJson(doc, out, size);
+  if (doc.overflowed() || length >= size - 1) {
+    LOG_ERROR("Upload batch of %u readings does not fit, reduce UPLOAD_BATCH_MAX", (unsigned)count);
+    return 0;
+  }
+  return length;
 }
 
-bool DataManager::sendJsonToBackend(const String &jsonPayload) {
+const Cadence &DataManager::getCadence() {
+  return cadence;
+}
+
+const char *DataManager::getBundleUrl() {
+  return bundleUrl;
+}
+
+const Tariff &DataManager::getTariff() {
+  return tariff;
+}
+
+void DataManager::validateCadence() {
+  if (cadence.measurementMs < MIN_MEASUREMENT_INTERVAL_MS) {
+    cadence.measurementMs = MIN_MEASUREMENT_INTERVAL_MS;
+  }
+  if (cadence.aggregationMs < cadence.measurementMs) {
+    cadence.aggregationMs = cadence.measurementMs;
+  }
+  if (cadence.reportMs < cadence.aggregationMs) {
+    cadence.reportMs = cadence.aggregationMs;
+  }
+  
+  // Every month has the billing day
+  if (tariff.billingDay < 1 || tariff.billingDay > 28) {
+    tariff.billingDay = TARIFF_BILLING_DAY;
+  }
+}
+
+bool DataManager::sendJsonToBackend(const char *payload, size_t length) {
   HTTPClient http;
   bool success = false;
   int retryCount = 0;
@@ -103,21 +288,19 @@ bool DataManager::sendJsonToBackend(const String &jsonPayload) {
     http.addHeader("Content-Type", "application/json");
     
     // Send POST request
-    int httpResponseCode = http.POST(jsonPayload);
+    int httpResponseCode = http.POST((uint8_t *)payload, length);
     
     if (httpResponseCode > 0) {
-      Serial.print("HTTP Response code: ");
-      Serial.println(httpResponseCode);
+      LOG_DEBUG("HTTP Response code: %d", httpResponseCode);
       
       if (httpResponseCode == HTTP_CODE_OK) {
         success = true;
       } else {
-        Serial.print("HTTP error: ");
-        Serial.println(http.errorToString(httpResponseCode));
+        LOG_WARN_EVERY(10000, "HTTP error: %d", httpResponseCode);
       }
     } else {
-      Serial.print("Failed to connect, error: ");
-      Serial.println(http.errorToString(httpResponseCode));
+      // Negative codes are HTTPClient errors (see HTTPC_ERROR_* in HTTPClient.h)
+      LOG_WARN_EVERY(10000, "Failed to connect, error: %d", httpResponseCode);
     }
     
     http.end();
@@ -125,7 +308,7 @@ bool DataManager::sendJsonToBackend(const String &jsonPayload) {
     if (!success) {
       retryCount++;
       if (retryCount < MAX_RETRY_ATTEMPTS) {
-        Serial.print("Retrying ("); Serial.print(retryCount); Serial.println("/3)...");
+        LOG_DEBUG("Retrying (%d/%d)...", retryCount, MAX_RETRY_ATTEMPTS);
         delay(500 * retryCount); // Exponential backoff
       }
     }
@@ -149,7 +332,7 @@ bool DataManager::loadConfig() {
   }
   
   // Parse JSON
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<768> doc;
   DeserializationError error = deserializeJson(doc, configFile);
   configFile.close();
   
@@ -161,7 +344,19 @@ bool DataManager::loadConfig() {
   
   // Load settings
   if (doc.containsKey("backend_url")) {
-    backendUrl = doc["backend_url"].as<String>();
+    strlcpy(backendUrl, doc["backend_url"] | DEFAULT_BACKEND_URL, sizeof(backendUrl));
+  }
+  if (doc.containsKey("bundle_url")) {
+    strlcpy(bundleUrl, doc["bundle_url"] | "", sizeof(bundleUrl));
+  }
+  cadence.measurementMs = doc["measurement_interval_ms"] | cadence.measurementMs;
+  cadence.aggregationMs = doc["aggregation_period_ms"] | cadence.aggregationMs;
+  cadence.reportMs = doc["report_period_ms"] | cadence.reportMs;
+  tariff.pricePerKwh = doc["tariff_per_kwh"] | tariff.pricePerKwh;
+  tariff.standingPerDay = doc["standing_charge_per_day"] | tariff.standingPerDay;
+  tariff.billingDay = doc["billing_day"] | tariff.billingDay;
+  if (doc.containsKey("currency")) {
+    strlcpy(tariff.currency, doc["currency"] | TARIFF_CURRENCY, sizeof(tariff.currency));
   }
   
   Serial.println("Configuration loaded");
@@ -169,10 +364,18 @@ bool DataManager::loadConfig() {
 }
 
 bool DataManager::saveConfig() {
-  StaticJsonDocument<512> doc;
+  StaticJsonDocument<768> doc;
   
   // Store current settings
-  doc["backend_url"] = backendUrl;
+  doc["backend_url"] = (const char *)backendUrl;
+  doc["bundle_url"] = (const char *)bundleUrl;
+  doc["measurement_interval_ms"] = cadence.measurementMs;
+  doc["aggregation_period_ms"] = cadence.aggregationMs;
+  doc["report_period_ms"] = cadence.reportMs;
+  doc["tariff_per_kwh"] = tariff.pricePerKwh;
+  doc["standing_charge_per_day"] = tariff.standingPerDay;
+  doc["billing_day"] = tariff.billingDay;
+  doc["currency"] = (const char *)tariff.currency;
   
   // Open file for writing
   File configFile = SPIFFS.open("/config.json", "w");
@@ -7,8 +7,12 @@
 #define DATA_MANAGER_H
 
 #include "Config.h"
+#include "RingBuffer.h"
 #include <ArduinoJson.h>
 
+// Fills one named section of the periodic telemetry payload
+typedef void (*TelemetrySource)(JsonObject &out);
+
 class DataManager {
 public:
   DataManager();
@@ -17,16 +21,40 @@ public:
   bool sendData(const PowerData &data);  // Send power data to backend
   void bufferData(const PowerData &data); // Store data for later transmission
   bool hasBufferedData();                // Check if there is buffered data
-  bool sendBufferedData();               // Send buffered data to backend
+  bool sendBufferedData();               // Send buffered data to backend in batches
+  void rebaseTimestamps(unsigned long bootEpoch); // Convert buffered pre-NTP uptime stamps to epoch
+  bool markAnomaly(unsigned long timestamp, bool synced); // Flag the buffered reading with this stamp; false once it was uploaded
+  uint32_t getLateFlags() { return lateFlags; } // Flags that arrived after their reading was uploaded
+  
+  void setBackendUrl(const char *url);   // Set backend URL
+  const char *getBundleUrl();            // Where newer parameter bundles are fetched from; empty to disable
+  const Cadence &getCadence();           // Measurement, aggregation and report periods
+  const Tariff &getTariff();             // Energy price, standing charge and billing day
+  
+  void addTelemetrySource(const char *key, TelemetrySource source); // Register a telemetry section
+  bool sendTelemetry(unsigned long timestamp); // Send all telemetry sections to backend
   
-  void setBackendUrl(const String &url); // Set backend URL
-
 private:
-  String backendUrl;                 // URL for the backend server
-  std::vector<PowerData> dataBuffer; // Buffer for unsent data
-
-  bool sendJsonToBackend(const String &jsonPayload); // Send JSON to backend
-  String convertDataToJson(const PowerData &data);   // Convert data to JSON string
+  char backendUrl[BACKEND_URL_MAX_LEN]; // URL for the backend server
+  char bundleUrl[BACKEND_URL_MAX_LEN]; // Loaded from config.json
+  RingBuffer<PowerData, DATA_BUFFER_SIZE> dataBuffer; // Buffer for unsent data
+  uint32_t lateFlags;                // Anomaly flags whose reading had already gone
+  char *payloadBuffer;               // Serialized JSON, from the boot arena
+  Cadence cadence;                   // Loaded from config.json
+  Tariff tariff;                     // Loaded from config.json
+  
+  struct TelemetryEntry {
+    const char *key;
+    TelemetrySource source;
+  };
+  TelemetryEntry telemetrySources[MAX_TELEMETRY_SOURCES]; // Registered telemetry sections
+  int telemetrySourceCount;
+  
+  bool sendJsonToBackend(const char *payload, size_t length); // Send JSON to backend
+  size_t convertDataToJson(const PowerData &data, char *out, size_t size); // Serialize one reading
+  size_t convertBatchToJson(size_t count, char *out, size_t size); // Serialize the oldest buffered readings
+  void validateCadence();            // Clamp periods to workable values
+  void recordUpload();               // Note the first successful upload in the boot timeline
   bool loadConfig();                                // Load configuration from storage
   bool saveConfig();                                // Save configuration to storage
 };
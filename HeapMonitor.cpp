@@ -0,0 +1,137 @@
+/**
+ * HeapMonitor implementation
+ */
+
+#include "HeapMonitor.h"
+#include "Arena.h"
+#include "Config.h"
+#include "Logger.h"
+#include <esp_heap_caps.h>
+
+HeapMonitor heapMonitor;
+
+HeapMonitor::HeapMonitor() {
+  watchedCount = 0;
+  initDone = false;
+  violations = 0;
+  lastViolationSize = 0;
+  lastViolationTask = NULL;
+  freeAtInit = 0;
+}
+
+void HeapMonitor::watchTask(TaskHandle_t task) {
+  if (task == NULL || watchedCount >= HEAP_MAX_WATCHED_TASKS) {
+    return;
+  }
+  watched[watchedCount++] = task;
+}
+
+void HeapMonitor::endInit() {
+  bootArena.seal();
+  freeAtInit = getFreeBytes();
+  initDone = true;
+  
+  Serial.printf("Init complete: boot arena %u/%u bytes, heap free %u, largest block %u\n",
+                (unsigned)bootArena.getUsed(), (unsigned)bootArena.getCapacity(),
+                (unsigned)freeAtInit, (unsigned)getLargestFreeBlock());
+}
+
+uint32_t HeapMonitor::getFreeBytes() {
+  return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t HeapMonitor::getLargestFreeBlock() {
+  return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+}
+
+uint32_t HeapMonitor::getMinFreeBytes() {
+  return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t HeapMonitor::getViolations() {
+  return violations;
+}
+
+void HeapMonitor::check() {
+  uint32_t largest = getLargestFreeBlock();
+  if (largest < HEAP_LOW_WATER_BYTES) {
+    LOG_WARN_EVERY(600000, "Heap fragmented: largest free block %u bytes (free %u)",
+                   (unsigned)largest, (unsigned)getFreeBytes());
+  }
+  if (violations > 0) {
+    LOG_WARN_EVERY(600000, "%u heap allocations after init (last %u bytes)",
+                   (unsigned)violations, (unsigned)lastViolationSize);
+  }
+}
+
+void HeapMonitor::printReport() {
+  uint32_t freeBytes = getFreeBytes();
+  uint32_t largest = getLargestFreeBlock();
+  
+  Serial.printf("Heap: free %u, largest block %u (%u%% fragmented), min ever %u, at init %u\n",
+                (unsigned)freeBytes, (unsigned)largest,
+                freeBytes > 0 ? (unsigned)(100 - (uint64_t)largest * 100 / freeBytes) : 0,
+                (unsigned)getMinFreeBytes(), (unsigned)freeAtInit);
+  Serial.printf("Boot arena: %u/%u bytes, %u refused\n", (unsigned)bootArena.getUsed(),
+                (unsigned)bootArena.getCapacity(), (unsigned)bootArena.getFailed());
+#if NO_MALLOC_AFTER_INIT
+  TaskHandle_t task = lastViolationTask;
+  Serial.printf("Allocations after init: %u", (unsigned)violations);
+  if (task != NULL) {
+    Serial.printf(" (last %u bytes from %s)", (unsigned)lastViolationSize, pcTaskGetName(task));
+  }
+  Serial.println();
+#endif
+}
+
+void HeapMonitor::addTelemetry(JsonObject &out) {
+  out["free"] = getFreeBytes();
+  out["largest_block"] = getLargestFreeBlock();
+  out["min_free"] = getMinFreeBytes();
+  out["arena_used"] = bootArena.getUsed();
+  out["violations"] = violations;
+}
+
+void HeapMonitor::onAllocation(size_t size) {
+  if (!initDone) {
+    return;
+  }
+  
+  TaskHandle_t current = xTaskGetCurrentTaskHandle();
+  for (int i = 0; i < watchedCount; i++) {
+    if (watched[i] == current) {
+      violations++;
+      lastViolationSize = size;
+      lastViolationTask = current;
+#if NO_MALLOC_ABORT
+      abort();
+#endif
+      return;
+    }
+  }
+}
+
+#if NO_MALLOC_AFTER_INIT
+// Linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see the
+// main_app_heapcheck environment); operator new goes through malloc too
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  heapMonitor.onAllocation(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  heapMonitor.onAllocation(count * size);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  heapMonitor.onAllocation(size);
+  return __real_realloc(ptr, size);
+}
+}
+#endif
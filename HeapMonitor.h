@@ -0,0 +1,47 @@
+/**
+ * HeapMonitor Class
+ * Tracks heap health (free bytes, largest free block, minimum ever free)
+ * and, when built with NO_MALLOC_AFTER_INIT=1, traps heap allocations made
+ * by watched tasks once initialization has finished.
+ */
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define HEAP_MAX_WATCHED_TASKS 6
+
+class HeapMonitor {
+public:
+  HeapMonitor();
+  
+  void watchTask(TaskHandle_t task); // Task that must not allocate after endInit()
+  void endInit();                    // Seal the boot arena and start trapping
+  
+  uint32_t getFreeBytes();
+  uint32_t getLargestFreeBlock();
+  uint32_t getMinFreeBytes();        // Low-water mark since boot
+  uint32_t getViolations();          // Allocations trapped after endInit()
+  
+  void check();                      // Warn when fragmentation gets close to failing
+  void printReport();
+  void addTelemetry(JsonObject &out);
+  
+  // Called from the malloc wrappers; must not allocate or print
+  void onAllocation(size_t size);
+  
+private:
+  TaskHandle_t watched[HEAP_MAX_WATCHED_TASKS];
+  int watchedCount;
+  volatile bool initDone;
+  volatile uint32_t violations;
+  volatile uint32_t lastViolationSize;
+  TaskHandle_t volatile lastViolationTask;
+  uint32_t freeAtInit;               // Free heap when endInit() ran
+};
+
+extern HeapMonitor heapMonitor;
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,370 @@
+/**
+ * InferenceEngine implementation
+ */
+
+#include "InferenceEngine.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+InferenceEngine::InferenceEngine() {
+  unload();
+}
+
+void InferenceEngine::unload() {
+  blob = NULL;
+  header = NULL;
+  tensors = NULL;
+  ops = NULL;
+  arena = NULL;
+  arenaCapacity = 0;
+  error = "no model";
+  invocations = 0;
+  lastMicros = 0;
+  maxMicros = 0;
+}
+
+bool InferenceEngine::fail(const char *message) {
+  header = NULL;
+  error = message;
+  return false;
+}
+
+uint32_t InferenceEngine::micros() {
+#ifdef ARDUINO
+  return ::micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint32_t InferenceEngine::crc32(const uint8_t *data, size_t size, uint32_t crc) {
+  // Bitwise CRC-32 (IEEE); only run when a model is loaded
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+bool InferenceEngine::load(const uint8_t *blob, size_t size, uint8_t *arena, size_t arenaCapacity) {
+  unload();
+  this->blob = blob;
+  this->arena = arena;
+  this->arenaCapacity = arenaCapacity;
+  
+  if (blob == NULL || size < sizeof(ModelHeader) || ((uintptr_t)blob & 3) != 0) {
+    return fail("blob missing, short or unaligned");
+  }
+  header = reinterpret_cast<const ModelHeader *>(blob);
+  if (header->magic != MODEL_MAGIC || header->version != MODEL_VERSION) {
+    return fail("bad magic or version");
+  }
+  if (header->totalSize < sizeof(ModelHeader) || header->totalSize > size) {
+    return fail("blob truncated");
+  }
+  
+  // The CRC covers the whole blob with its own field taken as zero
+  const size_t crcOffset = offsetof(ModelHeader, crc32);
+  const uint8_t zero[4] = { 0, 0, 0, 0 };
+  uint32_t crc = crc32(blob, crcOffset);
+  crc = crc32(zero, sizeof(zero), crc);
+  crc = crc32(blob + crcOffset + 4, header->totalSize - crcOffset - 4, crc);
+  if (crc != header->crc32) {
+    return fail("CRC mismatch");
+  }
+  
+  return validate(header->totalSize);
+}
+
+size_t InferenceEngine::tensorBytes(const TensorDesc &tensor) const {
+  size_t elementSize = tensor.type == TENSOR_INT32 ? 4 : 1;
+  return (size_t)tensor.length * tensor.channels * elementSize;
+}
+
+bool InferenceEngine::validate(size_t size) {
+  size_t tableBytes = sizeof(ModelHeader) + header->tensorCount * sizeof(TensorDesc) +
+                      header->opCount * sizeof(OpDesc);
+  if (tableBytes > size) {
+    return fail("tables past end of blob");
+  }
+  tensors = reinterpret_cast<const TensorDesc *>(blob + sizeof(ModelHeader));
+  ops = reinterpret_cast<const OpDesc *>(blob + sizeof(ModelHeader) + header->tensorCount * sizeof(TensorDesc));
+  
+  if (header->arenaSize > arenaCapacity || (arena == NULL && header->arenaSize > 0)) {
+    return fail("arena too small");
+  }
+  if (header->input >= header->tensorCount || header->output >= header->tensorCount ||
+      tensors[header->input].location != TENSOR_ARENA || tensors[header->output].location != TENSOR_ARENA) {
+    return fail("bad input/output tensor");
+  }
+  
+  // Every tensor must lie inside its region; int32 data must be aligned
+  // and zero points must be int8 values so the kernels' sums cannot overflow
+  for (uint16_t i = 0; i < header->tensorCount; i++) {
+    const TensorDesc &tensor = tensors[i];
+    size_t bytes = tensorBytes(tensor);
+    size_t limit = tensor.location == TENSOR_CONST ? size : header->arenaSize;
+    if (tensor.location > TENSOR_ARENA || tensor.type > TENSOR_INT32 || bytes == 0 ||
+        tensor.offset > limit || bytes > limit - tensor.offset ||
+        (tensor.type == TENSOR_INT32 && (tensor.offset & 3) != 0)) {
+      return fail("tensor out of bounds");
+    }
+    if (tensor.zeroPoint < -128 || tensor.zeroPoint > 127) {
+      return fail("zero point out of range");
+    }
+  }
+  
+  // Shapes must agree with each op so invoke() needs no checks; the kernels
+  // read op inputs from the arena, so a constant input is rejected
+  for (uint16_t i = 0; i < header->opCount; i++) {
+    const OpDesc &op = ops[i];
+    if (op.input >= header->tensorCount || op.output >= header->tensorCount ||
+        tensors[op.input].location != TENSOR_ARENA || tensors[op.output].location != TENSOR_ARENA ||
+        tensors[op.input].type != TENSOR_INT8 || tensors[op.output].type != TENSOR_INT8) {
+      return fail("bad op tensors");
+    }
+    const TensorDesc &in = tensors[op.input];
+    const TensorDesc &out = tensors[op.output];
+    size_t inCount = (size_t)in.length * in.channels;
+    size_t outCount = (size_t)out.length * out.channels;
+    bool ok = false;
+    
+    switch (op.type) {
+      case OP_DENSE:
+      case OP_CONV1D: {
+        if (op.weights >= header->tensorCount || op.bias >= header->tensorCount) {
+          break;
+        }
+        const TensorDesc &w = tensors[op.weights];
+        const TensorDesc &b = tensors[op.bias];
+        bool constants = w.location == TENSOR_CONST && w.type == TENSOR_INT8 &&
+                         b.location == TENSOR_CONST && b.type == TENSOR_INT32 &&
+                         (size_t)b.length * b.channels == out.channels && op.shift <= 30 && op.shift >= -31;
+        if (op.type == OP_DENSE) {
+          ok = constants && out.length == 1 && w.length == out.channels && w.channels == inCount;
+        } else {
+          size_t padded = (size_t)in.length + op.padding;
+          ok = constants && op.kernel > 0 && op.stride > 0 && padded >= op.kernel &&
+               out.length == (padded - op.kernel) / op.stride + 1 &&
+               w.length == out.channels && w.channels == (size_t)op.kernel * in.channels;
+        }
+        break;
+      }
+      case OP_MAXPOOL1D:
+        ok = op.kernel > 0 && op.stride > 0 && in.length >= op.kernel && out.channels == in.channels &&
+             out.length == (in.length - op.kernel) / op.stride + 1;
+        break;
+      case OP_RELU:
+        ok = outCount == inCount;
+        break;
+      case OP_LOOKUP:
+        ok = outCount == inCount && op.weights < header->tensorCount &&
+             tensors[op.weights].location == TENSOR_CONST && tensorBytes(tensors[op.weights]) == 256;
+        break;
+    }
+    if (!ok) {
+      return fail("op shape mismatch");
+    }
+  }
+  
+  error = "";
+  return true;
+}
+
+const void *InferenceEngine::constData(uint16_t index) const {
+  return blob + tensors[index].offset;
+}
+
+int8_t *InferenceEngine::activation(uint16_t index) const {
+  return reinterpret_cast<int8_t *>(arena + tensors[index].offset);
+}
+
+int8_t *InferenceEngine::input() {
+  return header ? activation(header->input) : NULL;
+}
+
+const int8_t *InferenceEngine::output() const {
+  return header ? activation(header->output) : NULL;
+}
+
+size_t InferenceEngine::inputSize() const {
+  return header ? tensorBytes(tensors[header->input]) : 0;
+}
+
+size_t InferenceEngine::outputSize() const {
+  return header ? tensorBytes(tensors[header->output]) : 0;
+}
+
+void InferenceEngine::setInput(size_t index, float value) {
+  const TensorDesc &tensor = tensors[header->input];
+  long q = lroundf(value / tensor.scale) + tensor.zeroPoint;
+  activation(header->input)[index] = (int8_t)(q < -128 ? -128 : q > 127 ? 127 : q);
+}
+
+float InferenceEngine::dequantizeInput(size_t index) const {
+  const TensorDesc &tensor = tensors[header->input];
+  return tensor.scale * (activation(header->input)[index] - tensor.zeroPoint);
+}
+
+float InferenceEngine::dequantizeOutput(size_t index) const {
+  const TensorDesc &tensor = tensors[header->output];
+  return tensor.scale * (activation(header->output)[index] - tensor.zeroPoint);
+}
+
+int32_t InferenceEngine::requantize(int32_t acc, int32_t multiplier, int shift) {
+  // acc * multiplier * 2^(shift - 31), rounded half away from zero
+  int64_t product = (int64_t)acc * multiplier;
+  int rightShift = 31 - shift;
+  int64_t round = (int64_t)1 << (rightShift - 1);
+  return (int32_t)(product >= 0 ? (product + round) >> rightShift : -((-product + round) >> rightShift));
+}
+
+static inline int8_t clampOutput(int32_t value, int32_t zeroPoint, int8_t actMin, int8_t actMax) {
+  value += zeroPoint;
+  if (value < actMin) {
+    value = actMin;
+  }
+  if (value > actMax) {
+    value = actMax;
+  }
+  return (int8_t)value;
+}
+
+void InferenceEngine::dense(const OpDesc &op) const {
+  const TensorDesc &in = tensors[op.input];
+  const TensorDesc &w = tensors[op.weights];
+  const TensorDesc &out = tensors[op.output];
+  const int8_t *x = activation(op.input);
+  const int8_t *weights = static_cast<const int8_t *>(constData(op.weights));
+  const int32_t *bias = static_cast<const int32_t *>(constData(op.bias));
+  int8_t *y = activation(op.output);
+  size_t n = w.channels;
+  
+  for (size_t m = 0; m < out.channels; m++) {
+    const int8_t *row = weights + m * n;
+    int32_t acc = bias[m];
+    for (size_t i = 0; i < n; i++) {
+      acc += (x[i] - in.zeroPoint) * (row[i] - w.zeroPoint);
+    }
+    y[m] = clampOutput(requantize(acc, op.multiplier, op.shift), out.zeroPoint, op.actMin, op.actMax);
+  }
+}
+
+void InferenceEngine::conv1d(const OpDesc &op) const {
+  const TensorDesc &in = tensors[op.input];
+  const TensorDesc &w = tensors[op.weights];
+  const TensorDesc &out = tensors[op.output];
+  const int8_t *x = activation(op.input);
+  const int8_t *weights = static_cast<const int8_t *>(constData(op.weights));
+  const int32_t *bias = static_cast<const int32_t *>(constData(op.bias));
+  int8_t *y = activation(op.output);
+  
+  for (size_t t = 0; t < out.length; t++) {
+    for (size_t f = 0; f < out.channels; f++) {
+      const int8_t *filter = weights + f * w.channels;
+      int32_t acc = bias[f];
+      for (size_t k = 0; k < op.kernel; k++) {
+        // Padding rows hold the input zero point and contribute nothing
+        long row = (long)(t * op.stride + k) - op.padding;
+        if (row < 0) {
+          continue;
+        }
+        const int8_t *sample = x + row * in.channels;
+        const int8_t *tap = filter + k * in.channels;
+        for (size_t c = 0; c < in.channels; c++) {
+          acc += (sample[c] - in.zeroPoint) * (tap[c] - w.zeroPoint);
+        }
+      }
+      y[t * out.channels + f] = clampOutput(requantize(acc, op.multiplier, op.shift), out.zeroPoint,
+                                            op.actMin, op.actMax);
+    }
+  }
+}
+
+void InferenceEngine::maxPool1d(const OpDesc &op) const {
+  const TensorDesc &out = tensors[op.output];
+  const int8_t *x = activation(op.input);
+  int8_t *y = activation(op.output);
+  
+  for (size_t t = 0; t < out.length; t++) {
+    for (size_t c = 0; c < out.channels; c++) {
+      int8_t best = -128;
+      for (size_t k = 0; k < op.kernel; k++) {
+        int8_t value = x[(t * op.stride + k) * out.channels + c];
+        if (value > best) {
+          best = value;
+        }
+      }
+      y[t * out.channels + c] = best;
+    }
+  }
+}
+
+void InferenceEngine::relu(const OpDesc &op) const {
+  const int8_t *x = activation(op.input);
+  int8_t *y = activation(op.output);
+  size_t count = tensorBytes(tensors[op.output]);
+  for (size_t i = 0; i < count; i++) {
+    int8_t value = x[i];
+    y[i] = value < op.actMin ? op.actMin : value > op.actMax ? op.actMax : value;
+  }
+}
+
+void InferenceEngine::lookup(const OpDesc &op) const {
+  const int8_t *x = activation(op.input);
+  const int8_t *table = static_cast<const int8_t *>(constData(op.weights));
+  int8_t *y = activation(op.output);
+  size_t count = tensorBytes(tensors[op.output]);
+  for (size_t i = 0; i < count; i++) {
+    y[i] = table[x[i] + 128];
+  }
+}
+
+bool InferenceEngine::invoke() {
+  if (!header) {
+    return false;
+  }
+  
+  uint32_t start = micros();
+  for (uint16_t i = 0; i < header->opCount; i++) {
+    const OpDesc &op = ops[i];
+    switch (op.type) {
+      case OP_DENSE: dense(op); break;
+      case OP_CONV1D: conv1d(op); break;
+      case OP_MAXPOOL1D: maxPool1d(op); break;
+      case OP_RELU: relu(op); break;
+      case OP_LOOKUP: lookup(op); break;
+    }
+  }
+  
+  lastMicros = micros() - start;
+  if (lastMicros > maxMicros) {
+    maxMicros = lastMicros;
+  }
+  invocations++;
+  return true;
+}
+
+uint32_t InferenceEngine::selfTest() {
+  if (!header) {
+    return 0;
+  }
+  
+  int8_t *data = input();
+  size_t size = inputSize();
+  for (size_t i = 0; i < size; i++) {
+    data[i] = (int8_t)((i * 37 + 11) & 0xFF);
+  }
+  invoke();
+  return crc32(reinterpret_cast<const uint8_t *>(output()), outputSize());
+}
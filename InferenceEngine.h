@@ -0,0 +1,162 @@
+/**
+ * InferenceEngine Class
+ * Minimal int8 interpreter for small models trained offline (autoencoder
+ * anomaly scoring, 1D-CNN appliance classifiers). Models are flat blobs
+ * (see tools/pack_model.py) that are executed in place, so a blob mapped
+ * from flash is never copied. Tensors use per-tensor affine quantization
+ * and all arithmetic in invoke() is integer with precomputed fixed-point
+ * multipliers, so the host build gives bit-identical outputs.
+ *
+ * Blob layout, little endian, every section 4-byte aligned:
+ *   ModelHeader, TensorDesc[tensorCount], OpDesc[opCount], constant data
+ * Activations live in a caller-supplied arena at offsets planned offline.
+ */
+
+#ifndef INFERENCE_ENGINE_H
+#define INFERENCE_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MODEL_MAGIC 0x4C444D51UL   // "QMDL"
+#define MODEL_VERSION 1
+
+enum ModelKind {
+  MODEL_GENERIC = 0,
+  MODEL_AUTOENCODER = 1,           // Output reconstructs the input; the error is the anomaly score
+  MODEL_CLASSIFIER = 2             // Output holds one score per class
+};
+
+enum TensorType {
+  TENSOR_INT8 = 0,
+  TENSOR_INT32 = 1                 // Biases only
+};
+
+enum TensorLocation {
+  TENSOR_CONST = 0,                // offset is into the blob
+  TENSOR_ARENA = 1                 // offset is into the activation arena
+};
+
+enum OpType {
+  OP_DENSE = 0,                    // out[m] = sum_n in[n] * w[m][n] + bias[m]
+  OP_CONV1D = 1,                   // Channels-last [length][channels], weights [out][kernel][in]
+  OP_MAXPOOL1D = 2,                // Window kernel, step stride, per channel
+  OP_RELU = 3,                     // Clamp to [actMin, actMax] in the output scale
+  OP_LOOKUP = 4                    // 256-entry int8 table (sigmoid, tanh, ...) in weights
+};
+
+struct ModelHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint8_t kind;                    // ModelKind
+  uint8_t reserved;
+  uint16_t tensorCount;
+  uint16_t opCount;
+  uint16_t input;                  // Tensor indices
+  uint16_t output;
+  uint32_t arenaSize;              // Activation bytes needed
+  uint32_t totalSize;              // Blob bytes, header included
+  float threshold;                 // Autoencoder score above which a window is anomalous
+  uint32_t crc32;                  // Of the blob with this field zeroed
+};
+
+struct TensorDesc {
+  uint32_t offset;
+  uint16_t length;                 // Rows (time steps); 1 for plain vectors
+  uint16_t channels;
+  int32_t zeroPoint;
+  float scale;                     // Real value = scale * (q - zeroPoint)
+  uint8_t type;                    // TensorType
+  uint8_t location;                // TensorLocation
+  uint16_t reserved;
+};
+
+struct OpDesc {
+  uint8_t type;                    // OpType
+  uint8_t reserved;
+  uint16_t input;
+  uint16_t output;
+  uint16_t weights;                // Unused by pooling and ReLU
+  uint16_t bias;
+  uint16_t kernel;
+  uint16_t stride;
+  uint16_t padding;                // Zero-point rows added before the input (conv1d)
+  int32_t multiplier;              // Requantization multiplier, Q31
+  int8_t shift;                    // Requantization exponent (left shift when positive)
+  int8_t actMin;                   // Fused activation clamp in the output scale
+  int8_t actMax;
+  uint8_t reserved2;
+};
+
+static_assert(sizeof(ModelHeader) == 32, "ModelHeader layout is part of the blob format");
+static_assert(sizeof(TensorDesc) == 20, "TensorDesc layout is part of the blob format");
+static_assert(sizeof(OpDesc) == 24, "OpDesc layout is part of the blob format");
+
+class InferenceEngine {
+public:
+  InferenceEngine();
+  
+  // Validates the blob and binds it; neither blob nor arena is copied
+  bool load(const uint8_t *blob, size_t size, uint8_t *arena, size_t arenaCapacity);
+  void unload();
+  bool isLoaded() const { return header != NULL; }
+  const char *getError() const { return error; }
+  
+  ModelKind getKind() const { return header ? (ModelKind)header->kind : MODEL_GENERIC; }
+  float getThreshold() const { return header ? header->threshold : 0.0f; }
+  
+  // Input and output tensors
+  int8_t *input();
+  const int8_t *output() const;
+  size_t inputSize() const;
+  size_t outputSize() const;
+  
+  // Float conversion using the tensors' quantization
+  void setInput(size_t index, float value);
+  float dequantizeInput(size_t index) const;
+  float dequantizeOutput(size_t index) const;
+  
+  bool invoke();
+  
+  // Deterministic run over a fixed input pattern; equal checksums on
+  // device and host show the builds are bit-identical
+  uint32_t selfTest();
+  
+  uint32_t getInvocations() const { return invocations; }
+  uint32_t getLastMicros() const { return lastMicros; }
+  uint32_t getMaxMicros() const { return maxMicros; }
+  size_t getArenaUsed() const { return header ? header->arenaSize : 0; }
+  size_t getArenaCapacity() const { return arenaCapacity; }
+  
+  static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+  
+private:
+  const uint8_t *blob;
+  const ModelHeader *header;
+  const TensorDesc *tensors;
+  const OpDesc *ops;
+  uint8_t *arena;
+  size_t arenaCapacity;
+  const char *error;
+  
+  uint32_t invocations;
+  uint32_t lastMicros;
+  uint32_t maxMicros;
+  
+  bool fail(const char *message);
+  bool validate(size_t size);
+  size_t tensorBytes(const TensorDesc &tensor) const;
+  const void *constData(uint16_t index) const;
+  int8_t *activation(uint16_t index) const;
+  
+  void dense(const OpDesc &op) const;
+  void conv1d(const OpDesc &op) const;
+  void maxPool1d(const OpDesc &op) const;
+  void relu(const OpDesc &op) const;
+  void lookup(const OpDesc &op) const;
+  
+  static int32_t requantize(int32_t acc, int32_t multiplier, int shift);
+  static uint32_t micros();
+};
+
+#endif // INFERENCE_ENGINE_H
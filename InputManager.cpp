@@ -0,0 +1,213 @@
+/**
+ * InputManager implementation
+ */
+
+#include "InputManager.h"
+#include <stdint.h>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <soc/gpio_struct.h>
+
+InputManager inputManager;
+
+InputManager::InputManager() {
+  buttonCount = 0;
+  inputTask = NULL;
+  consumerTask = NULL;
+  edges = NULL;
+  droppedEdges = 0;
+}
+
+bool InputManager::addButton(uint8_t pin, bool activeLow) {
+  if (buttonCount >= INPUT_MAX_BUTTONS) {
+    return false;
+  }
+  
+  Button &button = buttons[buttonCount];
+  button.owner = this;
+  button.index = buttonCount;
+  button.pin = pin;
+  button.activeLow = activeLow;
+  button.stablePressed = false;
+  button.settling = false;
+  button.edgeMs = 0;
+  button.held = false;
+  button.longFired = false;
+  button.taps = 0;
+  button.pressMs = 0;
+  button.releaseMs = 0;
+  buttonCount++;
+  return true;
+}
+
+void InputManager::begin(TaskHandle_t consumer) {
+  consumerTask = consumer;
+  edges = xQueueCreateStatic(INPUT_MAX_BUTTONS, sizeof(Edge), edgeStorage, &edgeQueue);
+  xTaskCreatePinnedToCore(inputTaskMain, "input", INPUT_TASK_STACK, this,
+                          INPUT_TASK_PRIORITY, &inputTask, INPUT_TASK_CORE);
+  
+  for (int i = 0; i < buttonCount; i++) {
+    Button &button = buttons[i];
+    pinMode(button.pin, button.activeLow ? INPUT_PULLUP : INPUT_PULLDOWN);
+    button.stablePressed = readPressed(button);
+    attachInterruptArg(button.pin, isr, &button, awaitedLevel(button) == LOW ? ONLOW : ONHIGH);
+    arm(button);
+  }
+  
+  // Level interrupts double as wakeup sources from automatic light sleep
+  esp_sleep_enable_gpio_wakeup();
+}
+
+bool InputManager::readPressed(const Button &button) {
+  return (digitalRead(button.pin) == LOW) == button.activeLow;
+}
+
+uint8_t InputManager::awaitedLevel(const Button &button) {
+  bool pressedLow = button.activeLow;
+  return button.stablePressed != pressedLow ? LOW : HIGH;
+}
+
+void InputManager::arm(Button &button) {
+  // Sets the pin's interrupt type as well as its wakeup level; if the pin
+  // already moved while disarmed, the interrupt fires straight away
+  gpio_wakeup_enable((gpio_num_t)button.pin, awaitedLevel(button) == LOW ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+
+bool InputManager::getEvent(InputEvent &event) {
+  return events.pop(event);
+}
+
+uint32_t InputManager::getDroppedEdges() {
+  return droppedEdges;
+}
+
+void IRAM_ATTR InputManager::isr(void *arg) {
+  // Runs with the flash cache possibly disabled (SPIFFS, OTA), so only
+  // IRAM code: a register write, millis() and the FreeRTOS ISR calls
+  Button *button = static_cast<Button *>(arg);
+  InputManager *self = button->owner;
+  
+  // A level interrupt keeps firing while the level holds, and the contacts
+  // are still bouncing; the pin stays disarmed until the input task has
+  // read the settled level
+  GPIO.pin[button->pin].int_type = GPIO_INTR_DISABLE;
+  
+  Edge edge;
+  edge.button = button->index;
+  edge.timeMs = millis();
+  
+  BaseType_t woken = pdFALSE;
+  if (xQueueSendFromISR(self->edges, &edge, &woken) != pdTRUE) {
+    self->droppedEdges++;
+  } else if (self->inputTask != NULL) {
+    vTaskNotifyGiveFromISR(self->inputTask, &woken);
+  }
+  portYIELD_FROM_ISR(woken);
+}
+
+void InputManager::inputTaskMain(void *param) {
+  InputManager *self = static_cast<InputManager *>(param);
+  uint32_t waitMs = UINT32_MAX;
+  
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, waitMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(waitMs));
+    waitMs = self->process();
+  }
+}
+
+void InputManager::onEdge(Button &button, bool pressed, uint32_t timeMs) {
+  if (pressed) {
+    button.held = true;
+    button.longFired = false;
+    button.pressMs = timeMs;
+  } else if (button.held) {
+    button.held = false;
+    button.releaseMs = timeMs;
+    if (!button.longFired) {
+      button.taps++;
+    }
+  }
+}
+
+uint32_t InputManager::process() {
+  Edge edge;
+  while (xQueueReceive(edges, &edge, 0) == pdTRUE) {
+    Button &button = buttons[edge.button];
+    button.settling = true;
+    button.edgeMs = edge.timeMs;
+  }
+  
+  // Settle disarmed pins, fire gestures whose deadline has passed and find
+  // the next deadline
+  uint32_t now = millis();
+  uint32_t waitMs = UINT32_MAX;
+  for (int i = 0; i < buttonCount; i++) {
+    Button &button = buttons[i];
+    uint32_t remaining;
+    
+    // The edge counts from when it started; a glitch that went back to the
+    // old level within the settling time is no edge at all
+    if (button.settling) {
+      uint32_t settledMs = now - button.edgeMs;
+      if (settledMs < INPUT_DEBOUNCE_MS) {
+        waitMs = INPUT_DEBOUNCE_MS - settledMs < waitMs ? INPUT_DEBOUNCE_MS - settledMs : waitMs;
+      } else {
+        button.settling = false;
+        bool pressed = readPressed(button);
+        if (pressed != button.stablePressed) {
+          button.stablePressed = pressed;
+          onEdge(button, pressed, button.edgeMs);
+        }
+        arm(button);
+      }
+    }
+    
+    if (button.held && !button.longFired) {
+      uint32_t heldMs = now - button.pressMs;
+      if (heldMs >= INPUT_LONG_PRESS_MS) {
+        button.longFired = true;
+        button.taps = 0;
+        emit(button, INPUT_LONG_PRESS, now);
+        continue;
+      }
+      remaining = INPUT_LONG_PRESS_MS - heldMs;
+    } else if (!button.held && button.taps > 0) {
+      uint32_t idleMs = now - button.releaseMs;
+      if (idleMs >= INPUT_MULTI_TAP_MS) {
+        emit(button, button.taps == 1 ? INPUT_SHORT_PRESS : INPUT_MULTI_TAP, now);
+        button.taps = 0;
+        continue;
+      }
+      remaining = INPUT_MULTI_TAP_MS - idleMs;
+    } else {
+      continue;
+    }
+    
+    if (remaining < waitMs) {
+      waitMs = remaining;
+    }
+  }
+  return waitMs;
+}
+
+void InputManager::emit(Button &button, uint8_t gesture, uint32_t nowMs) {
+  InputEvent event;
+  event.pin = button.pin;
+  event.gesture = gesture;
+  event.taps = gesture == INPUT_LONG_PRESS ? 1 : button.taps;
+  event.durationMs = (gesture == INPUT_LONG_PRESS ? nowMs : button.releaseMs) - button.pressMs;
+  event.timestampMs = nowMs;
+  
+  if (events.push(event) && consumerTask != NULL) {
+    xTaskNotifyGive(consumerTask);
+  }
+}
+
+const char *InputManager::gestureName(uint8_t gesture) {
+  switch (gesture) {
+    case INPUT_SHORT_PRESS: return "short press";
+    case INPUT_LONG_PRESS: return "long press";
+    case INPUT_MULTI_TAP: return "multi-tap";
+    default: return "unknown";
+  }
+}
@@ -0,0 +1,109 @@
+/**
+ * InputManager Class
+ * Interrupt-driven buttons with gesture detection. Each button has a level
+ * interrupt armed for the level it does not rest at, which is also its
+ * light-sleep wakeup source, so a press wakes the chip. The ISR disarms
+ * the pin and hands the edge to a small input task, which confirms the
+ * new level once it has settled, re-arms the pin and turns the edges into
+ * short press, long press and multi-tap events. Events are delivered
+ * through a queue and the consumer task is notified, so input latency
+ * does not depend on how busy the consumer is.
+ */
+
+#ifndef INPUT_MANAGER_H
+#define INPUT_MANAGER_H
+
+#include <Arduino.h>
+#include <freertos/queue.h>
+#include "SpscQueue.h"
+
+#ifndef INPUT_MAX_BUTTONS
+#define INPUT_MAX_BUTTONS 4
+#endif
+#ifndef INPUT_DEBOUNCE_MS
+#define INPUT_DEBOUNCE_MS 30       // Settling time before a new level is read back; shorter glitches are ignored
+#endif
+#ifndef INPUT_LONG_PRESS_MS
+#define INPUT_LONG_PRESS_MS 3000   // Hold time for a long press (fires once per hold)
+#endif
+#ifndef INPUT_MULTI_TAP_MS
+#define INPUT_MULTI_TAP_MS 350     // Max gap between taps of a multi-tap
+#endif
+#ifndef INPUT_TASK_CORE
+#define INPUT_TASK_CORE 0
+#define INPUT_TASK_PRIORITY 4      // Above network/ui so gestures are timed accurately
+#define INPUT_TASK_STACK 2048      // Bytes
+#endif
+
+enum InputGesture {
+  INPUT_SHORT_PRESS,               // One press and release
+  INPUT_LONG_PRESS,                // Held for INPUT_LONG_PRESS_MS
+  INPUT_MULTI_TAP                  // Two or more quick presses (see taps)
+};
+
+struct InputEvent {
+  uint8_t pin;
+  uint8_t gesture;                 // InputGesture
+  uint8_t taps;                    // Presses in a multi-tap
+  uint32_t durationMs;             // Hold time of the (last) press
+  uint32_t timestampMs;            // millis() when the gesture was recognised
+};
+
+class InputManager {
+public:
+  InputManager();
+  
+  bool addButton(uint8_t pin, bool activeLow = true); // Before begin()
+  void begin(TaskHandle_t consumer); // Attach interrupts and start the input task
+  bool getEvent(InputEvent &event);  // Next recognised gesture, false if none
+  uint32_t getDroppedEdges();
+  TaskHandle_t getTaskHandle() { return inputTask; }
+  
+  static const char *gestureName(uint8_t gesture);
+  
+private:
+  struct Edge {
+    uint8_t button;
+    uint32_t timeMs;               // First edge of the transition
+  };
+  
+  struct Button {
+    InputManager *owner;
+    uint8_t index;
+    uint8_t pin;
+    bool activeLow;
+    
+    // Debounce and gesture state, owned by the input task
+    bool stablePressed;            // Debounced level
+    bool settling;                 // Disarmed, waiting for the level to settle
+    uint32_t edgeMs;
+    bool held;
+    bool longFired;
+    uint8_t taps;
+    uint32_t pressMs;
+    uint32_t releaseMs;
+  };
+  
+  Button buttons[INPUT_MAX_BUTTONS];
+  int buttonCount;
+  QueueHandle_t edges;             // ISR -> input task, at most one pending per button
+  StaticQueue_t edgeQueue;
+  uint8_t edgeStorage[INPUT_MAX_BUTTONS * sizeof(Edge)];
+  volatile uint32_t droppedEdges;
+  SpscQueue<InputEvent, 8> events; // Input task -> consumer
+  TaskHandle_t inputTask;
+  TaskHandle_t consumerTask;
+  
+  static void IRAM_ATTR isr(void *arg);
+  static void inputTaskMain(void *param);
+  bool readPressed(const Button &button);
+  static uint8_t awaitedLevel(const Button &button); // Pin level that leaves stablePressed
+  void arm(Button &button);        // Interrupt and wakeup on the level that leaves stablePressed
+  void onEdge(Button &button, bool pressed, uint32_t timeMs);
+  uint32_t process();              // Returns ms until the next gesture deadline
+  void emit(Button &button, uint8_t gesture, uint32_t nowMs);
+};
+
+extern InputManager inputManager;
+
+#endif // INPUT_MANAGER_H
@@ -0,0 +1,184 @@
+/**
+ * KnnClassifier implementation
+ */
+
+#include "KnnClassifier.h"
+#include "InferenceEngine.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+// Largest weighted difference per feature; eight squares of it fit in 32 bits
+#define KNN_DIFF_LIMIT 16383
+
+KnnClassifier::KnnClassifier() {
+  unload();
+}
+
+void KnnClassifier::unload() {
+  header = NULL;
+  labels = NULL;
+  refs = NULL;
+  error = "no reference set";
+  classifications = 0;
+  lastMicros = 0;
+  maxMicros = 0;
+}
+
+bool KnnClassifier::fail(const char *message) {
+  header = NULL;
+  error = message;
+  return false;
+}
+
+uint32_t KnnClassifier::micros() {
+#ifdef ARDUINO
+  return ::micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+bool KnnClassifier::load(const uint8_t *blob, size_t size) {
+  unload();
+  if (blob == NULL || size < sizeof(WaveformRefHeader) || ((uintptr_t)blob & 3) != 0) {
+    return fail("blob missing, short or unaligned");
+  }
+  
+  const WaveformRefHeader *candidate = (const WaveformRefHeader *)blob;
+  if (candidate->magic != WAVEFORM_REF_MAGIC || candidate->version != WAVEFORM_REF_VERSION) {
+    return fail("bad magic or version");
+  }
+  if (candidate->featureCount != WAVEFORM_FEATURES) {
+    return fail("feature count mismatch");
+  }
+  if (candidate->k == 0 || candidate->k > KNN_MAX_K || candidate->labelCount == 0) {
+    return fail("bad k or label count");
+  }
+  size_t expected = sizeof(WaveformRefHeader) + (size_t)candidate->labelCount * WAVEFORM_LABEL_LEN +
+                    (size_t)candidate->refCount * sizeof(WaveformRef);
+  if (candidate->totalSize != expected || expected > size) {
+    return fail("size mismatch");
+  }
+  
+  const size_t crcOffset = offsetof(WaveformRefHeader, crc32);
+  const uint8_t zero[4] = { 0, 0, 0, 0 };
+  uint32_t crc = InferenceEngine::crc32(blob, crcOffset);
+  crc = InferenceEngine::crc32(zero, sizeof(zero), crc);
+  crc = InferenceEngine::crc32(blob + crcOffset + 4, expected - crcOffset - 4, crc);
+  if (crc != candidate->crc32) {
+    return fail("CRC mismatch");
+  }
+  
+  const char *labelTable = (const char *)(blob + sizeof(WaveformRefHeader));
+  for (uint8_t i = 0; i < candidate->labelCount; i++) {
+    if (labelTable[i * WAVEFORM_LABEL_LEN + WAVEFORM_LABEL_LEN - 1] != '\0') {
+      return fail("unterminated label");
+    }
+  }
+  const WaveformRef *refTable = (const WaveformRef *)(labelTable + candidate->labelCount * WAVEFORM_LABEL_LEN);
+  for (uint16_t i = 0; i < candidate->refCount; i++) {
+    if (refTable[i].kind >= WAVEFORM_KIND_COUNT || refTable[i].label >= candidate->labelCount) {
+      return fail("reference out of range");
+    }
+  }
+  
+  header = candidate;
+  labels = labelTable;
+  refs = refTable;
+  error = "";
+  return true;
+}
+
+uint32_t KnnClassifier::distance(const WaveformVector &vector, const WaveformRef &ref) const {
+  const uint16_t *weight = header->weight[vector.kind];
+  uint32_t sum = 0;
+  for (int i = 0; i < WAVEFORM_FEATURES; i++) {
+    int32_t diff = (int32_t)vector.values[i] - ref.values[i];
+    uint32_t scaled = (uint32_t)(diff < 0 ? -diff : diff) * weight[i] >> 8;
+    if (scaled > KNN_DIFF_LIMIT) {
+      scaled = KNN_DIFF_LIMIT;
+    }
+    sum += scaled * scaled;
+  }
+  return sum;
+}
+
+bool KnnClassifier::classify(const WaveformVector &vector, KnnResult &result) {
+  memset(&result, 0, sizeof(result));
+  result.label = -1;
+  if (header == NULL || vector.kind >= WAVEFORM_KIND_COUNT) {
+    return false;
+  }
+  
+  uint32_t start = micros();
+  
+  // Nearest k so far, sorted by distance; k is small, so insertion is cheapest
+  uint32_t nearest[KNN_MAX_K];
+  uint8_t nearestLabel[KNN_MAX_K];
+  uint8_t found = 0;
+  const uint8_t k = header->k;
+  for (uint16_t i = 0; i < header->refCount; i++) {
+    const WaveformRef &ref = refs[i];
+    if (ref.kind != vector.kind) {
+      continue;
+    }
+    uint32_t d = distance(vector, ref);
+    if (found == k && d >= nearest[k - 1]) {
+      continue;
+    }
+    
+    uint8_t slot = found < k ? found++ : k - 1;
+    while (slot > 0 && nearest[slot - 1] > d) {
+      nearest[slot] = nearest[slot - 1];
+      nearestLabel[slot] = nearestLabel[slot - 1];
+      slot--;
+    }
+    nearest[slot] = d;
+    nearestLabel[slot] = ref.label;
+  }
+  
+  if (found > 0) {
+    // Majority vote; a tie goes to the label with the closer neighbour
+    uint8_t bestVotes = 0;
+    for (uint8_t i = 0; i < found; i++) {
+      uint8_t votes = 0;
+      for (uint8_t j = 0; j < found; j++) {
+        votes += nearestLabel[j] == nearestLabel[i];
+      }
+      if (votes > bestVotes) {
+        bestVotes = votes;
+        result.label = nearestLabel[i];
+      }
+    }
+    result.votes = bestVotes;
+    result.neighbours = found;
+    result.distance = nearest[0];
+    
+    uint32_t reject = header->rejectDistance[vector.kind];
+    if (reject != 0 && nearest[0] > reject) {
+      result.label = -1;
+      result.votes = 0;
+    }
+  }
+  
+  result.micros = micros() - start;
+  lastMicros = result.micros;
+  if (lastMicros > maxMicros) {
+    maxMicros = lastMicros;
+  }
+  classifications++;
+  return found > 0;
+}
+
+const char *KnnClassifier::labelName(int label) const {
+  if (header == NULL || label < 0 || label >= header->labelCount) {
+    return "unknown";
+  }
+  return labels + label * WAVEFORM_LABEL_LEN;
+}
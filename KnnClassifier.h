@@ -0,0 +1,96 @@
+/**
+ * KnnClassifier Class
+ * k-nearest-neighbour appliance classification of WaveformAnalyzer vectors
+ * against a labelled reference set built offline (tools/make_waveform_refs.py).
+ * The set is a flat blob read in place, so one mapped from flash costs no
+ * RAM. Distances are weighted squared differences in integer arithmetic;
+ * each feature's weight brings it to a common scale, and steady and
+ * transition vectors are only compared with references of their own kind.
+ * A vector whose nearest reference is beyond the kind's reject distance is
+ * reported as unknown rather than forced onto the closest label.
+ *
+ * Blob layout, little endian:
+ *   WaveformRefHeader, char labels[labelCount][WAVEFORM_LABEL_LEN],
+ *   WaveformRef[refCount]
+ */
+
+#ifndef KNN_CLASSIFIER_H
+#define KNN_CLASSIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "WaveformAnalyzer.h"
+
+#define WAVEFORM_REF_MAGIC 0x46455257UL // "WREF"
+#define WAVEFORM_REF_VERSION 1
+#define WAVEFORM_LABEL_LEN 12
+#define KNN_MAX_K 7
+
+struct WaveformRefHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t featureCount;           // Must equal WAVEFORM_FEATURES
+  uint16_t refCount;
+  uint8_t labelCount;
+  uint8_t k;                       // Neighbours that vote, at most KNN_MAX_K
+  uint16_t weight[WAVEFORM_KIND_COUNT][WAVEFORM_FEATURES]; // Q8 multipliers applied to feature differences
+  uint32_t rejectDistance[WAVEFORM_KIND_COUNT]; // Nearest distance above which a vector is unknown; 0 accepts all
+  uint32_t totalSize;              // Blob bytes, header included
+  uint32_t crc32;                  // Of the blob with this field zeroed
+};
+
+struct WaveformRef {
+  uint8_t kind;                    // WaveformKind
+  uint8_t label;                   // Index into the label table
+  int16_t values[WAVEFORM_FEATURES];
+};
+
+static_assert(sizeof(WaveformRefHeader) == 60, "WaveformRefHeader layout is part of the blob format");
+static_assert(sizeof(WaveformRef) == 18, "WaveformRef layout is part of the blob format");
+
+struct KnnResult {
+  int label;                       // -1 when unknown
+  uint8_t votes;                   // Neighbours agreeing with label
+  uint8_t neighbours;              // Neighbours found (fewer than k for a small set)
+  uint32_t distance;               // To the nearest reference
+  uint32_t micros;                 // Time taken
+};
+
+class KnnClassifier {
+public:
+  KnnClassifier();
+  
+  // Validates the blob and binds it; it is not copied
+  bool load(const uint8_t *blob, size_t size);
+  void unload();
+  bool isLoaded() const { return header != NULL; }
+  const char *getError() const { return error; }
+  
+  // False when nothing is loaded or the set has no references of the vector's kind
+  bool classify(const WaveformVector &vector, KnnResult &result);
+  
+  const char *labelName(int label) const; // "unknown" for -1
+  uint16_t getRefCount() const { return header ? header->refCount : 0; }
+  uint8_t getLabelCount() const { return header ? header->labelCount : 0; }
+  uint8_t getK() const { return header ? header->k : 0; }
+  uint32_t getClassifications() const { return classifications; }
+  uint32_t getLastMicros() const { return lastMicros; }
+  uint32_t getMaxMicros() const { return maxMicros; }
+  
+  uint32_t distance(const WaveformVector &vector, const WaveformRef &ref) const;
+  
+private:
+  const WaveformRefHeader *header;
+  const char *labels;
+  const WaveformRef *refs;
+  const char *error;
+  
+  uint32_t classifications;
+  uint32_t lastMicros;
+  uint32_t maxMicros;
+  
+  bool fail(const char *message);
+  static uint32_t micros();
+};
+
+#endif // KNN_CLASSIFIER_H
@@ -0,0 +1,77 @@
+/**
+ * LatencyHistogram implementation
+ */
+
+#include "LatencyHistogram.h"
+#include <string.h>
+
+LatencyHistogram::LatencyHistogram() {
+  reset();
+}
+
+void LatencyHistogram::record(uint32_t value) {
+  counts[bucketIndex(value)]++;
+  if (count == 0 || value < minValue) {
+    minValue = value;
+  }
+  if (value > maxValue) {
+    maxValue = value;
+  }
+  count++;
+  sum += value;
+}
+
+void LatencyHistogram::reset() {
+  memset(counts, 0, sizeof(counts));
+  count = 0;
+  minValue = 0;
+  maxValue = 0;
+  sum = 0;
+}
+
+uint32_t LatencyHistogram::percentile(float p) const {
+  if (count == 0) {
+    return 0;
+  }
+  
+  uint32_t rank = (uint32_t)(p / 100.0f * count + 0.5f);
+  if (rank < 1) {
+    rank = 1;
+  }
+  
+  uint32_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // Report the bucket's upper edge, but never more than what we saw
+      uint32_t upper = i + 1 < BUCKETS ? bucketLowerBound(i + 1) - 1 : maxValue;
+      return upper < maxValue ? upper : maxValue;
+    }
+  }
+  return maxValue;
+}
+
+int LatencyHistogram::bucketIndex(uint32_t value) {
+  if (value < (uint32_t)SUB_BUCKETS) {
+    return value;
+  }
+  
+  // Position of the highest set bit selects the group, the next bits the sub-bucket
+  int exponent = 31 - __builtin_clz(value);
+  int group = exponent - SUB_BUCKET_BITS + 1;
+  if (group >= GROUPS) {
+    return BUCKETS - 1;
+  }
+  int sub = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return group * SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::bucketLowerBound(int index) {
+  int group = index / SUB_BUCKETS;
+  int sub = index % SUB_BUCKETS;
+  if (group == 0) {
+    return sub;
+  }
+  int exponent = group + SUB_BUCKET_BITS - 1;
+  return (1UL << exponent) + ((uint32_t)sub << (exponent - SUB_BUCKET_BITS));
+}
@@ -0,0 +1,154 @@
+/**
+ * LoadDisaggregator implementation
+ */
+
+#include "LoadDisaggregator.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert(NILM_MAX_APPLIANCES <= 32, "running state is a 32-bit mask");
+
+LoadDisaggregator::LoadDisaggregator() {
+  reset();
+}
+
+void LoadDisaggregator::reset() {
+  memset(&library, 0, sizeof(library));
+  library.magic = NILM_LIBRARY_MAGIC;
+  library.version = NILM_LIBRARY_VERSION;
+  running = 0;
+}
+
+int LoadDisaggregator::findMatch(float step, bool wantRunning) const {
+  // Nearest signature in units of its tolerance; beyond 1 is no match
+  int best = -1;
+  float bestScore = 1.0f;
+  for (uint16_t i = 0; i < library.count; i++) {
+    if (isRunning(i) != wantRunning) {
+      continue;
+    }
+    float power = library.appliances[i].power;
+    float tolerance = power * NILM_MATCH_TOLERANCE;
+    if (tolerance < NILM_MATCH_FLOOR_W) {
+      tolerance = NILM_MATCH_FLOOR_W;
+    }
+    float score = fabsf(step - power) / tolerance;
+    if (score <= bestScore) {
+      bestScore = score;
+      best = i;
+    }
+  }
+  return best;
+}
+
+int LoadDisaggregator::leastMatched() const {
+  int least = -1;
+  for (uint16_t i = 0; i < library.count; i++) {
+    if (!isRunning(i) && (least < 0 || library.appliances[i].matches < library.appliances[least].matches)) {
+      least = i;
+    }
+  }
+  return least;
+}
+
+int LoadDisaggregator::learn(float step) {
+  // A full library makes room by dropping the signature matched least
+  // often, so an early spurious step does not hold a slot for good
+  int index;
+  if (library.count < NILM_MAX_APPLIANCES) {
+    index = library.count++;
+  } else {
+    index = leastMatched();
+    if (index < 0) {
+      return -1;
+    }
+    library.otherEnergyKwh += library.appliances[index].energyKwh;
+  }
+  
+  ApplianceSignature &appliance = library.appliances[index];
+  memset(&appliance, 0, sizeof(appliance));
+  library.learned++;
+  snprintf(appliance.name, sizeof(appliance.name), "load%u", (unsigned)library.learned);
+  appliance.power = step;
+  return index;
+}
+
+ApplianceMatch LoadDisaggregator::onChange(const ChangeEvent &event) {
+  ApplianceMatch match;
+  match.index = -1;
+  match.on = event.magnitude > 0.0f;
+  match.learned = false;
+  
+  float step = fabsf(event.magnitude);
+  if ((event.type != CHANGE_STEP_UP && event.type != CHANGE_STEP_DOWN) || step < NILM_MIN_STEP_W) {
+    return match;
+  }
+  
+  if (match.on) {
+    // Switch-on: an appliance that is off, or a new one unless the step
+    // looks like a second unit of one already running
+    match.index = findMatch(step, false);
+    if (match.index < 0 && findMatch(step, true) < 0) {
+      match.index = learn(step);
+      match.learned = match.index >= 0;
+    }
+    if (match.index >= 0) {
+      running |= 1UL << match.index;
+      library.appliances[match.index].matches++;
+    }
+  } else {
+    // Switch-off: only a running appliance can turn off
+    match.index = findMatch(step, true);
+    if (match.index >= 0) {
+      running &= ~(1UL << match.index);
+    }
+  }
+  
+  // Both edges of a known appliance refine its step size
+  if (match.index >= 0 && !match.learned) {
+    ApplianceSignature &appliance = library.appliances[match.index];
+    appliance.power += NILM_LEARN_WEIGHT * (step - appliance.power);
+  }
+  
+  return match;
+}
+
+void LoadDisaggregator::accumulate(float totalPower, float seconds) {
+  if (totalPower < 0.0f || seconds <= 0.0f) {
+    return;
+  }
+  
+  float runningPower = 0.0f;
+  for (uint16_t i = 0; i < library.count; i++) {
+    if (isRunning(i)) {
+      runningPower += library.appliances[i].power;
+    }
+  }
+  
+  // Never attribute more than was measured; scale the running set down.
+  // The totals are doubles: at 1000 kWh a float no longer resolves a
+  // 5 s reading of a 100 W load
+  float scale = runningPower > totalPower && runningPower > 0.0f ? totalPower / runningPower : 1.0f;
+  float hours = seconds / 3600.0f;
+  for (uint16_t i = 0; i < library.count; i++) {
+    if (isRunning(i)) {
+      library.appliances[i].energyKwh += library.appliances[i].power * scale * hours / 1000.0;
+    }
+  }
+  library.otherEnergyKwh += (totalPower - runningPower * scale) * hours / 1000.0;
+}
+
+bool LoadDisaggregator::setLibrary(const ApplianceLibrary &saved) {
+  if (saved.magic != NILM_LIBRARY_MAGIC || saved.version != NILM_LIBRARY_VERSION ||
+      saved.count > NILM_MAX_APPLIANCES) {
+    return false;
+  }
+  
+  library = saved;
+  for (uint16_t i = 0; i < library.count; i++) {
+    library.appliances[i].name[NILM_NAME_LEN - 1] = '\0';
+  }
+  running = 0;
+  return true;
+}
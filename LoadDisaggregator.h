@@ -0,0 +1,93 @@
+/**
+ * LoadDisaggregator Class
+ * Event-based non-intrusive load monitoring: step changes in real power are
+ * matched against a library of appliance signatures, appliances are
+ * tracked as running or off, and the measured energy is attributed to the
+ * running ones with the rest booked as "other". Unmatched switch-on steps
+ * are learned as new appliances and matched steps refine their signature.
+ * When the library is full, a new appliance replaces the least-matched one
+ * that is not running, and that one's energy moves to "other". Energy
+ * totals are doubles so small readings still count after years of use.
+ * The library is one plain struct so it can be saved and restored as a blob.
+ */
+
+#ifndef LOAD_DISAGGREGATOR_H
+#define LOAD_DISAGGREGATOR_H
+
+#include <stdint.h>
+#include "ChangeDetector.h"
+
+#ifndef NILM_MAX_APPLIANCES
+#define NILM_MAX_APPLIANCES 16     // Signatures in the library
+#endif
+#ifndef NILM_MIN_STEP_W
+#define NILM_MIN_STEP_W 20.0f      // Smaller steps are not attributed to an appliance
+#endif
+#ifndef NILM_MATCH_TOLERANCE
+#define NILM_MATCH_TOLERANCE 0.15f // Relative step difference still accepted as a match
+#endif
+#ifndef NILM_MATCH_FLOOR_W
+#define NILM_MATCH_FLOOR_W 10.0f   // Absolute tolerance for small appliances (W)
+#endif
+#ifndef NILM_LEARN_WEIGHT
+#define NILM_LEARN_WEIGHT 0.1f     // Weight of a matched step in the signature
+#endif
+
+#define NILM_NAME_LEN 12
+#define NILM_LIBRARY_MAGIC 0x4D4C494EUL // "NILM"
+#define NILM_LIBRARY_VERSION 2
+
+struct ApplianceSignature {
+  char name[NILM_NAME_LEN];        // "load1", "load2", ... in order learned
+  float power;                     // Step in real power when it switches on (W)
+  uint32_t matches;                // Switch-on steps matched so far
+  double energyKwh;                // Energy attributed since it was learned
+};
+
+struct ApplianceLibrary {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  uint32_t learned;                // Signatures ever learned, numbers the names
+  double otherEnergyKwh;           // Energy not attributed to any appliance, or to evicted ones
+  ApplianceSignature appliances[NILM_MAX_APPLIANCES];
+};
+
+// Outcome of one step, for logging
+struct ApplianceMatch {
+  int index;                       // Library index, -1 if the step was not attributed
+  bool on;
+  bool learned;                    // A new signature was added for this step
+};
+
+class LoadDisaggregator {
+public:
+  LoadDisaggregator();
+  
+  void reset();
+  
+  // Feeds a load change; drifts and small steps are ignored
+  ApplianceMatch onChange(const ChangeEvent &event);
+  
+  // Splits the energy of one reading between running appliances and "other"
+  void accumulate(float totalPower, float seconds);
+  
+  uint16_t getCount() const { return library.count; }
+  const ApplianceSignature &getAppliance(uint16_t index) const { return library.appliances[index]; }
+  bool isRunning(uint16_t index) const { return (running >> index) & 1; }
+  uint32_t getRunning() const { return running; }
+  double getOtherEnergyKwh() const { return library.otherEnergyKwh; }
+  
+  const ApplianceLibrary &getLibrary() const { return library; }
+  bool setLibrary(const ApplianceLibrary &saved); // Rejects blobs with a bad header
+  
+private:
+  ApplianceLibrary library;
+  uint32_t running;                // Bit per library index
+  
+  int findMatch(float step, bool wantRunning) const;
+  int learn(float step);
+  int leastMatched() const;        // Eviction candidate among the idle signatures, -1 if all run
+};
+
+#endif // LOAD_DISAGGREGATOR_H
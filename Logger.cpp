@@ -0,0 +1,175 @@
+/**
+ * Logger implementation
+ */
+
+#include "Logger.h"
+
+Logger logger;
+
+#define LOG_FRAME_SYNC1 0xA5
+#define LOG_FRAME_SYNC2 0x5A
+#define LOG_FRAME_MAX_STR 32       // String argument bytes sent per binary frame
+
+static const char LEVEL_TAGS[] = { 'E', 'W', 'I', 'D' };
+
+Logger::Logger() {
+  drainTask = NULL;
+  level = LOG_LEVEL_INFO;
+  binaryOutput = LOG_BINARY_OUTPUT;
+  reportedDrops = 0;
+}
+
+void Logger::begin() {
+  xTaskCreatePinnedToCore(drainTaskMain, "log", LOG_TASK_STACK, this,
+                          LOG_TASK_PRIORITY, &drainTask, LOG_TASK_CORE);
+}
+
+void Logger::setLevel(uint8_t newLevel) {
+  level = newLevel > LOG_LEVEL_DEBUG ? LOG_LEVEL_DEBUG : newLevel;
+}
+
+void Logger::setBinaryOutput(bool enable) {
+  binaryOutput = enable;
+}
+
+void Logger::drainTaskMain(void *param) {
+  Logger *self = static_cast<Logger *>(param);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->drain();
+  }
+}
+
+void Logger::drain() {
+  LogRecord record;
+  while (ring.pop(record)) {
+    if (binaryOutput) {
+      emitBinary(record);
+    } else {
+      emitText(record);
+    }
+  }
+  
+  uint32_t drops = ring.getDropped();
+  if (drops != reportedDrops) {
+    Serial.printf("[log] ring full, %u records dropped\n", (unsigned)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+void Logger::emitText(const LogRecord &record) {
+  char out[160];
+  size_t pos = snprintf(out, sizeof(out), "[%10u][%c] ", (unsigned)record.timestampMs,
+                        LEVEL_TAGS[record.site->level]);
+  
+  // Expand one conversion at a time from the stored raw arguments
+  const char *f = record.site->format;
+  int arg = 0;
+  while (*f != '\0' && pos < sizeof(out) - 1) {
+    if (*f != '%') {
+      out[pos++] = *f++;
+      continue;
+    }
+    if (f[1] == '%') {
+      out[pos++] = '%';
+      f += 2;
+      continue;
+    }
+    
+    // Copy flags/width/precision, drop length modifiers, keep the conversion
+    char spec[16];
+    size_t len = 0;
+    spec[len++] = *f++;
+    while (*f != '\0' && strchr("-+ #0123456789.", *f) != NULL && len < sizeof(spec) - 3) {
+      spec[len++] = *f++;
+    }
+    while (*f == 'l' || *f == 'h' || *f == 'z') {
+      f++;
+    }
+    char conversion = *f != '\0' ? *f++ : 's';
+    
+    int remaining = sizeof(out) - pos;
+    if (arg >= record.argCount) {
+      pos += snprintf(out + pos, remaining, "?");
+      continue;
+    }
+    uint32_t raw = (uint32_t)record.args[arg];
+    uint8_t type = (record.types >> (2 * arg)) & 3;
+    arg++;
+    
+    if (conversion == 'f' || conversion == 'e' || conversion == 'g') {
+      float value;
+      if (type == LOG_ARG_FLOAT) {
+        memcpy(&value, &raw, 4);
+      } else {
+        value = type == LOG_ARG_INT ? (float)(int32_t)raw : (float)raw;
+      }
+      spec[len++] = conversion;
+      spec[len] = '\0';
+      pos += snprintf(out + pos, remaining, spec, (double)value);
+    } else if (conversion == 's') {
+      spec[len++] = 's';
+      spec[len] = '\0';
+      pos += snprintf(out + pos, remaining, spec, type == LOG_ARG_STR ? (const char *)record.args[arg - 1] : "?");
+    } else {
+      spec[len++] = 'l';
+      spec[len++] = conversion;
+      spec[len] = '\0';
+      if (conversion == 'd' || conversion == 'i') {
+        pos += snprintf(out + pos, remaining, spec, (long)(int32_t)raw);
+      } else {
+        pos += snprintf(out + pos, remaining, spec, (unsigned long)raw);
+      }
+    }
+  }
+  
+  if (pos > sizeof(out) - 1) {
+    pos = sizeof(out) - 1;
+  }
+  out[pos] = '\0';
+  
+  Serial.print(out);
+  if (record.suppressed > 0) {
+    Serial.printf(" (+%u suppressed)", (unsigned)record.suppressed);
+  }
+  Serial.println();
+}
+
+void Logger::emitBinary(const LogRecord &record) {
+  // Frame: A5 5A len | id:4 ts:4 suppressed:2 argc:1 types:1 args... | xor
+  // Numeric args are 4 bytes little-endian, strings are len:1 + bytes
+  uint8_t frame[3 + 12 + LOG_MAX_ARGS * (1 + LOG_FRAME_MAX_STR) + 1];
+  size_t pos = 3;
+  
+  memcpy(frame + pos, &record.site->id, 4); pos += 4;
+  memcpy(frame + pos, &record.timestampMs, 4); pos += 4;
+  memcpy(frame + pos, &record.suppressed, 2); pos += 2;
+  frame[pos++] = record.argCount;
+  frame[pos++] = record.types;
+  
+  for (int i = 0; i < record.argCount; i++) {
+    uint8_t type = (record.types >> (2 * i)) & 3;
+    if (type == LOG_ARG_STR) {
+      const char *str = (const char *)record.args[i];
+      size_t len = str != NULL ? strnlen(str, LOG_FRAME_MAX_STR) : 0;
+      frame[pos++] = len;
+      memcpy(frame + pos, str, len);
+      pos += len;
+    } else {
+      uint32_t value = (uint32_t)record.args[i];
+      memcpy(frame + pos, &value, 4);
+      pos += 4;
+    }
+  }
+  
+  uint8_t checksum = 0;
+  for (size_t i = 3; i < pos; i++) {
+    checksum ^= frame[i];
+  }
+  frame[0] = LOG_FRAME_SYNC1;
+  frame[1] = LOG_FRAME_SYNC2;
+  frame[2] = pos - 3;
+  frame[pos++] = checksum;
+  
+  Serial.write(frame, pos);
+}
@@ -0,0 +1,153 @@
+/**
+ * Logger Class
+ * Deferred binary logging. A log call stores the format string id, a
+ * timestamp and up to four raw arguments in a lock-free ring buffer;
+ * formatting and UART output happen later on a low-priority drain task.
+ * In binary mode records go out as compact frames that
+ * tools/log_decode.py turns back into text on the host.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "Config.h"
+#include "MpscQueue.h"
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG // Calls above this level compile to nothing
+#endif
+#ifndef LOG_RING_SIZE
+#define LOG_RING_SIZE 64           // Records buffered before drops (power of two)
+#endif
+#ifndef LOG_BINARY_OUTPUT
+#define LOG_BINARY_OUTPUT 0        // 1: emit binary frames for tools/log_decode.py
+#endif
+#define LOG_MAX_ARGS 4
+
+#define LOG_LEVEL_ERROR 0
+#define LOG_LEVEL_WARN 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+// Argument type tags, two bits per argument in LogRecord::types
+#define LOG_ARG_INT 0
+#define LOG_ARG_UINT 1
+#define LOG_ARG_FLOAT 2
+#define LOG_ARG_STR 3              // Pointer to a string that outlives the record (literals)
+
+// FNV-1a hash of the format string; the host decoder computes the same id
+constexpr uint32_t logFormatId(const char *s, uint32_t h = 2166136261u) {
+  return *s ? logFormatId(s + 1, (h ^ (uint8_t)*s) * 16777619u) : h;
+}
+
+// One per call site, lives in static storage next to the call
+struct LogSite {
+  uint32_t id;                     // logFormatId(format)
+  const char *format;
+  uint8_t level;
+  uint32_t minIntervalMs;          // Rate limit, 0 = unlimited
+  uint32_t lastMs;                 // Last time the site was emitted
+  uint16_t suppressed;             // Calls dropped by the rate limit since then
+};
+
+struct LogRecord {
+  const LogSite *site;
+  uint32_t timestampMs;
+  uint16_t suppressed;             // Rate-limited calls folded into this record
+  uint8_t argCount;
+  uint8_t types;                   // LOG_ARG_* per argument
+  uintptr_t args[LOG_MAX_ARGS];     // Raw 32-bit values or string pointers
+};
+
+class Logger {
+public:
+  Logger();
+  
+  void begin();                    // Start the drain task
+  void setLevel(uint8_t level);    // Runtime level threshold
+  uint8_t getLevel() { return level; }
+  void setBinaryOutput(bool enable); // Switch between text and binary frames
+  uint32_t getDropped() { return ring.getDropped(); }
+  TaskHandle_t getTaskHandle() { return drainTask; }
+  
+  // Called through the LOG_* macros
+  template <typename... Args>
+  void write(LogSite &site, const Args &... args) {
+    uint32_t now = millis();
+    // Sites are shared between tasks; a lost update only lets an extra record through
+    if (site.minIntervalMs > 0 && site.lastMs != 0 && now - site.lastMs < site.minIntervalMs) {
+      site.suppressed++;
+      return;
+    }
+    site.lastMs = now == 0 ? 1 : now;
+    
+    LogRecord record;
+    record.site = &site;
+    record.timestampMs = now;
+    record.suppressed = site.suppressed;
+    record.argCount = 0;
+    record.types = 0;
+    site.suppressed = 0;
+    pack(record, args...);
+    
+    if (ring.push(record) && drainTask != NULL) {
+      xTaskNotifyGive(drainTask);
+    }
+  }
+  
+  void drain();                    // Emit everything buffered (drain task or panic paths)
+  
+private:
+  MpscQueue<LogRecord, LOG_RING_SIZE> ring;
+  TaskHandle_t drainTask;
+  uint8_t level;
+  bool binaryOutput;
+  uint32_t reportedDrops;
+  
+  static void drainTaskMain(void *param);
+  void emitText(const LogRecord &record);
+  void emitBinary(const LogRecord &record);
+  
+  void pack(LogRecord &record) {}
+  template <typename T, typename... Rest>
+  void pack(LogRecord &record, const T &first, const Rest &... rest) {
+    if (record.argCount < LOG_MAX_ARGS) {
+      packArg(record, first);
+    }
+    pack(record, rest...);
+  }
+  
+  void store(LogRecord &record, uint8_t type, uintptr_t value) {
+    record.types |= type << (2 * record.argCount);
+    record.args[record.argCount++] = value;
+  }
+  void packArg(LogRecord &r, int v) { store(r, LOG_ARG_INT, (uint32_t)v); }
+  void packArg(LogRecord &r, long v) { store(r, LOG_ARG_INT, (uint32_t)v); }
+  void packArg(LogRecord &r, unsigned int v) { store(r, LOG_ARG_UINT, v); }
+  void packArg(LogRecord &r, unsigned long v) { store(r, LOG_ARG_UINT, (uint32_t)v); }
+  void packArg(LogRecord &r, bool v) { store(r, LOG_ARG_UINT, v ? 1 : 0); }
+  void packArg(LogRecord &r, float v) { uint32_t bits; memcpy(&bits, &v, 4); store(r, LOG_ARG_FLOAT, bits); }
+  void packArg(LogRecord &r, double v) { packArg(r, (float)v); }
+  void packArg(LogRecord &r, const char *v) { store(r, LOG_ARG_STR, (uintptr_t)v); }
+};
+
+extern Logger logger;
+
+#define LOG_AT(lvl, intervalMs, fmt, ...) do { \
+    if ((lvl) <= LOG_COMPILE_LEVEL && (lvl) <= logger.getLevel()) { \
+      static LogSite logSite_ = { logFormatId(fmt), fmt, (lvl), (intervalMs), 0, 0 }; \
+      logger.write(logSite_, ##__VA_ARGS__); \
+    } \
+  } while (0)
+
+// Format strings must be single string literals so the decoder can find them
+#define LOG_ERROR(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, 0, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG_AT(LOG_LEVEL_WARN, 0, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG_AT(LOG_LEVEL_INFO, 0, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG_AT(LOG_LEVEL_DEBUG, 0, fmt, ##__VA_ARGS__)
+
+// Rate-limited variants: at most one record per intervalMs per call site
+#define LOG_WARN_EVERY(intervalMs, fmt, ...) LOG_AT(LOG_LEVEL_WARN, intervalMs, fmt, ##__VA_ARGS__)
+#define LOG_INFO_EVERY(intervalMs, fmt, ...) LOG_AT(LOG_LEVEL_INFO, intervalMs, fmt, ##__VA_ARGS__)
+
+#endif // LOGGER_H
@@ -0,0 +1,38 @@
+/**
+ * ModelPartition implementation
+ */
+
+#include "ModelPartition.h"
+
+ModelPartition::ModelPartition() {
+  mapped = NULL;
+  mappedSize = 0;
+  handle = 0;
+}
+
+bool ModelPartition::map(const char *label, esp_partition_subtype_t subtype) {
+  unmap();
+  
+  const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, subtype, label);
+  if (partition == NULL) {
+    return false;
+  }
+  
+  // Mapped through the data cache (64 KB pages); the pointer stays valid until unmap()
+  const void *address;
+  if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &address, &handle) != ESP_OK) {
+    return false;
+  }
+  
+  mapped = static_cast<const uint8_t *>(address);
+  mappedSize = partition->size;
+  return true;
+}
+
+void ModelPartition::unmap() {
+  if (mapped != NULL) {
+    spi_flash_munmap(handle);
+    mapped = NULL;
+    mappedSize = 0;
+  }
+}
@@ -0,0 +1,31 @@
+/**
+ * ModelPartition Class
+ * Maps a data partition (a parameter bundle slot, see BundleStore) into
+ * the address space through the flash cache, so the model weights and
+ * reference sets in it are read in place without copying them to RAM
+ */
+
+#ifndef MODEL_PARTITION_H
+#define MODEL_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_partition.h>
+
+class ModelPartition {
+public:
+  ModelPartition();
+  
+  bool map(const char *label, esp_partition_subtype_t subtype); // False when missing or unmappable
+  void unmap();
+  
+  const uint8_t *data() const { return mapped; }
+  size_t size() const { return mappedSize; }
+  
+private:
+  const uint8_t *mapped;
+  size_t mappedSize;
+  spi_flash_mmap_handle_t handle;
+};
+
+#endif // MODEL_PARTITION_H
@@ -0,0 +1,77 @@
+/**
+ * MpscQueue Class
+ * Bounded lock-free multi-producer/single-consumer queue. Every slot
+ * carries a sequence number, so producers on either core claim slots
+ * with a single compare-and-swap and never block each other.
+ */
+
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, size_t Capacity>
+class MpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "MpscQueue capacity must be a power of two");
+                
+public:
+  MpscQueue() : enqueuePos(0), dequeuePos(0), dropped(0) {
+    for (size_t i = 0; i < Capacity; i++) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  
+  // Any task: returns false (and counts a drop) when the queue is full
+  bool push(const T &item) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells[pos & (Capacity - 1)];
+      size_t seq = cell.sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = item;
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  
+  // Consumer task only: returns false when the queue is empty
+  bool pop(T &item) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & (Capacity - 1)];
+    size_t seq = cell.sequence.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+      return false;
+    }
+    item = cell.data;
+    cell.sequence.store(pos + Capacity, std::memory_order_release);
+    dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+  }
+  
+  uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+  
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+  
+  Cell cells[Capacity];
+  std::atomic<size_t> enqueuePos;
+  std::atomic<size_t> dequeuePos;
+  std::atomic<uint32_t> dropped;
+};
+
+#endif // MPSC_QUEUE_H
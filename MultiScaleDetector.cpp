@@ -0,0 +1,185 @@
+/**
+ * MultiScaleDetector implementation
+ */
+
+#include "MultiScaleDetector.h"
+#include <math.h>
+
+MultiScaleDetector::MultiScaleDetector() {
+  for (int i = 0; i < ANOMALY_SCALE_COUNT; i++) {
+    levels[i].params = defaultParams((AnomalyScale)i);
+  }
+  levels[ANOMALY_SCALE_READING].fanIn = 1;
+  levels[ANOMALY_SCALE_QUARTER].fanIn = 15;
+  levels[ANOMALY_SCALE_HOUR].fanIn = 4;
+  setReadingInterval(5000);
+}
+
+MultiScaleDetector::ScaleParams MultiScaleDetector::defaultParams(AnomalyScale scale) {
+  // Longer scales average more noise away, so they use tighter thresholds
+  // and a longer memory, and are the ones trusted to see slow creep
+  static const ScaleParams defaults[ANOMALY_SCALE_COUNT] = {
+    { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 },         // Reading: tested by the caller
+    { 0.02f, 5.0f, 8.0f, 0.0f, 0.0f, 30 },       // Minute: spikes only
+    { 0.05f, 4.0f, 6.0f, 0.5f, 8.0f, 16 },       // Quarter
+    { 0.04f, 3.5f, 5.0f, 0.5f, 6.0f, 24 }        // Hour
+  };
+  return defaults[scale];
+}
+
+void MultiScaleDetector::setReadingInterval(uint32_t intervalMs) {
+  uint32_t perMinute = intervalMs > 0 ? (60000 + intervalMs / 2) / intervalMs : 1;
+  levels[ANOMALY_SCALE_MINUTE].fanIn = perMinute > 0 ? perMinute : 1;
+  reset();
+}
+
+void MultiScaleDetector::setScaleParams(AnomalyScale scale, const ScaleParams &params) {
+  levels[scale].params = params;
+  if (levels[scale].params.warmup < 2) {
+    levels[scale].params.warmup = 2;
+  }
+}
+
+void MultiScaleDetector::reset() {
+  for (int i = 0; i < ANOMALY_SCALE_COUNT; i++) {
+    Level &level = levels[i];
+    level.count = 0;
+    level.sum = 0.0;
+    level.periods = 0;
+    level.mean = 0.0f;
+    level.variance = 0.0f;
+    level.creepUp = 0.0f;
+    level.creepDown = 0.0f;
+  }
+}
+
+float MultiScaleDetector::getSigma(AnomalyScale scale) const {
+  float sigma = sqrtf(levels[scale].variance);
+  return sigma > MULTISCALE_SIGMA_FLOOR_W ? sigma : MULTISCALE_SIGMA_FLOOR_W;
+}
+
+int MultiScaleDetector::update(float power, uint32_t timestampMs, AnomalyEvent *events) {
+  int found = 0;
+  float value = power;
+  
+  // Carry the value up while periods close; each level sees one value per period
+  for (int i = ANOMALY_SCALE_MINUTE; i < ANOMALY_SCALE_COUNT; i++) {
+    Level &level = levels[i];
+    level.sum += value;
+    if (++level.count < level.fanIn) {
+      break;
+    }
+    
+    value = (float)(level.sum / level.count);
+    level.sum = 0.0;
+    level.count = 0;
+    if (test((AnomalyScale)i, value, timestampMs, events[found])) {
+      found++;
+    }
+  }
+  return found;
+}
+
+bool MultiScaleDetector::test(AnomalyScale scale, float value, uint32_t timestampMs, AnomalyEvent &event) {
+  Level &level = levels[scale];
+  const ScaleParams &params = level.params;
+  level.periods++;
+  
+  // Plain mean and variance while warming up, then exponential forgetting
+  if (level.periods <= params.warmup) {
+    float weight = 1.0f / level.periods;
+    float diff = value - level.mean;
+    level.mean += weight * diff;
+    level.variance = (1.0f - weight) * (level.variance + weight * diff * diff);
+    return false;
+  }
+  
+  float sigma = getSigma(scale);
+  float z = (value - level.mean) / sigma;
+  
+  event.scale = scale;
+  event.value = value;
+  event.expected = level.mean;
+  event.score = z;
+  event.timestampMs = timestampMs;
+  event.reserved = 0;
+  bool raised = false;
+  
+  if (fabsf(z) > params.zWarning) {
+    event.kind = ANOMALY_LEVEL;
+    event.severity = fabsf(z) > params.zCritical ? ANOMALY_CRITICAL : ANOMALY_WARNING;
+    raised = true;
+  }
+  
+  // Creep is accumulated on z clipped to the warning band, so one spike
+  // alone cannot trip it
+  if (params.creepH > 0.0f) {
+    float clipped = z > params.zWarning ? params.zWarning : (z < -params.zWarning ? -params.zWarning : z);
+    level.creepUp = fmaxf(0.0f, level.creepUp + clipped - params.creepK);
+    level.creepDown = fmaxf(0.0f, level.creepDown - clipped - params.creepK);
+    float creep = level.creepUp > level.creepDown ? level.creepUp : -level.creepDown;
+    if (!raised && fabsf(creep) > params.creepH) {
+      event.kind = ANOMALY_CREEP;
+      event.severity = ANOMALY_WARNING;
+      event.score = creep;
+      raised = true;
+    }
+    if (fabsf(creep) > params.creepH) {
+      level.creepUp = 0.0f;
+      level.creepDown = 0.0f;
+    }
+  }
+  
+  // Outliers are clipped before they reach the baseline so it is not
+  // dragged towards them
+  float bound = params.zCritical * sigma;
+  float diff = value - level.mean;
+  diff = diff > bound ? bound : (diff < -bound ? -bound : diff);
+  level.mean += params.alpha * diff;
+  level.variance = (1.0f - params.alpha) * (level.variance + params.alpha * diff * diff);
+  return raised;
+}
+
+AnomalyScale MultiScaleDetector::scaleOf(uint32_t seconds) {
+  if (seconds >= 3600) {
+    return ANOMALY_SCALE_HOUR;
+  }
+  if (seconds >= 900) {
+    return ANOMALY_SCALE_QUARTER;
+  }
+  return seconds >= 60 ? ANOMALY_SCALE_MINUTE : ANOMALY_SCALE_READING;
+}
+
+const char *MultiScaleDetector::scaleName(AnomalyScale scale) {
+  switch (scale) {
+    case ANOMALY_SCALE_READING: return "reading";
+    case ANOMALY_SCALE_MINUTE: return "minute";
+    case ANOMALY_SCALE_QUARTER: return "quarter";
+    case ANOMALY_SCALE_HOUR: return "hour";
+    default: break;
+  }
+  return "?";
+}
+
+const char *MultiScaleDetector::severityName(AnomalySeverity severity) {
+  switch (severity) {
+    case ANOMALY_INFO: return "info";
+    case ANOMALY_WARNING: return "warning";
+    case ANOMALY_CRITICAL: return "critical";
+    default: break;
+  }
+  return "?";
+}
+
+const char *MultiScaleDetector::kindName(AnomalyKind kind) {
+  switch (kind) {
+    case ANOMALY_LEVEL: return "level";
+    case ANOMALY_CREEP: return "creep";
+    case ANOMALY_OUTLIER: return "outlier";
+    case ANOMALY_CHANGE: return "change";
+    case ANOMALY_PROFILE: return "profile";
+    case ANOMALY_MODEL: return "model";
+    case ANOMALY_STATE: return "state";
+  }
+  return "?";
+}
@@ -0,0 +1,112 @@
+/**
+ * MultiScaleDetector Class
+ * Anomaly detection at several time scales over a rollup hierarchy:
+ * readings are averaged into minutes, minutes into quarter hours and
+ * quarters into hours, and each level is tested only when one of its
+ * periods closes. Every scale has its own robust exponential baseline, a
+ * level test against warning and critical thresholds for fast excursions,
+ * and a one-sided CUSUM pair for slow creeping increases or decreases.
+ * The cost per reading is O(1) however long the top scale is.
+ *
+ * The reading scale itself is left to the caller (see RobustWindow); the
+ * event types here are shared by every anomaly source so they can form
+ * one stream.
+ */
+
+#ifndef MULTI_SCALE_DETECTOR_H
+#define MULTI_SCALE_DETECTOR_H
+
+#include <stdint.h>
+
+#ifndef MULTISCALE_SIGMA_FLOOR_W
+#define MULTISCALE_SIGMA_FLOOR_W 3.0f // Lower bound on each scale's spread
+#endif
+
+enum AnomalyScale {
+  ANOMALY_SCALE_READING,           // One aggregated reading
+  ANOMALY_SCALE_MINUTE,
+  ANOMALY_SCALE_QUARTER,           // 15 minutes
+  ANOMALY_SCALE_HOUR,
+  ANOMALY_SCALE_COUNT
+};
+
+enum AnomalySeverity {
+  ANOMALY_INFO,                    // Noted, does not set the reading's anomaly flag
+  ANOMALY_WARNING,
+  ANOMALY_CRITICAL,
+  ANOMALY_SEVERITY_COUNT
+};
+
+enum AnomalyKind {
+  ANOMALY_LEVEL,                   // Period mean outside its scale's band
+  ANOMALY_CREEP,                   // Slow sustained shift accumulated by CUSUM
+  ANOMALY_OUTLIER,                 // Single reading far from the robust median
+  ANOMALY_CHANGE,                  // Load change point
+  ANOMALY_PROFILE,                 // Period atypical for its slot of the week
+  ANOMALY_MODEL,                   // Deployed model flagged its window
+  ANOMALY_STATE                    // Reading fits no learned operating state
+};
+
+struct AnomalyEvent {
+  uint8_t scale;                   // AnomalyScale
+  uint8_t severity;                // AnomalySeverity
+  uint8_t kind;                    // AnomalyKind
+  uint8_t reserved;
+  float value;                     // Value tested (W)
+  float expected;                  // Baseline it was tested against (W)
+  float score;                     // Deviation in the source's units; the sign gives the direction
+  uint32_t timestampMs;
+};
+
+class MultiScaleDetector {
+public:
+  struct ScaleParams {
+    float alpha;                   // Baseline smoothing per period once warm
+    float zWarning;                // Level thresholds in sigmas
+    float zCritical;
+    float creepK;                  // CUSUM allowance in sigmas
+    float creepH;                  // CUSUM threshold in sigmas; 0 disables creep detection
+    uint16_t warmup;               // Periods before the scale is tested
+  };
+  
+  MultiScaleDetector();
+  
+  void setReadingInterval(uint32_t intervalMs); // Readings per minute follow from this; also resets
+  void setScaleParams(AnomalyScale scale, const ScaleParams &params);
+  const ScaleParams &getScaleParams(AnomalyScale scale) const { return levels[scale].params; }
+  static ScaleParams defaultParams(AnomalyScale scale);
+  
+  void reset();
+  
+  // Feeds one reading. Scales whose period closed are tested; events found
+  // are written to events (room for ANOMALY_SCALE_COUNT) and counted.
+  int update(float power, uint32_t timestampMs, AnomalyEvent *events);
+  
+  float getBaseline(AnomalyScale scale) const { return levels[scale].mean; }
+  float getSigma(AnomalyScale scale) const;
+  uint32_t getPeriods(AnomalyScale scale) const { return levels[scale].periods; }
+  
+  static AnomalyScale scaleOf(uint32_t seconds); // Scale of a window or period of this length
+  static const char *scaleName(AnomalyScale scale);
+  static const char *severityName(AnomalySeverity severity);
+  static const char *kindName(AnomalyKind kind);
+  
+private:
+  struct Level {
+    ScaleParams params;
+    uint32_t fanIn;                // Periods of the level below per period of this one
+    uint32_t count;                // Periods accumulated towards the current one
+    double sum;
+    uint32_t periods;              // Periods tested so far
+    float mean;
+    float variance;
+    float creepUp;
+    float creepDown;
+  };
+  
+  Level levels[ANOMALY_SCALE_COUNT]; // The reading level only accumulates
+  
+  bool test(AnomalyScale scale, float value, uint32_t timestampMs, AnomalyEvent &event);
+};
+
+#endif // MULTI_SCALE_DETECTOR_H
@@ -3,6 +3,9 @@
  */
 
 #include "NetworkManager.h"
+#include "StageMonitor.h"
+#include "Logger.h"
+#include "BootTimeline.h"
 
 // Static variable to track connection status
 static bool s_connected = false;
@@ -11,7 +14,10 @@ NetworkManager::NetworkManager() {
   connected = false;
   lastReconnectAttempt = 0;
   ntpConfigured = false;
+  ntpRequested = false;
+  bootEpoch = 0;
   otaEnabled = false;
+  otaStarted = false;
 }
 
 void NetworkManager::wifiEventHandler(WiFiEvent_t event) {
@@ -20,11 +26,12 @@ void NetworkManager::wifiEventHandler(WiFiEvent_t event) {
       Serial.print("Connected to WiFi. IP address: ");
       Serial.println(WiFi.localIP());
       s_connected = true;
+      bootTimeline.mark(BOOT_WIFI_CONNECTED);
       // Turn off LED to indicate normal operation
       digitalWrite(LED_PIN, LOW);
       break;
     case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
-      Serial.println("Disconnected from WiFi");
+      LOG_WARN_EVERY(60000, "Disconnected from WiFi");
       s_connected = false;
       break;
     default:
@@ -50,6 +57,26 @@ void NetworkManager::begin() {
 }
 
 void NetworkManager::update() {
+  maintainConnection();
+  service();
+}
+
+void NetworkManager::registerJobs(Scheduler &scheduler) {
+  scheduler.addPeriodic("net-service", NETWORK_POLL_INTERVAL, serviceJob, this);
+  scheduler.addPeriodic("net-connection", NETWORK_CONNECTION_CHECK_INTERVAL, connectionJob, this);
+}
+
+void NetworkManager::serviceJob(void *context) {
+  StageMonitor::Timer timer(stageMonitor, STAGE_NETWORK_UPDATE);
+  static_cast<NetworkManager *>(context)->service();
+}
+
+void NetworkManager::connectionJob(void *context) {
+  StageMonitor::Timer timer(stageMonitor, STAGE_NETWORK_UPDATE);
+  static_cast<NetworkManager *>(context)->maintainConnection();
+}
+
+void NetworkManager::maintainConnection() {
   // Update connection status
   connected = s_connected;
   
@@ -60,17 +87,27 @@ void NetworkManager::update() {
     // Try to reconnect periodically
     if (currentMillis - lastReconnectAttempt > CONNECTION_TIMEOUT) {
       lastReconnectAttempt = currentMillis;
-      Serial.println("Attempting to reconnect to Wi-Fi...");
+      LOG_INFO_EVERY(60000, "Attempting to reconnect to Wi-Fi...");
       connectToWifi();
     }
   } else {
     // If connected and NTP not yet configured, set up NTP
-    if (!ntpConfigured) {
+    if (!ntpRequested) {
       configureNTP();
-      ntpConfigured = true;
+    } else if (!ntpConfigured) {
+      checkTimeSync();
+    }
+    
+    // OTA needs the network stack up before it can listen
+    if (otaEnabled && !otaStarted) {
+      ArduinoOTA.begin();
+      otaStarted = true;
+      Serial.println("OTA updates enabled");
     }
   }
-  
+}
+
+void NetworkManager::service() {
   // Handle DNS requests if in portal mode
   wifiManager.process();
   
@@ -85,7 +122,14 @@ bool NetworkManager::isConnected() {
 }
 
 unsigned long NetworkManager::getTimestamp() {
-  if (ntpConfigured) {
+  bool synced;
+  return getTimestamp(synced);
+}
+
+unsigned long NetworkManager::getTimestamp(bool &synced) {
+  // Read the flag once so the stamp and its kind always agree
+  synced = ntpConfigured;
+  if (synced) {
     time_t now;
     time(&now);
     return now;
@@ -95,19 +139,36 @@ unsigned long NetworkManager::getTimestamp() {
   }
 }
 
-String NetworkManager::getFormattedTime() {
+bool NetworkManager::isTimeSynced() {
+  return ntpConfigured;
+}
+
+unsigned long NetworkManager::getBootEpoch() {
+  return bootEpoch;
+}
+
+void NetworkManager::toEpoch(unsigned long &timestamp, bool &synced) {
+  if (synced || !ntpConfigured) {
+    return;
+  }
+  timestamp = bootEpoch + timestamp / 1000;
+  synced = true;
+}
+
+bool NetworkManager::getFormattedTime(char *buffer, size_t size) {
   if (!ntpConfigured) {
-    return "NTP not configured";
+    strlcpy(buffer, "NTP not configured", size);
+    return false;
   }
   
   struct tm timeinfo;
   if (!getLocalTime(&timeinfo)) {
-    return "Failed to obtain time";
+    strlcpy(buffer, "Failed to obtain time", size);
+    return false;
   }
   
-  char timeString[30];
-  strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", &timeinfo);
-  return String(timeString);
+  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+  return true;
 }
 
 void NetworkManager::startConfigPortal() {
@@ -135,14 +196,14 @@ void NetworkManager::resetSettings() {
   ESP.restart();
 }
 
-void NetworkManager::setupOTA(const String &hostname) {
+void NetworkManager::setupOTA(const char *hostname) {
   // Set up OTA updates
-  ArduinoOTA.setHostname(hostname.c_str());
+  ArduinoOTA.setHostname(hostname);
   ArduinoOTA.setPassword(OTA_PASSWORD);
   ArduinoOTA.setPort(OTA_PORT);
   
   ArduinoOTA.onStart([]() {
-    String type;
+    const char *type;
     if (ArduinoOTA.getCommand() == U_FLASH) {
       type = "sketch";
     } else { // U_SPIFFS
@@ -150,7 +211,8 @@ void NetworkManager::setupOTA(const String &hostname) {
     }
     
     // Close any open files or stop sensors before OTA
-    Serial.println("Start updating " + type);
+    Serial.print("Start updating ");
+    Serial.println(type);
   });
   
   ArduinoOTA.onEnd([]() {
@@ -182,8 +244,8 @@ void NetworkManager::setupOTA(const String &hostname) {
 void NetworkManager::enableOTA(bool enable) {
   otaEnabled = enable;
   if (enable) {
-    ArduinoOTA.begin();
-    Serial.println("OTA updates enabled");
+    // Started by maintainConnection() once Wi-Fi is up
+    Serial.println("OTA updates requested");
   } else {
     Serial.println("OTA updates disabled");
   }
@@ -208,42 +270,48 @@ void NetworkManager::setupConfigPortal() {
 }
 
 void NetworkManager::configureNTP() {
-  // Configure NTP time synchronization
+  // Configure NTP time synchronization; SNTP retries in the background,
+  // so there is no need to wait here
   configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER1, NTP_SERVER2);
+  ntpRequested = true;
   Serial.println("NTP configuration initiated");
-  
-  // Wait for time to be set
-  int retry = 0;
-  while (time(nullptr) < 24 * 3600 && retry < 10) {
-    Serial.println("Waiting for NTP time sync...");
-    delay(1000);
-    retry++;
+}
+
+void NetworkManager::checkTimeSync() {
+  time_t now = time(nullptr);
+  if (now < (time_t)MIN_VALID_EPOCH) {
+    return;
   }
   
-  if (retry < 10) {
-    Serial.println("NTP time synchronized");
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-      char timeString[30];
-      strftime(timeString, sizeof(timeString), "%Y-%m-%d %H:%M:%S", &timeinfo);
-      Serial.print("Current time: ");
-      Serial.println(timeString);
-    }
-  } else {
-    Serial.println("Failed to synchronize NTP time, will try again later");
-    ntpConfigured = false;
+  bootEpoch = now - millis() / 1000;
+  ntpConfigured = true;
+  bootTimeline.mark(BOOT_TIME_SYNCED);
+  
+  // Printed directly: the deferred logger keeps string arguments by
+  // pointer, and this buffer is gone before the log task formats it
+  char timeString[30];
+  if (getFormattedTime(timeString, sizeof(timeString))) {
+    Serial.printf("NTP time synchronized: %s\n", timeString);
   }
 }
 
 void NetworkManager::connectToWifi() {
   // Try to connect to the saved WiFi network
-  // If cannot connect, start the configuration portal
+  // If there is none, start the configuration portal
   Serial.println("Connecting to WiFi...");
   
   // Turn on LED to indicate connection attempt
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, HIGH);
   
+  if (wifiManager.getWiFiIsSaved()) {
+    // Returns immediately; the GOT_IP event and maintainConnection() follow up
+    WiFi.mode(WIFI_STA);
+    WiFi.begin();
+    return;
+  }
+  
+  // Blocks the network task until the portal is done or times out
   if (!wifiManager.autoConnect(DEVICE_NAME)) {
     Serial.println("Failed to connect and hit timeout");
     // Turn off LED
@@ -7,6 +7,7 @@
 #define NETWORK_MANAGER_H
 
 #include "Config.h"
+#include "Scheduler.h"
 #include <WiFiManager.h>
 #include <DNSServer.h>
 #include <WebServer.h>
@@ -17,27 +18,41 @@ class NetworkManager {
 public:
   NetworkManager();
   
-  void begin();                    // Initialize network connection
+  void begin();                    // Initialize network connection (non-blocking with saved credentials)
   void update();                   // Update network state, handle reconnection
+  void registerJobs(Scheduler &scheduler); // Register periodic upkeep jobs
   bool isConnected();              // Check if connected to network
-  unsigned long getTimestamp();    // Get current timestamp (seconds since epoch)
-  String getFormattedTime();       // Get formatted time string
+  unsigned long getTimestamp();    // Get current timestamp (seconds since epoch, uptime ms before NTP sync)
+  unsigned long getTimestamp(bool &synced); // Same, saying which of the two it is
+  bool isTimeSynced();             // True once NTP has delivered a valid time
+  unsigned long getBootEpoch();    // Epoch seconds at millis() == 0, valid once synced
+  void toEpoch(unsigned long &timestamp, bool &synced); // Convert a pre-sync uptime timestamp once time is known
+  bool getFormattedTime(char *buffer, size_t size); // Format local time, false if unavailable
   
   void startConfigPortal();        // Force start the configuration portal
   void resetSettings();            // Reset all saved settings
-  void setupOTA(const String &hostname); // Set up Over-The-Air updates
+  void setupOTA(const char *hostname); // Set up Over-The-Air updates
   void enableOTA(bool enable);     // Enable or disable OTA updates
   
 private:
   WiFiManager wifiManager;         // WiFiManager instance for captive portal
   bool connected;                  // Current connection status
   unsigned long lastReconnectAttempt; // Last time we tried to reconnect
-  bool ntpConfigured;              // Flag to track if NTP is configured
+  bool ntpConfigured;              // Flag to track if NTP time is valid
+  bool ntpRequested;               // SNTP started, waiting for the first sync
+  unsigned long bootEpoch;         // Epoch seconds at millis() == 0
   bool otaEnabled;                 // Flag to track if OTA is enabled
+  bool otaStarted;                 // ArduinoOTA.begin() done (needs a connection)
   
   void setupConfigPortal();        // Set up the configuration portal
   void connectToWifi();            // Try to connect to Wi-Fi
-  void configureNTP();             // Configure NTP time server
+  void configureNTP();             // Start SNTP; the sync is picked up later
+  void checkTimeSync();            // Mark time valid once SNTP has synced
+  void service();                  // Serve portal DNS and OTA requests
+  void maintainConnection();       // Reconnect Wi-Fi, set up NTP once connected
+  
+  static void serviceJob(void *context);
+  static void connectionJob(void *context);
   
   // WiFi event handlers for ESP32
   static void wifiEventHandler(WiFiEvent_t event);
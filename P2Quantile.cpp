@@ -0,0 +1,101 @@
+/**
+ * P2Quantile implementation
+ */
+
+#include "P2Quantile.h"
+
+P2Quantile::P2Quantile(float p) {
+  reset(p);
+}
+
+void P2Quantile::reset(float p) {
+  this->p = p;
+  n = 0;
+  for (int i = 0; i < 5; i++) {
+    height[i] = 0.0f;
+    position[i] = i + 1;
+  }
+  desired[0] = 1.0f;
+  desired[1] = 1.0f + 2.0f * p;
+  desired[2] = 1.0f + 4.0f * p;
+  desired[3] = 3.0f + 2.0f * p;
+  desired[4] = 5.0f;
+}
+
+void P2Quantile::add(float x) {
+  // The first five samples become the markers, kept sorted
+  if (n < 5) {
+    int i = n++;
+    while (i > 0 && height[i - 1] > x) {
+      height[i] = height[i - 1];
+      i--;
+    }
+    height[i] = x;
+    return;
+  }
+  n++;
+  
+  // Find the cell of x, widening the extremes if needed
+  int k;
+  if (x < height[0]) {
+    height[0] = x;
+    k = 0;
+  } else if (x >= height[4]) {
+    height[4] = x;
+    k = 3;
+  } else {
+    k = 0;
+    while (k < 3 && x >= height[k + 1]) {
+      k++;
+    }
+  }
+  for (int i = k + 1; i < 5; i++) {
+    position[i]++;
+  }
+  
+  // Desired positions advance by 0, p/2, p, (1+p)/2 and 1
+  desired[1] += p / 2.0f;
+  desired[2] += p;
+  desired[3] += (1.0f + p) / 2.0f;
+  desired[4] += 1.0f;
+  
+  // Move the middle markers one step towards their desired positions
+  for (int i = 1; i <= 3; i++) {
+    float offset = desired[i] - position[i];
+    if ((offset >= 1.0f && position[i + 1] - position[i] > 1) ||
+        (offset <= -1.0f && position[i - 1] - position[i] < -1)) {
+      int d = offset > 0.0f ? 1 : -1;
+      float candidate = parabolic(i, d);
+      if (height[i - 1] < candidate && candidate < height[i + 1]) {
+        height[i] = candidate;
+      } else {
+        height[i] = linear(i, d);
+      }
+      position[i] += d;
+    }
+  }
+}
+
+float P2Quantile::parabolic(int i, int d) const {
+  float span = (float)(position[i + 1] - position[i - 1]);
+  float above = (height[i + 1] - height[i]) / (position[i + 1] - position[i]);
+  float below = (height[i] - height[i - 1]) / (position[i] - position[i - 1]);
+  return height[i] + d / span * ((position[i] - position[i - 1] + d) * above +
+                                 (position[i + 1] - position[i] - d) * below);
+}
+
+float P2Quantile::linear(int i, int d) const {
+  return height[i] + d * (height[i + d] - height[i]) / (position[i + d] - position[i]);
+}
+
+float P2Quantile::value() const {
+  if (n == 0) {
+    return 0.0f;
+  }
+  if (n < 5) {
+    // Nearest rank over the sorted samples
+    int index = (int)(p * (n - 1) + 0.5f);
+    return height[index];
+  }
+  return height[2];
+}
@@ -0,0 +1,37 @@
+/**
+ * P2Quantile Class
+ * Streaming estimate of one quantile with the P-square algorithm (Jain and
+ * Chlamtac): five markers whose heights are nudged with a piecewise
+ * parabolic fit as samples arrive. Fixed memory and O(1) per sample, no
+ * sample storage.
+ */
+
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#include <stdint.h>
+
+class P2Quantile {
+public:
+  explicit P2Quantile(float p = 0.5f);
+  
+  void reset(float p);
+  void reset() { reset(p); }
+  void add(float x);
+  
+  float value() const;             // Exact for fewer than five samples
+  uint32_t count() const { return n; }
+  float getProbability() const { return p; }
+  
+private:
+  float p;
+  uint32_t n;
+  float height[5];                 // Marker heights
+  int32_t position[5];             // Actual marker positions (1-based)
+  float desired[5];                // Desired marker positions
+  
+  float parabolic(int i, int d) const;
+  float linear(int i, int d) const;
+};
+
+#endif // P2_QUANTILE_H
@@ -0,0 +1,138 @@
+/**
+ * ParamBundle implementation
+ */
+
+#include "ParamBundle.h"
+#include "InferenceEngine.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define BUNDLE_REPORT(...) Serial.printf(__VA_ARGS__)
+#else
+#include <stdio.h>
+#define BUNDLE_REPORT(...) fprintf(stderr, __VA_ARGS__)
+#endif
+
+ParamBundle::ParamBundle() {
+  unbind();
+}
+
+void ParamBundle::unbind() {
+  blob = NULL;
+  header = NULL;
+  sections = NULL;
+  params = NULL;
+  paramCount = 0;
+  error = "no bundle";
+}
+
+bool ParamBundle::fail(const char *message) {
+  unbind();
+  error = message;
+  return false;
+}
+
+bool ParamBundle::bind(const uint8_t *blob, size_t size) {
+  unbind();
+  if (blob == NULL || size < sizeof(BundleHeader) || ((uintptr_t)blob & 3) != 0) {
+    return fail("blob missing, short or unaligned");
+  }
+  
+  // An erased slot reads as all ones; report it plainly
+  const BundleHeader *candidate = (const BundleHeader *)blob;
+  if (candidate->magic == 0xFFFFFFFFUL) {
+    return fail("empty");
+  }
+  if (candidate->magic != BUNDLE_MAGIC || candidate->version != BUNDLE_VERSION) {
+    return fail("bad magic or version");
+  }
+  size_t tableEnd = sizeof(BundleHeader) + (size_t)candidate->sectionCount * sizeof(BundleSection);
+  if (candidate->totalSize > size || candidate->totalSize < tableEnd) {
+    return fail("size mismatch");
+  }
+  
+  const size_t crcOffset = offsetof(BundleHeader, crc32);
+  const uint8_t zero[4] = { 0, 0, 0, 0 };
+  uint32_t crc = InferenceEngine::crc32(blob, crcOffset);
+  crc = InferenceEngine::crc32(zero, sizeof(zero), crc);
+  crc = InferenceEngine::crc32(blob + crcOffset + 4, candidate->totalSize - crcOffset - 4, crc);
+  if (crc != candidate->crc32) {
+    return fail("CRC mismatch");
+  }
+  
+  const BundleSection *table = (const BundleSection *)(blob + sizeof(BundleHeader));
+  for (uint16_t i = 0; i < candidate->sectionCount; i++) {
+    const BundleSection &entry = table[i];
+    if ((entry.offset & 3) != 0 || entry.offset < tableEnd || entry.offset > candidate->totalSize ||
+        entry.size > candidate->totalSize - entry.offset) {
+      return fail("section out of bounds");
+    }
+  }
+  
+  this->blob = blob;
+  header = candidate;
+  sections = table;
+  error = "";
+  
+  size_t paramBytes;
+  params = (const BundleParam *)section(BUNDLE_SECTION_PARAMS, paramBytes);
+  if (paramBytes % sizeof(BundleParam) != 0) {
+    return fail("parameter section size");
+  }
+  paramCount = paramBytes / sizeof(BundleParam);
+  for (uint16_t i = 0; i < paramCount; i++) {
+    if (params[i].name[BUNDLE_PARAM_NAME_LEN - 1] != '\0') {
+      return fail("unterminated parameter name");
+    }
+  }
+  return true;
+}
+
+const uint8_t *ParamBundle::section(uint32_t type, size_t &size) const {
+  size = 0;
+  if (header == NULL) {
+    return NULL;
+  }
+  for (uint16_t i = 0; i < header->sectionCount; i++) {
+    if (sections[i].type == type) {
+      size = sections[i].size;
+      return blob + sections[i].offset;
+    }
+  }
+  return NULL;
+}
+
+float ParamBundle::getParam(const char *name, float fallback, float min, float max) const {
+  for (uint16_t i = 0; i < paramCount; i++) {
+    if (strcmp(params[i].name, name) != 0) {
+      continue;
+    }
+    
+    // NaN would fail every threshold comparison and silently disable a
+    // detector, and casting it to an integer is undefined
+    float value = params[i].value;
+    if (!isfinite(value)) {
+      BUNDLE_REPORT("Bundle parameter %s is not a number, using %g\n", name, fallback);
+      return fallback;
+    }
+    if (value < min || value > max) {
+      float clamped = value < min ? min : max;
+      BUNDLE_REPORT("Bundle parameter %s = %g outside %g..%g, using %g\n", name, value, min, max, clamped);
+      return clamped;
+    }
+    return value;
+  }
+  return fallback;
+}
+
+const char *ParamBundle::sectionName(uint32_t type) {
+  switch (type) {
+    case BUNDLE_SECTION_PARAMS: return "params";
+    case BUNDLE_SECTION_MODEL: return "model";
+    case BUNDLE_SECTION_WAVEFORMS: return "waveforms";
+    default: break;
+  }
+  return "?";
+}
@@ -0,0 +1,101 @@
+/**
+ * ParamBundle Class
+ * Read-only view of a parameter bundle: one versioned, checksummed blob
+ * carrying tuning parameters and the deployed model and waveform reference
+ * set, so they can be updated without rebuilding the firmware. The bundle
+ * is used in place; sections are handed out as pointers into it, which
+ * for a bundle mapped from flash (BundleStore) means no RAM copy.
+ *
+ * Blob layout, little endian, every section 4-byte aligned:
+ *   BundleHeader, BundleSection[sectionCount], section data
+ * Sections:
+ *   PARM  BundleParam[]: named float parameters; names the firmware does
+ *         not know are ignored, missing ones keep their Config.h default
+ *         and each is checked against its documented range
+ *   QMDL  packed model (InferenceEngine.h, tools/pack_model.py)
+ *   WREF  waveform reference set (KnnClassifier.h, tools/make_waveform_refs.py)
+ * tools/make_bundle.py builds and validates bundles.
+ */
+
+#ifndef PARAM_BUNDLE_H
+#define PARAM_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUNDLE_MAGIC 0x444E4245UL  // "EBND"
+#define BUNDLE_VERSION 1
+#define BUNDLE_PARAM_NAME_LEN 20
+
+#define BUNDLE_SECTION_PARAMS 0x4D524150UL // "PARM"
+#define BUNDLE_SECTION_MODEL 0x4C444D51UL // "QMDL"
+#define BUNDLE_SECTION_WAVEFORMS 0x46455257UL // "WREF"
+
+struct BundleHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t sectionCount;
+  uint32_t sequence;               // Raised with every update; the valid slot with the highest one is used
+  uint32_t totalSize;              // Blob bytes, header included
+  uint32_t created;                // Build time (epoch seconds), for display
+  uint32_t crc32;                  // Of the blob with this field zeroed
+};
+
+struct BundleSection {
+  uint32_t type;                   // BUNDLE_SECTION_*
+  uint32_t offset;                 // From the start of the blob
+  uint32_t size;
+  uint32_t reserved;
+};
+
+struct BundleParam {
+  char name[BUNDLE_PARAM_NAME_LEN]; // NUL-terminated
+  float value;
+};
+
+static_assert(sizeof(BundleHeader) == 24, "BundleHeader layout is part of the blob format");
+static_assert(sizeof(BundleSection) == 16, "BundleSection layout is part of the blob format");
+static_assert(sizeof(BundleParam) == 24, "BundleParam layout is part of the blob format");
+
+class ParamBundle {
+public:
+  ParamBundle();
+  
+  // Validates the blob (header, CRC, section bounds) and binds it; it is not copied
+  bool bind(const uint8_t *blob, size_t size);
+  void unbind();
+  bool isBound() const { return header != NULL; }
+  const char *getError() const { return error; }
+  
+  uint32_t getSequence() const { return header ? header->sequence : 0; }
+  uint32_t getCreated() const { return header ? header->created : 0; }
+  uint32_t getSize() const { return header ? header->totalSize : 0; }
+  uint16_t getSectionCount() const { return header ? header->sectionCount : 0; }
+  const BundleSection &getSectionAt(uint16_t index) const { return sections[index]; }
+  
+  // Section data of the given type, or NULL with size 0 when absent
+  const uint8_t *section(uint32_t type, size_t &size) const;
+  
+  // Parameter value, or fallback when the bundle does not set it. A
+  // non-finite value is rejected in favour of fallback and one outside
+  // [min, max] is clamped; either is reported on the console.
+  float getParam(const char *name, float fallback, float min, float max) const;
+  uint16_t getParamCount() const { return paramCount; }
+  const BundleParam &getParamAt(uint16_t index) const { return params[index]; }
+  
+  // Sequence comparison that survives wrap-around
+  static bool isNewer(uint32_t sequence, uint32_t than) { return (int32_t)(sequence - than) > 0; }
+  static const char *sectionName(uint32_t type);
+  
+private:
+  const uint8_t *blob;
+  const BundleHeader *header;
+  const BundleSection *sections;
+  const BundleParam *params;
+  uint16_t paramCount;
+  const char *error;
+  
+  bool fail(const char *message);
+};
+
+#endif // PARAM_BUNDLE_H
@@ -0,0 +1,65 @@
+/**
+ * PowerCycleDetector implementation
+ */
+
+#include "PowerCycleDetector.h"
+#include <Preferences.h>
+#include <esp_system.h>
+
+#define POWER_CYCLE_MAGIC 0x50435943UL // Marks the RTC counter as initialised
+
+PowerCycleDetector powerCycleDetector;
+
+// Not cleared on reset, only when power is removed
+RTC_NOINIT_ATTR static uint32_t rtcMagic;
+RTC_NOINIT_ATTR static uint32_t rtcCount;
+
+PowerCycleDetector::PowerCycleDetector() {
+  count = 0;
+}
+
+bool PowerCycleDetector::begin() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  bool rtcValid = rtcMagic == POWER_CYCLE_MAGIC && reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT;
+  
+  if (rtcValid) {
+    count = rtcCount;
+  } else {
+    Preferences prefs;
+    prefs.begin("powercycle", true);
+    count = prefs.getUChar("count", 0);
+    prefs.end();
+  }
+  
+  count++;
+  if (count >= POWER_CYCLE_COUNT) {
+    // Start over so the next boot does not trigger again
+    Serial.printf("Detected %u quick restarts\n", count);
+    store(0);
+    return true;
+  }
+  
+  store(count);
+  return false;
+}
+
+void PowerCycleDetector::markStable() {
+  if (count > 0) {
+    count = 0;
+    store(0);
+  }
+}
+
+uint8_t PowerCycleDetector::getCount() {
+  return count;
+}
+
+void PowerCycleDetector::store(uint8_t value) {
+  rtcMagic = POWER_CYCLE_MAGIC;
+  rtcCount = value;
+  
+  Preferences prefs;
+  prefs.begin("powercycle", false);
+  prefs.putUChar("count", value);
+  prefs.end();
+}
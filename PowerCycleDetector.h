@@ -0,0 +1,41 @@
+/**
+ * PowerCycleDetector Class
+ * Counts quick successive restarts so that power-cycling the device
+ * POWER_CYCLE_COUNT times within POWER_CYCLE_WINDOW_MS of each other
+ * can open the configuration portal without a button.
+ *
+ * The count is kept in RTC memory, which survives resets from the EN
+ * button, software and watchdogs without touching flash. RTC memory is
+ * lost when power is removed, so the count is mirrored to NVS for real
+ * power cycles.
+ */
+
+#ifndef POWER_CYCLE_DETECTOR_H
+#define POWER_CYCLE_DETECTOR_H
+
+#include <Arduino.h>
+
+#ifndef POWER_CYCLE_COUNT
+#define POWER_CYCLE_COUNT 3        // Restarts in a row that trigger the portal
+#endif
+#ifndef POWER_CYCLE_WINDOW_MS
+#define POWER_CYCLE_WINDOW_MS 5000 // Uptime after which a boot no longer counts
+#endif
+
+class PowerCycleDetector {
+public:
+  PowerCycleDetector();
+  
+  bool begin();                    // Count this boot; true when the threshold is reached
+  void markStable();               // Uptime passed the window: reset the count
+  uint8_t getCount();
+  
+private:
+  uint8_t count;
+  
+  void store(uint8_t value);
+};
+
+extern PowerCycleDetector powerCycleDetector;
+
+#endif // POWER_CYCLE_DETECTOR_H
@@ -0,0 +1,20 @@
+/**
+ * Power reading record shared by the firmware modules and host tools
+ */
+
+#ifndef POWER_DATA_H
+#define POWER_DATA_H
+
+// Data structure for power readings
+struct PowerData {
+  unsigned long timestamp;   // Epoch seconds when synced, else uptime ms before the first NTP sync
+  float current;     // Amperes
+  float voltage;     // Volts
+  float power;       // Watts
+  float energy;      // Kilowatt-hours
+  float peak;        // Highest measured power in the period (W); power for a single measurement
+  bool synced;       // timestamp is epoch seconds; set when taken, never guessed from the value
+  bool anomaly;      // Flag for detected anomalies
+};
+
+#endif // POWER_DATA_H
@@ -0,0 +1,135 @@
+/**
+ * PowerManager implementation
+ */
+
+#include "PowerManager.h"
+#include <esp_timer.h>
+
+PowerManager::PowerManager() {
+  lightSleepEnabled = false;
+  captureLock = NULL;
+  busyMux = portMUX_INITIALIZER_UNLOCKED;
+  busyTasks = 0;
+  busySince = 0;
+  busyTotalUs = 0;
+  startTimeUs = 0;
+  latencySamples = 0;
+  latencyTotalMs = 0;
+  latencyMaxMs = 0;
+}
+
+void PowerManager::begin() {
+  startTimeUs = esp_timer_get_time();
+
+#if LOW_POWER_MODE && CONFIG_PM_ENABLE
+  // Sampling must not see the APB clock change mid-block
+  if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "capture", &captureLock) != ESP_OK) {
+    captureLock = NULL;
+  }
+  
+  esp_pm_config_esp32_t pmConfig;
+  pmConfig.max_freq_mhz = CPU_MAX_FREQ_MHZ;
+  pmConfig.min_freq_mhz = CPU_MIN_FREQ_MHZ;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pmConfig.light_sleep_enable = true;
+#else
+  pmConfig.light_sleep_enable = false;
+#endif
+
+  esp_err_t err = esp_pm_configure(&pmConfig);
+  if (err != ESP_OK) {
+    Serial.print("Power management setup failed: ");
+    Serial.println(esp_err_to_name(err));
+    return;
+  }
+  
+  lightSleepEnabled = pmConfig.light_sleep_enable;
+  Serial.printf("PowerManager initialized: DFS %d-%d MHz, light sleep %s\n",
+                CPU_MIN_FREQ_MHZ, CPU_MAX_FREQ_MHZ, lightSleepEnabled ? "on" : "off");
+  if (!lightSleepEnabled) {
+    Serial.println("Light sleep needs CONFIG_FREERTOS_USE_TICKLESS_IDLE in sdkconfig");
+  }
+#else
+  Serial.println("PowerManager initialized: low-power mode disabled");
+#endif
+}
+
+bool PowerManager::isLightSleepEnabled() {
+  return lightSleepEnabled;
+}
+
+void PowerManager::beginCapture() {
+  if (captureLock != NULL) {
+    esp_pm_lock_acquire(captureLock);
+  }
+}
+
+void PowerManager::endCapture() {
+  if (captureLock != NULL) {
+    esp_pm_lock_release(captureLock);
+  }
+}
+
+void PowerManager::recordWakeLatency(uint32_t lateMs) {
+  // Only the sampling task writes these
+  latencySamples++;
+  latencyTotalMs += lateMs;
+  if (lateMs > latencyMaxMs) {
+    latencyMaxMs = lateMs;
+  }
+}
+
+void PowerManager::taskAwake() {
+  portENTER_CRITICAL(&busyMux);
+  if (busyTasks++ == 0) {
+    busySince = esp_timer_get_time();
+  }
+  portEXIT_CRITICAL(&busyMux);
+}
+
+void PowerManager::taskIdle() {
+  portENTER_CRITICAL(&busyMux);
+  if (busyTasks > 0 && --busyTasks == 0) {
+    busyTotalUs += esp_timer_get_time() - busySince;
+  }
+  portEXIT_CRITICAL(&busyMux);
+}
+
+float PowerManager::getAwakeFraction() {
+  portENTER_CRITICAL(&busyMux);
+  int64_t now = esp_timer_get_time();
+  int64_t busy = busyTotalUs;
+  if (busyTasks > 0) {
+    busy += now - busySince;
+  }
+  portEXIT_CRITICAL(&busyMux);
+  
+  int64_t elapsed = now - startTimeUs;
+  return elapsed > 0 ? (float)busy / elapsed : 1.0;
+}
+
+float PowerManager::getEstimatedCurrentMa() {
+  // Two-state model: busy time at ACTIVE_CURRENT_MA, the rest at the idle
+  // floor of the configured mode. Radio traffic is not modelled, so bench
+  // measurements remain the reference.
+  float awake = getAwakeFraction();
+  float idleCurrent = lightSleepEnabled ? LIGHT_SLEEP_CURRENT_MA : IDLE_CURRENT_MA;
+  return awake * ACTIVE_CURRENT_MA + (1.0 - awake) * idleCurrent;
+}
+
+float PowerManager::getMeanWakeLatencyMs() {
+  return latencySamples > 0 ? (float)latencyTotalMs / latencySamples : 0.0;
+}
+
+uint32_t PowerManager::getMaxWakeLatencyMs() {
+  return latencyMaxMs;
+}
+
+void PowerManager::printReport() {
+  Serial.println("Power report:");
+  Serial.printf("  Light sleep:        %s\n", lightSleepEnabled ? "enabled" : "disabled");
+  Serial.printf("  Awake fraction:     %.2f %%\n", getAwakeFraction() * 100.0);
+  Serial.printf("  Estimated current:  %.1f mA\n", getEstimatedCurrentMa());
+  Serial.printf("  Sampling latency:   mean %.2f ms, max %u ms (%u wake-ups)\n",
+                getMeanWakeLatencyMs(), (unsigned)latencyMaxMs, (unsigned)latencySamples);
+}
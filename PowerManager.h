@@ -0,0 +1,57 @@
+/**
+ * PowerManager Class
+ * Handles dynamic frequency scaling and automatic light sleep between
+ * capture blocks, and estimates the resulting average current draw
+ */
+
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include "Config.h"
+#include <esp_pm.h>
+
+class PowerManager {
+public:
+  PowerManager();
+  
+  void begin();                    // Configure DFS and light sleep (if LOW_POWER_MODE)
+  bool isLightSleepEnabled();      // True once automatic light sleep is active
+  
+  void beginCapture();             // Keep APB clock stable for an ADC capture block
+  void endCapture();               // Allow sleep again after the capture block
+  void recordWakeLatency(uint32_t lateMs); // How late the sampling task ran
+  
+  void taskAwake();                // A task started work (see AwakeScope)
+  void taskIdle();                 // A task is about to block
+  
+  float getAwakeFraction();        // Share of time any task was busy since boot
+  float getEstimatedCurrentMa();   // Modelled average supply current (mA)
+  float getMeanWakeLatencyMs();    // Mean added measurement latency (ms)
+  uint32_t getMaxWakeLatencyMs();  // Worst added measurement latency (ms)
+  void printReport();              // Print power and latency figures to serial
+  
+  // Marks a task as busy for the lifetime of the scope
+  class AwakeScope {
+  public:
+    explicit AwakeScope(PowerManager &pm) : manager(pm) { manager.taskAwake(); }
+    ~AwakeScope() { manager.taskIdle(); }
+  private:
+    PowerManager &manager;
+  };
+  
+private:
+  bool lightSleepEnabled;          // Automatic light sleep configured successfully
+  esp_pm_lock_handle_t captureLock; // APB_FREQ_MAX lock held while sampling
+  
+  portMUX_TYPE busyMux;            // Guards the busy-time bookkeeping below
+  int busyTasks;                   // Tasks currently running work
+  int64_t busySince;               // esp_timer time the first task went busy
+  int64_t busyTotalUs;             // Accumulated time with at least one busy task
+  int64_t startTimeUs;             // esp_timer time begin() was called
+  
+  uint32_t latencySamples;         // Sampling wake-ups measured
+  uint64_t latencyTotalMs;         // Sum of wake-up lateness
+  uint32_t latencyMaxMs;           // Worst wake-up lateness
+};
+
+#endif // POWER_MANAGER_H
@@ -3,6 +3,8 @@
  */
 
 #include "PowerMonitor.h"
+#include "Profiler.h"
+#include <string.h>
 
 PowerMonitor::PowerMonitor() {
   currentRMS = 0.0;
@@ -10,6 +12,8 @@ PowerMonitor::PowerMonitor() {
   powerWatts = 0.0;
   energyKwh = 0.0;
   lastEnergyCalcTime = 0;
+  memset(samples, 0, sizeof(samples));
+  captureMicros = 0;
   calibrationFactor = 1.0; // Default value, should be calibrated
 }
 
@@ -27,6 +31,8 @@ void PowerMonitor::begin() {
 void PowerMonitor::update() {
   // Read current sensor and calculate RMS value
   float rawCurrent = readCurrentSensor();
+  
+  PROFILE_ZONE(PROF_RMS);
   currentRMS = calculateRMSCurrent(rawCurrent);
   
   // Calculate power based on current and voltage
@@ -59,13 +65,16 @@ void PowerMonitor::setVoltage(float v) {
 }
 
 float PowerMonitor::readCurrentSensor() {
+  PROFILE_ZONE(PROF_SAMPLING);
   int sampleCount = SAMPLES_PER_CYCLE;
   float sumSquared = 0.0;
+  uint32_t start = micros();
   
   // Take multiple samples to improve accuracy
   for (int i = 0; i < sampleCount; i++) {
     // Read analog value from CT sensor
     int adcValue = analogRead(CURRENT_SENSOR_PIN);
+    samples[i] = (int16_t)adcValue;
     
     // Convert to voltage
     float voltage = (adcValue / float(ADC_COUNTS)) * VREF;
@@ -79,6 +88,7 @@ float PowerMonitor::readCurrentSensor() {
     // Small delay between samples
     delayMicroseconds(200);
   }
+  captureMicros = micros() - start;
   
   // Return the mean squared value
   return sumSquared / sampleCount;
@@ -22,7 +22,11 @@ public:
   
   void calibrate();            // Run calibration routine
   void setVoltage(float v);    // Set the mains voltage
-
+  
+  const int16_t *getSamples() const { return samples; }   // Raw ADC samples of the last capture
+  size_t getSampleCount() const { return SAMPLES_PER_CYCLE; }
+  uint32_t getCaptureMicros() const { return captureMicros; } // Duration of the last capture
+  
 private:
   float currentRMS;            // Calculated RMS current value
   float mainVoltage;           // Configured mains voltage
@@ -31,6 +35,9 @@ private:
   
   unsigned long lastEnergyCalcTime;  // Timestamp for energy calculation
   
+  int16_t samples[SAMPLES_PER_CYCLE]; // Last capture, kept for waveform features
+  uint32_t captureMicros;
+  
   float readCurrentSensor();   // Read raw values from current sensor
   float calculateRMSCurrent(float rawADC); // Calculate RMS current from raw ADC
   void calculatePower();       // Calculate power from current and voltage
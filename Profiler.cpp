@@ -0,0 +1,88 @@
+/**
+ * Profiler implementation
+ */
+
+#include "Profiler.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifdef ARDUINO
+#define PROFILER_PRINTF Serial.printf
+#define PROFILER_TICK_UNIT "cycles"
+#else
+#define PROFILER_PRINTF printf
+#define PROFILER_TICK_UNIT "ns"
+#endif
+
+Profiler profiler;
+
+static const char *ZONE_NAMES[PROF_ZONE_COUNT] = {
+  "sampling",
+  "rms",
+  "serialize",
+  "ai",
+  "display",
+};
+
+Profiler::Profiler() {
+  reset();
+}
+
+void Profiler::record(ProfileZone zone, uint32_t ticks) {
+#ifdef ARDUINO
+  // Only this core writes its table; masking interrupts keeps a task
+  // preempted mid-update on the same core from interleaving with it
+  portDISABLE_INTERRUPTS();
+  ZoneStats &s = stats[xPortGetCoreID()][zone];
+#else
+  ZoneStats &s = stats[0][zone];
+#endif
+  if (s.count == 0 || ticks < s.minTicks) {
+    s.minTicks = ticks;
+  }
+  if (ticks > s.maxTicks) {
+    s.maxTicks = ticks;
+  }
+  s.count++;
+  s.totalTicks += ticks;
+  s.histogram.record(ticks);
+#ifdef ARDUINO
+  portENABLE_INTERRUPTS();
+#endif
+}
+
+void Profiler::dump() {
+  PROFILER_PRINTF("Profile zones (" PROFILER_TICK_UNIT "):  core    count        min       mean        max        p99\n");
+  for (int core = 0; core < PROFILER_CORES; core++) {
+    for (int zone = 0; zone < PROF_ZONE_COUNT; zone++) {
+      const ZoneStats &s = stats[core][zone];
+      if (s.count == 0) {
+        continue;
+      }
+      PROFILER_PRINTF("  %-16s %6d %8u %10u %10u %10u %10u\n", ZONE_NAMES[zone], core,
+                      (unsigned)s.count, (unsigned)s.minTicks, (unsigned)(s.totalTicks / s.count),
+                      (unsigned)s.maxTicks, (unsigned)s.histogram.percentile(99));
+    }
+  }
+#ifdef ARDUINO
+  // CCOUNT follows the current CPU clock, which DFS may lower while idle
+  PROFILER_PRINTF("CPU clock now %u MHz\n", (unsigned)ESP.getCpuFreqMHz());
+#endif
+}
+
+void Profiler::reset() {
+  for (int core = 0; core < PROFILER_CORES; core++) {
+    for (int zone = 0; zone < PROF_ZONE_COUNT; zone++) {
+      ZoneStats &s = stats[core][zone];
+      s.count = 0;
+      s.minTicks = 0;
+      s.maxTicks = 0;
+      s.totalTicks = 0;
+      s.histogram.reset();
+    }
+  }
+}
+
+const char *Profiler::zoneName(int zone) {
+  return zone >= 0 && zone < PROF_ZONE_COUNT ? ZONE_NAMES[zone] : "unknown";
+}
@@ -0,0 +1,91 @@
+/**
+ * Profiler Class
+ * Cycle-accurate scoped probes for hot paths. On the ESP32 a zone reads
+ * the Xtensa CCOUNT register on entry and exit; on a host build the same
+ * probes use std::chrono::steady_clock (nanoseconds). Each core writes
+ * only its own statistics table, so probes never take a lock.
+ * Define PROFILING_ENABLED=0 to compile every probe away.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "LatencyHistogram.h"
+
+#ifndef PROFILING_ENABLED
+#define PROFILING_ENABLED 1
+#endif
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define PROFILER_CORES 2
+#else
+#include <chrono>
+#define PROFILER_CORES 1
+#endif
+
+enum ProfileZone {
+  PROF_SAMPLING,                   // ADC sample loop
+  PROF_RMS,                        // RMS, power and energy calculation
+  PROF_SERIALIZE,                  // JSON serialization of payloads
+  PROF_AI,                         // Anomaly detection and model updates
+  PROF_DISPLAY,                    // Reading log / TFT redraw
+  PROF_ZONE_COUNT
+};
+
+struct ZoneStats {
+  uint32_t count;
+  uint32_t minTicks;
+  uint32_t maxTicks;
+  uint64_t totalTicks;
+  LatencyHistogram histogram;      // For p99
+};
+
+class Profiler {
+public:
+  Profiler();
+  
+  // Raw tick source: CPU cycles on ESP32, nanoseconds on the host
+  static inline uint32_t now() {
+#ifdef ARDUINO
+    uint32_t ccount;
+    asm volatile("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+  
+  void record(ProfileZone zone, uint32_t ticks); // Add one zone execution
+  void dump();                                   // Print min/mean/max/p99 per zone per core
+  void reset();
+  static const char *zoneName(int zone);
+  
+private:
+  ZoneStats stats[PROFILER_CORES][PROF_ZONE_COUNT];
+};
+
+extern Profiler profiler;
+
+// Times the enclosing scope into a zone
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileZone z) : zone(z), start(Profiler::now()) {}
+  ~ProfileScope() { profiler.record(zone, Profiler::now() - start); }
+private:
+  ProfileZone zone;
+  uint32_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#if PROFILING_ENABLED
+#define PROFILE_ZONE(zone) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(zone)
+#else
+#define PROFILE_ZONE(zone) do {} while (0)
+#endif
+
+#endif // PROFILER_H
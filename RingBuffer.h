@@ -0,0 +1,69 @@
+/**
+ * RingBuffer Class
+ * Fixed-capacity FIFO history with storage embedded in the object, used
+ * instead of std::vector/std::deque so steady-state code never touches
+ * the heap. Not thread-safe; use SpscQueue to pass data between tasks.
+ */
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+template <typename T, size_t Capacity>
+class RingBuffer {
+  static_assert(Capacity > 0, "RingBuffer capacity must be non-zero");
+  
+public:
+  RingBuffer() : start(0), count(0) {}
+  
+  // Appends an item; when full the oldest item is overwritten and false returned
+  bool push(const T &item) {
+    if (count == Capacity) {
+      items[start] = item;
+      start = (start + 1) % Capacity;
+      return false;
+    }
+    items[(start + count) % Capacity] = item;
+    count++;
+    return true;
+  }
+  
+  // Removes the oldest item; returns false when empty
+  bool pop(T &item) {
+    if (count == 0) {
+      return false;
+    }
+    item = items[start];
+    start = (start + 1) % Capacity;
+    count--;
+    return true;
+  }
+  
+  void popFront() {
+    if (count > 0) {
+      start = (start + 1) % Capacity;
+      count--;
+    }
+  }
+  
+  // Index 0 is the oldest item
+  const T &operator[](size_t i) const { return items[(start + i) % Capacity]; }
+  T &operator[](size_t i) { return items[(start + i) % Capacity]; }
+  
+  const T &front() const { return items[start]; }
+  const T &back() const { return items[(start + count - 1) % Capacity]; }
+  
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == Capacity; }
+  void clear() { start = 0; count = 0; }
+  static size_t capacity() { return Capacity; }
+  
+private:
+  T items[Capacity];
+  size_t start;
+  size_t count;
+};
+
+#endif // RING_BUFFER_H
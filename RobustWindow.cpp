@@ -0,0 +1,79 @@
+/**
+ * RobustWindow implementation
+ */
+
+#include "RobustWindow.h"
+#include <math.h>
+
+RobustWindow::RobustWindow(uint32_t horizon) {
+  setHorizon(horizon);
+}
+
+float RobustWindow::probability(RobustQuantile which) {
+  static const float probabilities[ROBUST_QUANTILE_COUNT] = { 0.05f, 0.25f, 0.5f, 0.75f, 0.95f };
+  return probabilities[which];
+}
+
+void RobustWindow::setHorizon(uint32_t samples) {
+  horizon = samples < 2 ? 2 : samples;
+  total = 0;
+  restart(estimators[0]);
+  restart(estimators[1]);
+}
+
+void RobustWindow::restart(Estimator &estimator) {
+  for (int i = 0; i < ROBUST_QUANTILE_COUNT; i++) {
+    estimator.quantiles[i].reset(probability((RobustQuantile)i));
+  }
+  estimator.deviation.reset(0.5f);
+  estimator.count = 0;
+}
+
+void RobustWindow::add(float x) {
+  // Set 0 restarts at multiples of the horizon, set 1 half a horizon later
+  uint32_t half = horizon / 2;
+  if (total > 0 && total % horizon == 0) {
+    restart(estimators[0]);
+  }
+  if (total > half && (total - half) % horizon == 0) {
+    restart(estimators[1]);
+  }
+  total++;
+  
+  for (int e = 0; e < 2; e++) {
+    Estimator &estimator = estimators[e];
+    if (e == 1 && total <= half) {
+      continue;
+    }
+    for (int i = 0; i < ROBUST_QUANTILE_COUNT; i++) {
+      estimator.quantiles[i].add(x);
+    }
+    // Deviation from the median as estimated so far
+    estimator.deviation.add(fabsf(x - estimator.quantiles[ROBUST_P50].value()));
+    estimator.count++;
+  }
+}
+
+const RobustWindow::Estimator &RobustWindow::current() const {
+  return estimators[1].count > estimators[0].count ? estimators[1] : estimators[0];
+}
+
+float RobustWindow::quantile(RobustQuantile which) const {
+  return current().quantiles[which].value();
+}
+
+float RobustWindow::mad() const {
+  return current().deviation.value();
+}
+
+float RobustWindow::score(float x) const {
+  float deviation = mad();
+  if (deviation < ROBUST_MAD_FLOOR_W) {
+    deviation = ROBUST_MAD_FLOOR_W;
+  }
+  return 0.6745f * (x - median()) / deviation;
+}
+
+uint32_t RobustWindow::coverage() const {
+  return current().count;
+}
@@ -0,0 +1,63 @@
+/**
+ * RobustWindow Class
+ * Fixed-memory quantiles over a sliding horizon: two staggered sets of P2
+ * estimators, each restarted every horizon samples half a horizon apart,
+ * so the older set always covers between half and one full horizon of the
+ * most recent samples. Gives percentile baselines and a median/MAD outlier
+ * score that, unlike mean and standard deviation, is not dragged around
+ * by the outliers themselves or by on/off bimodal loads.
+ */
+
+#ifndef ROBUST_WINDOW_H
+#define ROBUST_WINDOW_H
+
+#include <stdint.h>
+#include "P2Quantile.h"
+
+#ifndef ROBUST_MAD_FLOOR_W
+#define ROBUST_MAD_FLOOR_W 2.0f    // Lower bound on the MAD so steady loads do not score noise
+#endif
+
+enum RobustQuantile {
+  ROBUST_P05,
+  ROBUST_P25,
+  ROBUST_P50,
+  ROBUST_P75,
+  ROBUST_P95,
+  ROBUST_QUANTILE_COUNT
+};
+
+class RobustWindow {
+public:
+  explicit RobustWindow(uint32_t horizon = 720);
+  
+  void setHorizon(uint32_t samples); // Also clears the window
+  uint32_t getHorizon() const { return horizon; }
+  void add(float x);
+  
+  float quantile(RobustQuantile which) const;
+  float median() const { return quantile(ROBUST_P50); }
+  float mad() const;               // Median absolute deviation from the median
+  
+  // Modified z-score 0.6745 * (x - median) / MAD; |score| > 3.5 is the usual outlier cut
+  float score(float x) const;
+  
+  uint32_t coverage() const;       // Samples the current estimates are based on
+  static float probability(RobustQuantile which);
+  
+private:
+  struct Estimator {
+    P2Quantile quantiles[ROBUST_QUANTILE_COUNT];
+    P2Quantile deviation;          // Median of |x - median|
+    uint32_t count;
+  };
+  
+  uint32_t horizon;
+  uint32_t total;                  // Samples since the last clear
+  Estimator estimators[2];
+  
+  void restart(Estimator &estimator);
+  const Estimator &current() const;
+};
+
+#endif // ROBUST_WINDOW_H
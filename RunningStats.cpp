@@ -0,0 +1,78 @@
+/**
+ * RunningStats implementation
+ */
+
+#include "RunningStats.h"
+#include <math.h>
+
+RunningStats::RunningStats() {
+  reset();
+}
+
+void RunningStats::reset() {
+  n = 0;
+  meanValue = 0.0;
+  m2 = 0.0;
+  sumY = 0.0;
+  sumXY = 0.0;
+}
+
+void RunningStats::push(float value) {
+  // The new value sits at position n
+  sumXY += (double)n * value;
+  sumY += value;
+  
+  n++;
+  double delta = value - meanValue;
+  meanValue += delta / n;
+  m2 += delta * (value - meanValue);
+}
+
+void RunningStats::popOldest(float value) {
+  if (n <= 1) {
+    reset();
+    return;
+  }
+  
+  // Every remaining value moves one position towards the start
+  sumY -= value;
+  sumXY -= sumY;
+  
+  n--;
+  double delta = value - meanValue;
+  meanValue -= delta / n;
+  m2 -= delta * (value - meanValue);
+  if (m2 < 0.0) {
+    m2 = 0.0;
+  }
+}
+
+float RunningStats::variance() const {
+  return n > 1 ? (float)(m2 / (n - 1)) : 0.0f;
+}
+
+float RunningStats::stddev() const {
+  return sqrtf(variance());
+}
+
+float RunningStats::slope() const {
+  if (n < 2) {
+    return 0.0f;
+  }
+  
+  // Positions are 0..n-1, so their sums have closed forms
+  double sumX = (double)n * (n - 1) / 2.0;
+  double sumX2 = (double)(n - 1) * n * (2 * n - 1) / 6.0;
+  double denominator = n * sumX2 - sumX * sumX;
+  return (float)((n * sumXY - sumX * sumY) / denominator);
+}
+
+float RunningStats::predict(float x) const {
+  if (n == 0) {
+    return 0.0f;
+  }
+  
+  double sumX = (double)n * (n - 1) / 2.0;
+  double intercept = (sumY - slope() * sumX) / n;
+  return (float)(intercept + slope() * x);
+}
@@ -0,0 +1,39 @@
+/**
+ * RunningStats Class
+ * O(1) statistics over a sliding window: mean and variance (Welford,
+ * with removal) and the least-squares line through the window, where x is
+ * the position in the window (0 = oldest). The caller owns the window
+ * storage and passes each value in when it enters and when it leaves.
+ * Accumulators are double and can be rebuilt from the window now and then
+ * to bound rounding drift.
+ */
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <stddef.h>
+
+class RunningStats {
+public:
+  RunningStats();
+  
+  void reset();
+  void push(float value);          // Value enters as the newest
+  void popOldest(float value);     // Oldest value leaves the window
+  
+  size_t count() const { return n; }
+  float mean() const { return (float)meanValue; }
+  float variance() const;          // Sample variance (n - 1)
+  float stddev() const;
+  float slope() const;             // Change per sample of the fitted line
+  float predict(float x) const;    // Fitted value at window position x
+  
+private:
+  size_t n;
+  double meanValue;                // Welford running mean
+  double m2;                       // Sum of squared deviations from the mean
+  double sumY;                     // Sum of values
+  double sumXY;                    // Sum of position * value
+};
+
+#endif // RUNNING_STATS_H
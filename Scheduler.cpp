@@ -0,0 +1,199 @@
+/**
+ * Scheduler implementation
+ */
+
+#include "Scheduler.h"
+
+Scheduler::Scheduler(const char *name) {
+  schedulerName = name;
+  heapSize = 0;
+  for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+    jobs[i].active = false;
+  }
+}
+
+int Scheduler::addPeriodic(const char *name, unsigned long periodMs, JobCallback callback,
+                           void *context, unsigned long firstDelayMs) {
+  if (periodMs == 0) {
+    return INVALID_JOB;
+  }
+  return allocateJob(name, periodMs, firstDelayMs, callback, context);
+}
+
+int Scheduler::addOneShot(const char *name, unsigned long delayMs, JobCallback callback,
+                          void *context) {
+  return allocateJob(name, 0, delayMs, callback, context);
+}
+
+void Scheduler::cancel(int jobId) {
+  if (jobId < 0 || jobId >= SCHEDULER_MAX_JOBS || !jobs[jobId].active) {
+    return;
+  }
+  heapRemove(jobId);
+  jobs[jobId].active = false;
+}
+
+void Scheduler::reschedule(int jobId, unsigned long delayMs) {
+  if (jobId < 0 || jobId >= SCHEDULER_MAX_JOBS || !jobs[jobId].active) {
+    return;
+  }
+  heapRemove(jobId);
+  jobs[jobId].nextDue = millis() + delayMs;
+  heapPush(jobId);
+}
+
+unsigned long Scheduler::runDue() {
+  while (heapSize > 0) {
+    uint8_t index = heap[0];
+    Job &job = jobs[index];
+    unsigned long now = millis();
+    
+    // Deadlines are compared as signed differences so millis() may wrap
+    long lateness = (long)(now - job.nextDue);
+    if (lateness < 0) {
+      break;
+    }
+    
+    heapPop();
+    job.lastJitterMs = lateness;
+    if ((uint32_t)lateness > job.maxJitterMs) {
+      job.maxJitterMs = lateness;
+    }
+    job.totalJitterMs += lateness;
+    job.runs++;
+    
+    if (job.periodMs > 0) {
+      // Advance by whole periods to stay drift-free, skipping any we missed
+      job.nextDue += job.periodMs;
+      if ((long)(now - job.nextDue) >= 0) {
+        unsigned long behind = (now - job.nextDue) / job.periodMs + 1;
+        job.missed += behind;
+        job.nextDue += behind * job.periodMs;
+      }
+      heapPush(index);
+    } else {
+      job.active = false;
+    }
+    
+    // Callbacks may add or cancel jobs, so the heap is consistent before the call
+    job.callback(job.context);
+  }
+  
+  return timeUntilNext();
+}
+
+unsigned long Scheduler::timeUntilNext() {
+  if (heapSize == 0) {
+    return ULONG_MAX;
+  }
+  long remaining = (long)(jobs[heap[0]].nextDue - millis());
+  return remaining > 0 ? remaining : 0;
+}
+
+void Scheduler::printStats() {
+  Serial.printf("Scheduler '%s' jobs (runs / missed / jitter last, mean, max ms):\n", schedulerName);
+  for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+    const Job &job = jobs[i];
+    if (!job.active) {
+      continue;
+    }
+    unsigned long mean = job.runs > 0 ? job.totalJitterMs / job.runs : 0;
+    Serial.printf("  %-16s %7u %5u %5u %5lu %5u\n", job.name, (unsigned)job.runs,
+                  (unsigned)job.missed, (unsigned)job.lastJitterMs, mean, (unsigned)job.maxJitterMs);
+  }
+}
+
+int Scheduler::allocateJob(const char *name, unsigned long periodMs, unsigned long delayMs,
+                           JobCallback callback, void *context) {
+  for (int i = 0; i < SCHEDULER_MAX_JOBS; i++) {
+    Job &job = jobs[i];
+    if (job.active) {
+      continue;
+    }
+    job.name = name;
+    job.callback = callback;
+    job.context = context;
+    job.periodMs = periodMs;
+    job.nextDue = millis() + delayMs;
+    job.active = true;
+    job.runs = 0;
+    job.missed = 0;
+    job.lastJitterMs = 0;
+    job.maxJitterMs = 0;
+    job.totalJitterMs = 0;
+    heapPush(i);
+    return i;
+  }
+  
+  Serial.printf("Scheduler '%s' full, dropping job %s\n", schedulerName, name);
+  return INVALID_JOB;
+}
+
+bool Scheduler::earlier(uint8_t a, uint8_t b) const {
+  return (long)(jobs[heap[a]].nextDue - jobs[heap[b]].nextDue) < 0;
+}
+
+void Scheduler::heapPush(uint8_t jobIndex) {
+  heap[heapSize] = jobIndex;
+  siftUp(heapSize);
+  heapSize++;
+}
+
+uint8_t Scheduler::heapPop() {
+  uint8_t top = heap[0];
+  heapSize--;
+  if (heapSize > 0) {
+    heap[0] = heap[heapSize];
+    siftDown(0);
+  }
+  return top;
+}
+
+void Scheduler::heapRemove(uint8_t jobIndex) {
+  for (uint8_t pos = 0; pos < heapSize; pos++) {
+    if (heap[pos] != jobIndex) {
+      continue;
+    }
+    heapSize--;
+    if (pos < heapSize) {
+      heap[pos] = heap[heapSize];
+      siftDown(pos);
+      siftUp(pos);
+    }
+    return;
+  }
+}
+
+void Scheduler::siftUp(uint8_t pos) {
+  while (pos > 0) {
+    uint8_t parent = (pos - 1) / 2;
+    if (!earlier(pos, parent)) {
+      break;
+    }
+    uint8_t tmp = heap[pos];
+    heap[pos] = heap[parent];
+    heap[parent] = tmp;
+    pos = parent;
+  }
+}
+
+void Scheduler::siftDown(uint8_t pos) {
+  for (;;) {
+    uint8_t left = 2 * pos + 1;
+    uint8_t right = left + 1;
+    uint8_t smallest = pos;
+    if (left < heapSize && earlier(left, smallest)) {
+      smallest = left;
+    }
+    if (right < heapSize && earlier(right, smallest)) {
+      smallest = right;
+    }
+    if (smallest == pos) {
+      break;
+    }
+    uint8_t tmp = heap[pos];
+    heap[pos] = heap[smallest];
+    heap[smallest] = tmp;
+    pos = smallest;
+  }
+}
@@ -0,0 +1,68 @@
+/**
+ * Scheduler Class
+ * Runs periodic and one-shot jobs from a fixed-capacity min-heap ordered
+ * by deadline. Each task owns its scheduler and blocks until the next
+ * deadline, so FreeRTOS tickless idle can sleep the core in between.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+#include <limits.h>
+
+#ifndef SCHEDULER_MAX_JOBS
+#define SCHEDULER_MAX_JOBS 8       // Jobs per scheduler instance
+#endif
+
+typedef void (*JobCallback)(void *context);
+
+class Scheduler {
+public:
+  static const int INVALID_JOB = -1;
+  
+  explicit Scheduler(const char *name);
+  
+  // Register a job; returns its id or INVALID_JOB when the table is full
+  int addPeriodic(const char *name, unsigned long periodMs, JobCallback callback,
+                  void *context = NULL, unsigned long firstDelayMs = 0);
+  int addOneShot(const char *name, unsigned long delayMs, JobCallback callback,
+                 void *context = NULL);
+  void cancel(int jobId);                 // Remove a pending job
+  void reschedule(int jobId, unsigned long delayMs); // Move a job's next deadline
+  
+  unsigned long runDue();                 // Run due jobs, return ms until the next deadline
+  unsigned long timeUntilNext();          // Ms until the next deadline (ULONG_MAX if idle)
+  void printStats();                      // Print per-job run count and jitter
+
+private:
+  struct Job {
+    const char *name;
+    JobCallback callback;
+    void *context;
+    unsigned long periodMs;               // 0 for one-shot jobs
+    unsigned long nextDue;                // millis() deadline
+    bool active;
+    uint32_t runs;                        // Completed executions
+    uint32_t missed;                      // Periods skipped because the job ran too late
+    uint32_t lastJitterMs;                // Lateness of the most recent run
+    uint32_t maxJitterMs;                 // Worst lateness seen
+    uint64_t totalJitterMs;               // For the mean lateness
+  };
+  
+  const char *schedulerName;
+  Job jobs[SCHEDULER_MAX_JOBS];
+  uint8_t heap[SCHEDULER_MAX_JOBS];       // Job indices ordered by nextDue
+  uint8_t heapSize;
+  
+  int allocateJob(const char *name, unsigned long periodMs, unsigned long delayMs,
+                  JobCallback callback, void *context);
+  bool earlier(uint8_t a, uint8_t b) const;
+  void heapPush(uint8_t jobIndex);
+  uint8_t heapPop();
+  void heapRemove(uint8_t jobIndex);
+  void siftUp(uint8_t pos);
+  void siftDown(uint8_t pos);
+};
+
+#endif // SCHEDULER_H
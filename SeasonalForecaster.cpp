@@ -0,0 +1,123 @@
+/**
+ * SeasonalForecaster implementation
+ */
+
+#include "SeasonalForecaster.h"
+#include <math.h>
+#include <string.h>
+
+// Weight of the newest error in the smoothed error metrics, about one week
+#define FORECAST_ERROR_WINDOW 168
+
+SeasonalForecaster::SeasonalForecaster() {
+  reset();
+}
+
+void SeasonalForecaster::reset() {
+  memset(&state, 0, sizeof(state));
+  state.magic = FORECAST_STATE_MAGIC;
+  state.version = FORECAST_STATE_VERSION;
+}
+
+uint32_t SeasonalForecaster::weekSlot(uint32_t hour) {
+  // 1970-01-01 was a Thursday; shift so slot 0 is Monday 00:00
+  return (hour + 72) % FORECAST_WEEK_SLOTS;
+}
+
+float SeasonalForecaster::seasonal(uint32_t hour) const {
+  return state.daily[hour % FORECAST_DAY_SLOTS] + state.weekly[weekSlot(hour)];
+}
+
+void SeasonalForecaster::update(uint32_t hour, float meanPower) {
+  if (state.observations == 0) {
+    state.level = meanPower;
+    state.trend = 0.0f;
+    state.lastHour = hour;
+    state.observations = 1;
+    return;
+  }
+  
+  // Ignore repeats and clock steps backwards
+  if (hour <= state.lastHour) {
+    return;
+  }
+  
+  // Hours missed while powered off: let the damped trend carry the level
+  uint32_t gap = hour - state.lastHour;
+  if (gap > FORECAST_WEEK_SLOTS) {
+    gap = FORECAST_WEEK_SLOTS;
+  }
+  for (uint32_t i = 1; i < gap; i++) {
+    state.trend *= FORECAST_PHI;
+    state.level += state.trend;
+  }
+  
+  // Score the forecast made for this hour before learning from it
+  float predicted = state.level + FORECAST_PHI * state.trend + seasonal(hour);
+  float error = meanPower - predicted;
+  float weight = 1.0f / (state.observations < FORECAST_ERROR_WINDOW ? state.observations : FORECAST_ERROR_WINDOW);
+  state.errorVariance += weight * (error * error - state.errorVariance);
+  if (fabsf(meanPower) >= FORECAST_MAPE_MIN_W) {
+    state.mapeCount++;
+    float mapeWeight = 1.0f / (state.mapeCount < FORECAST_ERROR_WINDOW ? state.mapeCount : FORECAST_ERROR_WINDOW);
+    state.mape += mapeWeight * (100.0f * fabsf(error / meanPower) - state.mape);
+  }
+  
+  // Additive double-seasonal Holt-Winters
+  float &daily = state.daily[hour % FORECAST_DAY_SLOTS];
+  float &weekly = state.weekly[weekSlot(hour)];
+  float previousLevel = state.level;
+  state.level = FORECAST_ALPHA * (meanPower - daily - weekly) +
+                (1.0f - FORECAST_ALPHA) * (previousLevel + FORECAST_PHI * state.trend);
+  state.trend = FORECAST_BETA * (state.level - previousLevel) + (1.0f - FORECAST_BETA) * FORECAST_PHI * state.trend;
+  float newDaily = FORECAST_GAMMA * (meanPower - state.level - weekly) + (1.0f - FORECAST_GAMMA) * daily;
+  weekly = FORECAST_DELTA * (meanPower - state.level - daily) + (1.0f - FORECAST_DELTA) * weekly;
+  daily = newDaily;
+  
+  state.lastHour = hour;
+  state.observations++;
+}
+
+float SeasonalForecaster::forecast(uint32_t stepsAhead) const {
+  // Damped trend: phi + phi^2 + ... + phi^h
+  float damping = 0.0f;
+  float phi = 1.0f;
+  for (uint32_t i = 0; i < stepsAhead; i++) {
+    phi *= FORECAST_PHI;
+    damping += phi;
+  }
+  
+  float value = state.level + damping * state.trend + seasonal(state.lastHour + stepsAhead);
+  return value > 0.0f ? value : 0.0f;
+}
+
+void SeasonalForecaster::interval(uint32_t stepsAhead, float &low, float &high) const {
+  // The level error compounds with the horizon (simple exponential smoothing approximation)
+  uint32_t h = stepsAhead > 0 ? stepsAhead : 1;
+  float variance = state.errorVariance * (1.0f + (h - 1) * FORECAST_ALPHA * FORECAST_ALPHA);
+  float halfWidth = FORECAST_INTERVAL_Z * sqrtf(variance);
+  float centre = forecast(stepsAhead);
+  low = centre > halfWidth ? centre - halfWidth : 0.0f;
+  high = centre + halfWidth;
+}
+
+bool SeasonalForecaster::setState(const State &saved) {
+  if (saved.magic != FORECAST_STATE_MAGIC || saved.version != FORECAST_STATE_VERSION) {
+    return false;
+  }
+  
+  bool finite = isfinite(saved.level) && isfinite(saved.trend) &&
+                isfinite(saved.errorVariance) && isfinite(saved.mape);
+  for (int i = 0; finite && i < FORECAST_DAY_SLOTS; i++) {
+    finite = isfinite(saved.daily[i]);
+  }
+  for (int i = 0; finite && i < FORECAST_WEEK_SLOTS; i++) {
+    finite = isfinite(saved.weekly[i]);
+  }
+  if (!finite) {
+    return false;
+  }
+  
+  state = saved;
+  return true;
+}
@@ -0,0 +1,87 @@
+/**
+ * SeasonalForecaster Class
+ * Incremental double-seasonal Holt-Winters (additive, damped trend) over
+ * hourly means: level + trend + hour-of-day + hour-of-week components.
+ * Tracks the one-step error variance for prediction intervals and the
+ * mean absolute percentage error of its own forecasts. The whole model is
+ * one plain State struct so it can be saved and restored as a blob.
+ */
+
+#ifndef SEASONAL_FORECASTER_H
+#define SEASONAL_FORECASTER_H
+
+#include <stdint.h>
+
+#ifndef FORECAST_ALPHA
+#define FORECAST_ALPHA 0.10f       // Level smoothing
+#endif
+#ifndef FORECAST_BETA
+#define FORECAST_BETA 0.01f        // Trend smoothing
+#endif
+#ifndef FORECAST_GAMMA
+#define FORECAST_GAMMA 0.20f       // Hour-of-day smoothing
+#endif
+#ifndef FORECAST_DELTA
+#define FORECAST_DELTA 0.10f       // Hour-of-week smoothing
+#endif
+#ifndef FORECAST_PHI
+#define FORECAST_PHI 0.98f         // Trend damping per hour
+#endif
+#ifndef FORECAST_MIN_HOURS
+#define FORECAST_MIN_HOURS 24      // Observations before forecasts are trusted
+#endif
+#ifndef FORECAST_INTERVAL_Z
+#define FORECAST_INTERVAL_Z 1.96f  // Prediction interval width (95 %)
+#endif
+#ifndef FORECAST_MAPE_MIN_W
+#define FORECAST_MAPE_MIN_W 1.0f   // Hours below this are left out of the MAPE
+#endif
+
+#define FORECAST_DAY_SLOTS 24
+#define FORECAST_WEEK_SLOTS 168
+#define FORECAST_STATE_MAGIC 0x48575346UL // "FSWH"
+#define FORECAST_STATE_VERSION 1
+
+class SeasonalForecaster {
+public:
+  struct State {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t observations;         // Hours folded in so far
+    uint32_t lastHour;             // Local hours since the epoch of the last observation
+    float level;
+    float trend;
+    float daily[FORECAST_DAY_SLOTS];
+    float weekly[FORECAST_WEEK_SLOTS];
+    float errorVariance;           // Smoothed squared one-step error (W^2)
+    float mape;                    // Smoothed absolute percentage error (%)
+    uint32_t mapeCount;            // Hours that contributed to mape
+  };
+  
+  SeasonalForecaster();
+  
+  void reset();
+  
+  // Folds in the mean power of one local hour (hours since the epoch)
+  void update(uint32_t hour, float meanPower);
+  
+  // Mean power expected stepsAhead hours after the last observation
+  float forecast(uint32_t stepsAhead) const;
+  void interval(uint32_t stepsAhead, float &low, float &high) const;
+  
+  bool isReady() const { return state.observations >= FORECAST_MIN_HOURS; }
+  uint32_t getObservations() const { return state.observations; }
+  uint32_t getLastHour() const { return state.lastHour; }
+  float getMape() const { return state.mape; }
+  
+  const State &getState() const { return state; }
+  bool setState(const State &saved); // Rejects blobs with a bad header or non-finite values
+  
+private:
+  State state;
+  
+  float seasonal(uint32_t hour) const;
+  static uint32_t weekSlot(uint32_t hour);
+};
+
+#endif // SEASONAL_FORECASTER_H
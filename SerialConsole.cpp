@@ -0,0 +1,84 @@
+/**
+ * SerialConsole implementation
+ */
+
+#include "SerialConsole.h"
+
+SerialConsole serialConsole;
+
+static TaskHandle_t s_ownerTask = NULL;
+
+SerialConsole::SerialConsole() {
+  commandCount = 0;
+  lineLength = 0;
+}
+
+void SerialConsole::begin(TaskHandle_t owner) {
+  s_ownerTask = owner;
+  
+  // Called from the UART driver task whenever bytes arrive
+  Serial.onReceive([]() {
+    if (s_ownerTask != NULL) {
+      xTaskNotifyGive(s_ownerTask);
+    }
+  });
+}
+
+bool SerialConsole::addCommand(const char *name, ConsoleHandler handler, const char *help) {
+  if (commandCount >= CONSOLE_MAX_COMMANDS) {
+    return false;
+  }
+  commands[commandCount].name = name;
+  commands[commandCount].handler = handler;
+  commands[commandCount].help = help;
+  commandCount++;
+  return true;
+}
+
+void SerialConsole::poll() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (lineLength > 0) {
+        line[lineLength] = '\0';
+        dispatch();
+        lineLength = 0;
+      }
+    } else if (lineLength < CONSOLE_LINE_LENGTH - 1) {
+      line[lineLength++] = c;
+    }
+  }
+}
+
+void SerialConsole::dispatch() {
+  // Split "name args..." in place
+  char *args = strchr(line, ' ');
+  if (args != NULL) {
+    *args++ = '\0';
+    while (*args == ' ') {
+      args++;
+    }
+  } else {
+    args = line + lineLength;
+  }
+  
+  for (int i = 0; i < commandCount; i++) {
+    if (strcmp(line, commands[i].name) == 0) {
+      commands[i].handler(args);
+      return;
+    }
+  }
+  
+  if (strcmp(line, "help") != 0) {
+    Serial.print("Unknown command: ");
+    Serial.println(line);
+  }
+  printHelp();
+}
+
+void SerialConsole::printHelp() {
+  Serial.println("Commands:");
+  for (int i = 0; i < commandCount; i++) {
+    Serial.printf("  %-10s %s\n", commands[i].name, commands[i].help);
+  }
+}
@@ -0,0 +1,48 @@
+/**
+ * SerialConsole Class
+ * Line-based command interpreter on the serial port. Modules register
+ * named commands; the owning task is woken when input arrives, so the
+ * console costs nothing while idle.
+ */
+
+#ifndef SERIAL_CONSOLE_H
+#define SERIAL_CONSOLE_H
+
+#include <Arduino.h>
+
+#ifndef CONSOLE_MAX_COMMANDS
+#define CONSOLE_MAX_COMMANDS 16    // Registered commands
+#endif
+#ifndef CONSOLE_LINE_LENGTH
+#define CONSOLE_LINE_LENGTH 64     // Longest accepted command line
+#endif
+
+typedef void (*ConsoleHandler)(const char *args);
+
+class SerialConsole {
+public:
+  SerialConsole();
+  
+  void begin(TaskHandle_t owner);  // Wake the owner task on serial input
+  bool addCommand(const char *name, ConsoleHandler handler, const char *help);
+  void poll();                     // Read pending input and run complete lines
+  
+private:
+  struct Command {
+    const char *name;
+    ConsoleHandler handler;
+    const char *help;
+  };
+  
+  Command commands[CONSOLE_MAX_COMMANDS];
+  int commandCount;
+  char line[CONSOLE_LINE_LENGTH];
+  size_t lineLength;
+  
+  void dispatch();                 // Run the command in line[]
+  void printHelp();
+};
+
+extern SerialConsole serialConsole;
+
+#endif // SERIAL_CONSOLE_H
@@ -0,0 +1,71 @@
+/**
+ * SlidingExtremum Class
+ * Minimum (or maximum) of the last Window values with a monotonic deque:
+ * each value is pushed and popped at most once, so updates are O(1)
+ * amortized and the current extremum is always at the front. Storage for
+ * Window entries is embedded in the object.
+ */
+
+#ifndef SLIDING_EXTREMUM_H
+#define SLIDING_EXTREMUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <size_t Window, bool Maximum = false, typename T = float>
+class SlidingExtremum {
+  static_assert(Window >= 1, "SlidingExtremum needs a window of at least one value");
+  
+public:
+  SlidingExtremum() { clear(); }
+  
+  void clear() {
+    head = 0;
+    count = 0;
+    pushed = 0;
+  }
+  
+  // Adds a value; the value pushed Window pushes ago leaves the window
+  void push(T value) {
+    // Indices are distinct, so at most the front entry can expire
+    if (count > 0 && pushed - entries[head].index >= Window) {
+      head = wrap(head + 1);
+      count--;
+    }
+    
+    // Entries the new value dominates can never be the extremum again
+    while (count > 0 && !keeps(entries[wrap(head + count - 1)].value, value)) {
+      count--;
+    }
+    
+    Entry &entry = entries[wrap(head + count)];
+    entry.value = value;
+    entry.index = pushed++;
+    count++;
+  }
+  
+  T value() const { return entries[head].value; } // Undefined while empty
+  bool empty() const { return count == 0; }
+  bool full() const { return pushed >= Window; }  // The window holds Window values
+  uint32_t getPushed() const { return pushed; }
+  size_t getDequeSize() const { return count; }
+  static size_t window() { return Window; }
+  
+private:
+  struct Entry {
+    T value;
+    uint32_t index;
+  };
+  
+  Entry entries[Window];
+  size_t head;
+  size_t count;
+  uint32_t pushed;
+  
+  static size_t wrap(size_t i) { return i >= Window ? i - Window : i; }
+  
+  // True if an older entry stays ahead of a newer value
+  static bool keeps(T older, T newer) { return Maximum ? older > newer : older < newer; }
+};
+
+#endif // SLIDING_EXTREMUM_H
@@ -0,0 +1,57 @@
+/**
+ * Snapshot Class
+ * Double-buffered value published by one writer task and read by any
+ * number of reader tasks without locking. The writer always fills the
+ * buffer readers are not pointed at, inside a sequence lock: the sequence
+ * is odd while a write is in progress, so a reader that was lapped mid-copy
+ * sees it and copies again.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T>
+class Snapshot {
+public:
+  Snapshot() : sequence(0) {}
+
+  // Writer side: only one task may publish
+  void publish(const T &value) {
+    uint32_t s = sequence.load(std::memory_order_relaxed);
+    sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    buffers[((s >> 1) + 1) & 1] = value;
+    sequence.store(s + 2, std::memory_order_release);
+  }
+
+  // Reader side: returns false if nothing has been published yet
+  bool read(T &out) const {
+    for (;;) {
+      // Published count and the buffer holding the latest; an odd sequence
+      // means a write to the other buffer is under way
+      uint32_t published = sequence.load(std::memory_order_acquire) & ~1UL;
+      if (published == 0) {
+        return false;
+      }
+      out = buffers[(published >> 1) & 1];
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // The buffer just copied is rewritten from the next write but one,
+      // which first moves the sequence to published + 3
+      if (sequence.load(std::memory_order_relaxed) - published <= 2) {
+        return true;
+      }
+    }
+  }
+
+  // Number of publishes so far, lets readers skip unchanged snapshots
+  uint32_t getVersion() const { return sequence.load(std::memory_order_acquire) >> 1; }
+
+private:
+  T buffers[2];
+  std::atomic<uint32_t> sequence; // Twice the publishes so far, plus one while writing
+};
+
+#endif // SNAPSHOT_H
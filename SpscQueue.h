@@ -0,0 +1,59 @@
+/**
+ * SpscQueue Class
+ * Lock-free single-producer/single-consumer ring buffer for passing
+ * readings between FreeRTOS tasks without taking a mutex
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0), dropped(0) {}
+
+  // Producer side: returns false (and counts a drop) when the queue is full
+  bool push(const T &item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h & (Capacity - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: returns false when the queue is empty
+  bool pop(T &item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[t & (Capacity - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  bool empty() const { return size() == 0; }
+  uint32_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+  T items[Capacity];
+  std::atomic<size_t> head;      // Next slot to write (producer owned)
+  std::atomic<size_t> tail;      // Next slot to read (consumer owned)
+  std::atomic<uint32_t> dropped; // Items rejected because the queue was full
+};
+
+#endif // SPSC_QUEUE_H
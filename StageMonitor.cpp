@@ -0,0 +1,111 @@
+/**
+ * StageMonitor implementation
+ */
+
+#include "StageMonitor.h"
+
+StageMonitor stageMonitor;
+
+// Default stall budgets; a stage running longer than this is logged
+static const uint32_t DEFAULT_BUDGETS_US[STAGE_COUNT] = {
+  50000,     // power update: 100 samples should take ~25 ms
+  20000,     // ai update
+  2000000,   // send data: one HTTP POST
+  5000000,   // send buffered: several POSTs with pacing delays
+  200000,    // network upkeep (NTP sync and reconnects block)
+  50000,     // display
+};
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+  "power_update",
+  "ai_update",
+  "send_data",
+  "send_buffered",
+  "network_update",
+  "display",
+};
+
+StageMonitor::StageMonitor() {
+  stallMux = portMUX_INITIALIZER_UNLOCKED;
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    budgetsUs[i] = DEFAULT_BUDGETS_US[i];
+  }
+  reset();
+}
+
+void StageMonitor::record(Stage stage, uint32_t durationUs) {
+  // Each stage is timed from a single task, so histograms need no lock
+  histograms[stage].record(durationUs);
+  
+  if (durationUs <= budgetsUs[stage]) {
+    return;
+  }
+  
+  portENTER_CRITICAL(&stallMux);
+  StallRecord &entry = stallLog[stallTotal % STALL_LOG_SIZE];
+  entry.stage = stage;
+  entry.durationUs = durationUs;
+  entry.uptimeMs = millis();
+  stallTotal++;
+  stallCounts[stage]++;
+  portEXIT_CRITICAL(&stallMux);
+}
+
+void StageMonitor::setBudget(Stage stage, uint32_t budgetUs) {
+  budgetsUs[stage] = budgetUs;
+}
+
+void StageMonitor::reset() {
+  portENTER_CRITICAL(&stallMux);
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    histograms[i].reset();
+    stallCounts[i] = 0;
+  }
+  stallTotal = 0;
+  portEXIT_CRITICAL(&stallMux);
+}
+
+void StageMonitor::printReport() {
+  Serial.println("Stage latency (us):       count      p50      p90      p99      max   stalls");
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    const LatencyHistogram &h = histograms[i];
+    Serial.printf("  %-18s %10u %8u %8u %8u %8u %8u\n", STAGE_NAMES[i],
+                  (unsigned)h.getCount(), (unsigned)h.percentile(50), (unsigned)h.percentile(90),
+                  (unsigned)h.percentile(99), (unsigned)h.getMax(), (unsigned)stallCounts[i]);
+  }
+  
+  uint32_t total = stallTotal;
+  uint32_t shown = total < STALL_LOG_SIZE ? total : STALL_LOG_SIZE;
+  Serial.printf("Recent stalls (%u total):\n", (unsigned)total);
+  for (uint32_t n = 0; n < shown; n++) {
+    const StallRecord &entry = stallLog[(total - 1 - n) % STALL_LOG_SIZE];
+    Serial.printf("  t=%10u ms  %-18s %8u us (budget %u us)\n", (unsigned)entry.uptimeMs,
+                  STAGE_NAMES[entry.stage], (unsigned)entry.durationUs,
+                  (unsigned)budgetsUs[entry.stage]);
+  }
+}
+
+void StageMonitor::addTelemetry(JsonObject &out) {
+  for (int i = 0; i < STAGE_COUNT; i++) {
+    const LatencyHistogram &h = histograms[i];
+    JsonObject stage = out.createNestedObject(STAGE_NAMES[i]);
+    stage["n"] = h.getCount();
+    stage["p50_us"] = h.percentile(50);
+    stage["p99_us"] = h.percentile(99);
+    stage["max_us"] = h.getMax();
+    stage["stalls"] = stallCounts[i];
+  }
+  
+  uint32_t total = stallTotal;
+  if (total > 0) {
+    const StallRecord &last = stallLog[(total - 1) % STALL_LOG_SIZE];
+    JsonObject stall = out.createNestedObject("last_stall");
+    stall["stage"] = STAGE_NAMES[last.stage];
+    stall["duration_us"] = last.durationUs;
+    stall["uptime_ms"] = last.uptimeMs;
+  }
+}
+
+const char *StageMonitor::stageName(int stage) {
+  return stage >= 0 && stage < STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
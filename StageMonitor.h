@@ -0,0 +1,71 @@
+/**
+ * StageMonitor Class
+ * Records the execution time of each major processing stage into a
+ * latency histogram and keeps a log of stages that overran their budget
+ */
+
+#ifndef STAGE_MONITOR_H
+#define STAGE_MONITOR_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "LatencyHistogram.h"
+
+#ifndef STALL_LOG_SIZE
+#define STALL_LOG_SIZE 8           // Most recent stalls kept for inspection
+#endif
+
+enum Stage {
+  STAGE_POWER_UPDATE,              // PowerMonitor::update
+  STAGE_AI_UPDATE,                 // AiProcessor::processBatch, one batch per sample
+  STAGE_SEND_DATA,                 // DataManager::sendData
+  STAGE_SEND_BUFFERED,             // DataManager::sendBufferedData
+  STAGE_NETWORK_UPDATE,            // NetworkManager upkeep (Wi-Fi, NTP, OTA, portal)
+  STAGE_DISPLAY,                   // Serial reading log / TFT displayData
+  STAGE_COUNT
+};
+
+struct StallRecord {
+  uint8_t stage;                   // Stage that overran
+  uint32_t durationUs;             // How long it actually took
+  uint32_t uptimeMs;               // When it finished
+};
+
+class StageMonitor {
+public:
+  StageMonitor();
+  
+  void record(Stage stage, uint32_t durationUs); // Add a measurement, flag stalls
+  void setBudget(Stage stage, uint32_t budgetUs); // Override a stage's stall budget
+  void reset();                                  // Clear histograms and stall log
+  
+  void printReport();                            // Print histograms and stalls to serial
+  void addTelemetry(JsonObject &out);            // Add a summary to a telemetry payload
+  static const char *stageName(int stage);
+  
+  // Times a stage for the lifetime of the scope
+  class Timer {
+  public:
+    Timer(StageMonitor &monitor, Stage stage)
+      : owner(monitor), timedStage(stage), start(esp_timer_get_time()) {}
+    ~Timer() { owner.record(timedStage, (uint32_t)(esp_timer_get_time() - start)); }
+  private:
+    StageMonitor &owner;
+    Stage timedStage;
+    int64_t start;
+  };
+  
+private:
+  LatencyHistogram histograms[STAGE_COUNT];
+  uint32_t budgetsUs[STAGE_COUNT];
+  uint32_t stallCounts[STAGE_COUNT];
+  
+  portMUX_TYPE stallMux;                         // Stages are recorded from several tasks
+  StallRecord stallLog[STALL_LOG_SIZE];
+  uint32_t stallTotal;                           // Stalls ever recorded (log index = total % size)
+};
+
+extern StageMonitor stageMonitor;
+
+#endif // STAGE_MONITOR_H
@@ -0,0 +1,330 @@
+/**
+ * StateClusterer implementation
+ */
+
+#include "StateClusterer.h"
+#include <math.h>
+#include <string.h>
+
+StateClusterer::StateClusterer() {
+  rejectSigma = OPSTATE_REJECT_SIGMA;
+  reset();
+}
+
+void StateClusterer::reset() {
+  memset(&learned, 0, sizeof(learned));
+  learned.magic = OPSTATE_STATE_MAGIC;
+  learned.version = OPSTATE_STATE_VERSION;
+  learned.clusterCount = OPSTATE_CLUSTERS;
+  learned.featureCount = OPSTATE_FEATURES;
+  clearBatch();
+  runLength = 0;
+  unknownStreak = 0;
+  current = -1;
+  lastKnown = -1;
+  candidate = -1;
+  candidateRun = 0;
+}
+
+void StateClusterer::clearBatch() {
+  memset(batchSum, 0, sizeof(batchSum));
+  memset(batchSquares, 0, sizeof(batchSquares));
+  memset(batchCount, 0, sizeof(batchCount));
+  batchReadings = 0;
+}
+
+float StateClusterer::powerOf(const Cluster &cluster) {
+  return OPSTATE_POWER_SCALE_W * (expf(cluster.center[0]) - 1.0f);
+}
+
+float StateClusterer::peakRatioOf(const Cluster &cluster) {
+  float power = powerOf(cluster);
+  if (power <= 0.0f) {
+    return 1.0f;
+  }
+  return OPSTATE_POWER_SCALE_W * (expf(cluster.center[0] + cluster.center[1]) - 1.0f) / power;
+}
+
+uint8_t StateClusterer::getActiveCount() const {
+  uint8_t count = 0;
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    count += learned.clusters[i].weight > 0.0f;
+  }
+  return count;
+}
+
+float StateClusterer::scaledDistanceSq(const float *a, const float *b, const float *variance) {
+  const float floor = OPSTATE_MIN_SPREAD * OPSTATE_MIN_SPREAD;
+  float d = 0.0f;
+  for (int f = 0; f < OPSTATE_FEATURES; f++) {
+    float diff = a[f] - b[f];
+    d += diff * diff / (variance[f] > floor ? variance[f] : floor);
+  }
+  return d;
+}
+
+int StateClusterer::nearest(const float *features, float &distanceSq) const {
+  int best = -1;
+  distanceSq = 0.0f;
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    const Cluster &cluster = learned.clusters[i];
+    if (cluster.weight <= 0.0f) {
+      continue;
+    }
+    float d = scaledDistanceSq(features, cluster.center, cluster.spread);
+    if (best < 0 || d < distanceSq) {
+      best = i;
+      distanceSq = d;
+    }
+  }
+  return best;
+}
+
+void StateClusterer::update(float power, float peak, float seconds, StateReading &out) {
+  // Log power and the log of peak over mean, both offset so 0 W is finite
+  float mean = power > 0.0f ? power : 0.0f;
+  float top = peak > mean ? peak : mean;
+  float features[OPSTATE_FEATURES];
+  features[0] = logf(1.0f + mean / OPSTATE_POWER_SCALE_W);
+  features[1] = logf(1.0f + top / OPSTATE_POWER_SCALE_W) - features[0];
+  float kwh = mean * seconds / 3600000.0f;
+  learned.readings++;
+  
+  float distanceSq;
+  int k = nearest(features, distanceSq);
+  out.state = -1;
+  out.nearest = k;
+  out.novel = false;
+  out.created = false;
+  out.score = sqrtf(distanceSq);
+  
+  if (k >= 0 && out.score <= rejectSigma) {
+    // Centres only move when the mini-batch closes
+    Cluster &cluster = learned.clusters[k];
+    for (int f = 0; f < OPSTATE_FEATURES; f++) {
+      float diff = features[f] - cluster.center[f];
+      batchSum[k][f] += features[f];
+      batchSquares[k][f] += diff * diff;
+    }
+    batchCount[k]++;
+    
+    cluster.lastSeen = learned.readings;
+    cluster.readings++;
+    cluster.seconds += seconds;
+    cluster.energyKwh += kwh;
+    runLength = 0;
+    unknownStreak = 0;
+    out.state = k;
+  } else {
+    learned.unknownReadings++;
+    learned.unknownKwh += kwh;
+    
+    // Single readings straddling a transition are not worth reporting
+    if (unknownStreak < 0xFFFF) {
+      unknownStreak++;
+    }
+    out.novel = k >= 0 && unknownStreak == OPSTATE_DWELL_READINGS;
+    
+    // A run founds a state only while its readings agree with each other
+    float runMean[OPSTATE_FEATURES];
+    float runVariance[OPSTATE_FEATURES];
+    if (runLength > 0) {
+      for (int f = 0; f < OPSTATE_FEATURES; f++) {
+        runMean[f] = runSum[f] / runLength;
+        runVariance[f] = runSquares[f] / runLength - runMean[f] * runMean[f];
+      }
+      if (scaledDistanceSq(features, runMean, runVariance) > rejectSigma * rejectSigma) {
+        runLength = 0;
+      }
+    }
+    if (runLength == 0) {
+      memset(runSum, 0, sizeof(runSum));
+      memset(runSquares, 0, sizeof(runSquares));
+    }
+    for (int f = 0; f < OPSTATE_FEATURES; f++) {
+      runSum[f] += features[f];
+      runSquares[f] += features[f] * features[f];
+    }
+    runLength++;
+    
+    int slot = runLength >= OPSTATE_NEW_READINGS ? slotForNewState() : -1;
+    if (slot >= 0) {
+      clearSlot(slot);
+      Cluster &cluster = learned.clusters[slot];
+      for (int f = 0; f < OPSTATE_FEATURES; f++) {
+        cluster.center[f] = runSum[f] / runLength;
+        float variance = runSquares[f] / runLength - cluster.center[f] * cluster.center[f];
+        cluster.spread[f] = variance > 0.0f ? variance : 0.0f;
+      }
+      cluster.weight = runLength;
+      cluster.lastSeen = learned.readings;
+      runLength = 0;
+      unknownStreak = 0;
+      out.state = slot;
+      out.created = true;
+    }
+  }
+  
+  if (++batchReadings >= OPSTATE_BATCH_SIZE) {
+    applyBatch();
+    mergeClose();
+    clearBatch();
+  }
+  track(out.state);
+}
+
+void StateClusterer::applyBatch() {
+  // Per-centre learning rate of batch size over readings remembered, so a
+  // young centre settles quickly and an old one keeps tracking slowly
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    Cluster &cluster = learned.clusters[i];
+    if (batchCount[i] == 0 || cluster.weight <= 0.0f) {
+      continue;
+    }
+    float n = batchCount[i];
+    cluster.weight = cluster.weight + n < OPSTATE_MEMORY ? cluster.weight + n : OPSTATE_MEMORY;
+    float eta = n / cluster.weight;
+    for (int f = 0; f < OPSTATE_FEATURES; f++) {
+      cluster.center[f] += eta * (batchSum[i][f] / n - cluster.center[f]);
+      cluster.spread[f] += eta * (batchSquares[i][f] / n - cluster.spread[f]);
+    }
+  }
+}
+
+void StateClusterer::mergeClose() {
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    for (int j = i + 1; j < OPSTATE_CLUSTERS; j++) {
+      const Cluster &a = learned.clusters[i];
+      const Cluster &b = learned.clusters[j];
+      if (a.weight <= 0.0f || b.weight <= 0.0f) {
+        continue;
+      }
+      
+      // Within one spread of each other, in the wider of the two per feature
+      float spread[OPSTATE_FEATURES];
+      for (int f = 0; f < OPSTATE_FEATURES; f++) {
+        spread[f] = a.spread[f] > b.spread[f] ? a.spread[f] : b.spread[f];
+      }
+      if (scaledDistanceSq(a.center, b.center, spread) <= 1.0f) {
+        if (a.weight >= b.weight) {
+          merge(i, j);
+        } else {
+          merge(j, i);
+        }
+      }
+    }
+  }
+}
+
+void StateClusterer::merge(int into, int from) {
+  Cluster &a = learned.clusters[into];
+  const Cluster &b = learned.clusters[from];
+  float total = a.weight + b.weight;
+  float wa = a.weight / total;
+  float wb = b.weight / total;
+  for (int f = 0; f < OPSTATE_FEATURES; f++) {
+    float diff = a.center[f] - b.center[f];
+    a.center[f] = wa * a.center[f] + wb * b.center[f];
+    a.spread[f] = wa * a.spread[f] + wb * b.spread[f] + wa * wb * diff * diff;
+  }
+  a.weight = total < OPSTATE_MEMORY ? total : OPSTATE_MEMORY;
+  a.lastSeen = a.lastSeen > b.lastSeen ? a.lastSeen : b.lastSeen;
+  a.readings += b.readings;
+  a.seconds += b.seconds;
+  a.energyKwh += b.energyKwh;
+  
+  // Transitions between the two become moves within one state
+  for (int k = 0; k < OPSTATE_CLUSTERS; k++) {
+    learned.transitions[into][k] += learned.transitions[from][k];
+    learned.transitions[k][into] += learned.transitions[k][from];
+  }
+  learned.transitions[into][into] = 0;
+  current = current == from ? into : current;
+  lastKnown = lastKnown == from ? into : lastKnown;
+  candidate = candidate == from ? into : candidate;
+  clearSlot(from);
+}
+
+int StateClusterer::slotForNewState() const {
+  // A free slot, else the state unseen for longest if it has been gone long enough
+  int stale = -1;
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    const Cluster &cluster = learned.clusters[i];
+    if (cluster.weight <= 0.0f) {
+      return i;
+    }
+    if (learned.readings - cluster.lastSeen >= OPSTATE_FORGET_READINGS &&
+        (stale < 0 || cluster.lastSeen < learned.clusters[stale].lastSeen)) {
+      stale = i;
+    }
+  }
+  return stale;
+}
+
+void StateClusterer::clearSlot(int slot) {
+  memset(&learned.clusters[slot], 0, sizeof(Cluster));
+  for (int k = 0; k < OPSTATE_CLUSTERS; k++) {
+    learned.transitions[slot][k] = 0;
+    learned.transitions[k][slot] = 0;
+  }
+  memset(batchSum[slot], 0, sizeof(batchSum[slot]));
+  memset(batchSquares[slot], 0, sizeof(batchSquares[slot]));
+  batchCount[slot] = 0;
+  current = current == slot ? -1 : current;
+  lastKnown = lastKnown == slot ? -1 : lastKnown;
+  candidate = candidate == slot ? -1 : candidate;
+}
+
+void StateClusterer::track(int state) {
+  // A state is confirmed once it holds for OPSTATE_DWELL_READINGS readings,
+  // so a reading near a boundary does not count as two transitions
+  if (state == current) {
+    candidateRun = 0;
+    return;
+  }
+  if (state != candidate) {
+    candidate = state;
+    candidateRun = 0;
+  }
+  if (++candidateRun < OPSTATE_DWELL_READINGS) {
+    return;
+  }
+  
+  if (state >= 0) {
+    if (lastKnown >= 0 && lastKnown != state) {
+      learned.transitions[lastKnown][state]++;
+    }
+    lastKnown = state;
+  }
+  current = state;
+  candidateRun = 0;
+}
+
+bool StateClusterer::setState(const State &saved) {
+  if (saved.magic != OPSTATE_STATE_MAGIC || saved.version != OPSTATE_STATE_VERSION ||
+      saved.clusterCount != OPSTATE_CLUSTERS || saved.featureCount != OPSTATE_FEATURES) {
+    return false;
+  }
+  
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    const Cluster &c = saved.clusters[i];
+    if (!(c.weight >= 0.0f && c.weight <= OPSTATE_MEMORY)) {
+      return false;
+    }
+    for (int f = 0; f < OPSTATE_FEATURES; f++) {
+      if (!isfinite(c.center[f]) || !isfinite(c.spread[f]) || c.spread[f] < 0.0f) {
+        return false;
+      }
+    }
+  }
+  
+  learned = saved;
+  clearBatch();
+  runLength = 0;
+  unknownStreak = 0;
+  current = -1;
+  lastKnown = -1;
+  candidate = -1;
+  candidateRun = 0;
+  return true;
+}
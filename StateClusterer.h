@@ -0,0 +1,140 @@
+/**
+ * StateClusterer Class
+ * Learns the discrete operating states of the monitored load (idle,
+ * running, heavy load, ...) from unlabelled readings with streaming
+ * mini-batch k-means in fixed memory. Each reading becomes a feature
+ * vector of log power and its within-period peak over mean (how bursty the
+ * load is), so states are told apart by relative rather than absolute
+ * watts. Distances are scaled by each state's own per-feature spread
+ * (a diagonal Gaussian), so a bursty state is allowed a wide peak range.
+ * A reading more than OPSTATE_REJECT_SIGMA from every state fits no known
+ * state; a run of such readings that agree with each other founds a new
+ * state, in a free slot or in place of one unseen for
+ * OPSTATE_FORGET_READINGS. Centres that drift together are merged. Time,
+ * energy and transitions are tracked per state.
+ */
+
+#ifndef STATE_CLUSTERER_H
+#define STATE_CLUSTERER_H
+
+#include <stdint.h>
+
+#ifndef OPSTATE_CLUSTERS
+#define OPSTATE_CLUSTERS 4         // Operating states learned at most
+#endif
+#ifndef OPSTATE_BATCH_SIZE
+#define OPSTATE_BATCH_SIZE 12      // Readings per mini-batch update (1 minute of 5 s readings)
+#endif
+#ifndef OPSTATE_MEMORY
+#define OPSTATE_MEMORY 720         // Readings a centre remembers; bounds how slowly it adapts
+#endif
+#ifndef OPSTATE_FORGET_READINGS
+#define OPSTATE_FORGET_READINGS 17280 // Readings unseen before a state's slot may be reused (1 day of 5 s readings)
+#endif
+#ifndef OPSTATE_NEW_READINGS
+#define OPSTATE_NEW_READINGS 6     // Consecutive agreeing unknown readings that found a state
+#endif
+#ifndef OPSTATE_DWELL_READINGS
+#define OPSTATE_DWELL_READINGS 2   // Readings a state must hold before a transition counts
+#endif
+#ifndef OPSTATE_REJECT_SIGMA
+#define OPSTATE_REJECT_SIGMA 3.0f  // Distance, in the state's spread, beyond which a reading fits no state
+#endif
+#ifndef OPSTATE_MIN_SPREAD
+#define OPSTATE_MIN_SPREAD 0.1f    // Floor on a state's spread in feature units (about 10 % in power)
+#endif
+#ifndef OPSTATE_POWER_SCALE_W
+#define OPSTATE_POWER_SCALE_W 10.0f // Power features are ln(1 + P / scale), so idle loads near 0 W stay finite
+#endif
+
+#define OPSTATE_FEATURES 2
+#define OPSTATE_STATE_MAGIC 0x53504F53UL // "SOPS"
+#define OPSTATE_STATE_VERSION 1
+
+// Where one reading landed
+struct StateReading {
+  int8_t state;                    // State it was assigned to, -1 when none fits
+  int8_t nearest;                  // Nearest state, -1 before any exists
+  bool novel;                      // Readings have fit no state for OPSTATE_DWELL_READINGS in a row
+  bool created;                    // The run founded a new state in slot state
+  float score;                     // Distance to the nearest state in its spreads; 0 before any state exists
+};
+
+class StateClusterer {
+public:
+  struct Cluster {
+    float center[OPSTATE_FEATURES];
+    float spread[OPSTATE_FEATURES]; // Variance of its readings per feature
+    float weight;                  // Readings remembered, at most OPSTATE_MEMORY; 0 for a free slot
+    uint32_t lastSeen;             // Reading count when it last won a reading
+    uint32_t readings;
+    double seconds;                // Time in this state
+    float energyKwh;               // Energy used in this state
+  };
+  
+  struct State {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t clusterCount;          // OPSTATE_CLUSTERS of the build that saved it
+    uint8_t featureCount;
+    uint32_t readings;
+    uint32_t unknownReadings;      // Readings that fit no state
+    float unknownKwh;
+    Cluster clusters[OPSTATE_CLUSTERS];
+    uint32_t transitions[OPSTATE_CLUSTERS][OPSTATE_CLUSTERS]; // [from][to], between confirmed states
+  };
+  
+  StateClusterer();
+  
+  void reset();
+  void setRejectSigma(float sigma) { rejectSigma = sigma; }
+  
+  // Assigns a reading (mean and peak power over seconds) to a state and
+  // learns from it; centres move once per mini-batch
+  void update(float power, float peak, float seconds, StateReading &out);
+  
+  int getCurrent() const { return current; } // Confirmed state, -1 when unknown
+  uint8_t getActiveCount() const;
+  
+  const State &getState() const { return learned; }
+  bool setState(const State &saved);         // Rejects blobs from another layout or with non-finite values
+  
+  static float powerOf(const Cluster &cluster);     // Centre power (W)
+  static float peakRatioOf(const Cluster &cluster); // Centre peak over mean
+  
+private:
+  State learned;
+  float rejectSigma;
+  
+  // Mini-batch accumulators per cluster
+  float batchSum[OPSTATE_CLUSTERS][OPSTATE_FEATURES];
+  float batchSquares[OPSTATE_CLUSTERS][OPSTATE_FEATURES]; // Squared deviations from the centre
+  uint16_t batchCount[OPSTATE_CLUSTERS];
+  uint16_t batchReadings;
+  
+  // Run of readings that fit no state
+  float runSum[OPSTATE_FEATURES];
+  float runSquares[OPSTATE_FEATURES];
+  uint16_t runLength;
+  uint16_t unknownStreak;          // Consecutive readings that fit no state
+  
+  // Transition debouncing
+  int8_t current;
+  int8_t lastKnown;                // Last confirmed state other than unknown
+  int8_t candidate;
+  uint8_t candidateRun;
+  
+  void clearBatch();
+  int nearest(const float *features, float &distanceSq) const;
+  void applyBatch();
+  void mergeClose();
+  void merge(int into, int from);
+  int slotForNewState() const;
+  void clearSlot(int slot);
+  void track(int state);
+  
+  // Squared distance in units of the given per-feature variances, each floored at OPSTATE_MIN_SPREAD
+  static float scaledDistanceSq(const float *a, const float *b, const float *variance);
+};
+
+#endif // STATE_CLUSTERER_H
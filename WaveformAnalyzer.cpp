@@ -0,0 +1,386 @@
+/**
+ * WaveformAnalyzer implementation
+ */
+
+#include "WaveformAnalyzer.h"
+#include <math.h>
+#include <string.h>
+
+// Harmonic number of each WaveformHarmonic
+static const uint8_t harmonicOrder[HARMONIC_COUNT] = { 1, 2, 3, 5, 7 };
+
+WaveformAnalyzer::WaveformAnalyzer() {
+  mainsHz = WAVEFORM_MAINS_HZ;
+  coefficientUs = 0;
+  coefficientCount = 0;
+  memset(coefficient, 0, sizeof(coefficient));
+  reset();
+}
+
+void WaveformAnalyzer::reset() {
+  memset(&last, 0, sizeof(last));
+  clearSegment();
+  recentCount = 0;
+  phase = PHASE_STEADY;
+  memset(&reference, 0, sizeof(reference));
+  hasReference = false;
+  before = 0.0f;
+  step = 0.0f;
+  changeMs = 0;
+  peakExcursion = 0.0f;
+  peakMs = 0;
+  runStartMs = 0;
+  runLength = 0;
+  runMean = 0.0f;
+  settleMs = 0;
+  transitions = 0;
+  incomplete = 0;
+}
+
+void WaveformAnalyzer::setMainsFrequency(float hz) {
+  if (hz > 0.0f) {
+    mainsHz = hz;
+    coefficientUs = 0;
+  }
+}
+
+void WaveformAnalyzer::updateCoefficients(size_t count, uint32_t durationUs) {
+  // The sample rate comes from the measured capture time, so ADC and
+  // scheduling overhead between samples do not detune the filters
+  float sampleRate = count * 1e6f / durationUs;
+  for (int h = 0; h < HARMONIC_COUNT; h++) {
+    float w = 2.0f * (float)M_PI * harmonicOrder[h] * mainsHz / sampleRate;
+    coefficient[h] = (int32_t)lroundf(2.0f * cosf(w) * 16384.0f);
+  }
+  coefficientUs = durationUs;
+  coefficientCount = count;
+}
+
+bool WaveformAnalyzer::analyze(const int16_t *samples, size_t count, uint32_t durationUs, CaptureFeatures &out) {
+  memset(&out, 0, sizeof(out));
+  if (samples == NULL || count == 0 || durationUs == 0) {
+    return false;
+  }
+  
+  uint32_t drift = durationUs > coefficientUs ? durationUs - coefficientUs : coefficientUs - durationUs;
+  if (count != coefficientCount || drift > coefficientUs / 64) {
+    updateCoefficients(count, durationUs);
+  }
+  
+  // The CT bias is never exactly mid-scale, so remove the capture's own offset
+  int32_t sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += samples[i];
+  }
+  int32_t offset = sum / (int32_t)count;
+  
+  uint64_t sumSquares = 0;
+  uint32_t sumAbs = 0;
+  int32_t peak = 0;
+  int64_t s1[HARMONIC_COUNT] = { 0 };
+  int64_t s2[HARMONIC_COUNT] = { 0 };
+  for (size_t i = 0; i < count; i++) {
+    int32_t x = samples[i] - offset;
+    int32_t magnitude = x < 0 ? -x : x;
+    sumSquares += (uint64_t)((int64_t)x * x);
+    sumAbs += magnitude;
+    if (magnitude > peak) {
+      peak = magnitude;
+    }
+    
+    // Goertzel: s[n] = x[n] + 2cos(w) s[n-1] - s[n-2], coefficients in Q14
+    for (int h = 0; h < HARMONIC_COUNT; h++) {
+      int64_t s = x + ((coefficient[h] * s1[h]) >> 14) - s2[h];
+      s2[h] = s1[h];
+      s1[h] = s;
+    }
+  }
+  
+  // Everything below is Q4 ADC counts so small harmonics keep a few bits
+  out.rms = (int32_t)isqrt(sumSquares * 256 / count);
+  out.peak = peak * 16;
+  int32_t meanAbs = (int32_t)((uint64_t)sumAbs * 16 / count);
+  out.crest = ratio(out.peak, out.rms);
+  out.form = ratio(out.rms, meanAbs);
+  
+  for (int h = 0; h < HARMONIC_COUNT; h++) {
+    // |X|^2 = s1^2 + s2^2 - 2cos(w) s1 s2; the amplitude is 2|X| / N
+    int64_t energy = s1[h] * s1[h] + s2[h] * s2[h] - ((coefficient[h] * s1[h]) >> 14) * s2[h];
+    out.harmonic[h] = energy > 0 ? (int32_t)(isqrt((uint64_t)energy) * 32 / count) : 0;
+  }
+  return true;
+}
+
+bool WaveformAnalyzer::add(const int16_t *samples, size_t count, uint32_t durationUs, float power,
+                           uint32_t timestampMs, WaveformVector &out) {
+  if (!analyze(samples, count, durationUs, last)) {
+    return false;
+  }
+  
+  recentPower[recentCount & (WAVEFORM_HISTORY - 1)] = power;
+  recentMs[recentCount & (WAVEFORM_HISTORY - 1)] = timestampMs;
+  recentCount++;
+  
+  switch (phase) {
+    case PHASE_SETTLING:
+      trackPeak(power, timestampMs);
+      if (settle(power, timestampMs)) {
+        phase = PHASE_COLLECTING;
+      } else if (timestampMs - changeMs > WAVEFORM_SETTLE_TIMEOUT_MS) {
+        // A load that keeps ramping is described by the level it reached
+        settleMs = WAVEFORM_SETTLE_TIMEOUT_MS;
+        phase = PHASE_COLLECTING;
+      }
+      return false;
+    
+    case PHASE_COLLECTING:
+      accumulate(power);
+      if (segmentCount < WAVEFORM_MIN_SEGMENT) {
+        return false;
+      }
+      phase = PHASE_STEADY;
+      if (!hasReference) {
+        incomplete++;
+        return false;
+      }
+      transitions++;
+      fillTransition(segmentLevel(), timestampMs, out);
+      return true;
+    
+    case PHASE_STEADY:
+      accumulate(power);
+      if (segmentCount < WAVEFORM_SEGMENT_MAX) {
+        return false;
+      }
+      
+      // Cut long segments so a load running for hours is still described,
+      // and keep the level as the reference for the next change
+      reference = segmentLevel();
+      hasReference = true;
+      fillSteady(reference, timestampMs, out);
+      clearSegment();
+      return true;
+  }
+  return false;
+}
+
+bool WaveformAnalyzer::onChange(const ChangeEvent &event, WaveformVector &out) {
+  // The closing segment also holds the few captures between the change
+  // point and its detection; they are outweighed by the rest
+  bool emitted = false;
+  if (segmentCount >= WAVEFORM_MIN_SEGMENT) {
+    reference = segmentLevel();
+    hasReference = true;
+    fillSteady(reference, event.timestampMs, out);
+    emitted = true;
+  } else if (phase != PHASE_STEADY) {
+    // Two changes in quick succession: the level between them is unknown
+    hasReference = false;
+  }
+  if (phase != PHASE_STEADY) {
+    incomplete++;
+  }
+  
+  before = event.before;
+  step = event.magnitude;
+  changeMs = event.timestampMs - event.delayMs;
+  peakExcursion = 0.0f;
+  peakMs = changeMs;
+  runLength = 0;
+  settleMs = 0;
+  clearSegment();
+  
+  // Replay the measurements since the change point; the transient may have
+  // peaked, or even settled, before the detector was sure of the change
+  phase = PHASE_SETTLING;
+  uint32_t available = recentCount < WAVEFORM_HISTORY ? recentCount : WAVEFORM_HISTORY;
+  for (uint32_t i = available; i > 0; i--) {
+    uint32_t index = (recentCount - i) & (WAVEFORM_HISTORY - 1);
+    if ((int32_t)(recentMs[index] - changeMs) < 0) {
+      continue;
+    }
+    trackPeak(recentPower[index], recentMs[index]);
+    if (settle(recentPower[index], recentMs[index])) {
+      phase = PHASE_COLLECTING;
+      break;
+    }
+  }
+  return emitted;
+}
+
+void WaveformAnalyzer::clearSegment() {
+  segmentCount = 0;
+  powerSum = 0.0;
+  crestSum = 0;
+  formSum = 0;
+  memset(harmonicSum, 0, sizeof(harmonicSum));
+}
+
+void WaveformAnalyzer::accumulate(float power) {
+  segmentCount++;
+  powerSum += power;
+  crestSum += last.crest;
+  formSum += last.form;
+  for (int h = 0; h < HARMONIC_COUNT; h++) {
+    harmonicSum[h] += last.harmonic[h];
+  }
+}
+
+WaveformAnalyzer::Level WaveformAnalyzer::segmentLevel() const {
+  Level level;
+  memset(&level, 0, sizeof(level));
+  if (segmentCount == 0) {
+    return level;
+  }
+  
+  level.count = segmentCount;
+  level.power = (float)(powerSum / segmentCount);
+  level.crest = (int32_t)(crestSum / segmentCount);
+  level.form = (int32_t)(formSum / segmentCount);
+  for (int h = 0; h < HARMONIC_COUNT; h++) {
+    level.harmonic[h] = (int32_t)(harmonicSum[h] / segmentCount);
+  }
+  return level;
+}
+
+void WaveformAnalyzer::trackPeak(float power, uint32_t timestampMs) {
+  float excursion = step >= 0.0f ? power - before : before - power;
+  if (excursion > peakExcursion) {
+    peakExcursion = excursion;
+    peakMs = timestampMs;
+  }
+}
+
+bool WaveformAnalyzer::settle(float power, uint32_t timestampMs) {
+  // Settled once a few measurements in a row agree with each other; the
+  // detector's level is not used because it includes the transient
+  float tolerance = fabsf(step) * WAVEFORM_SETTLE_FRACTION;
+  if (tolerance < WAVEFORM_SETTLE_FLOOR_W) {
+    tolerance = WAVEFORM_SETTLE_FLOOR_W;
+  }
+  
+  if (runLength == 0 || fabsf(power - runMean) > tolerance) {
+    runStartMs = timestampMs;
+    runMean = power;
+    runLength = 1;
+  } else {
+    runLength++;
+    runMean += (power - runMean) / runLength;
+  }
+  
+  if (runLength < WAVEFORM_SETTLE_SAMPLES) {
+    return false;
+  }
+  settleMs = (int32_t)(runStartMs - changeMs) > 0 ? runStartMs - changeMs : 0;
+  return true;
+}
+
+void WaveformAnalyzer::fillSteady(const Level &level, uint32_t timestampMs, WaveformVector &out) const {
+  memset(&out, 0, sizeof(out));
+  out.kind = WAVEFORM_STEADY;
+  out.captures = level.count > 0xFFFF ? 0xFFFF : (uint16_t)level.count;
+  out.timestampMs = timestampMs;
+  out.values[STEADY_POWER] = saturate(lroundf(level.power));
+  out.values[STEADY_CREST] = saturate(level.crest);
+  out.values[STEADY_FORM] = saturate(level.form);
+  
+  // Below the fundamental floor the ratios are only noise and stay zero
+  int32_t fundamental = level.harmonic[HARMONIC_1];
+  if (fundamental < WAVEFORM_MIN_FUNDAMENTAL) {
+    return;
+  }
+  uint64_t distortion = 0;
+  for (int h = HARMONIC_2; h < HARMONIC_COUNT; h++) {
+    out.values[STEADY_H2 + h - HARMONIC_2] = saturate(ratio(level.harmonic[h], fundamental));
+    distortion += (uint64_t)((int64_t)level.harmonic[h] * level.harmonic[h]);
+  }
+  out.values[STEADY_THD] = saturate(ratio(isqrt(distortion), fundamental));
+}
+
+void WaveformAnalyzer::fillTransition(const Level &level, uint32_t timestampMs, WaveformVector &out) const {
+  memset(&out, 0, sizeof(out));
+  out.kind = WAVEFORM_TRANSITION;
+  out.captures = level.count > 0xFFFF ? 0xFFFF : (uint16_t)level.count;
+  out.timestampMs = timestampMs;
+  
+  float stepW = level.power - before;
+  out.values[TRANSITION_STEP] = saturate(lroundf(stepW));
+  if (fabsf(stepW) >= 1.0f) {
+    out.values[TRANSITION_INRUSH] = saturate(lroundf(peakExcursion / fabsf(stepW) * (1 << WAVEFORM_Q)));
+  }
+  out.values[TRANSITION_RISE] = saturate((int32_t)(peakMs - changeMs) / WAVEFORM_TIME_UNIT_MS);
+  out.values[TRANSITION_SETTLE] = saturate(settleMs / WAVEFORM_TIME_UNIT_MS);
+  out.values[TRANSITION_CREST] = saturate(level.crest - reference.crest);
+  
+  // The switched load's own harmonic content, as far as magnitudes allow
+  int32_t fundamental = level.harmonic[HARMONIC_1] - reference.harmonic[HARMONIC_1];
+  if (fundamental < WAVEFORM_MIN_FUNDAMENTAL && fundamental > -WAVEFORM_MIN_FUNDAMENTAL) {
+    return;
+  }
+  out.values[TRANSITION_H3] = saturate(ratio(level.harmonic[HARMONIC_3] - reference.harmonic[HARMONIC_3], fundamental));
+  out.values[TRANSITION_H5] = saturate(ratio(level.harmonic[HARMONIC_5] - reference.harmonic[HARMONIC_5], fundamental));
+  out.values[TRANSITION_H7] = saturate(ratio(level.harmonic[HARMONIC_7] - reference.harmonic[HARMONIC_7], fundamental));
+}
+
+int16_t WaveformAnalyzer::saturate(int64_t value) {
+  return value > 32767 ? 32767 : value < -32768 ? -32768 : (int16_t)value;
+}
+
+int32_t WaveformAnalyzer::ratio(int64_t numerator, int64_t denominator) {
+  if (denominator == 0) {
+    return 0;
+  }
+  int64_t result = numerator * (1 << WAVEFORM_Q) / denominator;
+  return result > INT32_MAX ? INT32_MAX : result < INT32_MIN ? INT32_MIN : (int32_t)result;
+}
+
+uint32_t WaveformAnalyzer::isqrt(uint64_t value) {
+  // Bit-by-bit integer square root
+  uint64_t result = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (value >= result + bit) {
+      value -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)result;
+}
+
+const char *WaveformAnalyzer::kindName(WaveformKind kind) {
+  switch (kind) {
+    case WAVEFORM_STEADY: return "steady";
+    case WAVEFORM_TRANSITION: return "transition";
+    default: break;
+  }
+  return "?";
+}
+
+const char *WaveformAnalyzer::featureName(WaveformKind kind, int index) {
+  static const char *const steady[WAVEFORM_FEATURES] = {
+    "power", "crest", "form", "h2", "h3", "h5", "h7", "thd"
+  };
+  static const char *const transition[WAVEFORM_FEATURES] = {
+    "step", "inrush", "rise_ms", "settle_ms", "h3", "h5", "h7", "crest"
+  };
+  if (index < 0 || index >= WAVEFORM_FEATURES) {
+    return "?";
+  }
+  return kind == WAVEFORM_TRANSITION ? transition[index] : steady[index];
+}
+
+float WaveformAnalyzer::toFloat(WaveformKind kind, int index, int16_t value) {
+  if (index == 0) {
+    return value;                  // Power or step, already in W
+  }
+  if (kind == WAVEFORM_TRANSITION && (index == TRANSITION_RISE || index == TRANSITION_SETTLE)) {
+    return (float)value * WAVEFORM_TIME_UNIT_MS;
+  }
+  return (float)value / (1 << WAVEFORM_Q);
+}
@@ -0,0 +1,214 @@
+/**
+ * WaveformAnalyzer Class
+ * Feature extraction from the raw current capture behind each measurement,
+ * so appliances can be told apart by waveform shape and not only by the
+ * size of their power step. Per capture it computes RMS, peak, crest factor
+ * (peak / RMS), form factor (RMS / mean absolute value) and the 2nd, 3rd,
+ * 5th and 7th harmonic amplitudes with Goertzel filters, all in integer
+ * arithmetic on ADC counts. Captures are averaged over the steady segments
+ * between load changes, and after each change the power is followed until
+ * it settles to measure the turn-on transient. Two fixed-length vectors
+ * come out:
+ *   steady:     power, crest, form, h2, h3, h5, h7 and THD of a segment
+ *   transition: power step, inrush ratio, rise and settle time, and the
+ *               3rd/5th/7th harmonic content and crest change of the step
+ * Values are int16 in fixed scales (see SteadyFeature, TransitionFeature)
+ * so KnnClassifier compares them with integer distances.
+ *
+ * Only the current is sampled: harmonics are of the current and the phase
+ * against the voltage is unknown, so transition harmonics assume the new
+ * load's harmonics add in phase with the existing ones. A capture spans
+ * about one mains cycle, which leaves neighbouring harmonics one bin apart;
+ * raise SAMPLES_PER_CYCLE for sharper ratios. Transients are resolved at the
+ * measurement interval, not the ADC rate.
+ */
+
+#ifndef WAVEFORM_ANALYZER_H
+#define WAVEFORM_ANALYZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ChangeDetector.h"
+
+#ifndef WAVEFORM_MAINS_HZ
+#define WAVEFORM_MAINS_HZ 50.0f    // Fundamental the harmonics are measured against
+#endif
+#ifndef WAVEFORM_MIN_SEGMENT
+#define WAVEFORM_MIN_SEGMENT 10    // Captures a steady segment needs before it yields a vector
+#endif
+#ifndef WAVEFORM_SEGMENT_MAX
+#define WAVEFORM_SEGMENT_MAX 1500  // Long segments yield a vector every this many captures
+#endif
+#ifndef WAVEFORM_SETTLE_SAMPLES
+#define WAVEFORM_SETTLE_SAMPLES 3  // Consecutive measurements within tolerance that end a transient
+#endif
+#ifndef WAVEFORM_SETTLE_FRACTION
+#define WAVEFORM_SETTLE_FRACTION 0.05f // Settle tolerance as a fraction of the step
+#endif
+#ifndef WAVEFORM_SETTLE_FLOOR_W
+#define WAVEFORM_SETTLE_FLOOR_W 10.0f // Lower bound on the settle tolerance (W)
+#endif
+#ifndef WAVEFORM_SETTLE_TIMEOUT_MS
+#define WAVEFORM_SETTLE_TIMEOUT_MS 60000 // Transients still moving after this are measured as they are
+#endif
+#ifndef WAVEFORM_HISTORY
+#define WAVEFORM_HISTORY 16        // Recent measurements kept to find a peak before the change was detected (power of two)
+#endif
+#ifndef WAVEFORM_MIN_FUNDAMENTAL
+#define WAVEFORM_MIN_FUNDAMENTAL 32 // Fundamental (ADC counts, Q4) below which ratios are not computed
+#endif
+
+#define WAVEFORM_FEATURES 8
+#define WAVEFORM_Q 10              // Ratios are Q10: 1024 is 1.0
+#define WAVEFORM_TIME_UNIT_MS 10   // Rise and settle times count 10 ms units
+
+enum WaveformKind {
+  WAVEFORM_STEADY = 0,
+  WAVEFORM_TRANSITION = 1,
+  WAVEFORM_KIND_COUNT
+};
+
+enum SteadyFeature {
+  STEADY_POWER,                    // W
+  STEADY_CREST,                    // Q10
+  STEADY_FORM,                     // Q10
+  STEADY_H2,                       // Amplitude over the fundamental, Q10
+  STEADY_H3,
+  STEADY_H5,
+  STEADY_H7,
+  STEADY_THD                       // Over the harmonics measured, Q10
+};
+
+enum TransitionFeature {
+  TRANSITION_STEP,                 // Settled power minus the level before (W)
+  TRANSITION_INRUSH,               // Peak excursion over the step, Q10
+  TRANSITION_RISE,                 // Change point to peak (10 ms units)
+  TRANSITION_SETTLE,               // Change point to the settled level (10 ms units)
+  TRANSITION_H3,                   // Harmonic change over fundamental change, Q10
+  TRANSITION_H5,
+  TRANSITION_H7,
+  TRANSITION_CREST                 // Crest factor change, Q10
+};
+
+// Harmonics measured per capture; index 0 is the fundamental
+enum WaveformHarmonic {
+  HARMONIC_1,
+  HARMONIC_2,
+  HARMONIC_3,
+  HARMONIC_5,
+  HARMONIC_7,
+  HARMONIC_COUNT
+};
+
+struct WaveformVector {
+  uint8_t kind;                    // WaveformKind
+  uint8_t reserved;
+  uint16_t captures;               // Captures averaged into the (settled) level
+  uint32_t timestampMs;
+  int16_t values[WAVEFORM_FEATURES];
+};
+
+// Shape of one capture
+struct CaptureFeatures {
+  int32_t rms;                     // ADC counts, Q4
+  int32_t peak;                    // ADC counts, Q4
+  int32_t crest;                   // Q10
+  int32_t form;                    // Q10
+  int32_t harmonic[HARMONIC_COUNT]; // Amplitudes, ADC counts, Q4
+};
+
+class WaveformAnalyzer {
+public:
+  WaveformAnalyzer();
+  
+  void reset();
+  void setMainsFrequency(float hz);
+  
+  // Shape of one capture of signed ADC samples (midpoint removed or not)
+  // taken over durationUs; false for an empty capture
+  bool analyze(const int16_t *samples, size_t count, uint32_t durationUs, CaptureFeatures &out);
+  
+  // Feeds one measurement's capture and power; returns true and fills out
+  // when a transition has settled or a long segment is cut
+  bool add(const int16_t *samples, size_t count, uint32_t durationUs, float power, uint32_t timestampMs,
+           WaveformVector &out);
+  
+  // Closes the steady segment at a load change; returns true and fills out
+  // when the segment was long enough to describe
+  bool onChange(const ChangeEvent &event, WaveformVector &out);
+  
+  const CaptureFeatures &getLastCapture() const { return last; }
+  uint32_t getTransitions() const { return transitions; }
+  uint32_t getIncomplete() const { return incomplete; }
+  
+  static const char *kindName(WaveformKind kind);
+  static const char *featureName(WaveformKind kind, int index);
+  static float toFloat(WaveformKind kind, int index, int16_t value); // Feature in its natural unit
+  
+private:
+  enum Phase {
+    PHASE_STEADY,
+    PHASE_SETTLING,                // Following a transient after a change
+    PHASE_COLLECTING               // Settled, averaging the new level
+  };
+  
+  // Mean shape of a run of captures
+  struct Level {
+    float power;
+    int32_t crest;
+    int32_t form;
+    int32_t harmonic[HARMONIC_COUNT];
+    uint32_t count;
+  };
+  
+  // Goertzel coefficients, 2 cos(w) in Q14, for the capture duration they were computed for
+  float mainsHz;
+  uint32_t coefficientUs;
+  size_t coefficientCount;
+  int32_t coefficient[HARMONIC_COUNT];
+  CaptureFeatures last;
+  
+  // Running segment sums
+  uint32_t segmentCount;
+  double powerSum;
+  int64_t crestSum;
+  int64_t formSum;
+  int64_t harmonicSum[HARMONIC_COUNT];
+  
+  // Recent measurements, for a peak between the change point and its detection
+  float recentPower[WAVEFORM_HISTORY];
+  uint32_t recentMs[WAVEFORM_HISTORY];
+  uint32_t recentCount;
+  
+  // Transition being measured
+  Phase phase;
+  Level reference;                 // Segment before the change
+  bool hasReference;
+  float before;                    // Power before the change (W)
+  float step;                      // Step reported by the change detector (W)
+  uint32_t changeMs;               // Estimated change point
+  float peakExcursion;             // Largest move past the old level in the step's direction (W)
+  uint32_t peakMs;
+  uint32_t runStartMs;             // Current run of measurements within the settle tolerance
+  uint32_t runLength;
+  float runMean;
+  uint32_t settleMs;
+  
+  uint32_t transitions;
+  uint32_t incomplete;             // Transitions cut short by another change or without a level before
+  
+  void updateCoefficients(size_t count, uint32_t durationUs);
+  void clearSegment();
+  void accumulate(float power);
+  Level segmentLevel() const;
+  void trackPeak(float power, uint32_t timestampMs);
+  bool settle(float power, uint32_t timestampMs);
+  void fillSteady(const Level &level, uint32_t timestampMs, WaveformVector &out) const;
+  void fillTransition(const Level &level, uint32_t timestampMs, WaveformVector &out) const;
+  
+  static int16_t saturate(int64_t value);
+  static int32_t ratio(int64_t numerator, int64_t denominator);
+  static uint32_t isqrt(uint64_t value);
+};
+
+#endif // WAVEFORM_ANALYZER_H
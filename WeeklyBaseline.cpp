@@ -0,0 +1,121 @@
+/**
+ * WeeklyBaseline implementation
+ */
+
+#include "WeeklyBaseline.h"
+#include <math.h>
+#include <string.h>
+
+WeeklyBaseline::WeeklyBaseline() {
+  reset();
+}
+
+void WeeklyBaseline::reset() {
+  memset(&state, 0, sizeof(state));
+  state.magic = BASELINE_STATE_MAGIC;
+  state.version = BASELINE_STATE_VERSION;
+  state.binCount = BASELINE_BINS;
+  period = 0;
+  count = 0;
+  sum = 0.0;
+  sumSquares = 0.0;
+}
+
+uint16_t WeeklyBaseline::binOf(uint32_t localSeconds) {
+  // 1970-01-01 was a Thursday; shift by three days so bin 0 is Monday 00:00
+  return ((localSeconds + 3 * 86400UL) % 604800UL) / BASELINE_PERIOD_SECONDS;
+}
+
+void WeeklyBaseline::score(uint16_t bin, float value, float variance, bool valid, BaselineDeviation &out) const {
+  const Bin &b = state.bins[bin];
+  float sigma = sqrtf(variance);
+  if (sigma < BASELINE_SIGMA_FLOOR_W) {
+    sigma = BASELINE_SIGMA_FLOOR_W;
+  }
+  out.valid = valid;
+  out.bin = bin;
+  out.value = value;
+  out.expected = b.mean;
+  out.sigma = sigma;
+  out.score = valid ? (value - b.mean) / sigma : 0.0f;
+}
+
+bool WeeklyBaseline::update(uint32_t localSeconds, float power, BaselineDeviation &reading,
+                            BaselineDeviation &period) {
+  uint32_t current = localSeconds / BASELINE_PERIOD_SECONDS;
+  bool closed = false;
+  if (count > 0 && current != this->period) {
+    closePeriod(period);
+    closed = true;
+  }
+  
+  uint16_t bin = binOf(localSeconds);
+  const Bin &b = state.bins[bin];
+  score(bin, power, b.variance, b.periods > 0, reading);
+  
+  this->period = current;
+  sum += power;
+  sumSquares += (double)power * power;
+  count++;
+  return closed;
+}
+
+void WeeklyBaseline::closePeriod(BaselineDeviation &out) {
+  float mean = (float)(sum / count);
+  float within = (float)(sumSquares / count - (sum / count) * (sum / count));
+  if (within < 0.0f) {
+    within = 0.0f;
+  }
+  count = 0;
+  sum = 0.0;
+  sumSquares = 0.0;
+  
+  // Score against what the bin had learned before this period
+  uint16_t bin = binOf(period * BASELINE_PERIOD_SECONDS);
+  Bin &b = state.bins[bin];
+  score(bin, mean, b.periodVariance, b.periods >= BASELINE_MIN_PERIODS, out);
+  
+  // Plain average over the first weeks, then exponential forgetting
+  float weight = 1.0f / (b.periods + 1);
+  if (weight < 1.0f / BASELINE_MEMORY_WEEKS) {
+    weight = 1.0f / BASELINE_MEMORY_WEEKS;
+  }
+  float diff = mean - b.mean;
+  b.mean += weight * diff;
+  b.periodVariance = (1.0f - weight) * (b.periodVariance + weight * diff * diff);
+  // Reading variance combines the spread within the period with the shift of its mean
+  b.variance = (1.0f - weight) * (b.variance + weight * diff * diff) + weight * within;
+  if (b.periods < 0xFFFF) {
+    b.periods++;
+  }
+  state.periods++;
+}
+
+uint16_t WeeklyBaseline::getLearnedBins() const {
+  uint16_t learned = 0;
+  for (uint16_t i = 0; i < BASELINE_BINS; i++) {
+    learned += state.bins[i].periods > 0;
+  }
+  return learned;
+}
+
+bool WeeklyBaseline::setState(const State &saved) {
+  if (saved.magic != BASELINE_STATE_MAGIC || saved.version != BASELINE_STATE_VERSION ||
+      saved.binCount != BASELINE_BINS) {
+    return false;
+  }
+  
+  for (uint16_t i = 0; i < BASELINE_BINS; i++) {
+    const Bin &b = saved.bins[i];
+    if (!isfinite(b.mean) || !isfinite(b.variance) || !isfinite(b.periodVariance) ||
+        b.variance < 0.0f || b.periodVariance < 0.0f) {
+      return false;
+    }
+  }
+  
+  state = saved;
+  count = 0;
+  sum = 0.0;
+  sumSquares = 0.0;
+  return true;
+}
@@ -0,0 +1,94 @@
+/**
+ * WeeklyBaseline Class
+ * Learned hour-of-week profile of typical power: one bin per slot of the
+ * week (168 hourly or 672 quarter-hour bins) holding the expected power,
+ * the variance of single readings and the variance of the slot's mean.
+ * Each completed period is folded into its bin with exponential
+ * forgetting, so the profile follows seasonal drift over a few weeks.
+ * Readings and period means are scored as deviations from the typical
+ * value for their slot in O(1). The bins are one plain State struct so
+ * the profile can be saved and restored as a blob.
+ */
+
+#ifndef WEEKLY_BASELINE_H
+#define WEEKLY_BASELINE_H
+
+#include <stdint.h>
+
+#ifndef BASELINE_BINS
+#define BASELINE_BINS 168          // Slots per week; must divide 10080 minutes (168 or 672)
+#endif
+#ifndef BASELINE_MEMORY_WEEKS
+#define BASELINE_MEMORY_WEEKS 4.0f // Forgetting horizon; each new week weighs 1/this once learned
+#endif
+#ifndef BASELINE_MIN_PERIODS
+#define BASELINE_MIN_PERIODS 2     // Periods seen in a bin before period means are scored
+#endif
+#ifndef BASELINE_SIGMA_FLOOR_W
+#define BASELINE_SIGMA_FLOOR_W 5.0f // Lower bound on the spread so quiet slots do not score noise
+#endif
+
+#define BASELINE_STATE_MAGIC 0x4C534257UL // "WBSL"
+#define BASELINE_STATE_VERSION 1
+#define BASELINE_PERIOD_SECONDS (604800UL / BASELINE_BINS)
+
+// Deviation of a value from the typical power for its slot
+struct BaselineDeviation {
+  bool valid;                      // The bin had been learned when the value was scored
+  uint16_t bin;
+  float value;                     // Reading or period mean (W)
+  float expected;                  // Typical power for the slot (W)
+  float sigma;                     // Typical spread (W)
+  float score;                     // (value - expected) / sigma
+};
+
+class WeeklyBaseline {
+public:
+  struct Bin {
+    float mean;                    // Expected power (W)
+    float variance;                // Variance of single readings around mean (W^2)
+    float periodVariance;          // Variance of the period mean around mean (W^2)
+    uint16_t periods;              // Periods folded in, saturating
+    uint16_t reserved;
+  };
+  
+  struct State {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t binCount;             // BASELINE_BINS of the build that saved it
+    uint32_t periods;              // Periods folded in over all bins
+    Bin bins[BASELINE_BINS];
+  };
+  
+  WeeklyBaseline();
+  
+  void reset();
+  
+  // Scores a reading taken at a local time (seconds since the epoch) and
+  // adds it to the running period. Returns true when the reading started
+  // a new period; the finished one is then scored into period and learned.
+  bool update(uint32_t localSeconds, float power, BaselineDeviation &reading, BaselineDeviation &period);
+  
+  const Bin &getBin(uint16_t bin) const { return state.bins[bin]; }
+  uint16_t getLearnedBins() const;
+  uint32_t getPeriods() const { return state.periods; }
+  
+  const State &getState() const { return state; }
+  bool setState(const State &saved); // Rejects blobs from another bin layout or with non-finite values
+  
+  static uint16_t binOf(uint32_t localSeconds); // Bin 0 starts Monday 00:00
+  
+private:
+  State state;
+  
+  // Period being accumulated, not persisted
+  uint32_t period;                 // Local periods since the epoch
+  uint32_t count;
+  double sum;
+  double sumSquares;
+  
+  void score(uint16_t bin, float value, float variance, bool valid, BaselineDeviation &out) const;
+  void closePeriod(BaselineDeviation &out);
+};
+
+#endif // WEEKLY_BASELINE_H
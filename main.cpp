@@ -6,6 +6,11 @@
  * Includes Wi-Fi configuration via captive portal and connection recovery
  * Features OTA updates and local AI processing
  * 
+ * Work is split across FreeRTOS tasks (see the priority map in Config.h):
+ * sampling feeds analytics and the network uploader side by side, analytics
+ * flags anomalous readings to the uploader afterwards, and the UI task
+ * reads the latest reading from a double-buffered snapshot.
+ * 
  * Created for PlatformIO environment
  */
 
@@ -15,63 +20,742 @@
 #include "DataManager.h"
 #include "NetworkManager.h"
 #include "AiProcessor.h"
+#include "BundleStore.h"
+#include "PowerManager.h"
+#include "Aggregator.h"
+#include "ChangeDetector.h"
+#include "WaveformAnalyzer.h"
+#include "SpscQueue.h"
+#include "Snapshot.h"
+#include "Scheduler.h"
+#include "StageMonitor.h"
+#include "SerialConsole.h"
+#include "Logger.h"
+#include "HeapMonitor.h"
+#include "BootTimeline.h"
+#include "InputManager.h"
+#include "PowerCycleDetector.h"
+#include "Profiler.h"
 
 // Global instances
 PowerMonitor powerMonitor;
 DataManager dataManager;
 NetworkManager networkManager;
 AiProcessor aiProcessor;
+BundleStore bundleStore;
+PowerManager powerManager;
+
+// Per-task job schedulers
+Scheduler analyticsJobs("analytics");
+Scheduler networkJobs("network");
+Scheduler uiJobs("ui");
+
+// Names a reading by its capture stamp, for a flag that follows it to upload
+struct AnomalyFlag {
+  unsigned long timestamp;
+  bool synced;
+};
 
-// Timing variables
-unsigned long lastSendTime = 0;
-unsigned long lastAiProcessTime = 0;
-const unsigned long sendInterval = 5000; // 5 seconds
-const unsigned long aiProcessInterval = 60000; // 1 minute
+// Inter-task channels
+SpscQueue<PowerData, MEASUREMENT_QUEUE_SIZE> analyticsQueue; // sampling -> analytics
+SpscQueue<PowerData, MEASUREMENT_QUEUE_SIZE> uploadQueue;    // sampling -> network
+SpscQueue<AnomalyFlag, ANOMALY_FLAG_QUEUE_SIZE> anomalyFlagQueue; // analytics -> network
+SpscQueue<ChangeEvent, CHANGE_QUEUE_SIZE> changeQueue;       // sampling -> analytics
+SpscQueue<WaveformVector, FEATURE_QUEUE_SIZE> featureQueue;  // sampling -> analytics
+Snapshot<PowerData> latestReading;                           // analytics -> ui
+PowerData analyticsBatch[MEASUREMENT_QUEUE_SIZE];            // Readings processed per wake-up, analytics task only
+std::atomic<bool> configPortalRequested(false);              // ui -> network
+std::atomic<bool> wifiResetRequested(false);                 // ui -> network
 
-// Button handling for config portal
+// Task handles
+TaskHandle_t samplingTaskHandle = NULL;
+TaskHandle_t analyticsTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+TaskHandle_t uiTaskHandle = NULL;
+
+// Config button (gestures arrive from InputManager)
 const int CONFIG_BUTTON_PIN = 0; // typically BOOT/FLASH button on ESP32
-int lastButtonState = HIGH;
-unsigned long lastDebounceTime = 0;
-const unsigned long debounceDelay = 50;
 
-void checkConfigButton() {
-  // Read the button state
-  int reading = digitalRead(CONFIG_BUTTON_PIN);
+void requestNetworkAction(std::atomic<bool> &request) {
+  // The portal and settings reset block, so they have to run on the network task
+  request.store(true);
+  if (networkTaskHandle != NULL) {
+    xTaskNotifyGive(networkTaskHandle);
+  }
+}
+
+void printStatus() {
+  PowerData data;
+  if (latestReading.read(data)) {
+    Serial.printf("Latest: %.1f W, %.3f A, %.4f kWh\n", data.power, data.current, data.energy);
+  }
+  Serial.printf("Wi-Fi %s, time %s\n", networkManager.isConnected() ? "connected" : "disconnected",
+                networkManager.isTimeSynced() ? "synced" : "not synced");
+  bootTimeline.printReport();
+  heapMonitor.printReport();
+}
+
+void handleInput() {
+  InputEvent event;
+  while (inputManager.getEvent(event)) {
+    LOG_INFO("Button %u: %s (%u taps, held %u ms)", event.pin, InputManager::gestureName(event.gesture),
+             event.taps, (unsigned)event.durationMs);
+    
+    switch (event.gesture) {
+      case INPUT_SHORT_PRESS:
+        Serial.println("Config button pressed, starting configuration portal");
+        requestNetworkAction(configPortalRequested);
+        break;
+      case INPUT_LONG_PRESS:
+        Serial.println("Config button held, resetting Wi-Fi settings");
+        requestNetworkAction(wifiResetRequested);
+        break;
+      case INPUT_MULTI_TAP:
+        printStatus();
+        break;
+    }
+  }
+}
+
+void logReading(const PowerData &data) {
+  PROFILE_ZONE(PROF_DISPLAY);
+  // One deferred record per reading; formatting happens on the log task
+  // Records hold LOG_MAX_ARGS arguments, so current and voltage are left to the upload
+  LOG_INFO("t=%lu P=%.1f W E=%.4f kWh%s", data.timestamp, data.power, data.energy,
+           data.anomaly ? " * ANOMALY DETECTED *" : "");
+}
+
+TickType_t ticksUntil(unsigned long ms) {
+  // Block until the next job is due, or indefinitely when none is pending
+  return ms == ULONG_MAX ? portMAX_DELAY : pdMS_TO_TICKS(ms);
+}
+
+void powerCycleWindowJob(void *context) {
+  // Still running after the window: this boot does not count as a quick restart
+  powerCycleDetector.markStable();
+}
+
+void reportTaskStacks() {
+  // On ESP32 the high-watermark is reported in bytes
+  struct { const char *name; TaskHandle_t handle; uint32_t size; } tasks[] = {
+    { "sampling", samplingTaskHandle, SAMPLING_TASK_STACK },
+    { "analytics", analyticsTaskHandle, ANALYTICS_TASK_STACK },
+    { "network", networkTaskHandle, NETWORK_TASK_STACK },
+    { "ui", uiTaskHandle, UI_TASK_STACK },
+    { "log", logger.getTaskHandle(), LOG_TASK_STACK },
+    { "input", inputManager.getTaskHandle(), INPUT_TASK_STACK },
+  };
   
-  // Check if the reading has changed due to noise or button press
-  if (reading != lastButtonState) {
-    lastDebounceTime = millis();
+  Serial.println("Task stack high-watermarks (free bytes / size):");
+  for (const auto &task : tasks) {
+    if (task.handle == NULL) {
+      continue;
+    }
+    Serial.printf("  %-10s %5u / %5u\n", task.name,
+                  (unsigned)uxTaskGetStackHighWaterMark(task.handle), (unsigned)task.size);
   }
+  Serial.printf("Queue drops: analytics=%u upload=%u changes=%u features=%u flags=%u\n",
+                (unsigned)analyticsQueue.getDropped(), (unsigned)uploadQueue.getDropped(),
+                (unsigned)changeQueue.getDropped(), (unsigned)featureQueue.getDropped(),
+                (unsigned)anomalyFlagQueue.getDropped());
+  Serial.printf("Anomaly flags for readings already uploaded: %u\n", (unsigned)dataManager.getLateFlags());
   
-  // If the button state has been stable for the debounce period
-  if ((millis() - lastDebounceTime) > debounceDelay) {
-    // If the button is pressed (LOW for most ESP32 boards)
-    if (reading == LOW) {
-      Serial.println("Config button pressed, starting configuration portal");
+  analyticsJobs.printStats();
+  networkJobs.printStats();
+  uiJobs.printStats();
+}
+
+void stackReportJob(void *context) {
+  reportTaskStacks();
+  heapMonitor.check();
+}
+
+void powerReportJob(void *context) {
+  powerManager.printReport();
+}
+
+void reportJob(void *context) {
+  // Upload everything collected since the last report in batches
+  if (networkManager.isConnected() && dataManager.hasBufferedData()) {
+    StageMonitor::Timer timer(stageMonitor, STAGE_SEND_BUFFERED);
+    if (!dataManager.sendBufferedData()) {
+      LOG_WARN_EVERY(60000, "Upload failed, readings kept for the next report");
+    }
+  } else if (dataManager.hasBufferedData()) {
+    LOG_INFO_EVERY(60000, "No connection, data buffered for later transmission");
+  }
+}
+
+void telemetryJob(void *context) {
+  if (networkManager.isConnected()) {
+    dataManager.sendTelemetry(networkManager.getTimestamp());
+  }
+}
+
+void bundleJob(void *context) {
+  // A newer bundle goes to the inactive slot and takes over at the next boot
+  if (dataManager.getBundleUrl()[0] == '\0' || !networkManager.isConnected()) {
+    return;
+  }
+  if (bundleStore.fetch(dataManager.getBundleUrl())) {
+    Serial.println("Parameter bundle updated. Rebooting...");
+    aiProcessor.saveState();
+    delay(1000);
+    ESP.restart();
+  }
+}
+
+void registerConsoleCommands() {
+  serialConsole.addCommand("stages", [](const char *args) {
+    stageMonitor.printReport();
+    if (strcmp(args, "reset") == 0) {
+      stageMonitor.reset();
+    }
+  }, "Stage latency histograms and stalls ('stages reset' clears)");
+  serialConsole.addCommand("prof", [](const char *args) {
+    profiler.dump();
+    if (strcmp(args, "reset") == 0) {
+      profiler.reset();
+    }
+  }, "Hot-path cycle counts per zone and core ('prof reset' clears)");
+  serialConsole.addCommand("stacks", [](const char *args) { reportTaskStacks(); },
+                           "Task stack high-watermarks and job jitter");
+  serialConsole.addCommand("boot", [](const char *args) { bootTimeline.printReport(); },
+                           "Reset reason and time from reset to first sample/upload");
+  serialConsole.addCommand("heap", [](const char *args) { heapMonitor.printReport(); },
+                           "Heap free/largest block/min-ever and boot arena usage");
+  serialConsole.addCommand("forecast", [](const char *args) {
+    ForecastSummary summary;
+    if (!aiProcessor.getForecast(summary)) {
+      Serial.println("No hourly data yet (needs NTP time)");
+      return;
+    }
+    Serial.printf("Next hour %.1f W (%.1f-%.1f W), MAPE %.1f%% over %u hours%s\n", summary.nextHour,
+                  summary.low, summary.high, summary.mape, (unsigned)summary.hours,
+                  summary.ready ? "" : " (warming up)");
+  }, "Seasonal next-hour forecast, interval and accuracy");
+  serialConsole.addCommand("quantiles", [](const char *args) {
+    QuantileSummary summary;
+    if (!aiProcessor.getQuantiles(summary)) {
+      Serial.println("No readings yet");
+      return;
+    }
+    const QuantileBaseline *baselines[2] = { &summary.shortTerm, &summary.longTerm };
+    const char *names[2] = { "short", "long" };
+    for (int i = 0; i < 2; i++) {
+      const QuantileBaseline &b = *baselines[i];
+      Serial.printf("  %-5s p05 %.1f  p25 %.1f  p50 %.1f  p75 %.1f  p95 %.1f  MAD %.1f W (%u readings)\n", names[i],
+                    b.percentile[ROBUST_P05], b.percentile[ROBUST_P25], b.percentile[ROBUST_P50],
+                    b.percentile[ROBUST_P75], b.percentile[ROBUST_P95], b.mad, (unsigned)b.coverage);
+    }
+    Serial.printf("  Last score %.2f, %u outliers\n", summary.lastScore, (unsigned)summary.outliers);
+  }, "Streaming percentile baselines and median/MAD outlier count");
+  serialConsole.addCommand("baseline", [](const char *args) {
+    BaselineSummary summary;
+    if (!aiProcessor.getBaseline(summary)) {
+      Serial.println("No timed readings yet (needs NTP time)");
+      return;
+    }
+    Serial.printf("%u of %u slots learned, %u periods\n", (unsigned)summary.learnedBins, (unsigned)BASELINE_BINS,
+                  (unsigned)summary.periods);
+    const BaselineDeviation *deviations[2] = { &summary.reading, &summary.period };
+    const char *names[2] = { "reading", "period" };
+    for (int i = 0; i < 2; i++) {
+      const BaselineDeviation &d = *deviations[i];
+      if (!d.valid) {
+        Serial.printf("  %-7s slot %u not learned yet\n", names[i], (unsigned)d.bin);
+        continue;
+      }
+      Serial.printf("  %-7s slot %u: %.1f W, typical %.1f +/- %.1f W, score %.2f\n", names[i], (unsigned)d.bin,
+                    d.value, d.expected, d.sigma, d.score);
+    }
+  }, "Deviation of the latest reading and period from the weekly profile");
+  serialConsole.addCommand("anomalies", [](const char *args) {
+    AnomalySummary summary;
+    if (!aiProcessor.getAnomalies(summary)) {
+      Serial.println("No anomalies raised yet");
+      return;
+    }
+    for (int scale = 0; scale < ANOMALY_SCALE_COUNT; scale++) {
+      Serial.printf("  %-7s %u warning, %u critical\n", MultiScaleDetector::scaleName((AnomalyScale)scale),
+                    (unsigned)summary.counts[scale][ANOMALY_WARNING], (unsigned)summary.counts[scale][ANOMALY_CRITICAL]);
+    }
+    uint32_t shown = summary.total < ANOMALY_RECENT_EVENTS ? summary.total : ANOMALY_RECENT_EVENTS;
+    uint32_t now = millis();
+    for (uint32_t i = 0; i < shown; i++) {
+      const AnomalyEvent &event = summary.recent[(summary.total - 1 - i) % ANOMALY_RECENT_EVENTS];
+      Serial.printf("  %6us ago  %-7s %-8s %-7s %8.1f W (expected %.1f W, score %+.1f)\n",
+                    (unsigned)((now - event.timestampMs) / 1000),
+                    MultiScaleDetector::scaleName((AnomalyScale)event.scale),
+                    MultiScaleDetector::severityName((AnomalySeverity)event.severity),
+                    MultiScaleDetector::kindName((AnomalyKind)event.kind), event.value, event.expected, event.score);
+    }
+  }, "Anomaly counts per time scale and the latest events");
+  serialConsole.addCommand("baseload", [](const char *args) {
+    BaseloadSummary summary;
+    if (!aiProcessor.getBaseload(summary)) {
+      Serial.println("No readings yet");
+      return;
+    }
+    Serial.printf("Always-on %.1f W over %.1f h%s, sustained now %.1f W\n", summary.baseload, summary.coverageHours,
+                  summary.ready ? "" : " (warming up)", summary.sustained);
+    Serial.printf("Today %.3f kWh always-on, %.3f kWh active\n", summary.today.baseKwh, summary.today.activeKwh);
+    if (summary.hasYesterday) {
+      Serial.printf("Yesterday %.3f kWh always-on, %.3f kWh active\n", summary.yesterday.baseKwh,
+                    summary.yesterday.activeKwh);
+    }
+  }, "Always-on consumption and the daily always-on/active energy split");
+  serialConsole.addCommand("projection", [](const char *args) {
+    ProjectionSummary summary;
+    if (!aiProcessor.getProjection(summary) || !summary.valid) {
+      Serial.println("No projection yet (needs NTP time)");
+      return;
+    }
+    const Tariff &tariff = dataManager.getTariff();
+    const Projection *projections[2] = { &summary.day, &summary.period };
+    const char *names[2] = { "Today", "Billing period" };
+    for (int i = 0; i < 2; i++) {
+      const Projection &p = *projections[i];
+      Serial.printf("%s: %.2f kWh so far, %.2f kWh expected (%.2f-%.2f), %.2f %s (%.2f-%.2f)\n", names[i], p.usedKwh,
+                    p.expectedKwh, p.lowKwh, p.highKwh, p.cost, tariff.currency, p.costLow, p.costHigh);
+    }
+    if (summary.trendValid) {
+      Serial.printf("Trend over the history window %+.1f%%\n", summary.trendPercent);
+    }
+  }, "End-of-day and end-of-billing-period energy and cost projections");
+  serialConsole.addCommand("nilm", [](const char *args) {
+    // Too big for the ui task stack
+    static ApplianceSummary summary;
+    if (!aiProcessor.getAppliances(summary) || summary.library.count == 0) {
+      Serial.println("No appliances learned yet");
+      return;
+    }
+    for (uint16_t i = 0; i < summary.library.count; i++) {
+      const ApplianceSignature &appliance = summary.library.appliances[i];
+      Serial.printf("  %-12s %7.1f W  %-3s %8.3f kWh  %u starts\n", appliance.name, appliance.power,
+                    (summary.running >> i) & 1 ? "on" : "off", appliance.energyKwh, (unsigned)appliance.matches);
+    }
+    Serial.printf("  %-12s %20s %8.3f kWh\n", "other", "", summary.library.otherEnergyKwh);
+  }, "Learned appliances, running state and attributed energy");
+  serialConsole.addCommand("states", [](const char *args) {
+    static OperatingStateSummary summary;
+    if (!aiProcessor.getStates(summary)) {
+      Serial.println("No readings yet");
+      return;
+    }
+    const StateClusterer::State &learned = summary.learned;
+    
+    // Listed from the lowest power up
+    int order[OPSTATE_CLUSTERS];
+    int count = 0;
+    for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+      if (learned.clusters[i].weight <= 0.0f) {
+        continue;
+      }
+      int at = count++;
+      while (at > 0 && StateClusterer::powerOf(learned.clusters[order[at - 1]]) >
+                       StateClusterer::powerOf(learned.clusters[i])) {
+        order[at] = order[at - 1];
+        at--;
+      }
+      order[at] = i;
+    }
+    if (count == 0) {
+      Serial.println("No operating states learned yet");
+      return;
+    }
+    
+    for (int n = 0; n < count; n++) {
+      int i = order[n];
+      const StateClusterer::Cluster &cluster = learned.clusters[i];
+      Serial.printf("  %c%d %8.1f W  peak x%.2f %8.1f h %8.3f kWh  to:", i == summary.current ? '*' : ' ', i,
+                    StateClusterer::powerOf(cluster), StateClusterer::peakRatioOf(cluster), cluster.seconds / 3600.0,
+                    cluster.energyKwh);
+      for (int j = 0; j < OPSTATE_CLUSTERS; j++) {
+        if (learned.transitions[i][j] > 0) {
+          Serial.printf(" %d x%u", j, (unsigned)learned.transitions[i][j]);
+        }
+      }
+      Serial.println();
+    }
+    Serial.printf("Unknown: %u readings, %.3f kWh; latest reading %s (score %.1f)\n",
+                  (unsigned)learned.unknownReadings, learned.unknownKwh,
+                  summary.last.state >= 0 ? "fits a state" : "fits no state", summary.last.score);
+  }, "Learned operating states: power, time, energy and transitions");
+  serialConsole.addCommand("model", [](const char *args) {
+    ModelSummary summary;
+    if (!aiProcessor.getModel(summary)) {
+      Serial.println("No model loaded");
+      return;
+    }
+    Serial.printf("Model kind %u, self-test %08x, arena %u/%u bytes\n", summary.kind, (unsigned)summary.selfTest,
+                  (unsigned)summary.arenaUsed, (unsigned)summary.arenaCapacity);
+    Serial.printf("%u runs, last %u us, max %u us, score %.1f, class %d\n", (unsigned)summary.invocations,
+                  (unsigned)summary.lastMicros, (unsigned)summary.maxMicros, summary.score, summary.label);
+  }, "Deployed int8 model: self-test checksum, arena and latency");
+  serialConsole.addCommand("waveform", [](const char *args) {
+    WaveformSummary summary;
+    if (!aiProcessor.getWaveform(summary)) {
+      Serial.println("No waveform features yet");
+      return;
+    }
+    Serial.printf("%u references, %u steady and %u transition vectors, %u unknown\n", (unsigned)summary.refCount,
+                  (unsigned)summary.vectors[WAVEFORM_STEADY], (unsigned)summary.vectors[WAVEFORM_TRANSITION],
+                  (unsigned)summary.unknown);
+    if (summary.vectors[WAVEFORM_STEADY] + summary.vectors[WAVEFORM_TRANSITION] == 0) {
+      return;
+    }
+    WaveformKind kind = (WaveformKind)summary.last.kind;
+    Serial.printf("Last %s: %s (%u/%u votes, distance %u)\n", WaveformAnalyzer::kindName(kind), summary.labelName,
+                  summary.votes, summary.neighbours, (unsigned)summary.distance);
+    for (int i = 0; i < WAVEFORM_FEATURES; i++) {
+      Serial.printf("  %-9s %10.3f\n", WaveformAnalyzer::featureName(kind, i),
+                    WaveformAnalyzer::toFloat(kind, i, summary.last.values[i]));
+    }
+    Serial.printf("Classification last %u us, max %u us\n", (unsigned)summary.lastMicros,
+                  (unsigned)summary.maxMicros);
+  }, "Latest waveform features and appliance class");
+  serialConsole.addCommand("bundle", [](const char *args) {
+    for (int slot = 0; slot < BUNDLE_SLOTS; slot++) {
+      Serial.printf("Slot %s at 0x%06x, %u bytes%s\n", BundleStore::slotName(slot),
+                    (unsigned)bundleStore.getSlotAddress(slot), (unsigned)bundleStore.getSlotSize(slot),
+                    slot == bundleStore.getActiveSlot() ? " (active)" : "");
+    }
+    if (bundleStore.isPending()) {
+      Serial.printf("Bundle %u stored, active from the next boot\n", (unsigned)bundleStore.getPendingSequence());
+    }
+    const ParamBundle &bundle = bundleStore.active();
+    if (!bundle.isBound()) {
+      Serial.println("No parameter bundle, using built-in defaults");
+      return;
+    }
+    Serial.printf("Bundle %u, %u bytes, built %u\n", (unsigned)bundle.getSequence(), (unsigned)bundle.getSize(),
+                  (unsigned)bundle.getCreated());
+    for (uint16_t i = 0; i < bundle.getSectionCount(); i++) {
+      const BundleSection &section = bundle.getSectionAt(i);
+      Serial.printf("  %-9s %6u bytes\n", ParamBundle::sectionName(section.type), (unsigned)section.size);
+    }
+    for (uint16_t i = 0; i < bundle.getParamCount(); i++) {
+      const BundleParam &param = bundle.getParamAt(i);
+      Serial.printf("  %-19s %g\n", param.name, param.value);
+    }
+  }, "Parameter bundle slots, sections and parameters");
+  serialConsole.addCommand("power", [](const char *args) { powerManager.printReport(); },
+                           "Power and sampling latency report");
+  serialConsole.addCommand("log", [](const char *args) {
+    if (strcmp(args, "binary") == 0) {
+      logger.setBinaryOutput(true);
+    } else if (strcmp(args, "text") == 0) {
+      logger.setBinaryOutput(false);
+    } else if (args[0] >= '0' && args[0] <= '3') {
+      logger.setLevel(args[0] - '0');
+    }
+    Serial.printf("Log level %u, %u records dropped\n", logger.getLevel(), (unsigned)logger.getDropped());
+  }, "'log 0-3' sets level (E/W/I/D), 'log binary|text' sets output");
+}
+
+void registerTelemetrySources() {
+  dataManager.addTelemetrySource("stages", [](JsonObject &out) {
+    stageMonitor.addTelemetry(out);
+  });
+  dataManager.addTelemetrySource("boot", [](JsonObject &out) {
+    bootTimeline.addTelemetry(out);
+  });
+  dataManager.addTelemetrySource("heap", [](JsonObject &out) {
+    heapMonitor.addTelemetry(out);
+  });
+  dataManager.addTelemetrySource("changes", [](JsonObject &out) {
+    aiProcessor.addChangeTelemetry(out);
+  });
+  dataManager.addTelemetrySource("appliances", [](JsonObject &out) {
+    aiProcessor.addApplianceTelemetry(out);
+  });
+  dataManager.addTelemetrySource("model", [](JsonObject &out) {
+    aiProcessor.addModelTelemetry(out);
+  });
+  dataManager.addTelemetrySource("waveform", [](JsonObject &out) {
+    aiProcessor.addWaveformTelemetry(out);
+  });
+  dataManager.addTelemetrySource("states", [](JsonObject &out) {
+    aiProcessor.addStateTelemetry(out);
+  });
+  dataManager.addTelemetrySource("quantiles", [](JsonObject &out) {
+    aiProcessor.addQuantileTelemetry(out);
+  });
+  dataManager.addTelemetrySource("anomalies", [](JsonObject &out) {
+    aiProcessor.addAnomalyTelemetry(out);
+  });
+  dataManager.addTelemetrySource("projection", [](JsonObject &out) {
+    aiProcessor.addProjectionTelemetry(out);
+  });
+  dataManager.addTelemetrySource("baseload", [](JsonObject &out) {
+    aiProcessor.addBaseloadTelemetry(out);
+  });
+  dataManager.addTelemetrySource("baseline", [](JsonObject &out) {
+    aiProcessor.addBaselineTelemetry(out);
+  });
+  dataManager.addTelemetrySource("forecast", [](JsonObject &out) {
+    aiProcessor.addForecastTelemetry(out);
+  });
+  dataManager.addTelemetrySource("power", [](JsonObject &out) {
+    out["light_sleep"] = powerManager.isLightSleepEnabled();
+    out["awake_fraction"] = powerManager.getAwakeFraction();
+    out["est_current_ma"] = powerManager.getEstimatedCurrentMa();
+    out["wake_latency_mean_ms"] = powerManager.getMeanWakeLatencyMs();
+    out["wake_latency_max_ms"] = powerManager.getMaxWakeLatencyMs();
+  });
+}
+
+void samplingTask(void *param) {
+  const Cadence &cadence = dataManager.getCadence();
+  Aggregator aggregator;
+  aggregator.setPeriod(cadence.aggregationMs);
+  ChangeDetector changeDetector;
+  WaveformAnalyzer waveform;
+  
+  // Change detection tuning from the parameter bundle, defaults otherwise
+  const ParamBundle &bundle = bundleStore.active();
+  ChangeDetector::Params params = ChangeDetector::defaultParams();
+  params.cusumK = bundle.getParam("change_cusum_k", params.cusumK, 0.0f, 5.0f);
+  params.cusumH = bundle.getParam("change_cusum_h", params.cusumH, 1.0f, 100.0f);
+  params.phDelta = bundle.getParam("change_ph_delta", params.phDelta, 0.0f, 5.0f);
+  params.phLambda = bundle.getParam("change_ph_lambda", params.phLambda, 1.0f, 1000.0f);
+  params.minStep = bundle.getParam("change_min_step", params.minStep, 0.0f, 10000.0f);
+  params.sigmaFloor = bundle.getParam("change_sigma_floor", params.sigmaFloor, 0.1f, 1000.0f);
+  params.warmupSamples = (uint32_t)bundle.getParam("change_warmup", params.warmupSamples, 2, 10000);
+  changeDetector.setParams(params);
+  TickType_t lastWake = xTaskGetTickCount();
+  
+  // Measure as soon as the task starts, then at the measurement rate;
+  // only one aggregated reading per period goes on to analytics and upload
+  for (;;) {
+    {
+      PowerManager::AwakeScope awake(powerManager);
+      
+      // Read current sensor and calculate power metrics
+      powerManager.beginCapture();
+      {
+        StageMonitor::Timer timer(stageMonitor, STAGE_POWER_UPDATE);
+        powerMonitor.update();
+      }
+      powerManager.endCapture();
+      bootTimeline.mark(BOOT_FIRST_SAMPLE);
+      
+      // Before NTP sync this is uptime in ms; the network task rebases it
+      PowerData measurement;
+      measurement.timestamp = networkManager.getTimestamp(measurement.synced);
+      measurement.current = powerMonitor.getCurrentAmps();
+      measurement.voltage = powerMonitor.getVoltage();
+      measurement.power = powerMonitor.getPowerWatts();
+      measurement.energy = powerMonitor.getEnergyKwh();
+      measurement.peak = measurement.power;
+      measurement.anomaly = false;
+      
+      // Change points are tested on every measurement, before aggregation
+      uint32_t nowMs = millis();
+      ChangeEvent change;
+      WaveformVector features;
+      bool notify = false;
+      if (changeDetector.update(measurement.power, nowMs, change)) {
+        notify |= changeQueue.push(change);
+        if (waveform.onChange(change, features)) {
+          notify |= featureQueue.push(features);
+        }
+      }
+      
+      // Waveform shape of the capture just taken, summarised per steady
+      // segment and per transition; only the vectors go to analytics
+      if (waveform.add(powerMonitor.getSamples(), powerMonitor.getSampleCount(), powerMonitor.getCaptureMicros(),
+                       measurement.power, nowMs, features)) {
+        notify |= featureQueue.push(features);
+      }
+      if (notify) {
+        xTaskNotifyGive(analyticsTaskHandle);
+      }
+      
+      // Upload does not wait for analytics; anomaly flags follow separately
+      PowerData reading;
+      if (aggregator.add(measurement, nowMs, reading)) {
+        if (uploadQueue.push(reading)) {
+          xTaskNotifyGive(networkTaskHandle);
+        }
+        if (analyticsQueue.push(reading)) {
+          xTaskNotifyGive(analyticsTaskHandle);
+        }
+      }
+    }
+    
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(cadence.measurementMs));
+    
+    // lastWake now holds the deadline; anything beyond it is wake-up latency
+    powerManager.recordWakeLatency((xTaskGetTickCount() - lastWake) * portTICK_PERIOD_MS);
+  }
+}
+
+void analyticsTask(void *param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, ticksUntil(analyticsJobs.timeUntilNext()));
+    PowerManager::AwakeScope awake(powerManager);
+    analyticsJobs.runDue();
+    
+    // Change events come first so the reading that follows carries the flag
+    ChangeEvent change;
+    while (changeQueue.pop(change)) {
+      aiProcessor.onChange(change);
+    }
+    
+    WaveformVector features;
+    while (featureQueue.pop(features)) {
+      aiProcessor.onWaveform(features);
+    }
+    
+    // Everything queued since the last wake-up is processed as one batch
+    size_t count = 0;
+    while (count < MEASUREMENT_QUEUE_SIZE && analyticsQueue.pop(analyticsBatch[count])) {
+      count++;
+    }
+    if (count == 0) {
+      continue;
+    }
+    {
+      StageMonitor::Timer timer(stageMonitor, STAGE_AI_UPDATE);
+      aiProcessor.processBatch(analyticsBatch, count);
+    }
+    
+    // The readings are already on their way to upload; flags catch up with them there
+    bool flagged = false;
+    for (size_t i = 0; i < count; i++) {
+      if (analyticsBatch[i].anomaly) {
+        AnomalyFlag flag;
+        flag.timestamp = analyticsBatch[i].timestamp;
+        flag.synced = analyticsBatch[i].synced;
+        flagged |= anomalyFlagQueue.push(flag);
+      }
+    }
+    if (flagged) {
+      xTaskNotifyGive(networkTaskHandle);
+    }
+    latestReading.publish(analyticsBatch[count - 1]);
+    xTaskNotifyGive(uiTaskHandle);
+  }
+}
+
+void networkTask(void *param) {
+  bool timestampsRebased = false;
+  
+  // Bring up Wi-Fi, NTP and OTA here so sampling never waits for them;
+  // without saved credentials this blocks in the captive portal
+  networkManager.begin();
+  networkManager.enableOTA(true);
+  
+  for (;;) {
+    // Wi-Fi/OTA upkeep and reports run from the scheduler; new readings wake us early
+    ulTaskNotifyTake(pdTRUE, ticksUntil(networkJobs.timeUntilNext()));
+    PowerManager::AwakeScope awake(powerManager);
+    
+    if (configPortalRequested.load()) {
       networkManager.startConfigPortal();
+      configPortalRequested.store(false);
+    }
+    if (wifiResetRequested.load()) {
+      networkManager.resetSettings();
+    }
+    
+    // Readings buffered before the first NTP sync carry uptime stamps
+    if (!timestampsRebased && networkManager.isTimeSynced()) {
+      dataManager.rebaseTimestamps(networkManager.getBootEpoch());
+      timestampsRebased = true;
+    }
+    
+    // Anomaly flags are taken before the readings: a reading is queued for
+    // upload before analytics sees it, so every flag taken here finds its
+    // reading buffered below (or already uploaded)
+    AnomalyFlag flagged[ANOMALY_FLAG_QUEUE_SIZE];
+    size_t flagCount = 0;
+    while (flagCount < ANOMALY_FLAG_QUEUE_SIZE && anomalyFlagQueue.pop(flagged[flagCount])) {
+      flagCount++;
+    }
+    
+    // Collect readings; the report job uploads them at the report period
+    PowerData data;
+    while (uploadQueue.pop(data)) {
+      networkManager.toEpoch(data.timestamp, data.synced);
+      dataManager.bufferData(data);
     }
+    
+    // Flags name readings by their capture stamp, rebased the same way
+    for (size_t i = 0; i < flagCount; i++) {
+      networkManager.toEpoch(flagged[i].timestamp, flagged[i].synced);
+      dataManager.markAnomaly(flagged[i].timestamp, flagged[i].synced);
+    }
+    
+    networkJobs.runDue();
   }
+}
+
+void uiTask(void *param) {
+  uint32_t lastVersion = 0;
   
-  lastButtonState = reading;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, ticksUntil(uiJobs.timeUntilNext()));
+    PowerManager::AwakeScope awake(powerManager);
+    uiJobs.runDue();
+    
+    // Button gestures and complete console command lines
+    handleInput();
+    serialConsole.poll();
+    
+    // Print each new reading once
+    if (latestReading.getVersion() != lastVersion) {
+      PowerData data;
+      lastVersion = latestReading.getVersion();
+      if (latestReading.read(data)) {
+        StageMonitor::Timer timer(stageMonitor, STAGE_DISPLAY);
+        logReading(data);
+      }
+    }
+  }
+}
+
+void startTasks() {
+  xTaskCreatePinnedToCore(samplingTask, "sampling", SAMPLING_TASK_STACK, NULL,
+                          SAMPLING_TASK_PRIORITY, &samplingTaskHandle, SAMPLING_TASK_CORE);
+  xTaskCreatePinnedToCore(analyticsTask, "analytics", ANALYTICS_TASK_STACK, NULL,
+                          ANALYTICS_TASK_PRIORITY, &analyticsTaskHandle, ANALYTICS_TASK_CORE);
+  xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, NULL,
+                          NETWORK_TASK_PRIORITY, &networkTaskHandle, NETWORK_TASK_CORE);
+  xTaskCreatePinnedToCore(uiTask, "ui", UI_TASK_STACK, NULL,
+                          UI_TASK_PRIORITY, &uiTaskHandle, UI_TASK_CORE);
 }
 
 void setup() {
+  bootTimeline.mark(BOOT_SETUP_START);
+  
   // Initialize serial communication
   Serial.begin(115200);
   Serial.println("\n\nESP32 Power Monitoring System Starting...");
   Serial.print("Firmware Version: ");
   Serial.println(FIRMWARE_VERSION);
   
-  // Set up config button
-  pinMode(CONFIG_BUTTON_PIN, INPUT_PULLUP);
+  // Start the deferred logger so modules can log during initialization
+  logger.begin();
+  
+  // Configure frequency scaling and light sleep before anything else runs
+  powerManager.begin();
+  
+  // Set up config button; interrupts are attached once the ui task exists
+  inputManager.addButton(CONFIG_BUTTON_PIN);
   
   // Initialize file system for config storage
   if (!SPIFFS.begin(true)) {
     Serial.println("SPIFFS mount failed! System will use default values");
   }
   
-  // Initialize network manager (handles Wi-Fi connection and captive portal)
-  networkManager.begin();
+  // Power-cycling quickly POWER_CYCLE_COUNT times opens the config portal
+  if (powerCycleDetector.begin()) {
+    Serial.println("Quick power cycles detected, configuration portal will start");
+    configPortalRequested.store(true);
+  }
   
   // Initialize power monitor (handles sensor readings and calculations)
   powerMonitor.begin();
@@ -79,89 +763,48 @@ void setup() {
   // Initialize data manager (handles data storage and transmission)
   dataManager.begin();
   
+  // Choose the newest valid parameter bundle; it stays mapped until reboot
+  bundleStore.begin();
+  
   // Initialize AI processor (for local data analysis)
-  aiProcessor.begin();
+  aiProcessor.begin(bundleStore.active());
   
-  // Enable OTA updates after initialization
-  networkManager.enableOTA(true);
+  // Register periodic jobs with the scheduler of the task that runs them
+  const Cadence &cadence = dataManager.getCadence();
+  aiProcessor.setReadingInterval(cadence.aggregationMs);
+  aiProcessor.setTariff(dataManager.getTariff());
+  aiProcessor.registerJobs(analyticsJobs, networkJobs, cadence.reportMs);
+  networkManager.registerJobs(networkJobs);
+  networkJobs.addPeriodic("report", cadence.reportMs, reportJob, NULL, cadence.reportMs);
+  uiJobs.addOneShot("power-cycle", POWER_CYCLE_WINDOW_MS, powerCycleWindowJob);
+  uiJobs.addPeriodic("stack-report", STACK_REPORT_INTERVAL, stackReportJob, NULL, STACK_REPORT_INTERVAL);
+  uiJobs.addPeriodic("power-report", POWER_REPORT_INTERVAL, powerReportJob, NULL, POWER_REPORT_INTERVAL);
+  networkJobs.addPeriodic("telemetry", TELEMETRY_INTERVAL, telemetryJob, NULL, TELEMETRY_INTERVAL);
+  networkJobs.addPeriodic("bundle", BUNDLE_CHECK_INTERVAL, bundleJob, NULL, BUNDLE_CHECK_INTERVAL);
+  
+  // Diagnostics over serial and telemetry
+  registerConsoleCommands();
+  registerTelemetrySources();
+  
+  // Hand over to the task runtime; sampling starts right away while the
+  // network task brings up Wi-Fi, NTP and OTA in the background
+  startTasks();
+  bootTimeline.mark(BOOT_TASKS_STARTED);
+  serialConsole.begin(uiTaskHandle);
+  inputManager.begin(uiTaskHandle);
+  
+  // From here on the measurement path must run without touching the heap;
+  // network and ui are left out since HTTPClient, WiFiManager and
+  // Serial.printf allocate internally
+  heapMonitor.watchTask(samplingTaskHandle);
+  heapMonitor.watchTask(analyticsTaskHandle);
+  heapMonitor.watchTask(logger.getTaskHandle());
+  heapMonitor.endInit();
   
   Serial.println("System initialization complete");
 }
 
 void loop() {
-  // Handle network tasks (maintain connection, check for portal requests, OTA)
-  networkManager.update();
-  
-  // Check if config button is pressed
-  checkConfigButton();
-  
-  // Time to send data?
-  unsigned long currentMillis = millis();
-  if (currentMillis - lastSendTime >= sendInterval) {
-    lastSendTime = currentMillis;
-    
-    // Read current sensor and calculate power metrics
-    powerMonitor.update();
-    
-    // Prepare data for sending
-    PowerData data;
-    data.timestamp = networkManager.getTimestamp();
-    data.current = powerMonitor.getCurrentAmps();
-    data.voltage = powerMonitor.getVoltage();
-    data.power = powerMonitor.getPowerWatts();
-    data.energy = powerMonitor.getEnergyKwh();
-    
-    // Process data with AI module (anomaly detection)
-    data.anomaly = aiProcessor.detectAnomaly(data);
-    aiProcessor.update(data);
-    
-    // Log current readings to serial
-    Serial.println("------------------------------");
-    if (networkManager.isConnected()) {
-      Serial.print("Time: "); Serial.println(networkManager.getFormattedTime());
-    }
-    Serial.print("Current (A): "); Serial.println(data.current, 3);
-    Serial.print("Voltage (V): "); Serial.println(data.voltage, 1);
-    Serial.print("Power (W): "); Serial.println(data.power, 1);
-    Serial.print("Energy (kWh): "); Serial.println(data.energy, 4);
-    if (data.anomaly) {
-      Serial.println("* ANOMALY DETECTED *");
-    }
-    
-    // Try to send data or buffer it if connection is lost
-    if (networkManager.isConnected()) {
-      // First try to send any buffered data
-      if (dataManager.hasBufferedData()) {
-        dataManager.sendBufferedData();
-      }
-      
-      // Send current data
-      bool success = dataManager.sendData(data);
-      if (!success) {
-        dataManager.bufferData(data);
-        Serial.println("Failed to send data, buffered for later transmission");
-      }
-    } else {
-      // Buffer data for later
-      dataManager.bufferData(data);
-      Serial.println("No connection, data buffered for later transmission");
-    }
-  }
-  
-  // Time to run AI processing tasks?
-  if (currentMillis - lastAiProcessTime >= aiProcessInterval) {
-    lastAiProcessTime = currentMillis;
-    
-    // Run AI trend analysis
-    Serial.println("Running AI trend analysis...");
-    aiProcessor.analyzeTrend();
-    
-    // Display prediction
-    Serial.print("Predicted next power usage: ");
-    Serial.print(aiProcessor.getPredictedPower(), 1);
-    Serial.println(" W");
-  }
-  
-  // Allow for background tasks and power saving
-  delay(100);
+  // All work runs in dedicated tasks; free the Arduino loop task
+  vTaskDelete(NULL);
 }
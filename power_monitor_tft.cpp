@@ -15,6 +15,12 @@
 #include <SPIFFS.h>
 #include <WiFiManager.h>
 #include <TFT_eSPI.h>
+#include "Scheduler.h"
+#include "StageMonitor.h"
+#include "Profiler.h"
+#include "InputManager.h"
+#include "PowerCycleDetector.h"
+#include "BaseloadEstimator.h"
 
 // Initialize TFT display
 TFT_eSPI tft = TFT_eSPI();
@@ -44,12 +50,16 @@ TFT_eSPI tft = TFT_eSPI();
 #define MAX_RETRY_ATTEMPTS 3        // Number of times to retry connection
 
 // Timing variables
-unsigned long lastSendTime = 0;
+const unsigned long sampleInterval = 100; // 100 ms
 const unsigned long sendInterval = 5000; // 5 seconds
-unsigned long lastDisplayUpdateTime = 0;
 const unsigned long displayUpdateInterval = 1000; // 1 second
-unsigned long lastButtonCheckTime = 0;
-const unsigned long buttonDebounceTime = 50; // 50 ms debounce
+const unsigned long stageReportInterval = 60000; // 1 minute
+
+// Periodic jobs
+Scheduler scheduler("tft");
+
+// Always-on consumption; this app has no clock, so days are uptime days
+BaseloadEstimator baseload;
 
 // Global variables
 float currentRMS = 0.0;
@@ -59,20 +69,25 @@ float energyKwh = 0.0;
 unsigned long lastEnergyCalcTime = 0;
 String backendUrl = DEFAULT_BACKEND_URL;
 bool wifiConnected = false;
-int lastButtonState = HIGH;
 
 // Function declarations
 void setupWiFi();
 void setupDisplay();
 void displayData();
-void checkButton();
+void handleInput();
+void startConfigPortal();
 float readCurrentSensor();
 float calculateRMSCurrent(float rawADC);
 void calculatePower();
 void updateEnergy();
 bool sendData();
-String createJsonPayload();
+size_t createJsonPayload(char *out, size_t size);
 void drawProgressBar(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t percent, uint16_t frameColor, uint16_t barColor);
+void sampleJob(void *context);
+void displayJob(void *context);
+void sendJob(void *context);
+void powerCycleJob(void *context);
+void stageReportJob(void *context);
 
 void setup() {
   // Initialize serial communication
@@ -90,8 +105,9 @@ void setup() {
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, HIGH); // LED on during initialization
   
-  // Set up button with pull-up
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  // Set up button (pull-up, interrupt-driven once setup() is done)
+  inputManager.addButton(BUTTON_PIN);
+  bool portalRequested = powerCycleDetector.begin();
   
   // Configure ADC for current sensor
   analogReadResolution(ADC_BITS);
@@ -161,58 +177,101 @@ void setup() {
   delay(2000); // Show the splash screen for 2 seconds
   
   digitalWrite(LED_PIN, LOW); // Turn off LED after initialization
+  
+  // Power-cycling quickly POWER_CYCLE_COUNT times opens the config portal
+  if (portalRequested) {
+    startConfigPortal();
+  }
+  
+  // Register periodic jobs
+  scheduler.addOneShot("power-cycle", POWER_CYCLE_WINDOW_MS, powerCycleJob);
+  scheduler.addPeriodic("sample", sampleInterval, sampleJob);
+  scheduler.addPeriodic("display", displayUpdateInterval, displayJob);
+  scheduler.addPeriodic("send", sendInterval, sendJob, NULL, sendInterval);
+  scheduler.addPeriodic("stage-report", stageReportInterval, stageReportJob, NULL, stageReportInterval);
+  
+  // Button gestures are queued by the input task, which wakes this loop
+  inputManager.begin(xTaskGetCurrentTaskHandle());
+  
   Serial.println("System initialization complete");
 }
 
 void loop() {
-  unsigned long currentMillis = millis();
+  handleInput();
   
-  // Check if button is pressed to enter config mode
-  checkButton();
+  // Run whatever is due, then sleep until the next deadline or a button event
+  unsigned long wait = scheduler.runDue();
+  if (wait > 0) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+  }
+}
+
+void handleInput() {
+  InputEvent event;
+  while (inputManager.getEvent(event)) {
+    // A short press enters config mode
+    if (event.gesture == INPUT_SHORT_PRESS) {
+      startConfigPortal();
+    }
+  }
+}
+
+void powerCycleJob(void *context) {
+  // Still running after the window: this boot does not count as a quick restart
+  powerCycleDetector.markStable();
+}
+
+void sampleJob(void *context) {
+  StageMonitor::Timer timer(stageMonitor, STAGE_POWER_UPDATE);
   
   // Read current sensor and calculate power metrics
   float rawCurrent = readCurrentSensor();
+  
+  PROFILE_ZONE(PROF_RMS);
   currentRMS = calculateRMSCurrent(rawCurrent);
   calculatePower();
   updateEnergy();
-  
+}
+
+void displayJob(void *context) {
   // Update display
-  if (currentMillis - lastDisplayUpdateTime >= displayUpdateInterval) {
-    lastDisplayUpdateTime = currentMillis;
-    displayData();
-  }
-  
-  // Send data every 5 seconds
-  if (currentMillis - lastSendTime >= sendInterval) {
-    lastSendTime = currentMillis;
-    
-    // Log current readings to serial
-    Serial.println("------------------------------");
-    Serial.print("Current (A): "); Serial.println(currentRMS, 3);
-    Serial.print("Voltage (V): "); Serial.println(mainVoltage, 1);
-    Serial.print("Power (W): "); Serial.println(powerWatts, 1);
-    Serial.print("Energy (kWh): "); Serial.println(energyKwh, 4);
-    
-    // Send data to backend
-    if (wifiConnected && WiFi.status() == WL_CONNECTED) {
-      bool success = sendData();
-      if (success) {
-        Serial.println("Data sent successfully");
-        // Briefly flash LED to indicate successful transmission
-        digitalWrite(LED_PIN, HIGH);
-        delay(50);
-        digitalWrite(LED_PIN, LOW);
-      } else {
-        Serial.println("Failed to send data");
-      }
+  StageMonitor::Timer timer(stageMonitor, STAGE_DISPLAY);
+  displayData();
+}
+
+void stageReportJob(void *context) {
+  stageMonitor.printReport();
+  profiler.dump();
+}
+
+void sendJob(void *context) {
+  // Log current readings to serial
+  Serial.println("------------------------------");
+  Serial.print("Current (A): "); Serial.println(currentRMS, 3);
+  Serial.print("Voltage (V): "); Serial.println(mainVoltage, 1);
+  Serial.print("Power (W): "); Serial.println(powerWatts, 1);
+  Serial.print("Energy (kWh): "); Serial.println(energyKwh, 4);
+  
+  // Send data to backend
+  if (wifiConnected && WiFi.status() == WL_CONNECTED) {
+    bool success;
+    {
+      StageMonitor::Timer timer(stageMonitor, STAGE_SEND_DATA);
+      success = sendData();
+    }
+    if (success) {
+      Serial.println("Data sent successfully");
+      // Briefly flash LED to indicate successful transmission
+      digitalWrite(LED_PIN, HIGH);
+      delay(50);
+      digitalWrite(LED_PIN, LOW);
     } else {
-      Serial.println("WiFi not connected, data not sent");
-      wifiConnected = WiFi.status() == WL_CONNECTED;
+      Serial.println("Failed to send data");
     }
+  } else {
+    Serial.println("WiFi not connected, data not sent");
+    wifiConnected = WiFi.status() == WL_CONNECTED;
   }
-  
-  // Allow for background tasks and power saving
-  delay(100);
 }
 
 void setupDisplay() {
@@ -223,6 +282,8 @@ void setupDisplay() {
 }
 
 void displayData() {
+  PROFILE_ZONE(PROF_DISPLAY);
+  
   // Clear the screen area for the data
   tft.fillScreen(TFT_BLACK);
   
@@ -280,6 +341,28 @@ void displayData() {
   tft.print("Power Usage:");
   drawProgressBar(10, 145, tft.width() - 20, 20, percent, TFT_DARKGREY, TFT_GREEN);
   
+  // Display always-on consumption and today's split
+  tft.setCursor(10, 175);
+  tft.setTextColor(TFT_WHITE);
+  tft.print("Always-on:");
+  tft.setCursor(150, 175);
+  tft.setTextColor(TFT_YELLOW);
+  if (baseload.hasEstimate()) {
+    tft.print(baseload.getBaseload(), 1);
+    tft.print(baseload.isReady() ? " W" : " W (learning)");
+  } else {
+    tft.print("--");
+  }
+  tft.setCursor(10, 190);
+  tft.setTextColor(TFT_WHITE);
+  tft.print("Today base/active:");
+  tft.setCursor(150, 190);
+  tft.setTextColor(TFT_YELLOW);
+  tft.print(baseload.getToday().baseKwh, 2);
+  tft.print(" / ");
+  tft.print(baseload.getToday().activeKwh, 2);
+  tft.print(" kWh");
+  
   // Display WiFi status
   tft.setCursor(10, tft.height() - 20);
   tft.setTextColor(TFT_WHITE);
@@ -293,80 +376,63 @@ void displayData() {
   }
 }
 
-void checkButton() {
-  unsigned long currentMillis = millis();
+void startConfigPortal() {
+  Serial.println("Starting WiFi config portal");
   
-  // Only check periodically to debounce
-  if (currentMillis - lastButtonCheckTime < buttonDebounceTime) {
-    return;
-  }
+  // Display message
+  tft.fillScreen(TFT_BLACK);
+  tft.setTextSize(2);
+  tft.setCursor(20, 20);
+  tft.setTextColor(TFT_CYAN);
+  tft.println("WiFi Setup Mode");
+  tft.setTextSize(1);
+  tft.setCursor(20, 60);
+  tft.setTextColor(TFT_WHITE);
+  tft.println("Connect to WiFi network:");
+  tft.setCursor(20, 80);
+  tft.setTextColor(TFT_YELLOW);
+  tft.println(DEVICE_NAME);
+  tft.setCursor(20, 100);
+  tft.setTextColor(TFT_WHITE);
+  tft.println("Then go to IP: 192.168.4.1");
   
-  lastButtonCheckTime = currentMillis;
+  // Start WiFi Manager config portal
+  WiFiManager wifiManager;
   
-  // Read the button state
-  int buttonState = digitalRead(BUTTON_PIN);
+  // Add custom parameter for backend URL
+  WiFiManagerParameter custom_backend_url("backend_url", "Backend URL", backendUrl.c_str(), 100);
+  wifiManager.addParameter(&custom_backend_url);
   
-  // If the button is pressed (LOW for ESP32 GPIO0)
-  if (buttonState == LOW && lastButtonState == HIGH) {
-    // Button was just pressed
-    Serial.println("Config button pressed, starting WiFi config portal");
-    
-    // Display message
-    tft.fillScreen(TFT_BLACK);
-    tft.setTextSize(2);
-    tft.setCursor(20, 20);
-    tft.setTextColor(TFT_CYAN);
-    tft.println("WiFi Setup Mode");
-    tft.setTextSize(1);
-    tft.setCursor(20, 60);
-    tft.setTextColor(TFT_WHITE);
-    tft.println("Connect to WiFi network:");
-    tft.setCursor(20, 80);
-    tft.setTextColor(TFT_YELLOW);
-    tft.println(DEVICE_NAME);
-    tft.setCursor(20, 100);
-    tft.setTextColor(TFT_WHITE);
-    tft.println("Then go to IP: 192.168.4.1");
-    
-    // Start WiFi Manager config portal
-    WiFiManager wifiManager;
-    
-    // Add custom parameter for backend URL
-    WiFiManagerParameter custom_backend_url("backend_url", "Backend URL", backendUrl.c_str(), 100);
-    wifiManager.addParameter(&custom_backend_url);
-    
-    // Add parameter for configurable mains voltage
-    char voltage_str[10];
-    sprintf(voltage_str, "%.1f", mainVoltage);
-    WiFiManagerParameter custom_mains_voltage("mains_voltage", "Mains Voltage (V)", voltage_str, 10);
-    wifiManager.addParameter(&custom_mains_voltage);
+  // Add parameter for configurable mains voltage
+  char voltage_str[10];
+  sprintf(voltage_str, "%.1f", mainVoltage);
+  WiFiManagerParameter custom_mains_voltage("mains_voltage", "Mains Voltage (V)", voltage_str, 10);
+  wifiManager.addParameter(&custom_mains_voltage);
+  
+  // Start the portal (blocks until completed or timeout)
+  if (!wifiManager.startConfigPortal(DEVICE_NAME)) {
+    Serial.println("Failed to connect and hit timeout");
+  } else {
+    // Get custom parameters
+    String urlParam = custom_backend_url.getValue();
+    if (urlParam.length() > 0) {
+      backendUrl = urlParam;
+    }
     
-    // Start the portal (blocks until completed or timeout)
-    if (!wifiManager.startConfigPortal(DEVICE_NAME)) {
-      Serial.println("Failed to connect and hit timeout");
-    } else {
-      // Get custom parameters
-      String urlParam = custom_backend_url.getValue();
-      if (urlParam.length() > 0) {
-        backendUrl = urlParam;
-      }
-      
-      String voltageParam = custom_mains_voltage.getValue();
-      if (voltageParam.length() > 0) {
-        mainVoltage = voltageParam.toFloat();
-      }
-      
-      wifiConnected = WiFi.status() == WL_CONNECTED;
+    String voltageParam = custom_mains_voltage.getValue();
+    if (voltageParam.length() > 0) {
+      mainVoltage = voltageParam.toFloat();
     }
     
-    // After portal closes, redraw the screen
-    displayData();
+    wifiConnected = WiFi.status() == WL_CONNECTED;
   }
   
-  lastButtonState = buttonState;
+  // After portal closes, redraw the screen
+  displayData();
 }
 
 float readCurrentSensor() {
+  PROFILE_ZONE(PROF_SAMPLING);
   int sampleCount = SAMPLES_PER_CYCLE;
   float sumSquared = 0.0;
   
@@ -426,28 +492,31 @@ void updateEnergy() {
     
     // Add to cumulative energy
     energyKwh += energyIncrement;
+    baseload.update(1 + currentTime / 86400000UL, powerWatts, timeDelta / 1000.0f);
     
     // Update last calculation time
     lastEnergyCalcTime = currentTime;
   }
 }
 
-String createJsonPayload() {
+size_t createJsonPayload(char *out, size_t size) {
   // Create JSON document
-  StaticJsonDocument<256> doc;
+  StaticJsonDocument<384> doc;
   
   doc["timestamp"] = millis();
   doc["current_amps"] = currentRMS;
   doc["voltage_volts"] = mainVoltage;
   doc["power_watts"] = powerWatts;
   doc["energy_kwh"] = energyKwh;
+  if (baseload.hasEstimate()) {
+    doc["baseload_watts"] = baseload.getBaseload();
+  }
+  doc["base_kwh_today"] = baseload.getToday().baseKwh;
+  doc["active_kwh_today"] = baseload.getToday().activeKwh;
   doc["device_id"] = DEVICE_NAME;
   
-  // Serialize to string
-  String jsonString;
-  serializeJson(doc, jsonString);
-  
-  return jsonString;
+  // Serialize into the caller's buffer
+  return serializeJson(doc, out, size);
 }
 
 bool sendData() {
@@ -455,8 +524,9 @@ bool sendData() {
   bool success = false;
   int retryCount = 0;
   
-  // Create JSON payload
-  String jsonPayload = createJsonPayload();
+  // Create JSON payload in static storage (only the scheduler loop sends)
+  static char jsonPayload[384];
+  size_t payloadLength = createJsonPayload(jsonPayload, sizeof(jsonPayload));
   
   // Try to send with retries
   while (!success && retryCount < MAX_RETRY_ATTEMPTS) {
@@ -465,7 +535,7 @@ bool sendData() {
     http.addHeader("Content-Type", "application/json");
     
     // Send POST request
-    int httpResponseCode = http.POST(jsonPayload);
+    int httpResponseCode = http.POST((uint8_t *)jsonPayload, payloadLength);
     
     if (httpResponseCode > 0) {
       Serial.print("HTTP Response code: ");
@@ -511,8 +581,9 @@ void drawProgressBar(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t per
   tft.setTextColor(TFT_WHITE);
   
   // Calculate position to center the text
-  String percentText = String(percent) + "%";
-  int16_t textWidth = percentText.length() * 6; // Approximate width for size 1 text
+  char percentText[5];
+  int textLength = snprintf(percentText, sizeof(percentText), "%u%%", (unsigned)percent);
+  int16_t textWidth = textLength * 6; // Approximate width for size 1 text
   int16_t textX = x + (w - textWidth) / 2;
   int16_t textY = y + (h - 8) / 2 + 1; // 8 is approximate height for size 1 text
   
@@ -0,0 +1,495 @@
+/**
+ * Host replay of labelled power traces through the streaming detectors
+ *
+ * Reads a CSV trace of "timestamp_ms,power_w[,label]" lines, where label 1
+ * marks the first sample after a true change, runs ChangeDetector over it
+ * with the firmware code and reports detections, misses, false alarms per
+ * hour and detection delay. Thresholds can be overridden on the command
+ * line to tune the false-alarm rate before changing the firmware defaults.
+ * With --nilm the detected steps also drive LoadDisaggregator and the
+ * learned appliances and their attributed energy are printed. With
+ * --model the packed model is loaded like on the device, its self-test
+ * checksum is printed (it must match the 'model' console command) and it
+ * is scored over consecutive windows of the trace. With --quantiles the
+ * trace also runs through RobustWindow and its P2 percentiles and MAD are
+ * compared with exact values over the same readings, along with the
+ * update cost of both. With --scales the trace is averaged into readings
+ * of the given length and run through MultiScaleDetector, and its events
+ * per scale and severity are reported. With --states the same readings,
+ * with their peak, are clustered by StateClusterer and the learned
+ * operating states with their time, energy and transitions are printed.
+ * With --bundle the parameter bundle
+ * is validated like on the device, its contents are listed, its change_*
+ * parameters replace the defaults (flags after it still override them) and
+ * its model section is run as with --model.
+ *
+ *   pio run -e host_replay
+ *   .pio/build/host_replay/program trace.csv --h 6 --lambda 40 --events
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "../ChangeDetector.h"
+#include "../LoadDisaggregator.h"
+#include "../InferenceEngine.h"
+#include "../ParamBundle.h"
+#include "../RobustWindow.h"
+#include "../MultiScaleDetector.h"
+#include "../StateClusterer.h"
+
+struct Sample {
+  uint32_t timestampMs;
+  float power;
+  bool label;
+};
+
+static bool loadTrace(const char *path, std::vector<Sample> &samples) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  
+  char line[128];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    Sample sample;
+    unsigned long timestamp;
+    int label = 0;
+    // Header and comment lines do not parse and are skipped
+    if (sscanf(line, "%lu,%f,%d", &timestamp, &sample.power, &label) < 2) {
+      continue;
+    }
+    sample.timestampMs = (uint32_t)timestamp;
+    sample.label = label != 0;
+    samples.push_back(sample);
+  }
+  
+  fclose(file);
+  return true;
+}
+
+static bool loadBlob(const char *path, uint32_t *blob, size_t capacity, size_t &size) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  size = fread(blob, 1, capacity, file);
+  fclose(file);
+  return true;
+}
+
+static void runModel(const uint8_t *blob, size_t size, const std::vector<Sample> &samples) {
+  // The arena matches MODEL_ARENA_SIZE
+  static uint8_t arena[4096];
+  InferenceEngine model;
+  if (!model.load(blob, size, arena, sizeof(arena))) {
+    printf("Model:            not loaded (%s)\n", model.getError());
+    return;
+  }
+  printf("Model:            kind %u, %u -> %u values, arena %u/%u bytes, self-test %08x\n",
+         (unsigned)model.getKind(), (unsigned)model.inputSize(), (unsigned)model.outputSize(),
+         (unsigned)model.getArenaUsed(), (unsigned)model.getArenaCapacity(), (unsigned)model.selfTest());
+  
+  size_t count = model.inputSize();
+  uint32_t windows = 0;
+  uint32_t flagged = 0;
+  double maxScore = 0.0;
+  uint64_t micros = 0;
+  for (size_t start = 0; start + count <= samples.size(); start += count) {
+    for (size_t i = 0; i < count; i++) {
+      model.setInput(i, samples[start + i].power);
+    }
+    model.invoke();
+    micros += model.getLastMicros();
+    windows++;
+    
+    if (model.getKind() == MODEL_AUTOENCODER && model.outputSize() == count) {
+      double sum = 0.0;
+      for (size_t i = 0; i < count; i++) {
+        double error = model.dequantizeOutput(i) - model.dequantizeInput(i);
+        sum += error * error;
+      }
+      double score = sum / count;
+      maxScore = score > maxScore ? score : maxScore;
+      flagged += score > model.getThreshold();
+    }
+  }
+  
+  printf("Model windows:    %u, %u above threshold, max score %.1f, mean %.1f us\n", (unsigned)windows,
+         (unsigned)flagged, maxScore, windows ? (double)micros / windows : 0.0);
+}
+
+static bool loadBundle(const char *path, ParamBundle &bundle, ChangeDetector::Params &params) {
+  // Word-aligned like the flash mapping, one slot in size
+  static uint32_t blob[65536 / 4];
+  size_t size;
+  if (!loadBlob(path, blob, sizeof(blob), size)) {
+    return false;
+  }
+  if (!bundle.bind(reinterpret_cast<const uint8_t *>(blob), size)) {
+    fprintf(stderr, "%s: %s\n", path, bundle.getError());
+    return false;
+  }
+  
+  printf("Bundle:           sequence %u, %u bytes\n", (unsigned)bundle.getSequence(), (unsigned)bundle.getSize());
+  for (uint16_t i = 0; i < bundle.getSectionCount(); i++) {
+    const BundleSection &section = bundle.getSectionAt(i);
+    printf("  %-9s %6u bytes\n", ParamBundle::sectionName(section.type), (unsigned)section.size);
+  }
+  for (uint16_t i = 0; i < bundle.getParamCount(); i++) {
+    printf("  %-19s %g\n", bundle.getParamAt(i).name, bundle.getParamAt(i).value);
+  }
+  
+  // Same names as the sampling task reads on the device
+  params.cusumK = bundle.getParam("change_cusum_k", params.cusumK, 0.0f, 5.0f);
+  params.cusumH = bundle.getParam("change_cusum_h", params.cusumH, 1.0f, 100.0f);
+  params.phDelta = bundle.getParam("change_ph_delta", params.phDelta, 0.0f, 5.0f);
+  params.phLambda = bundle.getParam("change_ph_lambda", params.phLambda, 1.0f, 1000.0f);
+  params.minStep = bundle.getParam("change_min_step", params.minStep, 0.0f, 10000.0f);
+  params.sigmaFloor = bundle.getParam("change_sigma_floor", params.sigmaFloor, 0.1f, 1000.0f);
+  params.warmupSamples = (uint32_t)bundle.getParam("change_warmup", params.warmupSamples, 2, 10000);
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: host_replay trace.csv [--k sigmas] [--h sigmas] [--delta sigmas]\n"
+          "                   [--lambda sigmas] [--min-step W] [--warmup samples]\n"
+          "                   [--sigma-floor W]"
+          " [--match-ms ms] [--events] [--nilm]\n"
+          "                   [--model model.bin] [--bundle bundle.bin] [--quantiles readings]\n"
+          "                   [--scales reading-ms] [--states reading-ms]\n");
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static float exactQuantile(const std::vector<float> &sorted, float p) {
+  return sorted[(size_t)(p * (sorted.size() - 1) + 0.5f)];
+}
+
+static void runQuantiles(const std::vector<Sample> &samples, uint32_t horizon) {
+  RobustWindow window(horizon);
+  uint32_t step = horizon / 8 > 0 ? horizon / 8 : 1;
+  
+  double valueError[ROBUST_QUANTILE_COUNT + 1] = { 0 }; // Last entry is the MAD
+  double rankError[ROBUST_QUANTILE_COUNT] = { 0 };
+  uint32_t checks = 0;
+  double estimateNs = 0.0;
+  double exactNs = 0.0;
+  std::vector<float> sorted;
+  std::vector<float> deviations;
+  
+  for (size_t i = 0; i < samples.size(); i++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    window.add(samples[i].power);
+    estimateNs += elapsedNs(start);
+    
+    uint32_t coverage = window.coverage();
+    if ((i + 1) % step != 0 || coverage < horizon / 2) {
+      continue;
+    }
+    
+    // Exact values over exactly the readings the estimators have seen
+    start = std::chrono::steady_clock::now();
+    sorted.clear();
+    for (size_t j = i + 1 - coverage; j <= i; j++) {
+      sorted.push_back(samples[j].power);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    float median = exactQuantile(sorted, 0.5f);
+    deviations.clear();
+    for (size_t j = 0; j < sorted.size(); j++) {
+      deviations.push_back(fabsf(sorted[j] - median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    exactNs += elapsedNs(start);
+    
+    for (int q = 0; q < ROBUST_QUANTILE_COUNT; q++) {
+      float estimate = window.quantile((RobustQuantile)q);
+      float p = RobustWindow::probability((RobustQuantile)q);
+      valueError[q] += fabsf(estimate - exactQuantile(sorted, p));
+      float rank = (float)(std::lower_bound(sorted.begin(), sorted.end(), estimate) - sorted.begin()) / sorted.size();
+      rankError[q] += fabsf(rank - p);
+    }
+    valueError[ROBUST_QUANTILE_COUNT] += fabsf(window.mad() - exactQuantile(deviations, 0.5f));
+    checks++;
+  }
+  
+  printf("Quantiles:        horizon %u readings, %u bytes vs %u for the exact window, %u checks\n",
+         (unsigned)horizon, (unsigned)sizeof(RobustWindow), (unsigned)(horizon * sizeof(float)), (unsigned)checks);
+  if (checks == 0) {
+    return;
+  }
+  for (int q = 0; q < ROBUST_QUANTILE_COUNT; q++) {
+    printf("  p%02.0f             mean error %6.2f W, rank error %5.2f%%\n",
+           RobustWindow::probability((RobustQuantile)q) * 100.0f, valueError[q] / checks,
+           rankError[q] / checks * 100.0);
+  }
+  printf("  MAD             mean error %6.2f W\n", valueError[ROBUST_QUANTILE_COUNT] / checks);
+  printf("  Update cost:    P2 %.0f ns per reading, exact sort %.0f ns per query\n",
+         estimateNs / samples.size(), exactNs / checks);
+}
+
+static void runScales(const std::vector<Sample> &samples, uint32_t readingMs, bool printEvents) {
+  MultiScaleDetector detector;
+  detector.setReadingInterval(readingMs);
+  uint32_t counts[ANOMALY_SCALE_COUNT][ANOMALY_SEVERITY_COUNT] = { { 0 } };
+  
+  // Average the trace into readings the way Aggregator does
+  uint32_t periodStart = samples.front().timestampMs;
+  double sum = 0.0;
+  uint32_t count = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (count > 0 && samples[i].timestampMs - periodStart >= readingMs) {
+      AnomalyEvent events[ANOMALY_SCALE_COUNT];
+      int found = detector.update((float)(sum / count), samples[i].timestampMs, events);
+      for (int e = 0; e < found; e++) {
+        const AnomalyEvent &event = events[e];
+        counts[event.scale][event.severity]++;
+        if (printEvents) {
+          printf("%10u ms  %-7s %-8s %-5s %8.1f W (expected %.1f W, score %+.1f)\n", (unsigned)event.timestampMs,
+                 MultiScaleDetector::scaleName((AnomalyScale)event.scale),
+                 MultiScaleDetector::severityName((AnomalySeverity)event.severity),
+                 MultiScaleDetector::kindName((AnomalyKind)event.kind), event.value, event.expected, event.score);
+        }
+      }
+      periodStart = samples[i].timestampMs;
+      sum = 0.0;
+      count = 0;
+    }
+    sum += samples[i].power;
+    count++;
+  }
+  
+  printf("Scales:           %u ms readings\n", (unsigned)readingMs);
+  for (int scale = ANOMALY_SCALE_MINUTE; scale < ANOMALY_SCALE_COUNT; scale++) {
+    printf("  %-7s         %u periods, %u warning, %u critical, sigma %.1f W\n",
+           MultiScaleDetector::scaleName((AnomalyScale)scale), (unsigned)detector.getPeriods((AnomalyScale)scale),
+           (unsigned)counts[scale][ANOMALY_WARNING], (unsigned)counts[scale][ANOMALY_CRITICAL],
+           detector.getSigma((AnomalyScale)scale));
+  }
+}
+
+static void runStates(const std::vector<Sample> &samples, uint32_t readingMs, bool printEvents) {
+  StateClusterer clusterer;
+  uint32_t novel = 0;
+  uint32_t readings = 0;
+  double updateNs = 0.0;
+  
+  // Mean and peak per reading the way Aggregator does
+  uint32_t periodStart = samples.front().timestampMs;
+  double sum = 0.0;
+  float peak = 0.0f;
+  uint32_t count = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (count > 0 && samples[i].timestampMs - periodStart >= readingMs) {
+      StateReading reading;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      clusterer.update((float)(sum / count), peak, readingMs / 1000.0f, reading);
+      updateNs += elapsedNs(start);
+      readings++;
+      novel += reading.novel;
+      if (printEvents && (reading.novel || reading.created)) {
+        printf("%10u ms  %s %8.1f W (score %.1f)\n", (unsigned)samples[i].timestampMs,
+               reading.created ? "new state" : "no state ", sum / count, reading.score);
+      }
+      periodStart = samples[i].timestampMs;
+      sum = 0.0;
+      peak = 0.0f;
+      count = 0;
+    }
+    sum += samples[i].power;
+    peak = samples[i].power > peak ? samples[i].power : peak;
+    count++;
+  }
+  
+  const StateClusterer::State &learned = clusterer.getState();
+  printf("States:           %u learned from %u readings, %u readings fit none (%u runs), %.0f ns per reading\n",
+         (unsigned)clusterer.getActiveCount(), (unsigned)readings, (unsigned)learned.unknownReadings,
+         (unsigned)novel, readings ? updateNs / readings : 0.0);
+  for (int i = 0; i < OPSTATE_CLUSTERS; i++) {
+    const StateClusterer::Cluster &cluster = learned.clusters[i];
+    if (cluster.weight <= 0.0f) {
+      continue;
+    }
+    printf("  %d %8.1f W  peak x%.2f %7.2f h %8.3f kWh  to:", i, StateClusterer::powerOf(cluster),
+           StateClusterer::peakRatioOf(cluster), cluster.seconds / 3600.0, cluster.energyKwh);
+    for (int j = 0; j < OPSTATE_CLUSTERS; j++) {
+      printf(" %u", (unsigned)learned.transitions[i][j]);
+    }
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+  
+  ChangeDetector::Params params = ChangeDetector::defaultParams();
+  uint32_t matchMs = 60000;        // Detections later than this after a label are false alarms
+  bool printEvents = false;
+  bool nilm = false;
+  const char *modelPath = NULL;
+  ParamBundle bundle;
+  uint32_t quantileHorizon = 0;
+  uint32_t scaleReadingMs = 0;
+  uint32_t stateReadingMs = 0;
+  
+  for (int i = 2; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--events") == 0) {
+      printEvents = true;
+    } else if (strcmp(argv[i], "--nilm") == 0) {
+      nilm = true;
+    } else if (hasValue && strcmp(argv[i], "--model") == 0) {
+      modelPath = argv[++i];
+    } else if (hasValue && strcmp(argv[i], "--bundle") == 0) {
+      if (!loadBundle(argv[++i], bundle, params)) {
+        return 1;
+      }
+    } else if (hasValue && strcmp(argv[i], "--quantiles") == 0) {
+      quantileHorizon = atoi(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--scales") == 0) {
+      scaleReadingMs = atoi(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--states") == 0) {
+      stateReadingMs = atoi(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--k") == 0) {
+      params.cusumK = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--h") == 0) {
+      params.cusumH = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--delta") == 0) {
+      params.phDelta = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--lambda") == 0) {
+      params.phLambda = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--min-step") == 0) {
+      params.minStep = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--warmup") == 0) {
+      params.warmupSamples = atoi(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--sigma-floor") == 0) {
+      params.sigmaFloor = atof(argv[++i]);
+    } else if (hasValue && strcmp(argv[i], "--match-ms") == 0) {
+      matchMs = atoi(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  
+  std::vector<Sample> samples;
+  if (!loadTrace(argv[1], samples) || samples.empty()) {
+    fprintf(stderr, "No samples in %s\n", argv[1]);
+    return 1;
+  }
+  
+  ChangeDetector detector;
+  detector.setParams(params);
+  LoadDisaggregator disaggregator;
+  
+  uint32_t labels = 0;
+  uint32_t detected = 0;
+  uint32_t falseAlarms = 0;
+  uint64_t delaySum = 0;
+  uint32_t delayMax = 0;
+  bool labelOpen = false;          // Latest label not yet matched by a detection
+  uint32_t labelMs = 0;
+  
+  for (size_t i = 0; i < samples.size(); i++) {
+    const Sample &sample = samples[i];
+    if (sample.label) {
+      labels++;
+      labelOpen = true;
+      labelMs = sample.timestampMs;
+    }
+    
+    if (i > 0) {
+      disaggregator.accumulate(sample.power, (sample.timestampMs - samples[i - 1].timestampMs) / 1000.0f);
+    }
+    
+    ChangeEvent event;
+    if (!detector.update(sample.power, sample.timestampMs, event)) {
+      continue;
+    }
+    disaggregator.onChange(event);
+    
+    bool hit = labelOpen && sample.timestampMs - labelMs <= matchMs;
+    if (hit) {
+      uint32_t delay = sample.timestampMs - labelMs;
+      detected++;
+      delaySum += delay;
+      if (delay > delayMax) {
+        delayMax = delay;
+      }
+      labelOpen = false;
+    } else {
+      falseAlarms++;
+    }
+    
+    if (printEvents) {
+      printf("%10u ms  %-10s %+8.1f W (%.1f -> %.1f W), estimated delay %u samples / %u ms%s\n",
+             (unsigned)event.timestampMs, ChangeDetector::typeName(event.type), event.magnitude,
+             event.before, event.after, (unsigned)event.delaySamples, (unsigned)event.delayMs,
+             hit ? "" : "  FALSE ALARM");
+    }
+  }
+  
+  double hours = (samples.back().timestampMs - samples.front().timestampMs) / 3600000.0;
+  printf("Samples:          %u over %.2f h\n", (unsigned)samples.size(), hours);
+  printf("Parameters:       k=%.2f h=%.2f delta=%.3f lambda=%.1f min-step=%.1f W warmup=%u floor=%.1f W\n",
+         params.cusumK, params.cusumH, params.phDelta, params.phLambda, params.minStep,
+         (unsigned)params.warmupSamples, params.sigmaFloor);
+  printf("Labelled changes: %u\n", (unsigned)labels);
+  printf("Detected:         %u (%u missed)\n", (unsigned)detected, (unsigned)(labels - detected));
+  printf("False alarms:     %u (%.2f per hour)\n", (unsigned)falseAlarms, hours > 0 ? falseAlarms / hours : 0.0);
+  if (detected > 0) {
+    printf("Detection delay:  mean %.0f ms, max %u ms\n", (double)delaySum / detected, (unsigned)delayMax);
+  }
+  
+  if (nilm) {
+    printf("Appliances:\n");
+    for (uint16_t i = 0; i < disaggregator.getCount(); i++) {
+      const ApplianceSignature &appliance = disaggregator.getAppliance(i);
+      printf("  %-12s %7.1f W %6u starts %9.3f kWh\n", appliance.name, appliance.power,
+             (unsigned)appliance.matches, appliance.energyKwh);
+    }
+    printf("  %-12s %24s %9.3f kWh\n", "other", "", disaggregator.getOtherEnergyKwh());
+  }
+  
+  if (modelPath != NULL) {
+    // Word-aligned like the flash mapping
+    static uint32_t blob[65536 / 4];
+    size_t size;
+    if (loadBlob(modelPath, blob, sizeof(blob), size)) {
+      runModel(reinterpret_cast<const uint8_t *>(blob), size, samples);
+    }
+  }
+  
+  size_t modelSize;
+  const uint8_t *bundleModel = bundle.section(BUNDLE_SECTION_MODEL, modelSize);
+  if (bundleModel != NULL) {
+    runModel(bundleModel, modelSize, samples);
+  }
+  
+  if (quantileHorizon > 0) {
+    runQuantiles(samples, quantileHorizon);
+  }
+  
+  if (scaleReadingMs > 0) {
+    runScales(samples, scaleReadingMs, printEvents);
+  }
+  
+  if (stateReadingMs > 0) {
+    runStates(samples, stateReadingMs, printEvents);
+  }
+  
+  return 0;
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Decode binary log frames written by Logger (LOG_BINARY_OUTPUT=1).
+
+Builds the format-string dictionary by scanning the firmware sources for
+LOG_* calls and hashing each format string with FNV-1a, the same id the
+firmware computes at compile time. Bytes outside frames (boot messages,
+console output) are passed through unchanged.
+
+Usage:
+  python3 tools/log_decode.py capture.bin            # decode a capture file
+  python3 tools/log_decode.py --port /dev/ttyUSB0    # live (needs pyserial)
+"""
+
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+LEVEL_TAGS = "EWID"
+LOG_CALL = re.compile(
+    r'LOG_(ERROR|WARN|INFO|DEBUG)(?:_EVERY)?\(\s*(?:[^,"()]+,\s*)?"((?:[^"\\]|\\.)*)"')
+ARG_INT, ARG_UINT, ARG_FLOAT, ARG_STR = range(4)
+CONVERSION = re.compile(r"%[-+ #0-9.]*(?:hh|h|ll|l|z)?([diouxXeEfgGcsp%])")
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def unescape(literal):
+    return literal.encode("latin-1").decode("unicode_escape").encode("latin-1")
+
+
+def build_dictionary(source_dir):
+    formats = {}
+    for path in glob.glob(os.path.join(source_dir, "*.cpp")) + glob.glob(os.path.join(source_dir, "*.h")):
+        with open(path, encoding="utf-8", errors="replace") as f:
+            for match in LOG_CALL.finditer(f.read()):
+                level, literal = match.groups()
+                raw = unescape(literal)
+                formats[fnv1a(raw)] = (level[0], raw.decode("latin-1"))
+    return formats
+
+
+def render(fmt, args):
+    """Apply C-style conversions to decoded arguments, one at a time."""
+    out, index, pos = [], 0, 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        if m.group(1) == "%":
+            out.append("%")
+            continue
+        spec = re.sub(r"(hh|h|ll|l|z)", "", m.group(0))
+        if index >= len(args):
+            out.append("?")
+            continue
+        value = args[index]
+        index += 1
+        try:
+            out.append(spec % value)
+        except TypeError:
+            out.append(str(value))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def parse_frame(payload):
+    site_id, timestamp, suppressed, argc, types = struct.unpack_from("<IIHBB", payload, 0)
+    pos, args = 12, []
+    for i in range(argc):
+        kind = (types >> (2 * i)) & 3
+        if kind == ARG_STR:
+            length = payload[pos]
+            args.append(payload[pos + 1:pos + 1 + length].decode("latin-1"))
+            pos += 1 + length
+        else:
+            (raw,) = struct.unpack_from("<I", payload, pos)
+            pos += 4
+            if kind == ARG_INT:
+                raw = raw - (1 << 32) if raw & 0x80000000 else raw
+            elif kind == ARG_FLOAT:
+                (raw,) = struct.unpack("<f", struct.pack("<I", raw))
+            args.append(raw)
+    return site_id, timestamp, suppressed, args
+
+
+def decode_stream(data, formats, out):
+    """Decode a byte buffer; returns the unconsumed tail (partial frame)."""
+    pos = 0
+    while True:
+        start = data.find(SYNC, pos)
+        if start < 0:
+            keep = 1 if data.endswith(SYNC[:1]) else 0
+            out.write(data[pos:len(data) - keep].decode("latin-1"))
+            return data[len(data) - keep:]
+        out.write(data[pos:start].decode("latin-1"))
+        if start + 3 > len(data):
+            return data[start:]
+        length = data[start + 2]
+        end = start + 3 + length + 1
+        if end > len(data):
+            return data[start:]
+        payload = data[start + 3:start + 3 + length]
+        checksum = 0
+        for b in payload:
+            checksum ^= b
+        if length < 12 or checksum != data[end - 1]:
+            # Not a frame (or corrupted): emit the sync byte as text and resync
+            out.write(data[start:start + 1].decode("latin-1"))
+            pos = start + 1
+            continue
+        site_id, timestamp, suppressed, args = parse_frame(payload)
+        level, fmt = formats.get(site_id, ("?", "<unknown format id 0x%08x>" % site_id))
+        line = "[%10u][%s] %s" % (timestamp, level, render(fmt, args))
+        if suppressed:
+            line += " (+%u suppressed)" % suppressed
+        out.write(line + "\n")
+        pos = end
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("capture", nargs="?", help="raw serial capture file")
+    parser.add_argument("--port", help="serial port to read live")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--src", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."),
+                        help="firmware source directory (default: repository root)")
+    opts = parser.parse_args()
+
+    formats = build_dictionary(opts.src)
+    if opts.port:
+        import serial  # pyserial
+        stream = serial.Serial(opts.port, opts.baud, timeout=0.2)
+        read = lambda: stream.read(4096)
+    elif opts.capture:
+        stream = open(opts.capture, "rb")
+        read = lambda: stream.read(4096)
+    else:
+        read = lambda: sys.stdin.buffer.read(4096)
+
+    pending = b""
+    while True:
+        chunk = read()
+        if not chunk and not opts.port:
+            break
+        pending = decode_stream(pending + chunk, formats, sys.stdout)
+        sys.stdout.flush()
+
+
+if __name__ == "__main__":
+    main()
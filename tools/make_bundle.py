@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""
+Build and check parameter bundles for BundleStore (see ParamBundle.h for
+the layout). A bundle carries named tuning parameters and, optionally, the
+packed model (tools/pack_model.py) and the waveform reference set
+(tools/make_waveform_refs.py), so all of them can be updated without a
+firmware build.
+
+Parameters come from JSON ({"robust_z": 4.0, ...}) or name=value pairs.
+Names the firmware does not know are ignored; missing ones keep their
+Config.h default. The device clamps values to the ranges below and
+replaces NaN or infinite ones with the default, reporting both at boot.
+Known names and ranges:
+
+  robust_z 1-20, robust_min_samples 8-720, critical_ratio 1-10,
+  baseline_z 1-20, trend_window 16-1024, state_reject_sigma 1-10,
+  minute_z_warning 1-50, minute_z_critical 1-50, minute_creep_h 0-100
+  (also quarter_*, hour_*),
+  change_cusum_k 0-5, change_cusum_h 1-100, change_ph_delta 0-5,
+  change_ph_lambda 1-1000, change_min_step 0-10000 (W),
+  change_sigma_floor 0.1-1000 (W), change_warmup 2-10000
+
+The device uses the valid slot with the highest sequence number, which
+defaults to the build time so a newer bundle always wins.
+
+Usage:
+  python3 tools/make_bundle.py bundle.bin --params params.json --model model.bin --waveforms waveforms.bin
+  python3 tools/make_bundle.py bundle.bin --params robust_z=4.5 --params baseline_z=3
+  python3 tools/make_bundle.py --check bundle.bin
+  # then flash it to the slot that is not active (`bundle` console command):
+  esptool.py write_flash 0x3D0000 bundle.bin
+"""
+
+import argparse
+import json
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x444E4245
+VERSION = 1
+NAME_LEN = 20
+SLOT_SIZE = 0x10000
+
+HEADER = struct.Struct("<IHHIIII")
+SECTION = struct.Struct("<IIII")
+PARAM = struct.Struct("<%dsf" % NAME_LEN)
+
+SECTION_PARAMS = 0x4D524150
+SECTION_MODEL = 0x4C444D51
+SECTION_WAVEFORMS = 0x46455257
+SECTION_NAMES = {SECTION_PARAMS: "params", SECTION_MODEL: "model", SECTION_WAVEFORMS: "waveforms"}
+
+# Embedded blobs: header size, totalSize and crc32 offsets
+EMBEDDED = {SECTION_MODEL: (32, 20, 28), SECTION_WAVEFORMS: (60, 52, 56)}
+
+
+def crc_with_zeroed(blob, offset):
+    return zlib.crc32(blob[:offset] + b"\0\0\0\0" + blob[offset + 4:]) & 0xFFFFFFFF
+
+
+def read_params(sources):
+    params = {}
+    for source in sources:
+        if "=" in source:
+            name, value = source.split("=", 1)
+            params[name.strip()] = float(value)
+        else:
+            with open(source) as f:
+                params.update({name: float(value) for name, value in json.load(f).items()})
+    for name in params:
+        if not 0 < len(name.encode()) < NAME_LEN:
+            sys.exit("parameter name '%s' must be 1-%d bytes" % (name, NAME_LEN - 1))
+    return params
+
+
+def build(params, sections, sequence, created):
+    if params:
+        payload = b"".join(PARAM.pack(name.encode(), value) for name, value in sorted(params.items()))
+        sections = [(SECTION_PARAMS, payload)] + sections
+
+    offset = HEADER.size + SECTION.size * len(sections)
+    table = b""
+    body = b""
+    for kind, payload in sections:
+        pad = (-offset) % 4
+        body += b"\0" * pad
+        offset += pad
+        table += SECTION.pack(kind, offset, len(payload), 0)
+        body += payload
+        offset += len(payload)
+
+    fields = [MAGIC, VERSION, len(sections), sequence, offset, created]
+    blob = HEADER.pack(*(fields + [0])) + table + body
+    return HEADER.pack(*(fields + [zlib.crc32(blob) & 0xFFFFFFFF])) + table + body
+
+
+def check(blob):
+    """Returns a list of problems; prints the contents as it goes."""
+    if len(blob) < HEADER.size:
+        return ["shorter than the header"]
+    magic, version, count, sequence, total, created, crc = HEADER.unpack_from(blob)
+    if magic != MAGIC or version != VERSION:
+        return ["bad magic or version"]
+    if total > len(blob) or total < HEADER.size + SECTION.size * count:
+        return ["size mismatch (header says %d, file has %d)" % (total, len(blob))]
+    blob = blob[:total]
+    problems = []
+    if crc_with_zeroed(blob, HEADER.size - 4) != crc:
+        problems.append("CRC mismatch")
+    if total > SLOT_SIZE:
+        problems.append("larger than a %d KB slot" % (SLOT_SIZE // 1024))
+    print("sequence %d, %d bytes, built %s" % (sequence, total,
+                                               time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(created))))
+
+    for i in range(count):
+        kind, offset, size, _ = SECTION.unpack_from(blob, HEADER.size + i * SECTION.size)
+        name = SECTION_NAMES.get(kind, "0x%08x" % kind)
+        print("  %-9s %6d bytes at %d" % (name, size, offset))
+        if offset % 4 or offset + size > total:
+            problems.append("%s section out of bounds" % name)
+            continue
+        payload = blob[offset:offset + size]
+        if kind == SECTION_PARAMS:
+            if size % PARAM.size:
+                problems.append("parameter section size")
+                continue
+            for j in range(0, size, PARAM.size):
+                raw, value = PARAM.unpack_from(payload, j)
+                if raw[-1] != 0:
+                    problems.append("unterminated parameter name")
+                print("    %-19s %g" % (raw.rstrip(b"\0").decode(errors="replace"), value))
+        elif kind in EMBEDDED:
+            header_size, total_offset, crc_offset = EMBEDDED[kind]
+            if size < header_size or struct.unpack_from("<I", payload)[0] != kind:
+                problems.append("%s section is not a %s blob" % (name, name))
+                continue
+            inner_total, inner_crc = (struct.unpack_from("<I", payload, at)[0]
+                                      for at in (total_offset, crc_offset))
+            if inner_total != size or crc_with_zeroed(payload, crc_offset) != inner_crc:
+                problems.append("%s blob size or CRC mismatch" % name)
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build or check a parameter bundle for BundleStore")
+    parser.add_argument("output", help="bundle to write, or to check with --check")
+    parser.add_argument("--params", action="append", default=[], metavar="FILE|NAME=VALUE",
+                        help="parameters as JSON or name=value; repeatable")
+    parser.add_argument("--model", help="packed model (tools/pack_model.py)")
+    parser.add_argument("--waveforms", help="waveform reference set (tools/make_waveform_refs.py)")
+    parser.add_argument("--sequence", type=int, help="sequence number (default: build time)")
+    parser.add_argument("--check", action="store_true", help="validate an existing bundle and list its contents")
+    args = parser.parse_args()
+
+    if args.check:
+        with open(args.output, "rb") as f:
+            problems = check(f.read())
+        for problem in problems:
+            print("error: %s" % problem)
+        sys.exit(1 if problems else 0)
+
+    sections = []
+    for kind, path in ((SECTION_MODEL, args.model), (SECTION_WAVEFORMS, args.waveforms)):
+        if path:
+            with open(path, "rb") as f:
+                sections.append((kind, f.read()))
+    params = read_params(args.params)
+    if not params and not sections:
+        parser.error("nothing to bundle: give --params, --model or --waveforms")
+
+    created = int(time.time())
+    sequence = args.sequence if args.sequence is not None else created
+    blob = build(params, sections, sequence & 0xFFFFFFFF, created)
+    problems = check(blob)
+    if problems:
+        sys.exit("error: %s" % "; ".join(problems))
+    with open(args.output, "wb") as out:
+        out.write(blob)
+    print("%s: %d bytes, sequence %d" % (args.output, len(blob), sequence))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""
+Generate a labelled synthetic power trace for tools/host_replay.cpp.
+
+Simulates a base load with measurement noise, appliances switching on and
+off (steps) and slow ramps (drifts, e.g. a heater warming up). Each change
+is labelled on its first sample, so the replay can score detections,
+misses and false alarms.
+
+Usage:
+  python3 tools/make_trace.py trace.csv --hours 24 --interval-ms 200 --seed 1
+"""
+
+import argparse
+import random
+
+# Appliance loads switched on and off by the simulation (W)
+APPLIANCES = [40, 60, 100, 500, 1200, 2000]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("output")
+    parser.add_argument("--hours", type=float, default=24.0)
+    parser.add_argument("--interval-ms", type=int, default=200)
+    parser.add_argument("--base", type=float, default=120.0, help="base load (W)")
+    parser.add_argument("--noise", type=float, default=4.0, help="measurement noise sigma (W)")
+    parser.add_argument("--events-per-hour", type=float, default=6.0)
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    samples = int(args.hours * 3600000 / args.interval_ms)
+    event_probability = args.events_per_hour * args.interval_ms / 3600000.0
+
+    level = args.base
+    on = [False] * len(APPLIANCES)
+    ramp_left = 0
+    ramp_step = 0.0
+    labels = 0
+    with open(args.output, "w") as out:
+        out.write("timestamp_ms,power_w,label\n")
+        # Leave the first minute quiet for the detector to warm up
+        quiet = int(60000 / args.interval_ms)
+        for i in range(samples):
+            label = 0
+            if i > quiet and ramp_left == 0 and rng.random() < event_probability:
+                label = 1
+                labels += 1
+                if rng.random() < 0.8:
+                    # Toggle one appliance
+                    index = rng.randrange(len(APPLIANCES))
+                    on[index] = not on[index]
+                    level += APPLIANCES[index] if on[index] else -APPLIANCES[index]
+                else:
+                    # Drift of 30-150 W over 2-10 minutes
+                    ramp_left = int(rng.uniform(120000, 600000) / args.interval_ms)
+                    ramp_step = rng.choice([-1, 1]) * rng.uniform(30, 150) / ramp_left
+                    if level + ramp_step * ramp_left < args.base:
+                        ramp_step = -ramp_step
+            if ramp_left > 0:
+                level += ramp_step
+                ramp_left -= 1
+            power = max(0.0, level + rng.gauss(0.0, args.noise))
+            out.write("%d,%.2f,%d\n" % (i * args.interval_ms, power, label))
+
+    print("%d samples, %d labelled changes written to %s" % (samples, labels, args.output))
+
+
+if __name__ == "__main__":
+    main()
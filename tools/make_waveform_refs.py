@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Build the waveform reference set used by KnnClassifier (see KnnClassifier.h
+for the layout) from labelled feature vectors.
+
+The input is CSV with a header row and one vector per line, in the units
+the device prints with the `waveform` console command:
+
+  kind,label,f0,f1,f2,f3,f4,f5,f6,f7
+  transition,kettle,2150,1.02,0,400,0.01,0.00,0.00,0.00
+  transition,fridge,95,5.8,200,1800,0.12,0.05,0.02,0.35
+  steady,laptop,48,2.9,1.3,0.05,0.78,0.52,0.30,1.0
+
+Steady features:     power W, crest, form, h2, h3, h5, h7, thd (ratios)
+Transition features: step W, inrush, rise ms, settle ms, h3, h5, h7 (ratios),
+                     crest change
+
+Per kind, each feature is weighted by the inverse of its spread in the set,
+so no feature dominates the distance by its unit alone. A vector whose
+nearest reference is more than --reject-sigma spreads away in every feature
+is reported as unknown (0 disables the check).
+
+Usage:
+  python3 tools/make_waveform_refs.py vectors.csv waveforms.bin
+  python3 tools/make_waveform_refs.py --demo waveforms.bin   # synthetic set, for pipeline tests
+  # then deploy it in a parameter bundle:
+  python3 tools/make_bundle.py bundle.bin --waveforms waveforms.bin
+"""
+
+import argparse
+import csv
+import math
+import random
+import struct
+import sys
+import zlib
+
+MAGIC = 0x46455257
+VERSION = 1
+FEATURES = 8
+LABEL_LEN = 12
+MAX_K = 7
+KINDS = {"steady": 0, "transition": 1}
+Q = 1 << 10
+TIME_UNIT_MS = 10
+
+HEADER = struct.Struct("<IHHHBB%dH%dIII" % (2 * FEATURES, 2))
+REF = struct.Struct("<BB%dh" % FEATURES)
+
+
+def to_fixed(kind, index, value):
+    """Natural units to the int16 scales of WaveformAnalyzer."""
+    if index == 0:
+        fixed = round(value)
+    elif kind == KINDS["transition"] and index in (2, 3):
+        fixed = round(value / TIME_UNIT_MS)
+    else:
+        fixed = round(value * Q)
+    return max(-32768, min(32767, int(fixed)))
+
+
+def read_vectors(path):
+    vectors = []
+    with open(path, newline="") as f:
+        for row in csv.DictReader(f):
+            kind = KINDS.get(row["kind"].strip())
+            if kind is None:
+                sys.exit("unknown kind %r" % row["kind"])
+            values = [float(row["f%d" % i]) for i in range(FEATURES)]
+            vectors.append((kind, row["label"].strip(), values))
+    return vectors
+
+
+def weights_for(vectors, kind):
+    """Q8 multipliers bringing one standard deviation of each feature to 256."""
+    rows = [[to_fixed(kind, i, v) for i, v in enumerate(values)] for k, _, values in vectors if k == kind]
+    weights = []
+    for i in range(FEATURES):
+        column = [row[i] for row in rows]
+        if len(column) < 2:
+            weights.append(256)
+            continue
+        mean = sum(column) / len(column)
+        spread = math.sqrt(sum((x - mean) ** 2 for x in column) / (len(column) - 1))
+        weights.append(max(1, min(65535, round(256 * 256 / spread))) if spread > 0 else 256)
+    return weights
+
+
+def build(vectors, k, reject_sigma):
+    if not 1 <= k <= MAX_K:
+        sys.exit("k must be between 1 and %d" % MAX_K)
+    labels = sorted(set(label for _, label, _ in vectors))
+    if not labels or len(labels) > 255:
+        sys.exit("need between 1 and 255 labels, got %d" % len(labels))
+    if len(vectors) > 65535:
+        sys.exit("too many vectors")
+    for label in labels:
+        if len(label.encode()) >= LABEL_LEN:
+            sys.exit("label %r is longer than %d characters" % (label, LABEL_LEN - 1))
+
+    weights = [weights_for(vectors, kind) for kind in range(len(KINDS))]
+    reject = round(FEATURES * (reject_sigma * 256) ** 2) if reject_sigma > 0 else 0
+    reject = min(reject, 0xFFFFFFFF)
+
+    body = bytearray()
+    for label in labels:
+        body += label.encode().ljust(LABEL_LEN, b"\0")
+    for kind, label, values in vectors:
+        body += REF.pack(kind, labels.index(label), *[to_fixed(kind, i, v) for i, v in enumerate(values)])
+    total = HEADER.size + len(body)
+
+    fields = [MAGIC, VERSION, FEATURES, len(vectors), len(labels), k] + weights[0] + weights[1] + [reject, reject,
+                                                                                                   total]
+    crc = zlib.crc32(HEADER.pack(*(fields + [0])) + body) & 0xFFFFFFFF
+    return HEADER.pack(*(fields + [crc])) + bytes(body), labels
+
+
+def demo_vectors(per_label=12, seed=1):
+    """Synthetic appliances with noisy features, for testing the pipeline end to end."""
+    rng = random.Random(seed)
+    appliances = {
+        # label: (steady features, transition features)
+        "kettle": ([2200, 1.41, 1.11, 0.01, 0.01, 0.0, 0.0, 0.02], [2200, 1.02, 200, 200, 0.01, 0.0, 0.0, 0.0]),
+        "fridge": ([110, 1.6, 1.13, 0.02, 0.12, 0.05, 0.02, 0.14], [110, 5.5, 200, 1600, 0.12, 0.05, 0.02, 0.15]),
+        "laptop": ([55, 2.9, 1.35, 0.03, 0.8, 0.55, 0.3, 1.02], [55, 1.6, 200, 400, 0.8, 0.55, 0.3, 1.4]),
+        "led": ([12, 3.4, 1.45, 0.05, 0.85, 0.65, 0.4, 1.15], [12, 1.2, 200, 200, 0.85, 0.65, 0.4, 1.9]),
+        "washer": ([450, 1.8, 1.18, 0.05, 0.25, 0.1, 0.05, 0.28], [450, 3.0, 400, 4000, 0.25, 0.1, 0.05, 0.35]),
+    }
+    vectors = []
+    for label, shapes in appliances.items():
+        for kind, shape in enumerate(shapes):
+            for _ in range(per_label):
+                vectors.append((kind, label, [v * rng.gauss(1.0, 0.05) for v in shape]))
+    return vectors
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build the waveform reference set for KnnClassifier")
+    parser.add_argument("vectors", nargs="?", help="labelled feature vectors (CSV)")
+    parser.add_argument("output")
+    parser.add_argument("--k", type=int, default=3, help="neighbours that vote (default 3)")
+    parser.add_argument("--reject-sigma", type=float, default=3.0,
+                        help="nearest distance, in spreads per feature, beyond which a vector is unknown")
+    parser.add_argument("--demo", action="store_true", help="build a synthetic set instead of reading vectors")
+    args = parser.parse_args()
+
+    if args.demo:
+        vectors = demo_vectors()
+    elif args.vectors:
+        vectors = read_vectors(args.vectors)
+    else:
+        parser.error("a vectors file or --demo is required")
+
+    blob, labels = build(vectors, args.k, args.reject_sigma)
+    with open(args.output, "wb") as out:
+        out.write(blob)
+    print("%s: %d bytes, %d references, %d labels (%s)" % (args.output, len(blob), len(vectors), len(labels),
+                                                         ", ".join(labels)))
+
+
+if __name__ == "__main__":
+    main()
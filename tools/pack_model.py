@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+"""
+Quantize a small float model and pack it into the flat int8 blob executed
+by InferenceEngine (see InferenceEngine.h for the layout).
+
+The model is described in JSON, typically exported from the training
+notebook:
+
+  {
+    "kind": "autoencoder",              # autoencoder | classifier | generic
+    "threshold": 2500,                  # reconstruction MSE (W^2) that flags an anomaly
+    "input": {"length": 32, "channels": 1, "range": [0, 4000]},
+    "layers": [
+      {"type": "conv1d", "weights": [[[...]]], "bias": [...], "stride": 1,
+       "padding": "valid", "activation": "relu", "range": [0, 8]},
+      {"type": "maxpool1d", "pool": 2},
+      {"type": "dense", "weights": [[...]], "bias": [...], "range": [0, 4000]},
+      {"type": "sigmoid", "range": [0, 1]}
+    ]
+  }
+
+Weights are [out][in] for dense and [out][kernel][in] for conv1d; "range"
+is the calibrated float range of the layer output. Weights are quantized
+symmetrically per tensor, activations asymmetrically, and the requantization
+multipliers are computed here so the device only does integer arithmetic.
+
+Usage:
+  python3 tools/pack_model.py model.json model.bin
+  python3 tools/pack_model.py --demo-autoencoder 32 model.bin   # random weights, for pipeline tests
+  # then deploy it in a parameter bundle:
+  python3 tools/make_bundle.py bundle.bin --model model.bin
+"""
+
+import argparse
+import json
+import math
+import random
+import struct
+import sys
+import zlib
+
+MAGIC = 0x4C444D51
+VERSION = 1
+KINDS = {"generic": 0, "autoencoder": 1, "classifier": 2}
+TENSOR_INT8, TENSOR_INT32 = 0, 1
+CONST, ARENA = 0, 1
+OP_DENSE, OP_CONV1D, OP_MAXPOOL1D, OP_RELU, OP_LOOKUP = range(5)
+
+HEADER = struct.Struct("<IHBBHHHHIIfI")
+TENSOR = struct.Struct("<IHHifBBH")
+OP = struct.Struct("<BBHHHHHHHibbbB")
+
+
+def activation_params(low, high):
+    """Asymmetric int8 scale and zero point covering [low, high] and 0."""
+    low, high = min(low, 0.0), max(high, 0.0)
+    scale = (high - low) / 255.0 or 1.0
+    zero_point = int(round(-128 - low / scale))
+    return scale, max(-128, min(127, zero_point))
+
+
+def quantize(value, scale, zero_point):
+    return max(-128, min(127, int(round(value / scale)) + zero_point))
+
+
+def multiplier(real):
+    """Q31 multiplier and exponent with real = multiplier * 2^(shift - 31)."""
+    if real == 0.0:
+        return 0, 0
+    mantissa, shift = math.frexp(real)
+    q = int(round(mantissa * (1 << 31)))
+    if q == 1 << 31:
+        q //= 2
+        shift += 1
+    if shift < -31:
+        return 0, 0
+    if shift > 30:
+        sys.exit("requantization multiplier %g out of range" % real)
+    return q, shift
+
+
+def flatten(values):
+    if isinstance(values, list):
+        return [v for item in values for v in flatten(item)]
+    return [float(values)]
+
+
+class Packer:
+    def __init__(self):
+        self.tensors = []
+        self.ops = []
+        self.data = bytearray()
+        self.activations = []      # tensor indices placed in the arena later
+
+    def const(self, payload, length, channels, tensor_type, scale=1.0, zero_point=0):
+        while len(self.data) % 4:
+            self.data.append(0)
+        offset = len(self.data)
+        self.data += payload
+        self.tensors.append([offset, length, channels, zero_point, scale, tensor_type, CONST])
+        return len(self.tensors) - 1
+
+    def activation(self, length, channels, scale, zero_point):
+        self.tensors.append([0, length, channels, zero_point, scale, TENSOR_INT8, ARENA])
+        self.activations.append(len(self.tensors) - 1)
+        return len(self.tensors) - 1
+
+    def op(self, op_type, source, target, weights=0, bias=0, kernel=0, stride=0, padding=0,
+           mult=0, shift=0, act_min=-128, act_max=127):
+        self.ops.append((op_type, 0, source, target, weights, bias, kernel, stride, padding,
+                         mult, shift, act_min, act_max, 0))
+
+
+def clamp_range(layer, zero_point, scale):
+    activation = layer.get("activation", "none")
+    if activation == "relu":
+        return max(-128, zero_point), 127
+    if activation == "relu6":
+        return max(-128, zero_point), quantize(6.0, scale, zero_point)
+    if activation != "none":
+        sys.exit("unsupported fused activation %r" % activation)
+    return -128, 127
+
+
+def pack(spec):
+    packer = Packer()
+    shape = (spec["input"]["length"], spec["input"]["channels"])
+    scale, zero_point = activation_params(*spec["input"]["range"])
+    current = packer.activation(shape[0], shape[1], scale, zero_point)
+    model_input = current
+
+    for layer in spec["layers"]:
+        kind = layer["type"]
+        in_scale, in_zero = packer.tensors[current][4], packer.tensors[current][3]
+
+        if kind in ("dense", "conv1d"):
+            weights = flatten(layer["weights"])
+            w_scale = (max(abs(w) for w in weights) / 127.0) or 1.0
+            q_weights = bytes(struct.pack("<%db" % len(weights), *[quantize(w, w_scale, 0) for w in weights]))
+            bias = [float(b) for b in layer.get("bias", [])]
+            out_channels = len(layer["weights"])
+            bias = bias or [0.0] * out_channels
+            q_bias = struct.pack("<%di" % len(bias), *[int(round(b / (in_scale * w_scale))) for b in bias])
+            out_scale, out_zero = activation_params(*layer["range"])
+            mult, shift = multiplier(in_scale * w_scale / out_scale)
+            act_min, act_max = clamp_range(layer, out_zero, out_scale)
+
+            if kind == "dense":
+                in_count = shape[0] * shape[1]
+                if len(weights) != out_channels * in_count:
+                    sys.exit("dense weights do not match input size %d" % in_count)
+                w_index = packer.const(q_weights, out_channels, in_count, TENSOR_INT8, w_scale)
+                shape = (1, out_channels)
+                kernel = stride = padding = 0
+            else:
+                kernel = len(layer["weights"][0])
+                stride = layer.get("stride", 1)
+                padding = layer.get("padding", "valid")
+                padding = {"valid": 0, "causal": kernel - 1}.get(padding, padding)
+                if len(weights) != out_channels * kernel * shape[1]:
+                    sys.exit("conv1d weights do not match %d input channels" % shape[1])
+                w_index = packer.const(q_weights, out_channels, kernel * shape[1], TENSOR_INT8, w_scale)
+                shape = ((shape[0] + padding - kernel) // stride + 1, out_channels)
+            b_index = packer.const(q_bias, 1, out_channels, TENSOR_INT32)
+            target = packer.activation(shape[0], shape[1], out_scale, out_zero)
+            packer.op(OP_DENSE if kind == "dense" else OP_CONV1D, current, target, w_index, b_index,
+                      kernel, stride, padding, mult, shift, act_min, act_max)
+
+        elif kind == "maxpool1d":
+            pool = layer.get("pool", 2)
+            stride = layer.get("stride", pool)
+            shape = ((shape[0] - pool) // stride + 1, shape[1])
+            target = packer.activation(shape[0], shape[1], in_scale, in_zero)
+            packer.op(OP_MAXPOOL1D, current, target, kernel=pool, stride=stride)
+
+        elif kind in ("relu", "relu6"):
+            act_min = max(-128, in_zero)
+            act_max = quantize(6.0, in_scale, in_zero) if kind == "relu6" else 127
+            target = packer.activation(shape[0], shape[1], in_scale, in_zero)
+            packer.op(OP_RELU, current, target, act_min=act_min, act_max=act_max)
+
+        elif kind in ("sigmoid", "tanh"):
+            function = (lambda x: 1.0 / (1.0 + math.exp(-x))) if kind == "sigmoid" else math.tanh
+            out_scale, out_zero = activation_params(*layer.get("range", [0, 1] if kind == "sigmoid" else [-1, 1]))
+            table = [quantize(function(in_scale * (q - in_zero)), out_scale, out_zero) for q in range(-128, 128)]
+            t_index = packer.const(struct.pack("<256b", *table), 1, 256, TENSOR_INT8)
+            target = packer.activation(shape[0], shape[1], out_scale, out_zero)
+            packer.op(OP_LOOKUP, current, target, weights=t_index)
+
+        else:
+            sys.exit("unsupported layer type %r" % kind)
+
+        current = target
+
+    # The input keeps its own region so the autoencoder score can compare
+    # against it; the layer outputs ping-pong between two more regions
+    region = max(packer.tensors[i][1] * packer.tensors[i][2] for i in packer.activations)
+    region = (region + 3) & ~3
+    for position, index in enumerate(packer.activations):
+        packer.tensors[index][0] = 0 if position == 0 else region * (1 + (position - 1) % 2)
+    arena_size = region * min(len(packer.activations), 3)
+
+    tables = HEADER.size + TENSOR.size * len(packer.tensors) + OP.size * len(packer.ops)
+    for tensor in packer.tensors:
+        if tensor[6] == CONST:
+            tensor[0] += tables
+    body = bytearray()
+    for tensor in packer.tensors:
+        body += TENSOR.pack(tensor[0], tensor[1], tensor[2], tensor[3], tensor[4], tensor[5], tensor[6], 0)
+    for op in packer.ops:
+        body += OP.pack(*op)
+    body += packer.data
+    total = HEADER.size + len(body)
+
+    fields = [MAGIC, VERSION, KINDS[spec.get("kind", "generic")], 0, len(packer.tensors), len(packer.ops),
+              model_input, current, arena_size, total, float(spec.get("threshold", 0.0))]
+    crc = zlib.crc32(HEADER.pack(*(fields + [0])) + body) & 0xFFFFFFFF
+    return HEADER.pack(*(fields + [crc])) + bytes(body), arena_size
+
+
+def demo_autoencoder(length, seed=1):
+    """Random-weight conv + dense autoencoder for testing the pipeline end to end."""
+    rng = random.Random(seed)
+    filters, kernel, hidden = 4, 5, 8
+    conv_length = length - kernel + 1
+    return {
+        "kind": "autoencoder",
+        "threshold": 2500.0,
+        "input": {"length": length, "channels": 1, "range": [0, 4000]},
+        "layers": [
+            {"type": "conv1d", "stride": 1, "padding": "valid", "activation": "relu", "range": [0, 4000],
+             "weights": [[[rng.uniform(-0.5, 0.5)] for _ in range(kernel)] for _ in range(filters)],
+             "bias": [rng.uniform(-10, 10) for _ in range(filters)]},
+            {"type": "maxpool1d", "pool": 2},
+            {"type": "dense", "activation": "relu", "range": [0, 4000],
+             "weights": [[rng.uniform(-0.2, 0.2) for _ in range((conv_length // 2) * filters)] for _ in range(hidden)],
+             "bias": [rng.uniform(-10, 10) for _ in range(hidden)]},
+            {"type": "dense", "range": [0, 4000],
+             "weights": [[rng.uniform(-0.3, 0.3) for _ in range(hidden)] for _ in range(length)],
+             "bias": [rng.uniform(0, 100) for _ in range(length)]},
+        ],
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pack a quantized model for InferenceEngine")
+    parser.add_argument("spec", nargs="?", help="model description (JSON)")
+    parser.add_argument("output")
+    parser.add_argument("--demo-autoencoder", type=int, metavar="LENGTH",
+                        help="pack a random-weight autoencoder instead of a spec")
+    args = parser.parse_args()
+
+    if args.demo_autoencoder:
+        spec = demo_autoencoder(args.demo_autoencoder)
+    elif args.spec:
+        with open(args.spec) as f:
+            spec = json.load(f)
+    else:
+        parser.error("a spec file or --demo-autoencoder is required")
+
+    blob, arena_size = pack(spec)
+    with open(args.output, "wb") as out:
+        out.write(blob)
+    print("%s: %d bytes, %d layers, arena %d bytes" % (args.output, len(blob), len(spec["layers"]), arena_size))
+
+
+if __name__ == "__main__":
+    main()